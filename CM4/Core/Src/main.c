@@ -21,6 +21,7 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "bl_pipe.h"
 
 /* USER CODE END Includes */
 
@@ -103,6 +104,9 @@ int main(void)
   MX_GPIO_Init();
   /* USER CODE BEGIN 2 */
 
+  /* Parse HEX files for the CM7, see bl_pipe.h */
+  BL_Pipe_Worker();
+
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -0,0 +1,83 @@
+/*
+ * bl_bench.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_BENCH_H_
+#define INC_BL_BENCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ff.h"
+
+// End-to-end flashing benchmark: SD card to target flash, verify included.
+//
+// Phase accounting: the upload path switches the current phase with
+// BL_Bench_Enter and goes back with BL_Bench_Leave, the time in between is
+// charged to that phase only. Phases nest, so an SD read or a Write Memory
+// in the middle of parsing is taken out of the parse time. Parse covers
+// the HEX parser, the coalescer and building the image cache, verify every
+// CRC or read back of the target (the diff pass included). Time outside
+// all of them is "other": mount, GET, erase planning.
+//
+// Scenarios: generated HEX files (BL_Bench_Generate) from 4 KiB to 2 MiB,
+// dense or sparse, with different record lengths. BL_Bench_Run writes the
+// file to the card if it isn't there yet, uploads and verifies it and prints
+// one JSON line per run (see tools/bl_bench_compare.py):
+//
+// {"bench":"dense-64k-r16","cache":"cold","target":"sim","baud":115200,
+//  "size":65536,"span":65536,"record":16,"hex_bytes":184330,"ok":true,
+//  "total_us":...,"bytes_per_s":...,"phases_us":{"sd_read":...,...}}
+//
+// Cold runs delete the image cache first, warm runs upload again from it.
+// The link is whatever the bootloader is synced on.
+
+typedef enum {
+    BL_PHASE_OTHER,
+    BL_PHASE_SD_READ,
+    BL_PHASE_PARSE,
+    BL_PHASE_ERASE,
+    BL_PHASE_PROGRAM,
+    BL_PHASE_VERIFY,
+    BL_PHASES
+} BL_Phase_t;
+
+typedef struct {
+    const char *name;
+    uint32_t size;       // data bytes
+    uint32_t chunk;      // contiguous run of data, size for a dense image
+    uint32_t stride;     // start to start distance of the runs
+    uint8_t record_len;  // data bytes per record
+    bool warm;           // also upload a second time from the image cache
+} BL_BenchScenario_t;
+
+typedef struct {
+    bool ok;
+    uint32_t hex_bytes;
+    uint32_t total_us;
+    uint32_t phase_us[BL_PHASES];
+} BL_BenchResult_t;
+
+#define BL_BENCH_FILE_PREFIX "bench_"
+#define BL_BENCH_WRITE_SIZE  4096 // generator buffer, one f_write each
+
+// Phase of the code that follows, returns the phase to go back to
+BL_Phase_t BL_Bench_Enter(BL_Phase_t phase);
+void BL_Bench_Leave(BL_Phase_t previous);
+void BL_Bench_Reset(void);
+// Time per phase since the last reset, the current phase included
+void BL_Bench_Read(uint32_t phase_us[BL_PHASES]);
+
+// Scenario i of the built-in table, NULL past the end
+const BL_BenchScenario_t *BL_Bench_Scenario(uint8_t i);
+// Write the HEX text of s to file, only count it with file NULL. Returns
+// the length of the text, 0 if writing failed.
+uint32_t BL_Bench_Generate(const BL_BenchScenario_t *s, FIL *file);
+// One scenario, cold and then warm if it asks for it. target names the
+// other end in the JSON ("sim", "board", ...).
+bool BL_Bench_Run(const BL_BenchScenario_t *s, const char *target);
+// Every scenario up to max_size data bytes (0: all), true if all passed
+bool BL_Bench_RunSuite(const char *target, uint32_t max_size);
+
+#endif /* INC_BL_BENCH_H_ */
@@ -0,0 +1,22 @@
+/*
+ * bl_crc.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_CRC_H_
+#define INC_BL_CRC_H_
+
+#include <stdint.h>
+
+// Same parameters as the reset configuration of the STM32 CRC unit, which is
+// also what the ROM bootloader uses for Get Checksum: CRC-32 (MPEG-2 style),
+// 32-bit words in memory order, no reflection, no final XOR
+#define BL_CRC_POLYNOMIAL 0x04C11DB7
+#define BL_CRC_INIT       0xFFFFFFFF
+
+void BL_CRC_Init(void);
+// Continue a CRC over length words, start with crc = BL_CRC_INIT
+uint32_t BL_CRC_Update(uint32_t crc, const uint32_t *words, uint32_t length);
+
+#endif /* INC_BL_CRC_H_ */
@@ -0,0 +1,61 @@
+/*
+ * bl_device.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_DEVICE_H_
+#define INC_BL_DEVICE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bl_flash.h"
+#include "bl_erase.h"
+
+// Compiled-in profiles of the target parts, keyed by the product ID the ROM
+// bootloader reports with GET ID. After the sync the profile of the target
+// sets the flash layout for the erase planner, the erase costs for the plan
+// and the erase timeouts, the flash word the coalescer aligns blocks to and
+// the timeout of Write Memory. Parts that aren't in the table (or don't
+// answer GET ID) get the defaults: the layout and costs the engine had
+// before, and the widest flash word of the table, which is safe on all of
+// them.
+//
+// Erase and program times are worst case figures from the datasheets.
+
+// Optional commands of the ROM bootloader of a part
+#define BL_DEVICE_EXTENDED_ERASE 0x01 // 0x44, 16-bit page numbers
+#define BL_DEVICE_GET_CHECKSUM   0x02 // 0xA1
+
+typedef struct {
+    uint16_t pid;             // product ID, 0 for the defaults
+    const char *name;
+    BL_FlashLayout_t layout;
+    uint8_t flash_word;       // bytes programmed at once, a word can only be written once per erase
+    BL_EraseCost_t erase;
+    uint32_t program_ms;      // one 256 byte Write Memory
+    uint32_t max_baudrate;    // fastest rate the ROM keeps up with, 0: no known limit
+    uint8_t commands;         // BL_DEVICE_* the ROM offers
+} BL_Device_t;
+
+// Profile of a product ID, the defaults when it isn't in the table
+const BL_Device_t *BL_Device_Find(uint16_t pid);
+// Profile for a target that reported pid: the pinned one or BL_Device_Find
+const BL_Device_t *BL_Device_Select(uint16_t pid);
+// Take d for every target, whatever it reports. For targets whose geometry
+// is known better than from their ID (the host model), NULL undoes it.
+void BL_Device_Pin(const BL_Device_t *d);
+
+// Set up the flash layout and erase costs of d for the commands that follow
+void BL_Device_Apply(const BL_Device_t *d);
+// Profile applied last, the defaults before the first sync
+const BL_Device_t *BL_Device_Current(void);
+
+// Generous timeout of a Write Memory before the link has a sample of it
+static inline uint32_t BL_Device_ProgramTimeout(const BL_Device_t *d) {
+    return 2 * d->program_ms + 100;
+}
+
+void BL_Device_Report(const BL_Device_t *d, uint16_t pid);
+
+#endif /* INC_BL_DEVICE_H_ */
@@ -0,0 +1,50 @@
+/*
+ * bl_diff.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_DIFF_H_
+#define INC_BL_DIFF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bl_coalesce.h"
+#include "bl_erase.h"
+
+#define BL_DIFF_MAX_SECTORS 1024
+
+// Differential flashing. The image is hashed sector by sector, as the sector
+// will read after a normal erase + program (bytes the image leaves out are
+// 0xFF), and compared with the CRC of the same sector on the target. Only
+// sectors that differ are erased and programmed again.
+//
+// Blocks have to arrive in ascending address order, which is how linkers
+// write HEX files. If they don't, every sector the image touches is flagged.
+typedef struct {
+    uint32_t changed[BL_DIFF_MAX_SECTORS / 32]; // sectors to erase and program
+    uint32_t touched[BL_DIFF_MAX_SECTORS / 32]; // sectors the image covers
+    int32_t sector;      // sector being hashed, -1 if none
+    uint32_t next;       // everything below has been fed to the CRC
+    uint32_t crc;
+    uint32_t window;     // address of the staged block window
+    bool staged;
+    bool full;           // image can't be compared, program every sector
+    uint16_t sectors;    // sectors the image covers
+    uint16_t skipped;    // of which already up to date on the target
+    uint32_t bytes_skipped;
+    uint32_t stage[BL_COALESCE_BLOCK_SIZE / 4];
+} BL_Diff_t;
+
+void BL_Diff_Init(BL_Diff_t *d);
+// Coalescer sink for the hashing pass, compares each sector once it is complete
+bool BL_Diff_Hash(void *ctx, uint32_t address, const uint8_t *data, uint16_t length);
+// Compare the last sector, call after the coalescer has been flushed
+bool BL_Diff_Finish(BL_Diff_t *d);
+// Whether a block at address has to be programmed, addresses outside the
+// flash map always are
+bool BL_Diff_IsChanged(const BL_Diff_t *d, uint32_t address);
+// Mark every changed sector in an erase plan
+void BL_Diff_PlanErase(const BL_Diff_t *d, BL_ErasePlan_t *plan);
+
+#endif /* INC_BL_DIFF_H_ */
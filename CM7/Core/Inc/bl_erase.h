@@ -0,0 +1,78 @@
+/*
+ * bl_erase.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_ERASE_H_
+#define INC_BL_ERASE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Erase planner. The sectors the image covers are marked up front (from the
+// segment table of the image cache, or the changed sectors of a
+// differential upload), then a cost model picks between one mass erase and
+// sector erases. Sector erases happen just in time: the first block written
+// into a sector erases it, together with the next planned sectors up to the
+// batch size. While the target erases, the CM4 keeps parsing and the SD
+// read-ahead keeps reading.
+//
+// Without a plan every sector is found and erased on its own by its first
+// block.
+
+#define BL_ERASE_MAX_SECTORS 1024
+#define BL_ERASE_BUDGET_MS   250 // aim for Erase commands at most this long
+#define BL_ERASE_TIMINGS     64  // Erase commands kept for the report
+// 1: a mass erase is allowed when it is cheaper. It also wipes everything
+// outside the image (data, calibration), so it is off by default.
+#define BL_ERASE_ALLOW_MASS  0
+
+// Worst case erase times of the target flash in ms, plus the round trip of
+// one Erase command without the erase itself
+typedef struct {
+    uint32_t sector_ms;
+    uint32_t mass_ms;
+    uint32_t command_ms;
+} BL_EraseCost_t;
+
+// Figures of the 2 KiB page parts of BL_FLASH_DEFAULT_LAYOUT
+#define BL_ERASE_DEFAULT_COST {25, 25, 2}
+
+typedef struct {
+    uint16_t first;     // first sector of the command, 0xFFFF for a mass erase
+    uint16_t count;
+    uint32_t ms;
+} BL_EraseTiming_t;
+
+typedef struct {
+    uint32_t touched[BL_ERASE_MAX_SECTORS / 32]; // sectors the image covers
+    uint32_t erased[BL_ERASE_MAX_SECTORS / 32];  // sectors erased so far
+    uint16_t sectors;   // planned sectors
+    uint16_t batch;     // sectors per Erase command
+    bool mass;          // the whole flash was erased up front
+
+    // Report
+    uint16_t commands;
+    uint32_t total_ms;
+    uint16_t timing_count;
+    BL_EraseTiming_t timings[BL_ERASE_TIMINGS];
+} BL_ErasePlan_t;
+
+void BL_Erase_SetCost(const BL_EraseCost_t *cost);
+const BL_EraseCost_t *BL_Erase_GetCost(void);
+
+void BL_Erase_Init(BL_ErasePlan_t *p);
+// Mark the sectors under an address range, addresses outside the flash are ignored
+void BL_Erase_Touch(BL_ErasePlan_t *p, uint32_t address, uint32_t length);
+void BL_Erase_TouchSector(BL_ErasePlan_t *p, uint16_t sector);
+// Run the cost model over the marked sectors, a chosen mass erase runs right away
+bool BL_Erase_Plan(BL_ErasePlan_t *p, bool allow_mass);
+// Erase the sectors under a block that aren't erased yet, call before writing it
+bool BL_Erase_Before(BL_ErasePlan_t *p, uint32_t address, uint32_t length);
+// Take the sectors under a block as erased without erasing them, for blocks
+// that are on the target already (resumed uploads)
+void BL_Erase_Keep(BL_ErasePlan_t *p, uint32_t address, uint32_t length);
+void BL_Erase_Report(const BL_ErasePlan_t *p);
+
+#endif /* INC_BL_ERASE_H_ */
@@ -0,0 +1,42 @@
+/*
+ * bl_flash.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_FLASH_H_
+#define INC_BL_FLASH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BL_FLASH_MAX_REGIONS 4
+
+// Run of equally sized sectors (pages on the smaller parts)
+typedef struct {
+    uint32_t sector_size;
+    uint16_t count;
+} BL_FlashRegion_t;
+
+// Sector map of the target flash, regions follow each other from base up.
+// Sector numbers are the ones the Erase commands expect.
+typedef struct {
+    uint32_t base;
+    uint8_t region_count;
+    BL_FlashRegion_t regions[BL_FLASH_MAX_REGIONS];
+} BL_FlashLayout_t;
+
+// Layout used until BL_Flash_SetLayout is called: 2 KiB pages from
+// 0x08000000, which is what most of the single bank parts look like
+#define BL_FLASH_DEFAULT_LAYOUT {0x08000000, 1, {{2048, 512}}}
+
+void BL_Flash_SetLayout(const BL_FlashLayout_t *layout);
+const BL_FlashLayout_t *BL_Flash_GetLayout(void);
+
+uint16_t BL_Flash_SectorCount(void);
+// Sector holding address, -1 if it isn't in flash
+int32_t BL_Flash_SectorOf(uint32_t address);
+uint32_t BL_Flash_SectorStart(uint16_t sector);
+uint32_t BL_Flash_SectorSize(uint16_t sector);
+
+#endif /* INC_BL_FLASH_H_ */
@@ -0,0 +1,53 @@
+/*
+ * bl_gang.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_GANG_H_
+#define INC_BL_GANG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bootloader.h"
+#include "bl_erase.h"
+
+#define BL_GANG_MAX_TARGETS 4
+// The image is parsed once into RAM and sent to every target from there
+#define BL_GANG_IMAGE_SIZE  (256 * 1024)
+#define BL_GANG_MAX_BLOCKS  2048
+
+typedef enum {
+    BL_GANG_IDLE,
+    BL_GANG_CONNECTING,
+    BL_GANG_WRITING,
+    BL_GANG_VERIFYING,
+    BL_GANG_DONE,
+    BL_GANG_FAILED,
+} BL_GangState_t;
+
+// One target of the gang. A target that fails drops out, the others go on.
+typedef struct {
+    const char *name;
+    BL_TargetReset_t reset;   // puts this target into its ROM bootloader
+    BL_Target_t target;       // command state, the link lives in target.link
+    BL_ErasePlan_t erase;     // sectors of the image, erased before their first block
+    BL_GangState_t state;
+    BL_GangState_t failed_in; // phase the target failed in
+    uint32_t failed_address;  // block that failed while writing
+    uint32_t bytes;
+    uint32_t connect_ms;
+    uint32_t write_ms;
+    uint32_t verify_ms;
+} BL_GangTarget_t;
+
+void BL_Gang_InitTarget(BL_GangTarget_t *g, const char *name, BL_Transport_t *link, BL_TargetReset_t reset);
+// Parse the HEX file (or its image cache) into the RAM image
+bool BL_Gang_LoadImage(const char *filename);
+// Connect, write and verify all targets, returns how many passed
+uint8_t BL_Gang_Run(BL_GangTarget_t *targets, uint8_t count, const uint32_t *ladder, uint8_t ladder_count);
+// Start the user application on every target that passed
+void BL_Gang_StartApps(BL_GangTarget_t *targets, uint8_t count);
+void BL_Gang_Report(const BL_GangTarget_t *targets, uint8_t count);
+
+#endif /* INC_BL_GANG_H_ */
@@ -0,0 +1,72 @@
+/*
+ * bl_image.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_IMAGE_H_
+#define INC_BL_IMAGE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bl_coalesce.h"
+
+// Binary image cache. The first upload of a HEX file converts it into a
+// sidecar file (source name + BL_IMAGE_EXT) that holds the data as sorted,
+// merged segments, so later uploads stream it with large reads instead of
+// parsing text. The header records the size, timestamp and CRC of the
+// source file, the cache is rebuilt as soon as one of them changes.
+//
+// File layout: header, segment table, segment data. Every segment starts
+// word aligned, the padding after a segment is 0xFF.
+
+#define BL_IMAGE_MAGIC        0x43494C42 // "BLIC"
+#define BL_IMAGE_VERSION      1
+#define BL_IMAGE_EXT          ".img"
+#define BL_IMAGE_MAX_SEGMENTS 64
+#define BL_IMAGE_READ_SIZE    4096
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t segment_count;
+    uint32_t source_size;   // size of the HEX file
+    uint16_t source_date;   // FAT timestamp of the HEX file
+    uint16_t source_time;
+    uint32_t source_crc;    // CRC of the HEX file contents
+    uint32_t start_address; // from the 0x05 record, 0xFFFFFFFF if none
+    uint32_t data_size;     // bytes after the segment table
+    uint32_t data_crc;      // CRC of those bytes
+} BL_ImageHeader_t;
+
+typedef struct {
+    uint32_t address;
+    uint32_t length;
+    uint32_t offset;        // file offset of the data
+} BL_ImageSegment_t;
+
+typedef struct {
+    BL_ImageHeader_t header;
+    BL_ImageSegment_t segments[BL_IMAGE_MAX_SEGMENTS];
+    bool overflow;          // image has too many segments to be cached
+} BL_Image_t;
+
+// Read the header and segment table of the cache of source, fails if there
+// is none or it is out of date
+bool BL_Image_Load(BL_Image_t *img, const char *source);
+// Push the data of a loaded cache into the coalescer, in address order.
+// Fails at the end, after the last push, when the data CRC doesn't match.
+bool BL_Image_Stream(BL_Image_t *img, BL_Coalescer_t *c);
+
+// Building the cache takes two passes over the source. The first one feeds
+// BL_Image_Collect to find the segments, the second one BL_Image_Place to
+// store the data. Both are coalescer sinks.
+bool BL_Image_BuildBegin(BL_Image_t *img, const char *source);
+bool BL_Image_Collect(void *ctx, uint32_t address, const uint8_t *data, uint16_t length);
+bool BL_Image_BuildLayout(BL_Image_t *img);
+bool BL_Image_Place(void *ctx, uint32_t address, const uint8_t *data, uint16_t length);
+bool BL_Image_BuildEnd(BL_Image_t *img, uint32_t start_address);
+// Drop a half built cache
+void BL_Image_BuildAbort(BL_Image_t *img);
+
+#endif /* INC_BL_IMAGE_H_ */
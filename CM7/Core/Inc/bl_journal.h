@@ -0,0 +1,90 @@
+/*
+ * bl_journal.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_JOURNAL_H_
+#define INC_BL_JOURNAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ff.h"
+#include "bl_erase.h"
+
+// Progress journal of an upload, so a failed upload picks up where it broke
+// off instead of erasing and writing everything again. The journal is a
+// sidecar file (source name + BL_JOURNAL_EXT) holding one checkpoint: how
+// many blocks of the coalescer's stream are on the target, the last of them
+// as read back from the target, and the erase state of the plan. It is
+// rewritten at most every BL_JOURNAL_INTERVAL_MS and deleted once the upload
+// went through.
+//
+// The stream of a source is the same on every run (same file, same image
+// cache), so a resumed upload runs it again and skips the blocks up to the
+// checkpoint. Their sectors are not erased again. Blocks after the
+// checkpoint that went out before the failure are in those sectors too, the
+// ones already on the target are skipped and the rest are written.
+
+#define BL_JOURNAL_MAGIC       0x524A4C42 // "BLJR"
+#define BL_JOURNAL_VERSION     1
+#define BL_JOURNAL_EXT         ".jnl"
+#define BL_JOURNAL_INTERVAL_MS 1000
+#define BL_JOURNAL_CACHED      0x0001     // the stream came from the image cache
+#define BL_JOURNAL_WORD_SHIFT  8          // flags bits 8..15: flash word the blocks were padded to
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t source_size;   // size and FAT timestamp of the HEX file
+    uint16_t source_date;
+    uint16_t source_time;
+    uint32_t blocks;        // blocks of the stream on the target
+    uint32_t bytes;         // their payload
+    uint32_t last_address;  // word aligned span of the last of them
+    uint32_t last_length;
+    uint32_t last_crc;      // CRC of that span read back from the target
+    uint32_t erased[BL_ERASE_MAX_SECTORS / 32]; // sectors erased by then
+    uint32_t crc;           // of the record up to here
+} BL_JournalRecord_t;
+
+typedef enum {
+    BL_JOURNAL_WRITE,       // erase and write the block
+    BL_JOURNAL_SKIP,        // the block is on the target already
+    BL_JOURNAL_FAIL,        // the target doesn't match the journal
+} BL_JournalAction_t;
+
+typedef struct {
+    FIL file;
+    bool open;
+    BL_JournalRecord_t record;  // checkpoint being resumed from, then the last one written
+    uint32_t resume_blocks;     // blocks to skip, 0 for a fresh upload
+    uint32_t kept[BL_ERASE_MAX_SECTORS / 32]; // sectors with skipped blocks, not erased again
+    uint32_t blocks;            // blocks of the stream so far
+    uint32_t bytes;
+    uint32_t last_ms;           // time of the last checkpoint
+
+    // Report
+    uint32_t skipped_bytes;     // not sent again
+    uint16_t checkpoints;
+} BL_Journal_t;
+
+// Open the journal of source, resume from its checkpoint when it belongs to
+// the same file and stream and the last block is still on the target
+bool BL_Journal_Begin(BL_Journal_t *j, const char *source, bool cached);
+static inline bool BL_Journal_Resuming(const BL_Journal_t *j) {
+    return j->resume_blocks > 0;
+}
+// Before a block goes out: what to do with it. Skipped blocks mark their
+// sectors as erased in the plan.
+BL_JournalAction_t BL_Journal_Check(BL_Journal_t *j, BL_ErasePlan_t *plan, uint32_t address,
+                                    const uint8_t *data, uint16_t length);
+// After a block was written, takes a checkpoint when it is due
+bool BL_Journal_Written(BL_Journal_t *j, const BL_ErasePlan_t *plan, uint32_t address,
+                        const uint8_t *data, uint16_t length);
+// Close the journal, it is deleted when the upload is done
+void BL_Journal_End(BL_Journal_t *j, bool done);
+void BL_Journal_Report(const BL_Journal_t *j);
+
+#endif /* INC_BL_JOURNAL_H_ */
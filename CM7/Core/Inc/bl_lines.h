@@ -0,0 +1,53 @@
+/*
+ * bl_lines.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_LINES_H_
+#define INC_BL_LINES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ff.h"
+#include "bl_hex.h"
+
+// Line reader for text files on the SD card, in place of f_gets (which
+// costs one f_read per character). The file comes in with large sector
+// aligned f_read calls, so FatFs moves whole runs of sectors by DMA
+// straight into the buffer, and lines are found with a word at a time
+// newline scan. Lines are handed out where they are in the buffer, with
+// the CR/LF replaced by a NUL. A line cut by the end of the buffer is moved
+// in front of the next read so it comes out in one piece.
+
+#define BL_LINES_READ_SIZE 8192 // bytes per f_read, a multiple of the sector size
+#define BL_LINES_MAX       ((BL_HEX_LINE_MAX + 31) & ~31) // carry area for a cut line, a multiple of 32
+
+// Valid until the next call, NUL terminated, CR/LF not included
+typedef struct {
+    char *text;
+    uint32_t length;
+} BL_Line_t;
+
+typedef struct {
+    FIL *file;
+    uint32_t pos;       // next unread byte of buf
+    uint32_t end;       // end of the valid bytes
+    bool eof;           // nothing left to read from the file
+    bool error;
+    uint32_t lines;
+    uint32_t reads;     // f_read calls
+    // Carry area for a cut line, then the read area (32 byte aligned for
+    // the cache maintenance of the SD DMA), then room for the scan sentinel
+    uint8_t buf[BL_LINES_MAX + BL_LINES_READ_SIZE + 4] __attribute__((aligned(32)));
+} BL_LineReader_t;
+
+// Start reading file (opened for reading) from its current position, which
+// should be sector aligned for the reads to bypass the FatFs sector buffer
+void BL_LineReader_Init(BL_LineReader_t *r, FIL *file);
+// Next line, text NULL at the end of the file. False on a read error or a
+// line that doesn't fit BL_HEX_LINE_MAX with its CR and terminator, the
+// limit the CM4 side of the pipe has too.
+bool BL_LineReader_Next(BL_LineReader_t *r, BL_Line_t *line);
+
+#endif /* INC_BL_LINES_H_ */
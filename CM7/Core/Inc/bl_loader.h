@@ -0,0 +1,141 @@
+/*
+ * bl_loader.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_LOADER_H_
+#define INC_BL_LOADER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bl_transport.h"
+
+// RAM flash loader. A small stub, built for the target family and stored on
+// the SD card, is written into the target's SRAM with Write Memory and
+// started with Go. From then on the programmer speaks the stub's streaming
+// protocol instead of the ROM bootloader's:
+//
+// - frames carry up to payload_max bytes (4 KiB) instead of 256
+// - up to window frames are on the wire before the first ACK is needed,
+//   lost or corrupted frames are sent again from the first missing one
+// - header and payload are protected by a CRC-32 (bl_crc.h parameters, so
+//   the stub can use its CRC unit)
+// - the stub erases a sector just before the first write into it and
+//   receives the next frame while the flash is busy
+// - payloads can be PackBits compressed, which shrinks the 0xFF padding
+//   and constant tables of an image
+//
+// The stub image starts with its vector table (initial SP, reset handler),
+// which is what Go expects. If it can't be loaded the ROM bootloader is
+// still running and the upload goes the old way.
+
+#define BL_LOADER_FILE          "loader.bin"
+#define BL_LOADER_RAM_ADDRESS   0x20004000 // above the RAM the ROM bootloader uses
+#define BL_LOADER_WINDOW_MAX    4
+#define BL_LOADER_PAYLOAD_MAX   4096
+#define BL_LOADER_HELLO_TIMEOUT 500
+#define BL_LOADER_ACK_TIMEOUT   1000 // covers a sector erase
+#define BL_LOADER_RETRIES       3
+
+/* ********************** Protocol ****************************** */
+
+#define BL_LDR_SYNC_HOST 0xA5
+#define BL_LDR_SYNC_STUB 0x5A
+#define BL_LDR_VERSION   1
+
+// Frame types, host to stub
+#define BL_LDR_PROGRAM   0x01 // program raw_length bytes at address
+#define BL_LDR_CHECKSUM  0x02 // CRC of address, payload: length (word)
+#define BL_LDR_GO        0x03 // ACK, then jump to the vector table at address
+
+// Response types, stub to host
+#define BL_LDR_HELLO     0x80 // sent once after start, status = BL_LDR_VERSION
+#define BL_LDR_ACK       0x81
+#define BL_LDR_NACK      0x82 // only for the first frame the stub drops
+#define BL_LDR_RESULT    0x83 // ACK of a CHECKSUM, value = CRC
+
+// Response status
+#define BL_LDR_OK        0x00
+#define BL_LDR_ERR_CRC   0x01 // frame corrupted, send again
+#define BL_LDR_ERR_SEQ   0x02 // frame out of order, send again
+#define BL_LDR_ERR_FLASH 0x03 // erase or program failed at value
+#define BL_LDR_ERR_RANGE 0x04 // address outside the flash
+#define BL_LDR_ERR_FRAME 0x05 // unknown type, bad length or bad compression
+
+// Header flags and HELLO capabilities
+#define BL_LDR_FLAG_PACKBITS 0x01
+#define BL_LDR_CAP_PACKBITS  0x01
+
+// Host to stub: header, length payload bytes (a multiple of 4), CRC-32 of
+// both. All fields little endian.
+typedef struct __attribute__((packed)) {
+    uint8_t sync;
+    uint8_t type;
+    uint8_t seq;          // frame number, wraps at 256
+    uint8_t flags;
+    uint32_t address;
+    uint16_t length;      // payload bytes on the wire
+    uint16_t raw_length;  // bytes to program once decoded
+} BL_LoaderHeader_t;
+
+// Stub to host, CRC-32 over the first two words.
+// HELLO value: window (bits 0-7), capabilities (8-15), payload_max (16-31)
+typedef struct __attribute__((packed)) {
+    uint8_t sync;
+    uint8_t type;
+    uint8_t seq;
+    uint8_t status;
+    uint32_t value;
+    uint32_t crc;
+} BL_LoaderResponse_t;
+
+#define BL_LOADER_FRAME_MAX (sizeof(BL_LoaderHeader_t) + BL_LOADER_PAYLOAD_MAX + 4)
+
+/* ********************** Host side ****************************** */
+
+typedef enum {
+    BL_LOADER_STARTED,      // stub is running
+    BL_LOADER_UNAVAILABLE,  // no stub, the ROM bootloader is still in charge
+    BL_LOADER_LOST,         // stub started but didn't answer, target needs a reset
+} BL_LoaderStart_t;
+
+typedef struct BL_Loader {
+    BL_Transport_t *link;
+    uint8_t window;
+    uint8_t caps;
+    uint16_t payload_max;
+    uint32_t head;          // frames sent
+    uint32_t tail;          // frames acknowledged
+    uint8_t retries;        // resends of the current tail frame
+    uint32_t result;        // value of the last RESULT
+
+    // Frame being assembled from coalescer blocks
+    uint32_t pending_address;
+    uint16_t pending_length;
+    uint8_t pending[BL_LOADER_PAYLOAD_MAX] __attribute__((aligned(4)));
+
+    // Frames on the wire, kept until acknowledged
+    uint8_t frames[BL_LOADER_WINDOW_MAX][BL_LOADER_FRAME_MAX] __attribute__((aligned(4)));
+    uint16_t frame_length[BL_LOADER_WINDOW_MAX];
+
+    // Statistics
+    uint32_t raw_bytes;     // bytes programmed
+    uint32_t wire_bytes;    // payload bytes sent, after compression
+    uint32_t frame_count;
+    uint32_t resent;
+    uint32_t start_ms;
+} BL_Loader_t;
+
+// Load the stub from filename through the ROM bootloader of the selected
+// target and wait for its HELLO
+BL_LoaderStart_t BL_Loader_Start(BL_Loader_t *l, const char *filename, uint32_t ram_address);
+// Coalescer sink, merges contiguous blocks into full frames
+bool BL_Loader_Write(void *ctx, uint32_t address, const uint8_t *data, uint16_t length);
+// Send the partial frame and wait until every frame is acknowledged
+bool BL_Loader_Sync(BL_Loader_t *l);
+bool BL_Loader_Checksum(BL_Loader_t *l, uint32_t address, uint32_t length, uint32_t *crc);
+bool BL_Loader_Go(BL_Loader_t *l, uint32_t address);
+void BL_Loader_Report(const BL_Loader_t *l);
+
+#endif /* INC_BL_LOADER_H_ */
@@ -0,0 +1,69 @@
+/*
+ * bl_log.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_LOG_H_
+#define INC_BL_LOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32h7xx_hal.h"
+
+// Console log on USART1 that never waits for the UART. Records go into a
+// lock-free ring (any number of producers, thread or interrupt), the UART
+// interrupt renders them into a DMA buffer and sends it, so the cost at
+// the call site is reserving a few words of the ring and copying into it.
+//
+// Two kinds of records:
+// - text: printf and everything else on stdout/stderr ends up here through
+//   _write, already formatted by newlib (stdout is line buffered)
+// - deferred: BL_LOG stores the format pointer and up to BL_LOG_ARGS_MAX
+//   arguments, the formatting happens later in the drain. Arguments must be
+//   32 bits or less (no double, no long long), and %s only with strings
+//   that are still there when the line goes out (literals, statics).
+//
+// When the ring is full the overflow policy decides: DROP loses the record
+// (counted, and reported in the log once there is room again), BLOCK waits
+// for the UART to make room. Interrupt handlers and code running with
+// interrupts off always drop, they can't wait for the drain.
+
+#define BL_LOG_RING_WORDS 2048 // ring size in 32-bit words, power of two
+#define BL_LOG_TX_SIZE    512  // DMA buffer, one transfer at most
+#define BL_LOG_LINE_MAX   160  // longest rendered deferred line
+#define BL_LOG_TEXT_MAX   128  // text is split into records of this size
+#define BL_LOG_ARGS_MAX   8
+#define BL_LOG_IRQ_PRIORITY 6  // below the bootloader transport (1)
+
+typedef enum {
+    BL_LOG_DROP,
+    BL_LOG_BLOCK,
+} BL_LogPolicy_t;
+
+#define BL_LOG_DEFAULT_POLICY BL_LOG_DROP
+
+// Number of arguments, 0 to BL_LOG_ARGS_MAX
+#define BL_LOG_NARGS(...) BL_LOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define BL_LOG_NARGS_(z, a1, a2, a3, a4, a5, a6, a7, a8, n, ...) n
+
+// Deferred printf, see above
+#define BL_LOG(fmt, ...) BL_Log_Deferred(fmt, BL_LOG_NARGS(__VA_ARGS__), ##__VA_ARGS__)
+
+// Take over huart, whose hdmatx (normal mode) is linked in HAL_UART_MspInit.
+// irq is the UART interrupt, its handler has to call BL_Log_Drain after
+// HAL_UART_IRQHandler. Records logged before this wait in the ring.
+bool BL_Log_Init(UART_HandleTypeDef *huart, IRQn_Type irq);
+void BL_Log_SetPolicy(BL_LogPolicy_t policy);
+
+void BL_Log_Deferred(const char *fmt, uint8_t nargs, ...);
+// Copy text into the ring, returns the bytes taken
+uint32_t BL_Log_Write(const char *text, uint32_t length);
+
+// Start the next DMA transfer if the UART is idle, UART interrupt only
+void BL_Log_Drain(void);
+// Wait until everything logged so far is sent, false on timeout (ms)
+bool BL_Log_Flush(uint32_t timeout);
+uint32_t BL_Log_Dropped(void);
+
+#endif /* INC_BL_LOG_H_ */
@@ -0,0 +1,33 @@
+/*
+ * bl_perf.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_PERF_H_
+#define INC_BL_PERF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Boot-time self-check of the clock and cache profile. Prints the clocks the
+// core actually runs at and times a fixed parse + checksum workload: HEX
+// text through the parser and coalescer into the CRC unit, the same path an
+// upload takes minus the UART. Needs the DWT counter (BL_Trace_Init).
+
+#define BL_PERF_RECORDS    256 // data records of the generated HEX text
+#define BL_PERF_RECORD_LEN 16
+#define BL_PERF_ITERATIONS 8
+
+typedef struct {
+    uint32_t sysclk_hz;
+    uint32_t hclk_hz;
+    uint32_t cycles;      // best of BL_PERF_ITERATIONS parse passes
+    uint32_t text_bytes;  // HEX text per pass
+    uint32_t score;       // passes per second
+    bool checksum_ok;     // parsed image matches the generated data
+} BL_PerfResult_t;
+
+bool BL_Perf_SelfCheck(BL_PerfResult_t *result);
+
+#endif /* INC_BL_PERF_H_ */
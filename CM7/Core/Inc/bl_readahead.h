@@ -0,0 +1,58 @@
+/*
+ * bl_readahead.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_READAHEAD_H_
+#define INC_BL_READAHEAD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ff.h"
+#include "bl_sd.h"
+
+// Double-buffered read-ahead for files on the SD card. The file's cluster
+// chain is resolved once with a fast-seek link map, after that the reader
+// goes around FatFs and queues multi-sector reads (bl_sd) straight into two
+// buffers. While the caller works on one buffer the SDMMC fills the other.
+// FatFs accesses in between queue up behind the read in flight.
+
+#define BL_READAHEAD_SECTORS  16 // sectors per buffer (8 KiB)
+#define BL_READAHEAD_MAP_SIZE 64 // link map entries, up to 31 fragments
+#define BL_READAHEAD_TIMEOUT  1000
+
+// Read-only view into a read-ahead buffer, valid until the next call
+typedef struct {
+    const uint8_t *data;
+    uint32_t length;
+} BL_Span_t;
+
+typedef struct {
+    FIL *file;
+    DWORD map[BL_READAHEAD_MAP_SIZE]; // cluster link map of the file
+    uint32_t size;      // file size
+    uint32_t issued;    // file offset of the next read to start
+    uint32_t length[2]; // valid bytes in each buffer
+    uint8_t fill;       // buffer the DMA is writing to
+    bool busy;          // a read into buffers[fill] is in flight
+    BL_SdRequest_t req; // that read
+
+    // Throughput counters
+    uint32_t bytes;     // bytes handed out
+    uint32_t reads;     // DMA requests issued
+    uint32_t wait_ms;   // time the caller spent waiting for the card
+    uint32_t start_ms;
+    uint32_t elapsed_ms;
+} BL_ReadAhead_t;
+
+// Start reading file (opened for reading, at offset 0). Fails when the link
+// map does not fit, the caller then falls back to f_read.
+bool BL_ReadAhead_Open(BL_ReadAhead_t *r, FIL *file);
+// Next part of the file, length 0 at the end. The previous span is released.
+bool BL_ReadAhead_Next(BL_ReadAhead_t *r, BL_Span_t *span);
+// Wait for a read still in flight and give the card back to FatFs
+void BL_ReadAhead_Close(BL_ReadAhead_t *r);
+void BL_ReadAhead_Report(const BL_ReadAhead_t *r);
+
+#endif /* INC_BL_READAHEAD_H_ */
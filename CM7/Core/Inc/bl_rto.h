@@ -0,0 +1,98 @@
+/*
+ * bl_rto.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_RTO_H_
+#define INC_BL_RTO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Adaptive timeouts of the waits for the ROM bootloader, the way TCP sets
+// its retransmission timeout (RFC 6298). Every wait belongs to a class with
+// its own smoothed latency (srtt) and mean deviation (rttvar), learned from
+// the ACKs that came in. The wire time of the bytes on the line is taken
+// out of the samples and added back to the timeout, so the estimates hold
+// at any baud rate. Erase and Get Checksum scale with their size, their
+// estimates are per page and per KiB.
+//
+//     timeout = wire time + units * (srtt + max(2 ms, 4 * rttvar))
+//
+// Until the first sample the caller's fixed timeout is used. A timeout
+// doubles the next one of the class (up to BL_RTO_BACKOFF_MAX times) until
+// an ACK comes in again. Samples of retried commands are ambiguous and not
+// taken (Karn's algorithm).
+
+#define BL_RTO_MIN_MS       3      // floor of every timeout, ticks are 1 ms
+#define BL_RTO_VAR_MIN_US   2000   // floor of 4 * rttvar: a sample can be a tick off at both ends
+#define BL_RTO_MAX_MS       60000
+#define BL_RTO_BACKOFF_MAX  4
+#define BL_RTO_RETRIES      3      // per command, each after a resync
+#define BL_RTO_SYNC_MS      1000   // 0x7F is sent again until this is up
+#define BL_RTO_BUCKETS      16     // timeout histogram, bucket n: [2^n, 2^(n+1)) ms
+
+typedef enum {
+    BL_RTO_REPLY,       // ACK of a command, word or length frame
+    BL_RTO_PROGRAM,     // final ACK of Write Memory
+    BL_RTO_ERASE,       // final ACK of Erase, per page
+    BL_RTO_MASS_ERASE,  // final ACK of a mass erase
+    BL_RTO_CHECKSUM,    // final ACK of Get Checksum, per KiB
+    BL_RTO_CLASSES
+} BL_RtoClass_t;
+
+typedef struct {
+    uint32_t srtt_us;     // per unit, without the wire time
+    uint32_t rttvar_us;
+    uint8_t backoff;      // timeouts since the last sample
+
+    // Report
+    uint32_t waits;
+    uint32_t samples;
+    uint32_t timeouts;
+    uint32_t max_us;      // largest sample
+    uint32_t histogram[BL_RTO_BUCKETS]; // timeouts handed out
+} BL_RtoEstimator_t;
+
+// Estimates and retry counters of one target, all zero is a fresh start
+typedef struct {
+    BL_RtoEstimator_t cls[BL_RTO_CLASSES];
+    bool retrying;        // the command is being retried, no samples
+
+    // Report
+    uint32_t retries;     // commands sent again
+    uint32_t resyncs;
+    uint32_t recovered;   // commands that went through on a retry
+    uint32_t failed;      // commands that failed on every retry
+} BL_Rto_t;
+
+// One wait for an ACK, from when its frame was queued
+typedef struct {
+    BL_RtoClass_t cls;
+    uint32_t units;
+    uint32_t wire_us;
+    uint32_t start;
+    uint32_t deadline;
+} BL_RtoWait_t;
+
+// Time bytes take on the line (8E1), 0 when the rate isn't known
+uint32_t BL_Rto_WireUs(uint32_t baudrate, uint32_t bytes);
+// Timeout of a wait in ms, initial_ms until the class has a sample
+uint32_t BL_Rto_Timeout(const BL_Rto_t *r, BL_RtoClass_t cls, uint32_t units, uint32_t wire_us,
+                        uint32_t initial_ms);
+
+// A frame was queued at now, w gets the deadline of its ACK
+void BL_Rto_Begin(BL_Rto_t *r, BL_RtoWait_t *w, BL_RtoClass_t cls, uint32_t units, uint32_t wire_us,
+                  uint32_t initial_ms, uint32_t now);
+// The ACK came in at now, while waiting for it
+void BL_Rto_Sample(BL_Rto_t *r, const BL_RtoWait_t *w, uint32_t now);
+// Nothing came in before the deadline
+void BL_Rto_Expired(BL_Rto_t *r, const BL_RtoWait_t *w);
+
+// A command went through (or failed) after attempt retries
+void BL_Rto_Done(BL_Rto_t *r, uint8_t attempt, bool ok);
+
+void BL_Rto_Report(const BL_Rto_t *r);
+
+#endif /* INC_BL_RTO_H_ */
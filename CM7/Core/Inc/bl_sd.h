@@ -0,0 +1,99 @@
+/*
+ * bl_sd.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_SD_H_
+#define INC_BL_SD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Asynchronous sector I/O on the SD card. Requests go into a submission
+// queue and run one after the other as SDMMC1 DMA transfers, each one
+// completes from the SDMMC interrupt: state set, optional callback, event
+// for sleepers. Nothing spins while the card works. After a write the card
+// is busy programming until it answers CMD13 with TRANSFER again, that is
+// checked once per SysTick by whoever waits (BL_Sd_Wait, BL_Sd_Sync)
+// instead of in a loop. A request queued behind a write starts then too.
+// SysTick only flags a transfer past its deadline, the waiter aborts it.
+//
+// Buffers have to be in AXI SRAM (the IDMA can't reach the other memories)
+// and 4 byte aligned. The cache lines they cover are cleaned before a write
+// and invalidated after a read, so callers do no cache maintenance.
+//
+// The SDMMC and SysTick interrupts share priority 0, BL_Sd_Submit masks
+// interrupts briefly, so the queue needs no other locking.
+
+#define BL_SD_QUEUE_DEPTH   8  // power of two
+#define BL_SD_HIST_BUCKETS  12 // latency histogram, bucket n < 64 us << n, the last one the rest
+
+typedef enum {
+    BL_SD_READ,
+    BL_SD_WRITE,
+} BL_SdOp_t;
+
+typedef enum {
+    BL_SD_IDLE,
+    BL_SD_QUEUED,
+    BL_SD_ACTIVE,
+    BL_SD_DONE,
+    BL_SD_FAILED,
+} BL_SdState_t;
+
+typedef struct BL_SdRequest BL_SdRequest_t;
+
+// Called from the interrupt that finished the request
+typedef void (*BL_SdCallback_t)(BL_SdRequest_t *req);
+
+struct BL_SdRequest {
+    BL_SdOp_t op;
+    uint8_t *data;
+    uint32_t sector;
+    uint32_t count;        // sectors
+    uint32_t timeout;      // ms from submission until it fails
+    BL_SdCallback_t done;  // may be NULL
+    void *ctx;
+
+    // Owned by bl_sd while queued or active
+    volatile BL_SdState_t state;
+    uint32_t deadline;     // HAL tick
+    uint32_t submitted;    // DWT cycles
+    uint32_t started;
+};
+
+// Latency from submission to completion, per operation
+typedef struct {
+    uint32_t requests;
+    uint32_t errors;
+    uint32_t sectors;
+    uint32_t total_us;
+    uint32_t queued_us;    // part of total_us spent waiting in the queue
+    uint32_t max_us;
+    uint32_t hist[BL_SD_HIST_BUCKETS];
+} BL_SdStats_t;
+
+// Queue req (filled in up to ctx), false if the queue is full or req is bad
+bool BL_Sd_Submit(BL_SdRequest_t *req);
+// Sleep until req has finished, true if it succeeded
+bool BL_Sd_Wait(BL_SdRequest_t *req);
+// Blocking transfer through the queue, for the FatFs disk driver
+bool BL_Sd_Transfer(BL_SdOp_t op, uint8_t *data, uint32_t sector, uint32_t count, uint32_t timeout);
+// Sleep until the queue is empty and the card has finished programming
+bool BL_Sd_Sync(uint32_t timeout);
+
+static inline bool BL_Sd_Pending(const BL_SdRequest_t *req) {
+    return req->state == BL_SD_QUEUED || req->state == BL_SD_ACTIVE;
+}
+
+// Interrupt side: SDMMC completion and error callbacks, and SysTick
+void BL_Sd_TransferDone(void);
+void BL_Sd_TransferError(void);
+void BL_Sd_Tick(void);
+
+void BL_Sd_ResetStats(void);
+const BL_SdStats_t *BL_Sd_Stats(BL_SdOp_t op);
+void BL_Sd_Report(void);
+
+#endif /* INC_BL_SD_H_ */
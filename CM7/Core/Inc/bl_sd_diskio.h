@@ -0,0 +1,28 @@
+/*
+ * bl_sd_diskio.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_SD_DISKIO_H_
+#define INC_BL_SD_DISKIO_H_
+
+#include <stdbool.h>
+#include "ff_gen_drv.h"
+
+// FatFs disk driver on the bl_sdcache sector cache and the bl_sd request
+// queue, in place of the CubeMX generated SD_Driver
+// (FATFS/Target/sd_diskio.c), which polls the card and is rewritten on
+// every code generation. MX_FATFS_Init links the generated
+// driver, BL_SdDiskio_Link swaps this one in on the same drive.
+//
+// Transfers complete through SD callbacks registered on hsd1
+// (USE_HAL_SD_REGISTER_CALLBACKS), so the BSP completion callbacks of the
+// generated driver are never called.
+
+extern const Diskio_drvTypeDef BL_SdDiskio_Driver;
+
+// Replace the driver linked on path, false if that fails
+bool BL_SdDiskio_Link(char *path);
+
+#endif /* INC_BL_SD_DISKIO_H_ */
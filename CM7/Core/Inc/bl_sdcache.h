@@ -0,0 +1,64 @@
+/*
+ * bl_sdcache.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_SDCACHE_H_
+#define INC_BL_SDCACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Write-back LRU sector cache between the FatFs disk driver (bl_sd_diskio.c)
+// and the card (bl_sd). FatFs keeps a single sector window per volume, so
+// every FAT chain step, directory sector and small read is a card command of
+// its own. Here those sectors stay around:
+//  - Misses of neighbouring sectors are read with one multi-block command,
+//    and a miss that continues the previous read also reads ahead.
+//  - Writes only mark the sectors dirty. Dirty sectors go to the card on
+//    CTRL_SYNC or when one has to be evicted, sorted, adjacent ones as one
+//    multi-block command.
+//  - Sectors of the FAT are kept over other sectors, up to
+//    BL_SDCACHE_PIN_MAX of them.
+// Large requests (file data read or written straight into FatFs callers'
+// buffers) go around the cache, the cached copies are kept coherent.
+//
+// The sector buffers are in AXI SRAM (.bss), which the SDMMC1 IDMA reaches.
+// Not reentrant, like the FatFs disk driver above it.
+
+#define BL_SDCACHE_LINES   64 // cached sectors (32 KiB)
+#define BL_SDCACHE_RUN     8  // sectors per coalesced command and per read-ahead
+#define BL_SDCACHE_BYPASS  8  // requests of this many sectors go straight to the card
+#define BL_SDCACHE_PIN_MAX 24 // FAT sectors kept against eviction
+#define BL_SDCACHE_BUCKETS 32 // hash buckets, power of two
+#define BL_SDCACHE_TIMEOUT (30 * 1000)
+
+typedef struct {
+    uint32_t hits;       // sectors read from the cache
+    uint32_t misses;     // sectors read from the card
+    uint32_t ahead;      // sectors read ahead
+    uint32_t ahead_hits; // of those, read later
+    uint32_t bypass;     // sectors of large requests
+    uint32_t writes;     // sectors written into the cache
+    uint32_t writebacks; // dirty sectors written to the card
+    uint32_t commands;   // card commands, read and write
+    uint32_t evictions;
+} BL_SdCacheStats_t;
+
+// Disk driver side, count sectors of 512 bytes
+bool BL_SdCache_Read(uint8_t *buff, uint32_t sector, uint32_t count);
+bool BL_SdCache_Write(const uint8_t *buff, uint32_t sector, uint32_t count);
+// Write all dirty sectors to the card
+bool BL_SdCache_Flush(void);
+// After the card was (re)initialised: the cache is kept for the same card
+// and dropped for another one
+void BL_SdCache_Attach(void);
+
+// Keep sectors [sector, sector + count) over others, for the FAT
+void BL_SdCache_Pin(uint32_t sector, uint32_t count);
+
+const BL_SdCacheStats_t *BL_SdCache_Stats(void);
+void BL_SdCache_Report(void);
+
+#endif /* INC_BL_SDCACHE_H_ */
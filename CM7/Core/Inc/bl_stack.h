@@ -0,0 +1,26 @@
+/*
+ * bl_stack.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_STACK_H_
+#define INC_BL_STACK_H_
+
+#include <stdint.h>
+
+// Stack high water mark. BL_Stack_Paint fills the unused part of the
+// reserved stack (_Min_Stack_Size below _estack) with a pattern,
+// BL_Stack_Peak finds the deepest word that was overwritten since.
+// Only the reserved stack is painted, the heap sits right below it.
+
+#define BL_STACK_PATTERN 0xA5A5A5A5
+
+void BL_Stack_Paint(void);
+// Deepest stack use since the last paint in bytes, the reserved size if the
+// whole reservation was used (the stack may have run into the heap)
+uint32_t BL_Stack_Peak(void);
+uint32_t BL_Stack_Size(void);
+void BL_Stack_Report(const char *what);
+
+#endif /* INC_BL_STACK_H_ */
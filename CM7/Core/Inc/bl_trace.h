@@ -0,0 +1,45 @@
+/*
+ * bl_trace.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_TRACE_H_
+#define INC_BL_TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32h7xx_hal.h"
+
+// Phase timing of the bootloader commands with the DWT cycle counter.
+// Every command starts a trace with BL_Trace_Begin, each phase then stores
+// the cycles since the previous mark in a RAM ring. The ring keeps the last
+// BL_TRACE_DEPTH phases and is dumped as CSV, tools/bl_trace_hist.py turns
+// a dump into latency histograms.
+
+#define BL_TRACE_DEPTH 512 // phases kept, power of two
+
+typedef enum {
+    BL_TRACE_CMD_ACK,   // command byte + complement until its ACK
+    BL_TRACE_ADDR_ACK,  // address (or other word parameter) until its ACK
+    BL_TRACE_PAYLOAD,   // data sent or received
+    BL_TRACE_FINAL_ACK, // until the ACK that ends the command
+    BL_TRACE_DEFERRED,  // queued write until its ACK is collected, the work overlapped with programming
+    BL_TRACE_PHASES
+} BL_TracePhase_t;
+
+typedef struct {
+    uint32_t cycles; // duration of the phase
+    uint8_t command; // bootloader command code
+    uint8_t phase;   // BL_TracePhase_t
+    bool ok;         // phase completed (ACK received, data moved)
+} BL_TraceEntry_t;
+
+void BL_Trace_Init(void);
+void BL_Trace_Begin(uint8_t command);
+void BL_Trace_Mark(BL_TracePhase_t phase, bool ok);
+void BL_Trace_Clear(void);
+// Write the ring oldest first as CSV: seq,cmd,phase,cycles,us,ok
+void BL_Trace_Dump(UART_HandleTypeDef *huart);
+
+#endif /* INC_BL_TRACE_H_ */
@@ -0,0 +1,93 @@
+/*
+ * bl_transport.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_TRANSPORT_H_
+#define INC_BL_TRANSPORT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// RX ring size, must be a power of two and larger than the biggest response (257 bytes)
+#define BL_TRANSPORT_RX_SIZE 1024
+// Size of one TX slot: length byte + 256 data bytes + checksum
+#define BL_TRANSPORT_TX_SIZE 260
+#define BL_TRANSPORT_TX_SLOTS 2
+
+// Place transports driven by DMA1/DMA2 here. The section is in RAM_D3,
+// which the MPU maps non-cacheable, so no cache maintenance is needed.
+// Nothing in it is zeroed at startup.
+#define BL_DMA_BUFFER __attribute__((section(".dma_buffer")))
+
+typedef struct BL_Transport BL_Transport_t;
+
+// One piece of a frame, see BL_Transport_SendV
+typedef struct {
+    const uint8_t *data;
+    uint16_t length;
+} BL_TransportSpan_t;
+
+// Backend operations. start_tx is called with the transport lock-free from
+// thread or ISR context and must only start the transfer, completion is
+// signalled with BL_Transport_TxDone(). rx_poll updates rx_head, either by
+// reading the DMA position or by pushing bytes with BL_Transport_RxPush().
+typedef struct {
+    bool (*start_tx)(BL_Transport_t *t, const uint8_t *data, uint16_t length);
+    void (*rx_poll)(BL_Transport_t *t);
+    void (*rx_reset)(BL_Transport_t *t);
+    uint32_t (*get_tick)(void);
+    void (*idle)(BL_Transport_t *t); // optional, called while waiting
+    bool (*set_baudrate)(BL_Transport_t *t, uint32_t baudrate); // optional
+} BL_TransportOps_t;
+
+struct BL_Transport {
+    const BL_TransportOps_t *ops;
+    void *ctx;
+
+    // RX ring, written by the backend (DMA or ISR), read by the command layer
+    uint8_t rx_buf[BL_TRANSPORT_RX_SIZE] __attribute__((aligned(32)));
+    volatile uint16_t rx_head;
+    uint16_t rx_tail;
+
+    // TX slots, one can be on the wire while the next one is being filled
+    uint8_t tx_buf[BL_TRANSPORT_TX_SLOTS][BL_TRANSPORT_TX_SIZE] __attribute__((aligned(32)));
+    uint16_t tx_len[BL_TRANSPORT_TX_SLOTS];
+    volatile uint8_t tx_queued;  // slots filled but not completed yet
+    uint8_t tx_fill;             // next slot to fill
+    volatile uint8_t tx_active;  // slot currently on the wire
+
+    uint32_t baudrate;  // current line rate, 0 if unknown
+    uint32_t rx_overruns;
+};
+
+void BL_Transport_Init(BL_Transport_t *t, const BL_TransportOps_t *ops, void *ctx);
+
+// Time helpers, deadlines are absolute ticks (ms)
+uint32_t BL_Transport_Now(BL_Transport_t *t);
+uint32_t BL_Transport_Deadline(BL_Transport_t *t, uint32_t timeout_ms);
+
+// Queue a frame for transmission and return as soon as it is copied,
+// fails if no slot frees up before the deadline
+bool BL_Transport_Send(BL_Transport_t *t, const uint8_t *data, uint16_t length, uint32_t deadline);
+// Same for a frame made of several spans (header, payload, trailer), which
+// are gathered straight into the TX slot and sent as one transfer
+bool BL_Transport_SendV(BL_Transport_t *t, const BL_TransportSpan_t *spans, uint8_t count, uint32_t deadline);
+// Wait until every queued frame has left the UART
+bool BL_Transport_WaitTx(BL_Transport_t *t, uint32_t deadline);
+
+// Receive exactly length bytes from the RX ring or fail at the deadline
+bool BL_Transport_Receive(BL_Transport_t *t, uint8_t *data, uint16_t length, uint32_t deadline);
+uint16_t BL_Transport_Available(BL_Transport_t *t);
+// Drop everything received so far
+void BL_Transport_Flush(BL_Transport_t *t);
+
+// Change the line rate, drops everything queued or received
+bool BL_Transport_SetBaudrate(BL_Transport_t *t, uint32_t baudrate);
+
+// Backend hooks
+void BL_Transport_TxDone(BL_Transport_t *t);
+void BL_Transport_RxPush(BL_Transport_t *t, const uint8_t *data, uint16_t length);
+
+#endif /* INC_BL_TRANSPORT_H_ */
@@ -0,0 +1,20 @@
+/*
+ * bl_transport_uart.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_TRANSPORT_UART_H_
+#define INC_BL_TRANSPORT_UART_H_
+
+#include "bl_transport.h"
+#include "stm32h7xx_hal.h"
+
+// Number of UARTs that can be bound to a transport at the same time
+#define BL_TRANSPORT_UART_MAX 4
+
+// Bind a transport to a UART whose hdmarx (circular) and hdmatx (normal)
+// handles are linked in HAL_UART_MspInit. Starts the RX DMA right away.
+bool BL_TransportUart_Init(BL_Transport_t *t, UART_HandleTypeDef *huart);
+
+#endif /* INC_BL_TRANSPORT_UART_H_ */
@@ -0,0 +1,46 @@
+/*
+ * bl_verify.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_VERIFY_H_
+#define INC_BL_VERIFY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BL_VERIFY_MAX_RANGES 64
+
+// A contiguous written range. The CRC covers the word aligned span around
+// the written bytes, bytes that share a word with the image but weren't
+// written are taken as erased (0xFF), like the ROM bootloader pads them.
+// Blocks that follow on in the same or the next word extend the range.
+// Once the table is full a range also grows over gaps in flash, up to the
+// end of the sector and on into the next one, with the gap taken as erased:
+// every sector a block goes to is erased before it is written.
+typedef struct {
+    uint32_t address;   // word aligned start
+    uint32_t end;       // exclusive end of the written bytes
+    uint32_t crc;       // running CRC of the words completed so far
+} BL_VerifyRange_t;
+
+typedef struct {
+    BL_VerifyRange_t ranges[BL_VERIFY_MAX_RANGES];
+    uint16_t count;
+    bool open;          // last range can still be extended
+    bool overflow;      // more ranges than fit even sector by sector
+    bool coarse;        // ranges were grown over gaps to fit the table
+    uint32_t stage;     // partial word at the end of the open range
+} BL_Verify_t;
+
+void BL_Verify_Init(BL_Verify_t *v);
+// Record a block that was written to the target
+void BL_Verify_Track(BL_Verify_t *v, uint32_t address, const uint8_t *data, uint16_t length);
+// Compare every recorded range with the target, using Get Checksum when
+// the bootloader supports it and Read Memory otherwise
+bool BL_Verify_Run(BL_Verify_t *v);
+// CRC of a word aligned span of target memory, same method as BL_Verify_Run
+bool BL_Verify_TargetCrc(uint32_t address, uint32_t length, uint32_t *crc);
+
+#endif /* INC_BL_VERIFY_H_ */
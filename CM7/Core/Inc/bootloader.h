@@ -11,11 +11,18 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "bl_transport.h"
+#include "bl_verify.h"
+#include "bl_coalesce.h"
+#include "bl_loader.h"
+#include "bl_rto.h"
+#include "bl_device.h"
 
 // Acknowledge and Error Codes
 #define BL_ACK              0x79
 #define BL_NACK             0x1F
 #define BL_INIT_FRAME       0x7F
+#define BL_RESYNC_FILLER    0x02 // completes any frame the ROM waits for with a bad checksum, see BL_Resync
 
 // Bootloader Commands
 #define BL_CMD_GET          0x00 // Get the version and commands supported
@@ -24,8 +31,8 @@
 #define BL_CMD_READ_MEMORY  0x11 // Read from memory
 #define BL_CMD_GO           0x21 // Jump to user application code
 #define BL_CMD_WRITE_MEMORY 0x31 // Write to memory
-#define BL_CMD_ERASE        0x43 // Erase memory (or 0x44 for extended erase)
-#define BL_CMD_EXTENDED_ERASE 0x44
+#define BL_CMD_ERASE        0x43 // Erase memory, 8-bit page numbers
+#define BL_CMD_EXTENDED_ERASE 0x44 // Erase memory, 16-bit page numbers
 #define BL_CMD_WRITE_PROTECT 0x63 // Write protect certain sectors
 #define BL_CMD_WRITE_UNPROTECT 0x73 // Remove write protection
 #define BL_CMD_READOUT_PROTECT 0x82 // Activate readout protection
@@ -35,11 +42,45 @@
 // Complement calculations (for safety)
 #define BL_COMPLEMENT(x) (~(x))
 
+// Pages per Erase command, keeps the payload inside one TX slot
+#define BL_ERASE_PAGES_MAX  128
+
 // UART buffer size configuration
 #define BL_UART_BUFFER_SIZE 256
 
+// Baud rates tried by BL_InitBootloaderAutoBaud, fastest first
+#define BL_BAUD_LADDER {1000000, 921600, 460800, 230400, 115200}
+
+// Puts the target back into its ROM bootloader (reset with BOOT0 high)
+typedef void (*BL_TargetReset_t)(void);
+
+// State of one target device, see BL_SelectTarget
+typedef struct {
+    BL_Transport_t *link;       // transport the commands run on
+    uint8_t supported_cmd[15];  // command list from GET
+    uint16_t supported_cmd_len;
+    uint8_t version;            // bootloader version from GET
+    uint16_t pid;               // product ID from GET ID, 0 if it didn't answer
+    const BL_Device_t *device;  // profile picked after the sync
+    bool ack_pending;           // final ACK of the last Write Memory not read yet
+    uint32_t pending_address;
+    uint16_t pending_length;
+    uint8_t pending_data[256];  // kept to write it again when it fails
+    BL_RtoWait_t pending_wait;
+    BL_Rto_t rto;               // adaptive timeouts and retry counters
+    BL_Verify_t verify;         // CRCs of everything written, for the verify pass
+    BL_Loader_t *loader;        // RAM flash loader in charge, NULL: ROM bootloader
+} BL_Target_t;
+
 // UART transmission function prototypes
+void BL_SelectTarget(BL_Target_t *t);
+BL_Target_t *BL_GetTarget(void);
+void BL_SetTransport(BL_Transport_t *transport);
+BL_Transport_t *BL_GetTransport(void);
 bool BL_InitBootloader(void);
+bool BL_InitBootloaderAutoBaud(const uint32_t *ladder, uint8_t count, BL_TargetReset_t reset);
+bool BL_WaitPendingAck(void);
+bool BL_HasCommand(uint8_t cmd);
 bool BL_Get(uint8_t *buffer, uint16_t max_len, uint16_t *out_len);
 bool BL_GetID(uint8_t *buffer, uint16_t max_len, uint16_t *out_len);
 bool BL_GetVersion(uint8_t *version);
@@ -49,9 +90,15 @@ bool BL_ReadMemory(uint32_t address, uint8_t *data, uint16_t length);
 void BL_Hexdump(const void *buffer, size_t length);
 void BL_ReadMemoryHexdump(uint32_t address, uint16_t length);
 bool BL_WriteMemory(uint32_t address, const uint8_t *data, uint16_t length);
-bool BL_EraseMemory(uint16_t *page_numbers, uint16_t num_pages);
+bool BL_EraseMemory(const uint16_t *pages, uint16_t count, uint32_t timeout);
+bool BL_MassErase(uint32_t timeout);
+bool BL_GetChecksum(uint32_t address, uint32_t length, uint32_t *crc);
 
 bool BL_Mount_FS(void);
+bool BL_StartFlashLoader(const char *filename, uint32_t ram_address);
+bool BL_LoadHexImage(const char *filename, BL_BlockWriter_t writer, void *ctx);
 bool BL_UploadHexFile(const char *filename);
+bool BL_UploadHexFileDiff(const char *filename);
+bool BL_VerifyUpload(void);
 
 #endif /* INC_BOOTLOADER_H_ */
@@ -0,0 +1,306 @@
+/*
+ * bl_bench.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_bench.h"
+#include "bl_flash.h"
+#include "bl_image.h"
+#include "bootloader.h"
+#include <stdio.h>
+
+#if defined(USE_HAL_DRIVER)
+#include "stm32h7xx_hal.h"
+
+#define BL_BENCH_WRAP_MS 4000 // well inside a CYCCNT wrap, 10.7 s at 400 MHz
+
+// DWT cycles (BL_Trace_Init starts the counter), widened with the tick
+// count so a phase that runs longer than a wrap of CYCCNT still adds up
+static uint64_t BL_Bench_Now(void) {
+    static uint32_t last_cycles, last_tick;
+    static uint64_t total;
+    uint32_t cycles = DWT->CYCCNT;
+    uint32_t tick = HAL_GetTick();
+
+    if (tick - last_tick >= BL_BENCH_WRAP_MS) {
+        total += (uint64_t)(tick - last_tick) * (SystemCoreClock / 1000);
+    } else {
+        total += cycles - last_cycles;
+    }
+    last_cycles = cycles;
+    last_tick = tick;
+    return total;
+}
+
+static uint32_t BL_Bench_Us(uint64_t ticks) {
+    return (uint32_t)(ticks / (SystemCoreClock / 1000000));
+}
+#else
+#include <time.h>
+
+static uint64_t BL_Bench_Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t BL_Bench_Us(uint64_t ticks) {
+    return (uint32_t)(ticks / 1000);
+}
+#endif
+
+static const char *const phase_names[BL_PHASES] = {
+    "other", "sd_read", "parse", "erase", "program", "verify"
+};
+
+// 4 KiB to 2 MiB of data. The sparse images are 32 runs each, which keeps
+// them inside the segment table of the image cache and the verify ranges.
+static const BL_BenchScenario_t scenarios[] = {
+    {"dense-4k-r16",    4 * 1024,    4 * 1024,    4 * 1024,    16, false},
+    {"dense-64k-r16",   64 * 1024,   64 * 1024,   64 * 1024,   16, false},
+    {"dense-64k-r32",   64 * 1024,   64 * 1024,   64 * 1024,   32, false},
+    {"dense-64k-r64",   64 * 1024,   64 * 1024,   64 * 1024,   64, false},
+    {"sparse-64k-r16",  64 * 1024,   2 * 1024,    16 * 1024,   16, false},
+    {"dense-256k-r32",  256 * 1024,  256 * 1024,  256 * 1024,  32, true},
+    {"sparse-256k-r32", 256 * 1024,  8 * 1024,    64 * 1024,   32, false},
+    {"dense-1m-r32",    1024 * 1024, 1024 * 1024, 1024 * 1024, 32, false},
+    {"dense-2m-r32",    2048 * 1024, 2048 * 1024, 2048 * 1024, 32, false},
+};
+
+static uint64_t phase_ticks[BL_PHASES];
+static BL_Phase_t current;
+static uint64_t last;
+
+/* ********************** Phase accounting ****************************** */
+
+static void BL_Bench_Charge(void) {
+    uint64_t now = BL_Bench_Now();
+    phase_ticks[current] += now - last;
+    last = now;
+}
+
+BL_Phase_t BL_Bench_Enter(BL_Phase_t phase) {
+    BL_Phase_t previous = current;
+    BL_Bench_Charge();
+    current = phase;
+    return previous;
+}
+
+void BL_Bench_Leave(BL_Phase_t previous) {
+    BL_Bench_Charge();
+    current = previous;
+}
+
+void BL_Bench_Reset(void) {
+    for (uint8_t i = 0; i < BL_PHASES; i++) {
+        phase_ticks[i] = 0;
+    }
+    current = BL_PHASE_OTHER;
+    last = BL_Bench_Now();
+}
+
+void BL_Bench_Read(uint32_t phase_us[BL_PHASES]) {
+    BL_Bench_Charge();
+    for (uint8_t i = 0; i < BL_PHASES; i++) {
+        phase_us[i] = BL_Bench_Us(phase_ticks[i]);
+    }
+}
+
+/* ********************** Image generator ****************************** */
+
+typedef struct {
+    FIL *file;
+    uint32_t used;    // bytes in buf
+    uint32_t total;   // bytes of text so far
+    bool ok;
+} BL_BenchWriter_t;
+
+static char buf[BL_BENCH_WRITE_SIZE];
+
+static void BL_Bench_Flush(BL_BenchWriter_t *w) {
+    UINT n;
+    if (w->file != NULL && w->used > 0 &&
+        (f_write(w->file, buf, w->used, &n) != FR_OK || n != w->used)) {
+        w->ok = false;
+    }
+    w->used = 0;
+}
+
+static void BL_Bench_PutByte(BL_BenchWriter_t *w, uint8_t value) {
+    static const char digits[] = "0123456789ABCDEF";
+    buf[w->used++] = digits[value >> 4];
+    buf[w->used++] = digits[value & 0x0F];
+    w->total += 2;
+}
+
+// One record into buf. Without a file the text is only counted.
+static void BL_Bench_Record(BL_BenchWriter_t *w, uint8_t type, uint16_t address, const uint8_t *data, uint8_t length) {
+    // ':' + header + data + checksum + CRLF
+    if (w->used + 1 + 2 * (4 + length + 1) + 2 > sizeof(buf)) {
+        BL_Bench_Flush(w);
+    }
+    uint8_t sum = length + (address >> 8) + (address & 0xFF) + type;
+
+    buf[w->used++] = ':';
+    w->total++;
+    BL_Bench_PutByte(w, length);
+    BL_Bench_PutByte(w, address >> 8);
+    BL_Bench_PutByte(w, address & 0xFF);
+    BL_Bench_PutByte(w, type);
+    for (uint8_t i = 0; i < length; i++) {
+        BL_Bench_PutByte(w, data[i]);
+        sum += data[i];
+    }
+    BL_Bench_PutByte(w, (uint8_t)(~sum + 1));
+    buf[w->used++] = '\r';
+    buf[w->used++] = '\n';
+    w->total += 2;
+}
+
+uint32_t BL_Bench_Generate(const BL_BenchScenario_t *s, FIL *file) {
+    BL_BenchWriter_t w = { file, 0, 0, true };
+    uint32_t base = BL_Flash_GetLayout()->base;
+    uint32_t x = 0x2545F491; // xorshift, the same contents on every run
+    uint32_t upper = 0xFFFFFFFF;
+    uint8_t data[255];
+
+    for (uint32_t run = 0; run < s->size / s->chunk; run++) {
+        uint32_t address = base + run * s->stride;
+        uint32_t end = address + s->chunk;
+
+        while (address < end) {
+            // Records never cross a 64 KiB boundary
+            uint32_t length = end - address;
+            if (length > s->record_len) {
+                length = s->record_len;
+            }
+            if (length > 0x10000 - (address & 0xFFFF)) {
+                length = 0x10000 - (address & 0xFFFF);
+            }
+            if ((address >> 16) != upper) {
+                upper = address >> 16;
+                uint8_t ela[2] = { upper >> 8, upper & 0xFF };
+                BL_Bench_Record(&w, 0x04, 0, ela, 2);
+            }
+            for (uint32_t i = 0; i < length; i++) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                data[i] = (uint8_t)x;
+            }
+            BL_Bench_Record(&w, 0x00, address & 0xFFFF, data, length);
+            address += length;
+        }
+    }
+    BL_Bench_Record(&w, 0x01, 0, NULL, 0);
+    BL_Bench_Flush(&w);
+    return w.ok ? w.total : 0;
+}
+
+/* ********************** Runner ****************************** */
+
+static uint32_t BL_Bench_Span(const BL_BenchScenario_t *s) {
+    return (s->size / s->chunk - 1) * s->stride + s->chunk;
+}
+
+static bool BL_Bench_Fits(const BL_BenchScenario_t *s) {
+    const BL_FlashLayout_t *layout = BL_Flash_GetLayout();
+    uint32_t size = 0;
+    for (uint8_t i = 0; i < layout->region_count; i++) {
+        size += layout->regions[i].sector_size * layout->regions[i].count;
+    }
+    return BL_Bench_Span(s) <= size;
+}
+
+// Generate the HEX file unless the card already has one of the right length
+static bool BL_Bench_Prepare(const BL_BenchScenario_t *s, const char *name, uint32_t *hex_bytes) {
+    static FIL file;
+    FILINFO info;
+
+    *hex_bytes = BL_Bench_Generate(s, NULL);
+    if (f_stat(name, &info) == FR_OK && info.fsize == *hex_bytes) {
+        return true;
+    }
+
+    printf("Bench: generating %s, %lu bytes\n", name, (unsigned long)*hex_bytes);
+    if (f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+        return false;
+    }
+    bool ok = BL_Bench_Generate(s, &file) == *hex_bytes;
+    return f_close(&file) == FR_OK && ok;
+}
+
+static void BL_Bench_Print(const BL_BenchScenario_t *s, const char *cache, const char *target,
+                           const BL_BenchResult_t *r) {
+    const BL_Transport_t *link = BL_GetTransport();
+
+    printf("{\"bench\":\"%s\",\"cache\":\"%s\",\"target\":\"%s\",\"baud\":%lu,"
+           "\"size\":%lu,\"span\":%lu,\"record\":%u,\"hex_bytes\":%lu,\"ok\":%s,"
+           "\"total_us\":%lu,\"bytes_per_s\":%lu,\"phases_us\":{",
+           s->name, cache, target, (unsigned long)(link ? link->baudrate : 0),
+           (unsigned long)s->size, (unsigned long)BL_Bench_Span(s), s->record_len,
+           (unsigned long)r->hex_bytes, r->ok ? "true" : "false", (unsigned long)r->total_us,
+           (unsigned long)(r->total_us ? (uint64_t)s->size * 1000000 / r->total_us : 0));
+    for (uint8_t i = 0; i < BL_PHASES; i++) {
+        printf("%s\"%s\":%lu", i ? "," : "", phase_names[i], (unsigned long)r->phase_us[i]);
+    }
+    printf("}}\n");
+}
+
+// Upload and verify name once, with the phase clock running
+static bool BL_Bench_Once(const BL_BenchScenario_t *s, const char *name, const char *cache,
+                          const char *target, uint32_t hex_bytes) {
+    BL_BenchResult_t r = { .hex_bytes = hex_bytes, .total_us = 0 };
+
+    BL_Bench_Reset();
+    r.ok = BL_UploadHexFile(name) && BL_VerifyUpload();
+    BL_Bench_Read(r.phase_us);
+    for (uint8_t i = 0; i < BL_PHASES; i++) {
+        r.total_us += r.phase_us[i];
+    }
+
+    BL_Bench_Print(s, cache, target, &r);
+    return r.ok;
+}
+
+bool BL_Bench_Run(const BL_BenchScenario_t *s, const char *target) {
+    char name[64];
+    char cache[64 + sizeof(BL_IMAGE_EXT)];
+    uint32_t hex_bytes;
+
+    if (!BL_Bench_Fits(s)) {
+        printf("Bench: %s needs %lu bytes of flash, skipped\n", s->name, (unsigned long)BL_Bench_Span(s));
+        return true;
+    }
+    snprintf(name, sizeof(name), "%s%s.hex", BL_BENCH_FILE_PREFIX, s->name);
+    snprintf(cache, sizeof(cache), "%s%s", name, BL_IMAGE_EXT);
+
+    if (!BL_Mount_FS() || !BL_Bench_Prepare(s, name, &hex_bytes)) {
+        printf("Bench: can't write %s\n", name);
+        return false;
+    }
+
+    f_unlink(cache);
+    bool ok = BL_Bench_Once(s, name, "cold", target, hex_bytes);
+    if (s->warm) {
+        ok = BL_Bench_Once(s, name, "warm", target, hex_bytes) && ok;
+    }
+    return ok;
+}
+
+const BL_BenchScenario_t *BL_Bench_Scenario(uint8_t i) {
+    return (i < sizeof(scenarios) / sizeof(scenarios[0])) ? &scenarios[i] : NULL;
+}
+
+bool BL_Bench_RunSuite(const char *target, uint32_t max_size) {
+    const BL_BenchScenario_t *s;
+    bool ok = true;
+
+    for (uint8_t i = 0; (s = BL_Bench_Scenario(i)) != NULL; i++) {
+        if (max_size == 0 || s->size <= max_size) {
+            ok = BL_Bench_Run(s, target) && ok;
+        }
+    }
+    return ok;
+}
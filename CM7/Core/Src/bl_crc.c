@@ -0,0 +1,47 @@
+/*
+ * bl_crc.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_crc.h"
+#include "bl_tcm.h"
+
+#if defined(USE_HAL_DRIVER)
+#include "stm32h7xx_hal.h"
+
+// The HAL CRC driver isn't part of the project, the unit is simple enough
+// to drive through its registers directly
+void BL_CRC_Init(void) {
+    __HAL_RCC_CRC_CLK_ENABLE();
+    CRC->POL = BL_CRC_POLYNOMIAL;
+    CRC->CR = 0; // 32-bit polynomial, no input/output reversal
+}
+
+// Loading INIT and resetting makes DR continue from a previous result,
+// so several CRCs can be interleaved on the single unit
+BL_ITCM_CODE uint32_t BL_CRC_Update(uint32_t crc, const uint32_t *words, uint32_t length) {
+    CRC->INIT = crc;
+    CRC->CR |= CRC_CR_RESET;
+    for (uint32_t i = 0; i < length; i++) {
+        CRC->DR = words[i];
+    }
+    return CRC->DR;
+}
+
+#else
+
+void BL_CRC_Init(void) {
+}
+
+uint32_t BL_CRC_Update(uint32_t crc, const uint32_t *words, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= words[i];
+        for (uint8_t bit = 0; bit < 32; bit++) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ BL_CRC_POLYNOMIAL : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * bl_device.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_device.h"
+#include <stdio.h>
+
+#define KB 1024UL
+
+// Conservative defaults: the layout and erase costs the engine always
+// assumed, the widest flash word and the old fixed Write Memory timeout
+static const BL_Device_t default_device = {
+    .pid = 0, .name = "unknown part", .layout = BL_FLASH_DEFAULT_LAYOUT, .flash_word = 32,
+    .erase = BL_ERASE_DEFAULT_COST, .program_ms = 450, .max_baudrate = 0, .commands = 0,
+};
+
+// Single bank mode where a part has both, sectors numbered the way the Erase
+// commands expect them
+static const BL_Device_t devices[] = {
+    {0x410, "STM32F10x medium-density", {0x08000000, 1, {{1 * KB, 128}}},
+     2, {40, 40, 2}, 10, 115200, 0},
+    {0x414, "STM32F10x high-density", {0x08000000, 1, {{2 * KB, 256}}},
+     2, {40, 40, 2}, 10, 115200, 0},
+    {0x440, "STM32F030x8/F05x", {0x08000000, 1, {{1 * KB, 64}}},
+     2, {40, 40, 2}, 10, 115200, BL_DEVICE_EXTENDED_ERASE},
+    {0x413, "STM32F40x/F41x", {0x08000000, 3, {{16 * KB, 4}, {64 * KB, 1}, {128 * KB, 7}}},
+     1, {2000, 16000, 2}, 10, 921600, BL_DEVICE_EXTENDED_ERASE},
+    {0x449, "STM32F74x/F75x", {0x08000000, 3, {{32 * KB, 4}, {128 * KB, 1}, {256 * KB, 3}}},
+     1, {4000, 16000, 2}, 10, 921600, BL_DEVICE_EXTENDED_ERASE},
+    {0x451, "STM32F76x/F77x", {0x08000000, 3, {{32 * KB, 4}, {128 * KB, 1}, {256 * KB, 7}}},
+     1, {4000, 16000, 2}, 10, 921600, BL_DEVICE_EXTENDED_ERASE},
+    {0x435, "STM32L43x/L44x", {0x08000000, 1, {{2 * KB, 128}}},
+     8, {25, 25, 2}, 5, 921600, BL_DEVICE_EXTENDED_ERASE},
+    {0x415, "STM32L47x/L48x", {0x08000000, 1, {{2 * KB, 512}}},
+     8, {25, 25, 2}, 5, 921600, BL_DEVICE_EXTENDED_ERASE},
+    {0x466, "STM32G03x/G04x", {0x08000000, 1, {{2 * KB, 32}}},
+     8, {40, 40, 2}, 5, 921600, BL_DEVICE_EXTENDED_ERASE},
+    {0x460, "STM32G07x/G08x", {0x08000000, 1, {{2 * KB, 64}}},
+     8, {40, 40, 2}, 5, 921600, BL_DEVICE_EXTENDED_ERASE},
+    {0x468, "STM32G43x/G44x", {0x08000000, 1, {{2 * KB, 64}}},
+     8, {25, 25, 2}, 5, 921600, BL_DEVICE_EXTENDED_ERASE},
+    {0x483, "STM32H72x/H73x", {0x08000000, 1, {{128 * KB, 8}}},
+     32, {4000, 16000, 2}, 5, 1000000, BL_DEVICE_EXTENDED_ERASE},
+    {0x450, "STM32H74x/H75x", {0x08000000, 1, {{128 * KB, 16}}},
+     32, {4000, 16000, 2}, 5, 1000000, BL_DEVICE_EXTENDED_ERASE},
+};
+
+static const BL_Device_t *current = &default_device;
+static const BL_Device_t *pinned;
+
+/* ********************** API ****************************** */
+
+const BL_Device_t *BL_Device_Find(uint16_t pid) {
+    for (uint8_t i = 0; i < sizeof(devices) / sizeof(devices[0]); i++) {
+        if (devices[i].pid == pid) {
+            return &devices[i];
+        }
+    }
+    return &default_device;
+}
+
+const BL_Device_t *BL_Device_Select(uint16_t pid) {
+    return pinned != NULL ? pinned : BL_Device_Find(pid);
+}
+
+void BL_Device_Pin(const BL_Device_t *d) {
+    pinned = d;
+}
+
+void BL_Device_Apply(const BL_Device_t *d) {
+    current = d;
+    BL_Flash_SetLayout(&d->layout);
+    BL_Erase_SetCost(&d->erase);
+}
+
+const BL_Device_t *BL_Device_Current(void) {
+    return current;
+}
+
+void BL_Device_Report(const BL_Device_t *d, uint16_t pid) {
+    uint32_t size = 0;
+    uint16_t sectors = 0;
+    for (uint8_t i = 0; i < d->layout.region_count; i++) {
+        size += d->layout.regions[i].sector_size * d->layout.regions[i].count;
+        sectors += d->layout.regions[i].count;
+    }
+
+    printf("Device: %s (PID %03x), %lu KiB flash in %u sectors, %u byte flash words\n", d->name, pid,
+           (unsigned long)(size / KB), sectors, d->flash_word);
+    if (d->pid == 0) {
+        printf("Device: not in the database, using conservative defaults\n");
+    }
+}
@@ -0,0 +1,162 @@
+/*
+ * bl_diff.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_diff.h"
+#include "bl_crc.h"
+#include "bl_flash.h"
+#include "bl_verify.h"
+#include "bootloader.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BL_DIFF_WINDOW BL_COALESCE_BLOCK_SIZE
+
+#define BL_BIT_SET(map, n) ((map)[(n) / 32] |= 1UL << ((n) % 32))
+#define BL_BIT_GET(map, n) (((map)[(n) / 32] >> ((n) % 32)) & 1)
+
+static uint32_t erased[BL_DIFF_WINDOW / 4]; // a window of blank flash
+
+void BL_Diff_Init(BL_Diff_t *d) {
+    BL_CRC_Init();
+    memset(erased, 0xFF, sizeof(erased));
+    memset(d->changed, 0, sizeof(d->changed));
+    memset(d->touched, 0, sizeof(d->touched));
+    d->sector = -1;
+    d->staged = false;
+    d->full = false;
+    d->sectors = 0;
+    d->skipped = 0;
+    d->bytes_skipped = 0;
+}
+
+// Feed the staged window to the CRC
+static void BL_Diff_Unstage(BL_Diff_t *d) {
+    if (d->staged) {
+        d->crc = BL_CRC_Update(d->crc, d->stage, BL_DIFF_WINDOW / 4);
+        d->next = d->window + BL_DIFF_WINDOW;
+        d->staged = false;
+    }
+}
+
+// Feed blank flash up to end
+static void BL_Diff_Pad(BL_Diff_t *d, uint32_t end) {
+    while (d->next < end) {
+        uint32_t n = end - d->next;
+        if (n > BL_DIFF_WINDOW) {
+            n = BL_DIFF_WINDOW;
+        }
+        d->crc = BL_CRC_Update(d->crc, erased, n / 4);
+        d->next += n;
+    }
+}
+
+static bool BL_Diff_CloseSector(BL_Diff_t *d) {
+    if (d->sector < 0) {
+        return true;
+    }
+
+    uint16_t sector = (uint16_t)d->sector;
+    uint32_t start = BL_Flash_SectorStart(sector);
+    uint32_t size = BL_Flash_SectorSize(sector);
+    uint32_t crc;
+
+    BL_Diff_Unstage(d);
+    BL_Diff_Pad(d, start + size);
+    d->sector = -1;
+
+    if (!BL_Verify_TargetCrc(start, size, &crc)) {
+        printf("Diff: reading sector %u failed\n", sector);
+        return false;
+    }
+    if (crc == d->crc) {
+        d->skipped++;
+    } else {
+        BL_BIT_SET(d->changed, sector);
+    }
+    return true;
+}
+
+bool BL_Diff_Hash(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    BL_Diff_t *d = ctx;
+    int32_t sector = BL_Flash_SectorOf(address);
+
+    // Anything outside the flash map is always written, nothing to hash
+    if (sector < 0) {
+        return true;
+    }
+    if (sector >= BL_DIFF_MAX_SECTORS || sector < d->sector) {
+        d->full = true;
+    }
+    if (d->full) {
+        if (sector < BL_DIFF_MAX_SECTORS) {
+            BL_BIT_SET(d->touched, sector);
+        }
+        return true;
+    }
+
+    if (sector != d->sector) {
+        if (!BL_Diff_CloseSector(d)) {
+            return false;
+        }
+        d->sector = sector;
+        d->crc = BL_CRC_INIT;
+        d->next = BL_Flash_SectorStart((uint16_t)sector);
+        BL_BIT_SET(d->touched, sector);
+    }
+
+    // Blocks never cross a window, and sectors are whole windows
+    uint32_t window = address & ~(uint32_t)(BL_DIFF_WINDOW - 1);
+    if (d->staged && window != d->window) {
+        BL_Diff_Unstage(d);
+    }
+    if (!d->staged) {
+        if (window < d->next) {
+            d->full = true;
+            return true;
+        }
+        BL_Diff_Pad(d, window);
+        memset(d->stage, 0xFF, sizeof(d->stage));
+        d->window = window;
+        d->staged = true;
+    }
+
+    memcpy((uint8_t *)d->stage + (address - window), data, length);
+    return true;
+}
+
+bool BL_Diff_Finish(BL_Diff_t *d) {
+    if (!BL_Diff_CloseSector(d)) {
+        return false;
+    }
+
+    if (d->full) {
+        printf("Diff: image isn't in address order, programming every sector\n");
+        memcpy(d->changed, d->touched, sizeof(d->changed));
+        d->skipped = 0;
+    }
+
+    d->sectors = 0;
+    for (uint16_t i = 0; i < BL_DIFF_MAX_SECTORS / 32; i++) {
+        d->sectors += __builtin_popcount(d->touched[i]);
+    }
+    return true;
+}
+
+bool BL_Diff_IsChanged(const BL_Diff_t *d, uint32_t address) {
+    int32_t sector = BL_Flash_SectorOf(address);
+    if (sector < 0 || sector >= BL_DIFF_MAX_SECTORS) {
+        return true;
+    }
+    return BL_BIT_GET(d->changed, sector);
+}
+
+void BL_Diff_PlanErase(const BL_Diff_t *d, BL_ErasePlan_t *plan) {
+    for (uint16_t sector = 0; sector < BL_DIFF_MAX_SECTORS; sector++) {
+        if (BL_BIT_GET(d->changed, sector)) {
+            BL_Erase_TouchSector(plan, sector);
+        }
+    }
+}
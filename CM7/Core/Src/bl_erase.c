@@ -0,0 +1,210 @@
+/*
+ * bl_erase.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_erase.h"
+#include "bl_bench.h"
+#include "bl_flash.h"
+#include "bl_log.h"
+#include "bootloader.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BL_BIT_SET(map, n) ((map)[(n) / 32] |= 1UL << ((n) % 32))
+#define BL_BIT_GET(map, n) (((map)[(n) / 32] >> ((n) % 32)) & 1)
+
+static BL_EraseCost_t cost = BL_ERASE_DEFAULT_COST;
+
+void BL_Erase_SetCost(const BL_EraseCost_t *c) {
+    cost = *c;
+}
+
+const BL_EraseCost_t *BL_Erase_GetCost(void) {
+    return &cost;
+}
+
+/* ********************** Helpers ****************************** */
+
+static uint16_t BL_Erase_Total(void) {
+    uint16_t total = BL_Flash_SectorCount();
+    return (total > BL_ERASE_MAX_SECTORS) ? BL_ERASE_MAX_SECTORS : total;
+}
+
+// Generous timeout, the ROM bootloader only ACKs once every sector is done
+static uint32_t BL_Erase_Timeout(uint32_t erase_ms) {
+    return 2 * erase_ms + cost.command_ms + 100;
+}
+
+static void BL_Erase_Record(BL_ErasePlan_t *p, uint16_t first, uint16_t count, uint32_t ms) {
+    p->commands++;
+    p->total_ms += ms;
+    if (p->timing_count < BL_ERASE_TIMINGS) {
+        BL_EraseTiming_t *t = &p->timings[p->timing_count++];
+        t->first = first;
+        t->count = count;
+        t->ms = ms;
+    }
+}
+
+static bool BL_Erase_Mass(BL_ErasePlan_t *p) {
+    uint32_t start = BL_Transport_Now(BL_GetTransport());
+    BL_Phase_t phase = BL_Bench_Enter(BL_PHASE_ERASE);
+    bool ok = BL_MassErase(BL_Erase_Timeout(cost.mass_ms));
+    BL_Bench_Leave(phase);
+    if (!ok) {
+        BL_LOG("Erase: mass erase failed\n");
+        return false;
+    }
+    BL_Erase_Record(p, 0xFFFF, BL_Erase_Total(), BL_Transport_Now(BL_GetTransport()) - start);
+
+    for (uint16_t s = 0; s < BL_Erase_Total(); s++) {
+        BL_BIT_SET(p->erased, s);
+    }
+    p->mass = true;
+    return true;
+}
+
+// Erase sector together with the planned sectors that follow it
+static bool BL_Erase_Batch(BL_ErasePlan_t *p, uint16_t sector) {
+    static uint16_t pages[BL_ERASE_PAGES_MAX];
+    uint16_t total = BL_Erase_Total();
+    uint16_t count = 0;
+
+    pages[count++] = sector;
+    for (uint16_t s = sector + 1; s < total && count < p->batch; s++) {
+        if (BL_BIT_GET(p->touched, s) && !BL_BIT_GET(p->erased, s)) {
+            pages[count++] = s;
+        }
+    }
+
+    uint32_t start = BL_Transport_Now(BL_GetTransport());
+    BL_Phase_t phase = BL_Bench_Enter(BL_PHASE_ERASE);
+    bool ok = BL_EraseMemory(pages, count, BL_Erase_Timeout(count * cost.sector_ms));
+    BL_Bench_Leave(phase);
+    if (!ok) {
+        BL_LOG("Erase: sectors %u-%u failed\n", pages[0], pages[count - 1]);
+        return false;
+    }
+    BL_Erase_Record(p, sector, count, BL_Transport_Now(BL_GetTransport()) - start);
+
+    for (uint16_t i = 0; i < count; i++) {
+        BL_BIT_SET(p->erased, pages[i]);
+    }
+    return true;
+}
+
+/* ********************** API ****************************** */
+
+void BL_Erase_Init(BL_ErasePlan_t *p) {
+    memset(p, 0, sizeof(*p));
+    p->batch = 1;
+}
+
+void BL_Erase_TouchSector(BL_ErasePlan_t *p, uint16_t sector) {
+    if (sector < BL_ERASE_MAX_SECTORS) {
+        BL_BIT_SET(p->touched, sector);
+    }
+}
+
+void BL_Erase_Touch(BL_ErasePlan_t *p, uint32_t address, uint32_t length) {
+    if (length == 0) {
+        return;
+    }
+    int32_t first = BL_Flash_SectorOf(address);
+    int32_t last = BL_Flash_SectorOf(address + length - 1);
+    if (first < 0) {
+        return;
+    }
+    if (last < 0) {
+        last = BL_Flash_SectorCount() - 1; // runs past the end of the flash
+    }
+    for (int32_t s = first; s <= last; s++) {
+        BL_Erase_TouchSector(p, s);
+    }
+}
+
+bool BL_Erase_Plan(BL_ErasePlan_t *p, bool allow_mass) {
+    p->sectors = 0;
+    for (uint16_t i = 0; i < BL_ERASE_MAX_SECTORS / 32; i++) {
+        p->sectors += __builtin_popcount(p->touched[i]);
+    }
+
+    // As many sectors per command as fit the budget
+    p->batch = cost.sector_ms ? BL_ERASE_BUDGET_MS / cost.sector_ms : BL_ERASE_PAGES_MAX;
+    if (p->batch < 1) {
+        p->batch = 1;
+    }
+    if (p->batch > BL_ERASE_PAGES_MAX) {
+        p->batch = BL_ERASE_PAGES_MAX;
+    }
+    if (p->sectors == 0) {
+        return true; // sectors turn up while writing
+    }
+
+    uint32_t commands = (p->sectors + p->batch - 1) / p->batch;
+    uint32_t sector_cost = p->sectors * cost.sector_ms + commands * cost.command_ms;
+    uint32_t mass_cost = cost.mass_ms + cost.command_ms;
+    printf("Erase plan: %u sectors, %lu ms in %lu commands, mass erase %lu ms\n", p->sectors,
+           (unsigned long)sector_cost, (unsigned long)commands, (unsigned long)mass_cost);
+
+    if (allow_mass && mass_cost < sector_cost) {
+        return BL_Erase_Mass(p);
+    }
+    return true;
+}
+
+bool BL_Erase_Before(BL_ErasePlan_t *p, uint32_t address, uint32_t length) {
+    int32_t first = BL_Flash_SectorOf(address);
+    int32_t last = BL_Flash_SectorOf(address + length - 1);
+    if (first < 0) {
+        return true; // RAM, option bytes, ... nothing to erase
+    }
+    if (last < 0) {
+        last = first;
+    }
+
+    for (int32_t s = first; s <= last; s++) {
+        if (s >= BL_ERASE_MAX_SECTORS) {
+            BL_LOG("Erase: sector %ld beyond the plan\n", (long)s);
+            return false;
+        }
+        if (BL_BIT_GET(p->erased, s)) {
+            continue;
+        }
+        BL_BIT_SET(p->touched, s);
+        if (!BL_Erase_Batch(p, s)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BL_Erase_Keep(BL_ErasePlan_t *p, uint32_t address, uint32_t length) {
+    int32_t first = BL_Flash_SectorOf(address);
+    int32_t last = BL_Flash_SectorOf(address + length - 1);
+    if (first < 0) {
+        return;
+    }
+    if (last < 0) {
+        last = first;
+    }
+    for (int32_t s = first; s <= last && s < BL_ERASE_MAX_SECTORS; s++) {
+        BL_BIT_SET(p->touched, s);
+        BL_BIT_SET(p->erased, s);
+    }
+}
+
+void BL_Erase_Report(const BL_ErasePlan_t *p) {
+    printf("Erase: %u commands, %lu ms%s\n", p->commands, (unsigned long)p->total_ms, p->mass ? " (mass erase)" : "");
+    for (uint16_t i = 0; i < p->timing_count; i++) {
+        const BL_EraseTiming_t *t = &p->timings[i];
+        if (t->first == 0xFFFF) {
+            printf("  mass erase: %lu ms\n", (unsigned long)t->ms);
+        } else {
+            printf("  %u sectors from %u: %lu ms (%lu ms/sector)\n", t->count, t->first,
+                   (unsigned long)t->ms, (unsigned long)(t->ms / t->count));
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * bl_flash.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_flash.h"
+
+static BL_FlashLayout_t layout = BL_FLASH_DEFAULT_LAYOUT;
+
+void BL_Flash_SetLayout(const BL_FlashLayout_t *l) {
+    layout = *l;
+}
+
+const BL_FlashLayout_t *BL_Flash_GetLayout(void) {
+    return &layout;
+}
+
+uint16_t BL_Flash_SectorCount(void) {
+    uint16_t count = 0;
+    for (uint8_t i = 0; i < layout.region_count; i++) {
+        count += layout.regions[i].count;
+    }
+    return count;
+}
+
+int32_t BL_Flash_SectorOf(uint32_t address) {
+    if (address < layout.base) {
+        return -1;
+    }
+
+    uint32_t offset = address - layout.base;
+    int32_t sector = 0;
+    for (uint8_t i = 0; i < layout.region_count; i++) {
+        const BL_FlashRegion_t *r = &layout.regions[i];
+        uint32_t size = r->sector_size * r->count;
+        if (offset < size) {
+            return sector + (int32_t)(offset / r->sector_size);
+        }
+        offset -= size;
+        sector += r->count;
+    }
+    return -1;
+}
+
+uint32_t BL_Flash_SectorStart(uint16_t sector) {
+    uint32_t address = layout.base;
+    for (uint8_t i = 0; i < layout.region_count; i++) {
+        const BL_FlashRegion_t *r = &layout.regions[i];
+        if (sector < r->count) {
+            return address + sector * r->sector_size;
+        }
+        address += r->sector_size * r->count;
+        sector -= r->count;
+    }
+    return address;
+}
+
+uint32_t BL_Flash_SectorSize(uint16_t sector) {
+    for (uint8_t i = 0; i < layout.region_count; i++) {
+        const BL_FlashRegion_t *r = &layout.regions[i];
+        if (sector < r->count) {
+            return r->sector_size;
+        }
+        sector -= r->count;
+    }
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * bl_gang.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_gang.h"
+#include "bl_verify.h"
+#include <string.h>
+
+// Image as the coalescer produced it, every block is one Write Memory frame
+typedef struct {
+    uint32_t address;
+    uint32_t offset;    // position in image_data
+    uint16_t length;
+} BL_GangBlock_t;
+
+static uint8_t image_data[BL_GANG_IMAGE_SIZE];
+static BL_GangBlock_t blocks[BL_GANG_MAX_BLOCKS];
+static uint16_t block_count;
+static uint32_t image_size;
+
+static const char *const state_names[] = {
+    "idle", "connecting", "writing", "verifying", "done", "failed",
+};
+
+static bool BL_Gang_Store(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    if (block_count == BL_GANG_MAX_BLOCKS || image_size + length > BL_GANG_IMAGE_SIZE) {
+        printf("Gang: image doesn't fit in RAM\n");
+        return false;
+    }
+
+    BL_GangBlock_t *b = &blocks[block_count++];
+    b->address = address;
+    b->offset = image_size;
+    b->length = length;
+    memcpy(&image_data[image_size], data, length);
+    image_size += length;
+    return true;
+}
+
+bool BL_Gang_LoadImage(const char *filename) {
+    block_count = 0;
+    image_size = 0;
+
+    if (!BL_LoadHexImage(filename, BL_Gang_Store, NULL)) {
+        return false;
+    }
+    printf("Gang: %lu bytes in %u blocks loaded\n", (unsigned long)image_size, block_count);
+    return true;
+}
+
+void BL_Gang_InitTarget(BL_GangTarget_t *g, const char *name, BL_Transport_t *link, BL_TargetReset_t reset) {
+    memset(g, 0, sizeof(*g));
+    g->name = name;
+    g->reset = reset;
+    g->target.link = link;
+    g->state = BL_GANG_IDLE;
+}
+
+static void BL_Gang_Fail(BL_GangTarget_t *g, uint32_t address) {
+    g->failed_in = g->state;
+    g->failed_address = address;
+    g->state = BL_GANG_FAILED;
+    printf("Gang: %s failed while %s\n", g->name, state_names[g->failed_in]);
+}
+
+static uint32_t BL_Gang_Now(BL_GangTarget_t *g) {
+    return BL_Transport_Now(g->target.link);
+}
+
+// Every target gets a plan over the sectors of the RAM image. Mass erase
+// follows BL_ERASE_ALLOW_MASS like a single upload. The targets of a gang
+// are the same part, the sector map is the one of the last target synced.
+static bool BL_Gang_PlanErase(BL_GangTarget_t *g) {
+    BL_Erase_Init(&g->erase);
+    for (uint16_t i = 0; i < block_count; i++) {
+        BL_Erase_Touch(&g->erase, blocks[i].address, blocks[i].length);
+    }
+    return BL_Erase_Plan(&g->erase, BL_ERASE_ALLOW_MASS);
+}
+
+// Blocks go out round robin. Write Memory returns as soon as the payload is
+// queued on the DMA and collects its final ACK with the next command, so
+// while one target receives and programs a block the others get theirs.
+// The first block of a sector erases it first, on that target only.
+static void BL_Gang_Write(BL_GangTarget_t *targets, uint8_t count) {
+    for (uint16_t i = 0; i < block_count; i++) {
+        const BL_GangBlock_t *b = &blocks[i];
+        uint8_t active = 0;
+
+        for (uint8_t j = 0; j < count; j++) {
+            BL_GangTarget_t *g = &targets[j];
+            if (g->state != BL_GANG_WRITING) {
+                continue;
+            }
+
+            BL_SelectTarget(&g->target);
+            if (!BL_Erase_Before(&g->erase, b->address, b->length) ||
+                !BL_WriteMemory(b->address, &image_data[b->offset], b->length)) {
+                BL_Gang_Fail(g, b->address);
+                continue;
+            }
+            BL_Verify_Track(&g->target.verify, b->address, &image_data[b->offset], b->length);
+            g->bytes += b->length;
+            active++;
+        }
+
+        if (active == 0) {
+            return;
+        }
+    }
+}
+
+uint8_t BL_Gang_Run(BL_GangTarget_t *targets, uint8_t count, const uint32_t *ladder, uint8_t ladder_count) {
+    uint8_t passed = 0;
+    uint32_t start;
+
+    for (uint8_t i = 0; i < count; i++) {
+        BL_GangTarget_t *g = &targets[i];
+        g->state = BL_GANG_CONNECTING;
+        g->bytes = 0;
+
+        BL_SelectTarget(&g->target);
+        start = BL_Gang_Now(g);
+        if (!BL_InitBootloaderAutoBaud(ladder, ladder_count, g->reset)) {
+            BL_Gang_Fail(g, 0);
+            continue;
+        }
+        g->connect_ms = BL_Gang_Now(g) - start;
+        BL_Verify_Init(&g->target.verify);
+        g->state = BL_GANG_WRITING;
+        if (!BL_Gang_PlanErase(g)) {
+            BL_Gang_Fail(g, 0);
+        }
+    }
+
+    start = BL_Gang_Now(&targets[0]);
+    BL_Gang_Write(targets, count);
+
+    for (uint8_t i = 0; i < count; i++) {
+        BL_GangTarget_t *g = &targets[i];
+        if (g->state != BL_GANG_WRITING) {
+            continue;
+        }
+
+        BL_SelectTarget(&g->target);
+        if (!BL_WaitPendingAck()) {
+            BL_Gang_Fail(g, g->target.pending_address);
+            continue;
+        }
+        g->write_ms = BL_Gang_Now(g) - start;
+        g->state = BL_GANG_VERIFYING;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        BL_GangTarget_t *g = &targets[i];
+        if (g->state != BL_GANG_VERIFYING) {
+            continue;
+        }
+
+        BL_SelectTarget(&g->target);
+        uint32_t verify_start = BL_Gang_Now(g);
+        if (!BL_Verify_Run(&g->target.verify)) {
+            BL_Gang_Fail(g, 0);
+            continue;
+        }
+        g->verify_ms = BL_Gang_Now(g) - verify_start;
+        g->state = BL_GANG_DONE;
+        passed++;
+    }
+
+    BL_SelectTarget(NULL);
+    return passed;
+}
+
+void BL_Gang_StartApps(BL_GangTarget_t *targets, uint8_t count) {
+    for (uint8_t i = 0; i < count; i++) {
+        BL_GangTarget_t *g = &targets[i];
+        if (g->state != BL_GANG_DONE) {
+            continue;
+        }
+
+        BL_SelectTarget(&g->target);
+        if (!BL_GoToUserApp()) {
+            printf("Gang: %s didn't start its application\n", g->name);
+        }
+    }
+    BL_SelectTarget(NULL);
+}
+
+void BL_Gang_Report(const BL_GangTarget_t *targets, uint8_t count) {
+    printf("Target  State       Baud     Connect  Write    Verify   Bytes\n");
+    for (uint8_t i = 0; i < count; i++) {
+        const BL_GangTarget_t *g = &targets[i];
+        printf("%-7s %-11s %-8lu %-5lu ms %-5lu ms %-5lu ms %lu\n", g->name, state_names[g->state],
+               (unsigned long)g->target.link->baudrate, (unsigned long)g->connect_ms,
+               (unsigned long)g->write_ms, (unsigned long)g->verify_ms, (unsigned long)g->bytes);
+        if (g->state == BL_GANG_FAILED) {
+            printf("        failed while %s at %08lx\n", state_names[g->failed_in],
+                   (unsigned long)g->failed_address);
+        }
+        if (g->erase.commands > 0) {
+            printf("        %u Erase commands, %lu ms%s\n", g->erase.commands, (unsigned long)g->erase.total_ms,
+                   g->erase.mass ? " (mass erase)" : "");
+        }
+        if (g->target.rto.retries > 0) {
+            printf("        %lu retries, %lu resyncs\n", (unsigned long)g->target.rto.retries,
+                   (unsigned long)g->target.rto.resyncs);
+        }
+    }
+}
@@ -0,0 +1,331 @@
+/*
+ * bl_image.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_image.h"
+#include "bl_bench.h"
+#include "bl_crc.h"
+#include "fatfs.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BL_IMAGE_TABLE_END(img) (sizeof(BL_ImageHeader_t) + (img)->header.segment_count * sizeof(BL_ImageSegment_t))
+
+static FIL file;                 // cache file, or the source while it is hashed
+static char cache_name[64];
+static uint32_t buf[BL_IMAGE_READ_SIZE / 4];
+
+static bool BL_Image_CacheName(const char *source) {
+    int n = snprintf(cache_name, sizeof(cache_name), "%s%s", source, BL_IMAGE_EXT);
+    return n > 0 && n < (int)sizeof(cache_name);
+}
+
+// Exactly chunk bytes of file into buf
+static bool BL_Image_Read(UINT chunk) {
+    BL_Phase_t phase = BL_Bench_Enter(BL_PHASE_SD_READ);
+    UINT n;
+    bool ok = f_read(&file, buf, chunk, &n) == FR_OK && n == chunk;
+    BL_Bench_Leave(phase);
+    return ok;
+}
+
+// CRC of the next length bytes of file, a trailing partial word is padded with 0xFF
+static bool BL_Image_Hash(uint32_t length, uint32_t *crc) {
+    *crc = BL_CRC_INIT;
+    while (length > 0) {
+        UINT chunk = (length > BL_IMAGE_READ_SIZE) ? BL_IMAGE_READ_SIZE : length;
+        if (!BL_Image_Read(chunk)) {
+            return false;
+        }
+        if (chunk & 3) {
+            memset((uint8_t *)buf + chunk, 0xFF, 4 - (chunk & 3));
+        }
+        *crc = BL_CRC_Update(*crc, buf, (chunk + 3) / 4);
+        length -= chunk;
+    }
+    return true;
+}
+
+// Size and timestamp of the source
+static bool BL_Image_Stat(const char *source, BL_ImageHeader_t *h) {
+    FILINFO info;
+
+    if (f_stat(source, &info) != FR_OK) {
+        return false;
+    }
+    h->source_size = info.fsize;
+    h->source_date = info.fdate;
+    h->source_time = info.ftime;
+    return true;
+}
+
+// CRC of the source contents, its size has to be in h already
+static bool BL_Image_Source(const char *source, BL_ImageHeader_t *h) {
+    if (f_open(&file, source, FA_READ) != FR_OK) {
+        return false;
+    }
+    bool ok = BL_Image_Hash(h->source_size, &h->source_crc);
+    f_close(&file);
+    return ok;
+}
+
+// Sort the segments by address and merge the ones that touch or overlap
+static void BL_Image_Merge(BL_Image_t *img) {
+    BL_ImageSegment_t *s = img->segments;
+    uint16_t count = img->header.segment_count;
+
+    for (uint16_t i = 1; i < count; i++) {
+        BL_ImageSegment_t key = s[i];
+        int j = i - 1;
+        while (j >= 0 && s[j].address > key.address) {
+            s[j + 1] = s[j];
+            j--;
+        }
+        s[j + 1] = key;
+    }
+
+    uint16_t out = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        if (out > 0 && s[i].address <= s[out - 1].address + s[out - 1].length) {
+            uint32_t end = s[i].address + s[i].length;
+            if (end > s[out - 1].address + s[out - 1].length) {
+                s[out - 1].length = end - s[out - 1].address;
+            }
+        } else {
+            s[out++] = s[i];
+        }
+    }
+    img->header.segment_count = out;
+}
+
+/* ********************** Reading ****************************** */
+
+bool BL_Image_Load(BL_Image_t *img, const char *source) {
+    BL_ImageHeader_t *h = &img->header;
+    BL_ImageHeader_t current;
+    UINT n;
+
+    if (!BL_Image_CacheName(source) || f_open(&file, cache_name, FA_READ) != FR_OK) {
+        return false;
+    }
+    BL_CRC_Init();
+
+    bool ok = f_read(&file, h, sizeof(*h), &n) == FR_OK && n == sizeof(*h) &&
+              h->magic == BL_IMAGE_MAGIC && h->version == BL_IMAGE_VERSION &&
+              h->segment_count <= BL_IMAGE_MAX_SEGMENTS &&
+              f_read(&file, img->segments, h->segment_count * sizeof(BL_ImageSegment_t), &n) == FR_OK &&
+              n == h->segment_count * sizeof(BL_ImageSegment_t);
+    f_close(&file);
+    if (!ok) {
+        printf("Image cache %s is damaged\n", cache_name);
+        return false;
+    }
+
+    // An edited source nearly always shows in its size or timestamp, the
+    // contents are only hashed when both still match
+    if (!BL_Image_Stat(source, &current) || current.source_size != h->source_size ||
+        current.source_date != h->source_date || current.source_time != h->source_time ||
+        !BL_Image_Source(source, &current) || current.source_crc != h->source_crc) {
+        printf("Image cache %s is out of date\n", cache_name);
+        return false;
+    }
+
+    printf("Using image cache %s (%u segments, %lu bytes)\n", cache_name, h->segment_count,
+           (unsigned long)h->data_size);
+    return true;
+}
+
+// The data CRC is checked on the way, in the same reads that feed the
+// coalescer. The segments sit back to back in address order, so the reads
+// cover the data area exactly once. A damaged cache is deleted, the next
+// upload builds it again.
+bool BL_Image_Stream(BL_Image_t *img, BL_Coalescer_t *c) {
+    uint32_t offset = BL_IMAGE_TABLE_END(img);
+    uint32_t crc = BL_CRC_INIT;
+
+    if (f_open(&file, cache_name, FA_READ) != FR_OK) {
+        return false;
+    }
+    if (f_lseek(&file, offset) != FR_OK) {
+        f_close(&file);
+        return false;
+    }
+
+    for (uint16_t i = 0; i < img->header.segment_count; i++) {
+        const BL_ImageSegment_t *s = &img->segments[i];
+        uint32_t address = s->address;
+        uint32_t remaining = s->length;
+        uint32_t padded = (s->length + 3) & ~3UL;
+
+        if (s->offset != offset) {
+            f_close(&file);
+            printf("Image cache %s is damaged\n", cache_name);
+            f_unlink(cache_name);
+            return false;
+        }
+        offset += padded;
+
+        while (padded > 0) {
+            UINT chunk = (padded > BL_IMAGE_READ_SIZE) ? BL_IMAGE_READ_SIZE : padded;
+            UINT length = (remaining < chunk) ? remaining : chunk;
+            if (!BL_Image_Read(chunk)) {
+                f_close(&file);
+                return false;
+            }
+            crc = BL_CRC_Update(crc, buf, chunk / 4);
+            if (!BL_Coalescer_Push(c, address, (const uint8_t *)buf, length)) {
+                f_close(&file);
+                return false;
+            }
+            address += length;
+            remaining -= length;
+            padded -= chunk;
+        }
+    }
+    f_close(&file);
+
+    if (offset - BL_IMAGE_TABLE_END(img) != img->header.data_size || crc != img->header.data_crc) {
+        printf("Image cache %s is damaged\n", cache_name);
+        f_unlink(cache_name);
+        return false;
+    }
+    return true;
+}
+
+/* ********************** Building ****************************** */
+
+bool BL_Image_BuildBegin(BL_Image_t *img, const char *source) {
+    memset(&img->header, 0, sizeof(img->header));
+    img->overflow = false;
+
+    if (!BL_Image_CacheName(source)) {
+        return false;
+    }
+    BL_CRC_Init();
+    return BL_Image_Stat(source, &img->header) && BL_Image_Source(source, &img->header);
+}
+
+bool BL_Image_Collect(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    BL_Image_t *img = ctx;
+    uint16_t count = img->header.segment_count;
+
+    if (img->overflow) {
+        return true;
+    }
+
+    // Sorted files just keep growing the last segment
+    if (count > 0 && address == img->segments[count - 1].address + img->segments[count - 1].length) {
+        img->segments[count - 1].length += length;
+        return true;
+    }
+
+    if (count == BL_IMAGE_MAX_SEGMENTS) {
+        BL_Image_Merge(img);
+        count = img->header.segment_count;
+        if (count == BL_IMAGE_MAX_SEGMENTS) {
+            img->overflow = true;
+            return true;
+        }
+    }
+
+    img->segments[count].address = address;
+    img->segments[count].length = length;
+    img->header.segment_count = count + 1;
+    return true;
+}
+
+bool BL_Image_BuildLayout(BL_Image_t *img) {
+    BL_ImageHeader_t placeholder;
+    UINT n;
+
+    if (img->overflow) {
+        printf("Image has more than %d segments, not cached\n", BL_IMAGE_MAX_SEGMENTS);
+        return false;
+    }
+    BL_Image_Merge(img);
+
+    uint32_t offset = BL_IMAGE_TABLE_END(img);
+    for (uint16_t i = 0; i < img->header.segment_count; i++) {
+        img->segments[i].offset = offset;
+        offset += (img->segments[i].length + 3) & ~3UL;
+    }
+    img->header.data_size = offset - BL_IMAGE_TABLE_END(img);
+
+    if (f_open(&file, cache_name, FA_CREATE_ALWAYS | FA_WRITE | FA_READ) != FR_OK) {
+        printf("Failed to create %s\n", cache_name);
+        return false;
+    }
+
+    // No magic until the data is complete, so a half built file never loads
+    placeholder = img->header;
+    placeholder.magic = 0;
+    return f_write(&file, &placeholder, sizeof(placeholder), &n) == FR_OK && n == sizeof(placeholder) &&
+           f_write(&file, img->segments, img->header.segment_count * sizeof(BL_ImageSegment_t), &n) == FR_OK &&
+           n == img->header.segment_count * sizeof(BL_ImageSegment_t);
+}
+
+bool BL_Image_Place(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    BL_Image_t *img = ctx;
+    uint16_t lo = 0;
+    uint16_t hi = img->header.segment_count;
+    UINT n;
+
+    // Last segment starting at or below address, blocks never span two
+    while (hi - lo > 1) {
+        uint16_t mid = (lo + hi) / 2;
+        if (img->segments[mid].address <= address) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    const BL_ImageSegment_t *s = &img->segments[lo];
+    if (address < s->address || address + length > s->address + s->length) {
+        return false;
+    }
+
+    FSIZE_t offset = s->offset + (address - s->address);
+    if (f_tell(&file) != offset && f_lseek(&file, offset) != FR_OK) {
+        return false;
+    }
+    return f_write(&file, data, length, &n) == FR_OK && n == length;
+}
+
+bool BL_Image_BuildEnd(BL_Image_t *img, uint32_t start_address) {
+    BL_ImageHeader_t *h = &img->header;
+    static const uint8_t pad[3] = {0xFF, 0xFF, 0xFF};
+    UINT n;
+
+    for (uint16_t i = 0; i < h->segment_count; i++) {
+        const BL_ImageSegment_t *s = &img->segments[i];
+        uint8_t tail = s->length & 3;
+        if (tail != 0 && (f_lseek(&file, s->offset + s->length) != FR_OK ||
+                          f_write(&file, pad, 4 - tail, &n) != FR_OK || n != 4U - tail)) {
+            BL_Image_BuildAbort(img);
+            return false;
+        }
+    }
+
+    // Hash what actually landed on the card
+    h->magic = BL_IMAGE_MAGIC;
+    h->version = BL_IMAGE_VERSION;
+    h->start_address = start_address;
+    if (f_sync(&file) != FR_OK || f_lseek(&file, BL_IMAGE_TABLE_END(img)) != FR_OK ||
+        !BL_Image_Hash(h->data_size, &h->data_crc) || f_lseek(&file, 0) != FR_OK ||
+        f_write(&file, h, sizeof(*h), &n) != FR_OK || n != sizeof(*h) || f_close(&file) != FR_OK) {
+        BL_Image_BuildAbort(img);
+        return false;
+    }
+
+    printf("Built image cache %s (%u segments, %lu bytes)\n", cache_name, h->segment_count,
+           (unsigned long)h->data_size);
+    return true;
+}
+
+void BL_Image_BuildAbort(BL_Image_t *img) {
+    f_close(&file);
+    f_unlink(cache_name);
+}
@@ -0,0 +1,246 @@
+/*
+ * bl_journal.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_journal.h"
+#include "bl_coalesce.h"
+#include "bl_crc.h"
+#include "bl_device.h"
+#include "bl_flash.h"
+#include "bl_log.h"
+#include "bl_verify.h"
+#include "bootloader.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BL_BIT_SET(map, n) ((map)[(n) / 32] |= 1UL << ((n) % 32))
+#define BL_BIT_GET(map, n) (((map)[(n) / 32] >> ((n) % 32)) & 1)
+
+static char journal_name[64];
+static uint32_t words[BL_COALESCE_BLOCK_SIZE / 4 + 2]; // a block padded to whole words
+
+/* ********************** Helpers ****************************** */
+
+static uint32_t BL_Journal_RecordCrc(const BL_JournalRecord_t *r) {
+    return BL_CRC_Update(BL_CRC_INIT, (const uint32_t *)r, offsetof(BL_JournalRecord_t, crc) / 4);
+}
+
+// Word aligned span around a block, and its CRC once the block is written
+// into erased flash (or into blank flash with erased set)
+static uint32_t BL_Journal_SpanCrc(uint32_t address, const uint8_t *data, uint16_t length, bool erased,
+                                   uint32_t *start, uint32_t *span) {
+    *start = address & ~3UL;
+    *span = ((address + length + 3) & ~3UL) - *start;
+    memset(words, 0xFF, *span);
+    if (!erased) {
+        memcpy((uint8_t *)words + (address & 3), data, length);
+    }
+    return BL_CRC_Update(BL_CRC_INIT, words, *span / 4);
+}
+
+// Flash sectors under a block, false when it isn't in flash
+static bool BL_Journal_Sectors(uint32_t address, uint16_t length, int32_t *first, int32_t *last) {
+    *first = BL_Flash_SectorOf(address);
+    *last = BL_Flash_SectorOf(address + length - 1);
+    if (*first < 0 || *first >= BL_ERASE_MAX_SECTORS) {
+        return false;
+    }
+    if (*last < 0 || *last >= BL_ERASE_MAX_SECTORS) {
+        *last = *first;
+    }
+    return true;
+}
+
+static void BL_Journal_Save(BL_Journal_t *j) {
+    UINT n;
+
+    j->record.crc = BL_Journal_RecordCrc(&j->record);
+    if (f_lseek(&j->file, 0) != FR_OK || f_write(&j->file, &j->record, sizeof(j->record), &n) != FR_OK ||
+        n != sizeof(j->record) || f_sync(&j->file) != FR_OK) {
+        // The upload goes on, only without a way back in
+        BL_LOG("Journal: writing %s failed, no more checkpoints\n", journal_name);
+        f_close(&j->file);
+        j->open = false;
+        return;
+    }
+    j->checkpoints++;
+}
+
+/* ********************** API ****************************** */
+
+bool BL_Journal_Begin(BL_Journal_t *j, const char *source, bool cached) {
+    BL_JournalRecord_t *r = &j->record;
+    FILINFO info;
+    UINT n;
+
+    memset(j, 0, sizeof(*j));
+    j->last_ms = BL_Transport_Now(BL_GetTransport());
+    int len = snprintf(journal_name, sizeof(journal_name), "%s%s", source, BL_JOURNAL_EXT);
+    if (len <= 0 || len >= (int)sizeof(journal_name) || f_stat(source, &info) != FR_OK ||
+        f_open(&j->file, journal_name, FA_READ | FA_WRITE | FA_OPEN_ALWAYS) != FR_OK) {
+        printf("Journal: can't open the journal of %s, the upload can't be resumed\n", source);
+        return true;
+    }
+    j->open = true;
+    BL_CRC_Init();
+
+    // Blocks of another flash word are another stream
+    uint16_t flags = cached ? BL_JOURNAL_CACHED : 0;
+    flags |= (uint16_t)BL_Device_Current()->flash_word << BL_JOURNAL_WORD_SHIFT;
+    bool valid = f_read(&j->file, r, sizeof(*r), &n) == FR_OK && n == sizeof(*r) &&
+                 r->magic == BL_JOURNAL_MAGIC && r->version == BL_JOURNAL_VERSION &&
+                 r->crc == BL_Journal_RecordCrc(r) && r->flags == flags && r->blocks > 0 &&
+                 r->source_size == info.fsize && r->source_date == info.fdate && r->source_time == info.ftime;
+
+    // The checkpoint only counts when its last block is still on the target
+    if (valid) {
+        uint32_t crc;
+        if (!BL_Verify_TargetCrc(r->last_address, r->last_length, &crc)) {
+            printf("Journal: reading %08lx failed\n", (unsigned long)r->last_address);
+            BL_Journal_End(j, false);
+            return false;
+        }
+        if (crc == r->last_crc) {
+            j->resume_blocks = r->blocks;
+            printf("Journal: resuming after %lu blocks (%lu bytes)\n", (unsigned long)r->blocks,
+                   (unsigned long)r->bytes);
+        } else {
+            printf("Journal: last checkpoint is not on the target, starting over\n");
+        }
+    }
+
+    if (!BL_Journal_Resuming(j)) {
+        memset(r, 0, sizeof(*r));
+        r->magic = BL_JOURNAL_MAGIC;
+        r->version = BL_JOURNAL_VERSION;
+        r->flags = flags;
+        r->source_size = info.fsize;
+        r->source_date = info.fdate;
+        r->source_time = info.ftime;
+    }
+    return true;
+}
+
+BL_JournalAction_t BL_Journal_Check(BL_Journal_t *j, BL_ErasePlan_t *plan, uint32_t address,
+                                    const uint8_t *data, uint16_t length) {
+    int32_t first, last;
+    bool flash = BL_Journal_Sectors(address, length, &first, &last);
+
+    // Up to the checkpoint. RAM and the like don't survive the target reset,
+    // those blocks go out again.
+    if (j->blocks < j->resume_blocks) {
+        if (!flash) {
+            return BL_JOURNAL_WRITE;
+        }
+        for (int32_t s = first; s <= last; s++) {
+            if (!BL_BIT_GET(j->record.erased, s)) {
+                BL_LOG("Journal: sector %ld was written but never erased\n", (long)s);
+                j->resume_blocks = 0;
+                j->record.blocks = 0;
+                return BL_JOURNAL_FAIL;
+            }
+            BL_BIT_SET(j->kept, s);
+        }
+        BL_Erase_Keep(plan, address, length);
+        j->blocks++;
+        j->bytes += length;
+        j->skipped_bytes += length;
+        return BL_JOURNAL_SKIP;
+    }
+
+    // After the checkpoint, blocks in sectors that weren't erased again may
+    // have gone out before the failure
+    bool kept = false;
+    for (int32_t s = first; flash && s <= last; s++) {
+        kept |= BL_BIT_GET(j->kept, s);
+    }
+    if (!kept) {
+        return BL_JOURNAL_WRITE;
+    }
+
+    uint32_t start, span, crc;
+    uint32_t blank = BL_Journal_SpanCrc(address, data, length, true, &start, &span);
+    uint32_t written = BL_Journal_SpanCrc(address, data, length, false, &start, &span);
+    if (!BL_Verify_TargetCrc(start, span, &crc)) {
+        printf("Journal: reading %08lx failed\n", (unsigned long)start);
+        return BL_JOURNAL_FAIL;
+    }
+    if (crc == written) {
+        j->blocks++;
+        j->bytes += length;
+        j->skipped_bytes += length;
+        return BL_JOURNAL_SKIP;
+    }
+    if (crc != blank) {
+        printf("Journal: %08lx holds other data, can't resume\n", (unsigned long)start);
+        j->resume_blocks = 0;
+        j->record.blocks = 0;
+        return BL_JOURNAL_FAIL;
+    }
+    return BL_JOURNAL_WRITE;
+}
+
+bool BL_Journal_Written(BL_Journal_t *j, const BL_ErasePlan_t *plan, uint32_t address,
+                        const uint8_t *data, uint16_t length) {
+    int32_t first, last;
+
+    j->blocks++;
+    j->bytes += length;
+
+    uint32_t now = BL_Transport_Now(BL_GetTransport());
+    if (!j->open || now - j->last_ms < BL_JOURNAL_INTERVAL_MS) {
+        return true;
+    }
+    // The checkpoint block is read back later, so it has to be in flash and
+    // start a word of its own
+    if ((address & 3) != 0 || !BL_Journal_Sectors(address, length, &first, &last)) {
+        return true;
+    }
+
+    // Once the target has it, read it back
+    uint32_t start, span, crc;
+    uint32_t expected = BL_Journal_SpanCrc(address, data, length, false, &start, &span);
+    if (!BL_WaitPendingAck() || !BL_Verify_TargetCrc(start, span, &crc)) {
+        return false;
+    }
+    j->last_ms = now;
+    if (crc != expected) {
+        return true; // the verify pass reports it, no checkpoint on top of it
+    }
+
+    BL_JournalRecord_t *r = &j->record;
+    r->blocks = j->blocks;
+    r->bytes = j->bytes;
+    r->last_address = start;
+    r->last_length = span;
+    r->last_crc = crc;
+    memcpy(r->erased, plan->erased, sizeof(r->erased));
+    BL_Journal_Save(j);
+    return true;
+}
+
+void BL_Journal_End(BL_Journal_t *j, bool done) {
+    if (j->open) {
+        // Nothing to resume from after a mismatch
+        if (!done && j->record.blocks == 0) {
+            done = true;
+        }
+        f_close(&j->file);
+        j->open = false;
+        if (done) {
+            f_unlink(journal_name);
+        }
+    }
+}
+
+void BL_Journal_Report(const BL_Journal_t *j) {
+    if (BL_Journal_Resuming(j)) {
+        printf("Journal: resumed after %lu blocks, %lu bytes not sent again, %u checkpoints\n",
+               (unsigned long)j->resume_blocks, (unsigned long)j->skipped_bytes, j->checkpoints);
+    } else {
+        printf("Journal: %u checkpoints\n", j->checkpoints);
+    }
+}
@@ -0,0 +1,114 @@
+/*
+ * bl_lines.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_lines.h"
+#include <string.h>
+
+#define BL_LINES_ONES  0x01010101UL
+#define BL_LINES_HIGHS 0x80808080UL
+#define BL_LINES_NL    (0x0AUL * BL_LINES_ONES)
+
+// Index of the first '\n' in buf from index from on. buf[end] holds a '\n'
+// sentinel, so the scan needs no bounds check and always stops.
+static uint32_t BL_LineReader_Scan(const uint8_t *buf, uint32_t from) {
+    const uint8_t *p = &buf[from];
+
+    while (((uintptr_t)p & 3) != 0) {
+        if (*p == '\n') {
+            return p - buf;
+        }
+        p++;
+    }
+
+    // A word at a time: newline bytes become 0 after the XOR, and the
+    // classic zero byte test flags them. Little endian, so the lowest flag
+    // is the first newline (false flags only ever sit above a real one).
+    const uint32_t *w = (const uint32_t *)p;
+    while (true) {
+        uint32_t x = *w ^ BL_LINES_NL;
+        uint32_t zero = (x - BL_LINES_ONES) & ~x & BL_LINES_HIGHS;
+        if (zero != 0) {
+            return (const uint8_t *)w - buf + (__builtin_ctz(zero) >> 3);
+        }
+        w++;
+    }
+}
+
+// Move the unfinished line in front of the read area and read the next part
+static bool BL_LineReader_Fill(BL_LineReader_t *r) {
+    uint32_t tail = r->end - r->pos;
+    UINT n;
+
+    if (tail > BL_LINES_MAX) {
+        r->error = true;
+        return false;
+    }
+    memmove(&r->buf[BL_LINES_MAX - tail], &r->buf[r->pos], tail);
+    r->pos = BL_LINES_MAX - tail;
+
+    if (f_read(r->file, &r->buf[BL_LINES_MAX], BL_LINES_READ_SIZE, &n) != FR_OK) {
+        r->error = true;
+        return false;
+    }
+    r->reads++;
+    r->end = BL_LINES_MAX + n;
+    r->eof = n < BL_LINES_READ_SIZE;
+    r->buf[r->end] = '\n';
+    return true;
+}
+
+void BL_LineReader_Init(BL_LineReader_t *r, FIL *file) {
+    r->file = file;
+    r->pos = BL_LINES_MAX;
+    r->end = BL_LINES_MAX;
+    r->eof = false;
+    r->error = false;
+    r->lines = 0;
+    r->reads = 0;
+    r->buf[r->end] = '\n';
+}
+
+bool BL_LineReader_Next(BL_LineReader_t *r, BL_Line_t *line) {
+    line->text = NULL;
+    line->length = 0;
+
+    while (true) {
+        if (r->pos == r->end) {
+            if (r->eof) {
+                return true;
+            }
+            if (!BL_LineReader_Fill(r)) {
+                return false;
+            }
+            continue;
+        }
+
+        // A whole line, or the last one of a file that doesn't end in a newline
+        uint32_t nl = BL_LineReader_Scan(r->buf, r->pos);
+        if (nl < r->end || r->eof) {
+            char *text = (char *)&r->buf[r->pos];
+            uint32_t length = nl - r->pos;
+            if (length > BL_HEX_LINE_MAX - 1) {
+                r->error = true;
+                return false;
+            }
+            if (length > 0 && text[length - 1] == '\r') {
+                length--;
+            }
+            text[length] = '\0';
+
+            r->pos = (nl < r->end) ? nl + 1 : r->end;
+            r->lines++;
+            line->text = text;
+            line->length = length;
+            return true;
+        }
+
+        if (!BL_LineReader_Fill(r)) {
+            return false;
+        }
+    }
+}
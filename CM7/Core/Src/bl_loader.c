@@ -0,0 +1,330 @@
+/*
+ * bl_loader.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_loader.h"
+#include "bootloader.h"
+#include "bl_crc.h"
+#include "fatfs.h"
+#include <string.h>
+
+/* ********************** Helpers ****************************** */
+
+// PackBits: a header n of 0..127 is followed by n+1 literal bytes, -1..-127
+// by one byte that repeats 1-n times. Returns 0 when the result would not
+// be smaller than the input, the frame then goes out uncompressed.
+static uint16_t BL_Loader_PackBits(const uint8_t *in, uint16_t length, uint8_t *out) {
+    uint16_t i = 0;
+    uint16_t o = 0;
+
+    while (i < length) {
+        uint16_t run = 1;
+        while (i + run < length && run < 128 && in[i + run] == in[i]) {
+            run++;
+        }
+        if (run >= 3) {
+            if (o + 2 >= length) {
+                return 0;
+            }
+            out[o++] = (uint8_t)(1 - run);
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+
+        // Literals up to the next run of three
+        uint16_t start = i;
+        uint16_t count = 0;
+        while (i < length && count < 128) {
+            if (i + 2 < length && in[i] == in[i + 1] && in[i] == in[i + 2]) {
+                break;
+            }
+            i++;
+            count++;
+        }
+        if (o + 1 + count >= length) {
+            return 0;
+        }
+        out[o++] = (uint8_t)(count - 1);
+        memcpy(&out[o], &in[start], count);
+        o += count;
+    }
+    return o;
+}
+
+// Put a frame on the wire, in pieces the size of the transport's TX slots
+static bool BL_Loader_Transmit(BL_Loader_t *l, uint32_t index) {
+    uint8_t slot = index % BL_LOADER_WINDOW_MAX;
+    const uint8_t *frame = l->frames[slot];
+    uint16_t length = l->frame_length[slot];
+
+    for (uint16_t sent = 0; sent < length; ) {
+        uint16_t n = length - sent;
+        if (n > BL_TRANSPORT_TX_SIZE) {
+            n = BL_TRANSPORT_TX_SIZE;
+        }
+        if (!BL_Transport_Send(l->link, &frame[sent], n, BL_Transport_Deadline(l->link, 100))) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+// Wait for a response with a valid CRC, anything else on the line is skipped
+static bool BL_Loader_Receive(BL_Loader_t *l, BL_LoaderResponse_t *r, uint32_t deadline) {
+    uint8_t *bytes = (uint8_t *)r;
+    uint32_t words[2];
+
+    while (true) {
+        do {
+            if (!BL_Transport_Receive(l->link, &bytes[0], 1, deadline)) {
+                return false;
+            }
+        } while (bytes[0] != BL_LDR_SYNC_STUB);
+
+        if (!BL_Transport_Receive(l->link, &bytes[1], sizeof(*r) - 1, deadline)) {
+            return false;
+        }
+        memcpy(words, r, sizeof(words));
+        if (BL_CRC_Update(BL_CRC_INIT, words, 2) == r->crc) {
+            return true;
+        }
+    }
+}
+
+// Go back to the first unacknowledged frame and send everything again
+static bool BL_Loader_Resend(BL_Loader_t *l) {
+    if (++l->retries > BL_LOADER_RETRIES) {
+        printf("Loader: frame %lu not accepted after %u tries\n", (unsigned long)l->tail, BL_LOADER_RETRIES);
+        return false;
+    }
+    for (uint32_t i = l->tail; i != l->head; i++) {
+        if (!BL_Loader_Transmit(l, i)) {
+            return false;
+        }
+        l->resent++;
+    }
+    return true;
+}
+
+// Handle responses until at most keep frames are unacknowledged
+static bool BL_Loader_Drain(BL_Loader_t *l, uint32_t keep) {
+    uint32_t deadline = BL_Transport_Deadline(l->link, BL_LOADER_ACK_TIMEOUT);
+
+    while (l->head - l->tail > keep) {
+        BL_LoaderResponse_t r;
+        if (!BL_Loader_Receive(l, &r, deadline)) {
+            if (!BL_Loader_Resend(l)) {
+                return false;
+            }
+            deadline = BL_Transport_Deadline(l->link, BL_LOADER_ACK_TIMEOUT);
+            continue;
+        }
+
+        // Responses name the frame they are about, ACKs are cumulative.
+        // Anything behind the tail belongs to a frame that was resent.
+        uint32_t outstanding = l->head - l->tail;
+        uint8_t ahead = (uint8_t)(r.seq - (uint8_t)l->tail);
+        if (ahead >= outstanding) {
+            continue;
+        }
+
+        if (r.type == BL_LDR_ACK || r.type == BL_LDR_RESULT) {
+            l->tail += ahead + 1;
+            l->retries = 0;
+            l->result = r.value;
+            deadline = BL_Transport_Deadline(l->link, BL_LOADER_ACK_TIMEOUT);
+        } else if (r.type == BL_LDR_NACK && (r.status == BL_LDR_ERR_CRC || r.status == BL_LDR_ERR_SEQ)) {
+            l->tail += ahead;
+            if (!BL_Loader_Resend(l)) {
+                return false;
+            }
+            deadline = BL_Transport_Deadline(l->link, BL_LOADER_ACK_TIMEOUT);
+        } else if (r.type == BL_LDR_NACK) {
+            printf("Loader: frame %u failed with status %u at %08lx\n", r.seq, r.status, (unsigned long)r.value);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Build the next frame in its window slot and send it
+static bool BL_Loader_Send(BL_Loader_t *l, uint8_t type, uint32_t address, const uint8_t *data, uint16_t length) {
+    if (!BL_Loader_Drain(l, l->window - 1)) {
+        return false;
+    }
+
+    uint8_t slot = l->head % BL_LOADER_WINDOW_MAX;
+    uint8_t *frame = l->frames[slot];
+    BL_LoaderHeader_t *h = (BL_LoaderHeader_t *)frame;
+    uint8_t *payload = &frame[sizeof(*h)];
+    uint16_t wire = 0;
+
+    h->flags = 0;
+    if (type == BL_LDR_PROGRAM && (l->caps & BL_LDR_CAP_PACKBITS)) {
+        wire = BL_Loader_PackBits(data, length, payload);
+        if (wire != 0) {
+            h->flags = BL_LDR_FLAG_PACKBITS;
+        }
+    }
+    if (wire == 0 && length > 0) {
+        memcpy(payload, data, length);
+        wire = length;
+    }
+    while (wire & 3) {
+        payload[wire++] = 0xFF;
+    }
+
+    h->sync = BL_LDR_SYNC_HOST;
+    h->type = type;
+    h->seq = (uint8_t)l->head;
+    h->address = address;
+    h->length = wire;
+    h->raw_length = length;
+    uint32_t crc = BL_CRC_Update(BL_CRC_INIT, (const uint32_t *)frame, (sizeof(*h) + wire) / 4);
+    memcpy(&payload[wire], &crc, sizeof(crc));
+    l->frame_length[slot] = sizeof(*h) + wire + sizeof(crc);
+
+    l->head++;
+    l->frame_count++;
+    l->wire_bytes += wire;
+    return BL_Loader_Transmit(l, l->head - 1);
+}
+
+static bool BL_Loader_FlushPending(BL_Loader_t *l) {
+    if (l->pending_length == 0) {
+        return true;
+    }
+    bool ok = BL_Loader_Send(l, BL_LDR_PROGRAM, l->pending_address, l->pending, l->pending_length);
+    l->raw_bytes += l->pending_length;
+    l->pending_length = 0;
+    return ok;
+}
+
+/* ********************** API ****************************** */
+
+BL_LoaderStart_t BL_Loader_Start(BL_Loader_t *l, const char *filename, uint32_t ram_address) {
+    static FIL file;
+    static uint8_t chunk[BL_COALESCE_BLOCK_SIZE] __attribute__((aligned(4)));
+    uint32_t size = 0;
+    uint32_t crc = BL_CRC_INIT;
+    uint32_t target_crc;
+    UINT n;
+
+    if (f_open(&file, filename, FA_READ) != FR_OK) {
+        printf("Loader: %s not found\n", filename);
+        return BL_LOADER_UNAVAILABLE;
+    }
+
+    // Through the ROM bootloader, padded to words for the CRC check
+    BL_CRC_Init();
+    while (f_read(&file, chunk, sizeof(chunk), &n) == FR_OK && n > 0) {
+        while (n & 3) {
+            chunk[n++] = 0xFF;
+        }
+        if (!BL_WriteMemory(ram_address + size, chunk, n)) {
+            f_close(&file);
+            printf("Loader: writing the stub failed\n");
+            return BL_LOADER_UNAVAILABLE;
+        }
+        crc = BL_CRC_Update(crc, (const uint32_t *)chunk, n / 4);
+        size += n;
+    }
+    f_close(&file);
+
+    if (size == 0 || !BL_WaitPendingAck() ||
+        !BL_Verify_TargetCrc(ram_address, size, &target_crc) || target_crc != crc) {
+        printf("Loader: stub not in RAM\n");
+        return BL_LOADER_UNAVAILABLE;
+    }
+
+    // From here on the ROM bootloader is gone
+    l->link = BL_GetTransport();
+    BL_Transport_Flush(l->link);
+    if (!BL_Go(ram_address)) {
+        return BL_LOADER_LOST;
+    }
+
+    BL_LoaderResponse_t r;
+    if (!BL_Loader_Receive(l, &r, BL_Transport_Deadline(l->link, BL_LOADER_HELLO_TIMEOUT)) ||
+        r.type != BL_LDR_HELLO || r.status != BL_LDR_VERSION) {
+        printf("Loader: no HELLO from the stub\n");
+        return BL_LOADER_LOST;
+    }
+
+    l->window = r.value & 0xFF;
+    l->caps = (r.value >> 8) & 0xFF;
+    l->payload_max = r.value >> 16;
+    if (l->window == 0) {
+        l->window = 1;
+    }
+    if (l->window > BL_LOADER_WINDOW_MAX) {
+        l->window = BL_LOADER_WINDOW_MAX;
+    }
+    if (l->payload_max > BL_LOADER_PAYLOAD_MAX) {
+        l->payload_max = BL_LOADER_PAYLOAD_MAX;
+    }
+    if (l->payload_max < BL_COALESCE_BLOCK_SIZE) {
+        printf("Loader: stub frames too small (%u)\n", l->payload_max);
+        return BL_LOADER_LOST;
+    }
+
+    l->head = 0;
+    l->tail = 0;
+    l->retries = 0;
+    l->pending_length = 0;
+    l->raw_bytes = 0;
+    l->wire_bytes = 0;
+    l->frame_count = 0;
+    l->resent = 0;
+    l->start_ms = BL_Transport_Now(l->link);
+    printf("Loader: %lu byte stub running, window %u, frames of %u bytes%s\n", (unsigned long)size,
+           l->window, l->payload_max, (l->caps & BL_LDR_CAP_PACKBITS) ? ", PackBits" : "");
+    return BL_LOADER_STARTED;
+}
+
+bool BL_Loader_Write(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    BL_Loader_t *l = ctx;
+
+    if (l->pending_length > 0 &&
+        (address != l->pending_address + l->pending_length || l->pending_length + length > l->payload_max)) {
+        if (!BL_Loader_FlushPending(l)) {
+            return false;
+        }
+    }
+    if (l->pending_length == 0) {
+        l->pending_address = address;
+    }
+    memcpy(&l->pending[l->pending_length], data, length);
+    l->pending_length += length;
+    return true;
+}
+
+bool BL_Loader_Sync(BL_Loader_t *l) {
+    return BL_Loader_FlushPending(l) && BL_Loader_Drain(l, 0);
+}
+
+bool BL_Loader_Checksum(BL_Loader_t *l, uint32_t address, uint32_t length, uint32_t *crc) {
+    if (!BL_Loader_Sync(l) ||
+        !BL_Loader_Send(l, BL_LDR_CHECKSUM, address, (const uint8_t *)&length, sizeof(length)) ||
+        !BL_Loader_Drain(l, 0)) {
+        return false;
+    }
+    *crc = l->result;
+    return true;
+}
+
+bool BL_Loader_Go(BL_Loader_t *l, uint32_t address) {
+    return BL_Loader_Sync(l) && BL_Loader_Send(l, BL_LDR_GO, address, NULL, 0) && BL_Loader_Drain(l, 0);
+}
+
+void BL_Loader_Report(const BL_Loader_t *l) {
+    uint32_t elapsed = BL_Transport_Now(l->link) - l->start_ms;
+    printf("Loader: %lu bytes in %lu frames, %lu on the wire (%lu%%), %lu resent, %lu ms\n",
+           (unsigned long)l->raw_bytes, (unsigned long)l->frame_count, (unsigned long)l->wire_bytes,
+           (unsigned long)(l->raw_bytes ? (uint64_t)l->wire_bytes * 100 / l->raw_bytes : 0),
+           (unsigned long)l->resent, (unsigned long)elapsed);
+}
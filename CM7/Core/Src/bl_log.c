@@ -0,0 +1,248 @@
+/*
+ * bl_log.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_log.h"
+#include "bl_transport.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BL_LOG_MASK (BL_LOG_RING_WORDS - 1)
+
+// Record header: length in words (header included), type, and the argument
+// count or text length. 0 marks words that are reserved but not written yet,
+// the drain clears every word it has sent.
+#define BL_LOG_HEADER(words, type, n) ((uint32_t)(words) | ((uint32_t)(type) << 16) | ((uint32_t)(n) << 24))
+#define BL_LOG_WORDS(h)               ((h) & 0xFFFF)
+#define BL_LOG_TYPE(h)                (((h) >> 16) & 0xFF)
+#define BL_LOG_COUNT(h)               ((h) >> 24)
+
+enum {
+    BL_LOG_PAD = 1,   // rest of the ring up to the wrap
+    BL_LOG_TEXT,
+    BL_LOG_FORMAT,    // format pointer, then the arguments
+};
+
+static uint32_t ring[BL_LOG_RING_WORDS];
+static uint32_t head;            // words reserved by the producers
+static uint32_t tail;            // words released by the drain
+static uint32_t dropped;         // records lost to a full ring
+static uint32_t dropped_reported;
+
+static char tx[BL_LOG_TX_SIZE] BL_DMA_BUFFER;
+static volatile bool tx_busy;
+static UART_HandleTypeDef *uart;
+static IRQn_Type uart_irq;
+static BL_LogPolicy_t policy = BL_LOG_DEFAULT_POLICY;
+
+/* ********************** Ring ****************************** */
+
+// Reserve words in one piece, padding up to the wrap if they don't fit in
+// front of it. Returns the index, -1 if the ring is full.
+static int32_t BL_Log_Reserve(uint32_t words) {
+    uint32_t h, index, skip;
+
+    do {
+        h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+        index = h & BL_LOG_MASK;
+        skip = (BL_LOG_RING_WORDS - index < words) ? BL_LOG_RING_WORDS - index : 0;
+        if (h + skip + words - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) > BL_LOG_RING_WORDS) {
+            return -1;
+        }
+    } while (!__atomic_compare_exchange_n(&head, &h, h + skip + words, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    if (skip != 0) {
+        __atomic_store_n(&ring[index], BL_LOG_HEADER(skip, BL_LOG_PAD, 0), __ATOMIC_RELEASE);
+        return 0;
+    }
+    return (int32_t)index;
+}
+
+// Waiting needs the UART interrupt to get through
+static bool BL_Log_CanWait(void) {
+    return uart != NULL && __get_IPSR() == 0 && __get_PRIMASK() == 0;
+}
+
+static void BL_Log_Kick(void) {
+    if (uart != NULL && !tx_busy) {
+        NVIC_SetPendingIRQ(uart_irq);
+    }
+}
+
+static int32_t BL_Log_Claim(uint32_t words) {
+    while (true) {
+        int32_t index = BL_Log_Reserve(words);
+        if (index >= 0) {
+            return index;
+        }
+        if (policy == BL_LOG_DROP || !BL_Log_CanWait()) {
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+        BL_Log_Kick();
+    }
+}
+
+static void BL_Log_Commit(int32_t index, uint32_t header) {
+    __atomic_store_n(&ring[index], header, __ATOMIC_RELEASE);
+    BL_Log_Kick();
+}
+
+void BL_Log_Deferred(const char *fmt, uint8_t nargs, ...) {
+    va_list ap;
+
+    if (nargs > BL_LOG_ARGS_MAX) {
+        nargs = BL_LOG_ARGS_MAX;
+    }
+    int32_t index = BL_Log_Claim(2 + nargs);
+    if (index < 0) {
+        return;
+    }
+
+    ring[index + 1] = (uint32_t)fmt;
+    va_start(ap, nargs);
+    for (uint8_t i = 0; i < nargs; i++) {
+        ring[index + 2 + i] = va_arg(ap, uint32_t);
+    }
+    va_end(ap);
+    BL_Log_Commit(index, BL_LOG_HEADER(2 + nargs, BL_LOG_FORMAT, nargs));
+}
+
+uint32_t BL_Log_Write(const char *text, uint32_t length) {
+    uint32_t done = 0;
+
+    while (done < length) {
+        uint32_t n = length - done;
+        if (n > BL_LOG_TEXT_MAX) {
+            n = BL_LOG_TEXT_MAX;
+        }
+        int32_t index = BL_Log_Claim(1 + (n + 3) / 4);
+        if (index < 0) {
+            break;
+        }
+        memcpy(&ring[index + 1], &text[done], n);
+        BL_Log_Commit(index, BL_LOG_HEADER(1 + (n + 3) / 4, BL_LOG_TEXT, n));
+        done += n;
+    }
+    return done;
+}
+
+// newlib sends stdout and stderr here (the weak _write of syscalls.c goes
+// through __io_putchar a character at a time)
+int _write(int file, char *ptr, int len) {
+    (void)file;
+    BL_Log_Write(ptr, (uint32_t)len);
+    return len; // dropped text counts as written, like a full UART FIFO would
+}
+
+/* ********************** Drain ****************************** */
+
+// Render one record into out (at least BL_LOG_LINE_MAX bytes free)
+static uint32_t BL_Log_Render(uint32_t index, uint32_t header, char *out) {
+    switch (BL_LOG_TYPE(header)) {
+    case BL_LOG_TEXT:
+        memcpy(out, &ring[index + 1], BL_LOG_COUNT(header));
+        return BL_LOG_COUNT(header);
+    case BL_LOG_FORMAT: {
+        // All argument words go on the stack in order, which is how AAPCS
+        // passes 32-bit varargs. Unused ones are ignored by the format.
+        uint32_t args[BL_LOG_ARGS_MAX] = {0};
+        memcpy(args, &ring[index + 2], BL_LOG_COUNT(header) * sizeof(uint32_t));
+        int n = snprintf(out, BL_LOG_LINE_MAX, (const char *)ring[index + 1], args[0], args[1], args[2],
+                         args[3], args[4], args[5], args[6], args[7]);
+        if (n < 0) {
+            return 0;
+        }
+        return (n < BL_LOG_LINE_MAX) ? (uint32_t)n : BL_LOG_LINE_MAX - 1;
+    }
+    default:
+        return 0;
+    }
+}
+
+void BL_Log_Drain(void) {
+    uint32_t used = 0;
+
+    if (uart == NULL || tx_busy) {
+        return;
+    }
+
+    uint32_t lost = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+    if (lost != dropped_reported) {
+        used = snprintf(tx, BL_LOG_LINE_MAX, "[log: %lu records dropped]\n",
+                        (unsigned long)(lost - dropped_reported));
+        dropped_reported = lost;
+    }
+
+    uint32_t t = tail;
+    while (t != __atomic_load_n(&head, __ATOMIC_ACQUIRE) && used + BL_LOG_LINE_MAX <= sizeof(tx)) {
+        uint32_t index = t & BL_LOG_MASK;
+        uint32_t header = __atomic_load_n(&ring[index], __ATOMIC_ACQUIRE);
+        if (header == 0) {
+            break; // still being written, its commit kicks the drain again
+        }
+        used += BL_Log_Render(index, header, &tx[used]);
+        // Any word can be the header of a later record, all of them go back to 0
+        memset(&ring[index], 0, BL_LOG_WORDS(header) * sizeof(uint32_t));
+        t += BL_LOG_WORDS(header);
+        __atomic_store_n(&tail, t, __ATOMIC_RELEASE);
+    }
+
+    if (used > 0) {
+        tx_busy = true;
+        if (HAL_UART_Transmit_DMA(uart, (uint8_t *)tx, (uint16_t)used) != HAL_OK) {
+            tx_busy = false;
+        }
+    }
+}
+
+static void BL_Log_TxCplt(UART_HandleTypeDef *huart) {
+    tx_busy = false; // the IRQ handler calls BL_Log_Drain right after
+}
+
+static void BL_Log_Error(UART_HandleTypeDef *huart) {
+    if (huart->gState == HAL_UART_STATE_READY) {
+        tx_busy = false; // the chunk is lost
+    }
+}
+
+/* ********************** API ****************************** */
+
+bool BL_Log_Init(UART_HandleTypeDef *huart, IRQn_Type irq) {
+    if (huart->hdmatx == NULL ||
+        HAL_UART_RegisterCallback(huart, HAL_UART_TX_COMPLETE_CB_ID, BL_Log_TxCplt) != HAL_OK ||
+        HAL_UART_RegisterCallback(huart, HAL_UART_ERROR_CB_ID, BL_Log_Error) != HAL_OK) {
+        return false;
+    }
+    tx_busy = false;
+    uart_irq = irq;
+    uart = huart;
+    BL_Log_Kick(); // whatever was logged before
+    return true;
+}
+
+void BL_Log_SetPolicy(BL_LogPolicy_t p) {
+    policy = p;
+}
+
+bool BL_Log_Flush(uint32_t timeout) {
+    uint32_t start = HAL_GetTick();
+
+    if (!BL_Log_CanWait()) {
+        return false;
+    }
+    while (tx_busy || __atomic_load_n(&tail, __ATOMIC_ACQUIRE) != __atomic_load_n(&head, __ATOMIC_ACQUIRE)) {
+        BL_Log_Kick();
+        if (HAL_GetTick() - start >= timeout) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t BL_Log_Dropped(void) {
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
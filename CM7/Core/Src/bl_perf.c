@@ -0,0 +1,127 @@
+/*
+ * bl_perf.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_perf.h"
+#include "bl_hex.h"
+#include "bl_crc.h"
+#include "stm32h7xx_hal.h"
+#include <stdio.h>
+
+#define BL_PERF_LINE_LEN   (11 + 2 * BL_PERF_RECORD_LEN + 1) // ":LLAAAATT" data CC '\0'
+#define BL_PERF_DATA_WORDS (BL_PERF_RECORDS * BL_PERF_RECORD_LEN / 4)
+
+// Generated once, one NUL terminated line per record
+static char text[BL_PERF_RECORDS][BL_PERF_LINE_LEN];
+static uint32_t data[BL_PERF_DATA_WORDS];
+
+typedef struct {
+    uint32_t crc;
+    uint32_t next; // expected address of the next block
+    bool ordered;
+} BL_PerfSink_t;
+
+static bool BL_Perf_Checksum(void *ctx, uint32_t address, const uint8_t *block, uint16_t length) {
+    BL_PerfSink_t *s = ctx;
+    if (address != s->next || (length & 3) != 0) {
+        s->ordered = false;
+        return true;
+    }
+    s->crc = BL_CRC_Update(s->crc, (const uint32_t *)block, length / 4);
+    s->next = address + length;
+    return true;
+}
+
+static void BL_Perf_PutByte(char *out, uint8_t value) {
+    static const char digits[] = "0123456789ABCDEF";
+    out[0] = digits[value >> 4];
+    out[1] = digits[value & 0x0F];
+}
+
+// Contiguous data records from address 0 with xorshift contents, no
+// extended address record so the whole image stays in the first 64 KiB
+static void BL_Perf_Generate(void) {
+    uint32_t x = 0x2545F491;
+    for (uint32_t i = 0; i < BL_PERF_DATA_WORDS; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        data[i] = x;
+    }
+
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (uint32_t r = 0; r < BL_PERF_RECORDS; r++) {
+        uint16_t address = r * BL_PERF_RECORD_LEN;
+        char *line = text[r];
+        uint8_t sum = BL_PERF_RECORD_LEN + (address >> 8) + (address & 0xFF);
+
+        line[0] = ':';
+        BL_Perf_PutByte(&line[1], BL_PERF_RECORD_LEN);
+        BL_Perf_PutByte(&line[3], address >> 8);
+        BL_Perf_PutByte(&line[5], address & 0xFF);
+        BL_Perf_PutByte(&line[7], 0x00);
+        for (uint32_t i = 0; i < BL_PERF_RECORD_LEN; i++) {
+            uint8_t b = bytes[address + i];
+            BL_Perf_PutByte(&line[9 + 2 * i], b);
+            sum += b;
+        }
+        BL_Perf_PutByte(&line[9 + 2 * BL_PERF_RECORD_LEN], (uint8_t)(~sum + 1));
+        line[BL_PERF_LINE_LEN - 1] = '\0';
+    }
+}
+
+bool BL_Perf_SelfCheck(BL_PerfResult_t *result) {
+    static BL_Coalescer_t coalescer;
+    BL_HexParser_t hex;
+    BL_PerfSink_t sink;
+
+    result->sysclk_hz = HAL_RCC_GetSysClockFreq();
+    result->hclk_hz = HAL_RCC_GetHCLKFreq();
+    result->text_bytes = BL_PERF_RECORDS * (BL_PERF_LINE_LEN - 1);
+    result->cycles = 0xFFFFFFFF;
+    result->checksum_ok = true;
+
+    BL_CRC_Init();
+    BL_Perf_Generate();
+    uint32_t expected = BL_CRC_Update(BL_CRC_INIT, data, BL_PERF_DATA_WORDS);
+
+    // Best of several passes, the first one also warms the caches
+    for (uint32_t pass = 0; pass < BL_PERF_ITERATIONS; pass++) {
+        sink.crc = BL_CRC_INIT;
+        sink.next = 0;
+        sink.ordered = true;
+        BL_Coalescer_Init(&coalescer, BL_Perf_Checksum, &sink);
+        BL_HexParser_Init(&hex, &coalescer);
+
+        uint32_t start = DWT->CYCCNT;
+        for (uint32_t r = 0; r < BL_PERF_RECORDS; r++) {
+            if (!BL_ProcessHexLine(&hex, text[r])) {
+                return false;
+            }
+        }
+        BL_Coalescer_Flush(&coalescer);
+        uint32_t cycles = DWT->CYCCNT - start;
+
+        if (cycles < result->cycles) {
+            result->cycles = cycles;
+        }
+        if (!sink.ordered || sink.crc != expected) {
+            result->checksum_ok = false;
+        }
+    }
+
+    result->score = result->cycles ? (uint32_t)((uint64_t)SystemCoreClock / result->cycles) : 0;
+
+    printf("SYSCLK %lu MHz, HCLK %lu MHz, flash %lu WS, I-cache %s, D-cache %s\n",
+           (unsigned long)(result->sysclk_hz / 1000000), (unsigned long)(result->hclk_hz / 1000000),
+           (unsigned long)__HAL_FLASH_GET_LATENCY(),
+           (SCB->CCR & SCB_CCR_IC_Msk) ? "on" : "off", (SCB->CCR & SCB_CCR_DC_Msk) ? "on" : "off");
+    printf("Parse benchmark: %lu bytes of HEX in %lu cycles (%lu.%02lu cycles/byte), %lu passes/s, checksum %s\n",
+           (unsigned long)result->text_bytes, (unsigned long)result->cycles,
+           (unsigned long)(result->cycles / result->text_bytes),
+           (unsigned long)(result->cycles % result->text_bytes * 100 / result->text_bytes),
+           (unsigned long)result->score, result->checksum_ok ? "ok" : "MISMATCH");
+    return result->checksum_ok;
+}
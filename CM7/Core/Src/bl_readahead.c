@@ -0,0 +1,166 @@
+/*
+ * bl_readahead.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_readahead.h"
+#include "bl_sdcache.h"
+#include "bl_log.h"
+#include "stm32h7xx_hal.h"
+#include <stdio.h>
+
+#if _MAX_SS != 512
+#error "bl_readahead assumes 512 byte sectors"
+#endif
+
+#define BL_READAHEAD_SECTOR 512
+#define BL_READAHEAD_BUFFER (BL_READAHEAD_SECTORS * BL_READAHEAD_SECTOR)
+
+// In AXI SRAM (.bss), which the SDMMC1 IDMA can reach. Cache line aligned so
+// invalidating them never drops a neighbour's dirty line.
+static uint8_t buffers[2][BL_READAHEAD_BUFFER] __attribute__((aligned(32)));
+
+/* ********************** Helpers ****************************** */
+
+// Card sector of file offset, and how many sectors follow it contiguously
+static uint32_t BL_ReadAhead_Sector(const BL_ReadAhead_t *r, uint32_t offset, uint32_t *contiguous) {
+    const FATFS *fs = r->file->obj.fs;
+    uint32_t cluster_size = (uint32_t)fs->csize * BL_READAHEAD_SECTOR;
+    uint32_t index = offset / cluster_size;
+    const DWORD *fragment = &r->map[1];
+
+    // The map is a list of (length, first cluster) pairs
+    while (index >= fragment[0]) {
+        index -= fragment[0];
+        fragment += 2;
+    }
+
+    uint32_t in_cluster = (offset % cluster_size) / BL_READAHEAD_SECTOR;
+    *contiguous = (fragment[0] - index) * fs->csize - in_cluster;
+    return fs->database + (fragment[1] + index - 2) * fs->csize + in_cluster;
+}
+
+static bool BL_ReadAhead_Issue(BL_ReadAhead_t *r) {
+    if (r->issued >= r->size) {
+        return true;
+    }
+
+    uint32_t contiguous;
+    uint32_t sector = BL_ReadAhead_Sector(r, r->issued, &contiguous);
+    uint32_t left = (r->size - r->issued + BL_READAHEAD_SECTOR - 1) / BL_READAHEAD_SECTOR;
+    uint32_t count = BL_READAHEAD_SECTORS;
+    if (count > contiguous) {
+        count = contiguous;
+    }
+    if (count > left) {
+        count = left;
+    }
+
+    // Runs once the card is idle, after whatever FatFs queued before
+    r->req.op = BL_SD_READ;
+    r->req.data = buffers[r->fill];
+    r->req.sector = sector;
+    r->req.count = count;
+    r->req.timeout = BL_READAHEAD_TIMEOUT;
+    r->req.done = NULL;
+    if (!BL_Sd_Submit(&r->req)) {
+        BL_LOG("Read-ahead: read of sector %lu not queued\n", (unsigned long)sector);
+        return false;
+    }
+
+    uint32_t length = count * BL_READAHEAD_SECTOR;
+    if (length > r->size - r->issued) {
+        length = r->size - r->issued;
+    }
+    r->length[r->fill] = length;
+    r->issued += count * BL_READAHEAD_SECTOR;
+    r->busy = true;
+    r->reads++;
+    return true;
+}
+
+// Sleeps until the read is in, bl_sd has invalidated the buffer by then
+static bool BL_ReadAhead_Wait(BL_ReadAhead_t *r) {
+    uint32_t start = HAL_GetTick();
+    bool ok = BL_Sd_Wait(&r->req);
+    r->wait_ms += HAL_GetTick() - start;
+    r->busy = false;
+
+    if (!ok) {
+        BL_LOG("Read-ahead: read of sector %lu failed\n", (unsigned long)r->req.sector);
+    }
+    return ok;
+}
+
+/* ********************** API ****************************** */
+
+bool BL_ReadAhead_Open(BL_ReadAhead_t *r, FIL *file) {
+    r->file = file;
+    r->size = f_size(file);
+    r->issued = 0;
+    r->fill = 0;
+    r->busy = false;
+    r->bytes = 0;
+    r->reads = 0;
+    r->wait_ms = 0;
+    r->elapsed_ms = 0;
+    r->start_ms = HAL_GetTick();
+
+    // The reads below go around the sector cache, sectors written through
+    // FatFs have to be on the card first
+    if (!BL_SdCache_Flush()) {
+        return false;
+    }
+
+    // FatFs walks the FAT once and stores the fragments in the map
+    r->map[0] = BL_READAHEAD_MAP_SIZE;
+    file->cltbl = r->map;
+    if (f_lseek(file, CREATE_LINKMAP) != FR_OK) {
+        file->cltbl = NULL;
+        return false;
+    }
+
+    return BL_ReadAhead_Issue(r);
+}
+
+bool BL_ReadAhead_Next(BL_ReadAhead_t *r, BL_Span_t *span) {
+    span->data = NULL;
+    span->length = 0;
+    if (!r->busy) {
+        r->elapsed_ms = HAL_GetTick() - r->start_ms;
+        return true; // end of file
+    }
+
+    if (!BL_ReadAhead_Wait(r)) {
+        return false;
+    }
+
+    // The caller is done with the other buffer, refill it right away
+    uint8_t done = r->fill;
+    r->fill ^= 1;
+    if (!BL_ReadAhead_Issue(r)) {
+        return false;
+    }
+
+    span->data = buffers[done];
+    span->length = r->length[done];
+    r->bytes += span->length;
+    return true;
+}
+
+void BL_ReadAhead_Close(BL_ReadAhead_t *r) {
+    if (r->busy) {
+        BL_ReadAhead_Wait(r);
+    }
+    r->elapsed_ms = HAL_GetTick() - r->start_ms;
+    r->file->cltbl = NULL;
+}
+
+// SD is off the critical path when wait_ms stays close to zero
+void BL_ReadAhead_Report(const BL_ReadAhead_t *r) {
+    printf("Read-ahead: %lu bytes in %lu reads, %lu ms, %lu ms waiting for SD (%lu B/s)\n",
+           (unsigned long)r->bytes, (unsigned long)r->reads,
+           (unsigned long)r->elapsed_ms, (unsigned long)r->wait_ms,
+           (unsigned long)(r->elapsed_ms ? (uint64_t)r->bytes * 1000 / r->elapsed_ms : 0));
+}
@@ -0,0 +1,133 @@
+/*
+ * bl_rto.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_rto.h"
+#include <stdio.h>
+
+static const char *const class_names[BL_RTO_CLASSES] = {"reply", "program", "erase/page", "mass erase",
+                                                        "checksum/KiB"};
+
+/* ********************** Estimator ****************************** */
+
+uint32_t BL_Rto_WireUs(uint32_t baudrate, uint32_t bytes) {
+    if (baudrate == 0) {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)bytes * 11 * 1000000 + baudrate - 1) / baudrate);
+}
+
+uint32_t BL_Rto_Timeout(const BL_Rto_t *r, BL_RtoClass_t cls, uint32_t units, uint32_t wire_us,
+                        uint32_t initial_ms) {
+    const BL_RtoEstimator_t *e = &r->cls[cls];
+    uint64_t ms;
+
+    if (e->samples == 0) {
+        ms = initial_ms;
+    } else {
+        uint32_t var = 4 * e->rttvar_us;
+        uint64_t us = wire_us + (uint64_t)units * (e->srtt_us + (var > BL_RTO_VAR_MIN_US ? var : BL_RTO_VAR_MIN_US));
+        ms = (us + 999) / 1000 + 1; // a deadline of one tick can pass at once
+    }
+
+    ms <<= e->backoff;
+    if (ms < BL_RTO_MIN_MS) {
+        ms = BL_RTO_MIN_MS;
+    }
+    return ms > BL_RTO_MAX_MS ? BL_RTO_MAX_MS : (uint32_t)ms;
+}
+
+void BL_Rto_Begin(BL_Rto_t *r, BL_RtoWait_t *w, BL_RtoClass_t cls, uint32_t units, uint32_t wire_us,
+                  uint32_t initial_ms, uint32_t now) {
+    BL_RtoEstimator_t *e = &r->cls[cls];
+    uint32_t timeout = BL_Rto_Timeout(r, cls, units, wire_us, initial_ms);
+
+    w->cls = cls;
+    w->units = units > 0 ? units : 1;
+    w->wire_us = wire_us;
+    w->start = now;
+    w->deadline = now + timeout;
+
+    uint8_t bucket = 0;
+    while (bucket < BL_RTO_BUCKETS - 1 && (timeout >> (bucket + 1)) != 0) {
+        bucket++;
+    }
+    e->histogram[bucket]++;
+    e->waits++;
+}
+
+void BL_Rto_Sample(BL_Rto_t *r, const BL_RtoWait_t *w, uint32_t now) {
+    BL_RtoEstimator_t *e = &r->cls[w->cls];
+
+    e->backoff = 0;
+    if (r->retrying) {
+        return; // could be the ACK of an earlier try
+    }
+
+    uint32_t elapsed = (now - w->start) * 1000;
+    uint32_t sample = (elapsed > w->wire_us ? elapsed - w->wire_us : 0) / w->units;
+
+    if (e->samples == 0) {
+        e->srtt_us = sample;
+        e->rttvar_us = sample / 2;
+    } else {
+        uint32_t delta = sample > e->srtt_us ? sample - e->srtt_us : e->srtt_us - sample;
+        e->rttvar_us = (3 * e->rttvar_us + delta) / 4;
+        e->srtt_us = (7 * e->srtt_us + sample) / 8;
+    }
+    if (sample > e->max_us) {
+        e->max_us = sample;
+    }
+    e->samples++;
+}
+
+void BL_Rto_Expired(BL_Rto_t *r, const BL_RtoWait_t *w) {
+    BL_RtoEstimator_t *e = &r->cls[w->cls];
+
+    e->timeouts++;
+    if (e->backoff < BL_RTO_BACKOFF_MAX) {
+        e->backoff++;
+    }
+}
+
+void BL_Rto_Done(BL_Rto_t *r, uint8_t attempt, bool ok) {
+    r->retrying = false;
+    if (attempt > 0) {
+        if (ok) {
+            r->recovered++;
+        } else {
+            r->failed++;
+        }
+    }
+}
+
+/* ********************** Report ****************************** */
+
+void BL_Rto_Report(const BL_Rto_t *r) {
+    printf("Link: %lu retries, %lu resyncs, %lu commands recovered, %lu failed\n",
+           (unsigned long)r->retries, (unsigned long)r->resyncs, (unsigned long)r->recovered,
+           (unsigned long)r->failed);
+
+    for (uint8_t c = 0; c < BL_RTO_CLASSES; c++) {
+        const BL_RtoEstimator_t *e = &r->cls[c];
+        if (e->waits == 0) {
+            continue;
+        }
+        printf("Link %s: %lu waits, %lu timeouts, srtt %lu us, rttvar %lu us, max %lu us\n", class_names[c],
+               (unsigned long)e->waits, (unsigned long)e->timeouts, (unsigned long)e->srtt_us,
+               (unsigned long)e->rttvar_us, (unsigned long)e->max_us);
+
+        // Timeouts handed out, by power of two
+        char line[16 * BL_RTO_BUCKETS];
+        int n = 0;
+        for (uint8_t b = 0; b < BL_RTO_BUCKETS; b++) {
+            if (e->histogram[b] != 0 && n < (int)sizeof(line)) {
+                n += snprintf(line + n, sizeof(line) - n, " %lums:%lu", 1UL << b,
+                              (unsigned long)e->histogram[b]);
+            }
+        }
+        printf("Link %s timeouts:%s\n", class_names[c], line);
+    }
+}
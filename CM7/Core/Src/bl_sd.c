@@ -0,0 +1,280 @@
+/*
+ * bl_sd.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_sd.h"
+#include "bsp_driver_sd.h"
+#include "stm32h7xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BL_SD_SECTOR     512
+#define BL_SD_QUEUE_MASK (BL_SD_QUEUE_DEPTH - 1)
+#define BL_SD_HIST_SHIFT 6 // first histogram bucket is 64 us
+
+extern SD_HandleTypeDef hsd1;
+
+static BL_SdRequest_t *queue[BL_SD_QUEUE_DEPTH];
+static uint8_t queue_head;          // free running, next free entry
+static uint8_t queue_tail;          // free running, oldest request (the active one while a transfer runs)
+static BL_SdRequest_t *active;
+static bool card_busy;              // a write finished, the card may still be programming
+static volatile bool timed_out;     // the active request ran past its deadline, abort pending
+static BL_SdStats_t stats[2];
+
+/* ********************** Helpers ****************************** */
+
+// DWT cycles (BL_Trace_Init starts the counter) to microseconds
+static uint32_t BL_Sd_Us(uint32_t cycles) {
+    return cycles / (SystemCoreClock / 1000000);
+}
+
+static void BL_Sd_Record(BL_SdRequest_t *req, bool ok) {
+    BL_SdStats_t *s = &stats[req->op];
+    uint32_t now = DWT->CYCCNT;
+    uint32_t total = BL_Sd_Us(now - req->submitted);
+    uint32_t queued = (req->state == BL_SD_ACTIVE) ? BL_Sd_Us(req->started - req->submitted) : total;
+
+    s->requests++;
+    if (!ok) {
+        s->errors++;
+    }
+    s->sectors += req->count;
+    s->total_us += total;
+    s->queued_us += queued;
+    if (total > s->max_us) {
+        s->max_us = total;
+    }
+
+    uint8_t bucket = 0;
+    while (bucket < BL_SD_HIST_BUCKETS - 1 && total >= (1UL << (bucket + BL_SD_HIST_SHIFT))) {
+        bucket++;
+    }
+    s->hist[bucket]++;
+}
+
+// Take the oldest request off the queue and report it, interrupts masked
+static void BL_Sd_Finish(BL_SdRequest_t *req, bool ok) {
+    if (ok && req->op == BL_SD_READ && (SCB->CCR & SCB_CCR_DC_Msk)) {
+        // Lines the CPU pulled in while the IDMA was writing are stale.
+        // AXI SRAM is write-through, so widening to whole lines loses nothing.
+        uint32_t start = (uint32_t)req->data & ~31UL;
+        SCB_InvalidateDCache_by_Addr((uint32_t *)start, req->count * BL_SD_SECTOR + ((uint32_t)req->data - start));
+    }
+
+    BL_Sd_Record(req, ok);
+    active = NULL;
+    queue_tail++;
+    req->state = ok ? BL_SD_DONE : BL_SD_FAILED;
+    if (req->done != NULL) {
+        req->done(req);
+    }
+    __SEV(); // wake BL_Sd_Wait
+}
+
+// Start the oldest queued request if the card can take it, interrupts
+// masked. Behind a write the card has to answer CMD13 first, which only
+// BL_Sd_Service asks, so nothing starts here while card_busy is set.
+static void BL_Sd_StartNext(void) {
+    while (active == NULL && queue_tail != queue_head) {
+        BL_SdRequest_t *req = queue[queue_tail & BL_SD_QUEUE_MASK];
+
+        if (card_busy) {
+            if ((int32_t)(HAL_GetTick() - req->deadline) >= 0) {
+                BL_Sd_Finish(req, false);
+                continue;
+            }
+            return;
+        }
+
+        uint8_t status;
+        if (req->op == BL_SD_WRITE) {
+            if (SCB->CCR & SCB_CCR_DC_Msk) {
+                uint32_t start = (uint32_t)req->data & ~31UL;
+                SCB_CleanDCache_by_Addr((uint32_t *)start, req->count * BL_SD_SECTOR + ((uint32_t)req->data - start));
+            }
+            status = BSP_SD_WriteBlocks_DMA((uint32_t *)req->data, req->sector, req->count);
+        } else {
+            status = BSP_SD_ReadBlocks_DMA((uint32_t *)req->data, req->sector, req->count);
+        }
+        if (status != MSD_OK) {
+            BL_Sd_Finish(req, false);
+            continue;
+        }
+
+        req->started = DWT->CYCCNT;
+        req->state = BL_SD_ACTIVE;
+        active = req;
+    }
+}
+
+// Thread side of the queue, called by everything that waits on it. Aborts
+// a timed out transfer and polls the card with CMD13 while it programs.
+// Both wait for the card with HAL_GetTick deadlines, which don't move
+// inside the SysTick interrupt, so they can't run from BL_Sd_Tick.
+static void BL_Sd_Service(void) {
+    if (timed_out) {
+        HAL_SD_Abort(&hsd1); // with interrupts on, the tick has to move
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (timed_out) {
+        timed_out = false;
+        card_busy = true; // whatever state the card is in, ask before the next one
+        BL_Sd_Finish(active, false);
+    }
+    // CMD13 waits for its response with a loop count, not the tick
+    if (card_busy && active == NULL && BSP_SD_GetCardState() == SD_TRANSFER_OK) {
+        card_busy = false;
+    }
+    BL_Sd_StartNext();
+    __set_PRIMASK(primask);
+}
+
+/* ********************** API ****************************** */
+
+bool BL_Sd_Submit(BL_SdRequest_t *req) {
+    if (req->count == 0 || ((uint32_t)req->data & 3) != 0) {
+        return false;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool ok = (uint8_t)(queue_head - queue_tail) < BL_SD_QUEUE_DEPTH;
+    if (ok) {
+        req->state = BL_SD_QUEUED;
+        req->submitted = DWT->CYCCNT;
+        req->deadline = HAL_GetTick() + req->timeout;
+        queue[queue_head & BL_SD_QUEUE_MASK] = req;
+        queue_head++;
+    }
+    __set_PRIMASK(primask);
+    if (ok) {
+        BL_Sd_Service();
+    }
+    return ok;
+}
+
+bool BL_Sd_Wait(BL_SdRequest_t *req) {
+    // BL_Sd_Finish sends an event after the state change, so a completion
+    // between the check and the WFE doesn't leave it sleeping. SysTick
+    // wakes it every millisecond for BL_Sd_Service.
+    while (BL_Sd_Pending(req)) {
+        BL_Sd_Service();
+        if (!BL_Sd_Pending(req)) {
+            break;
+        }
+        __WFE();
+    }
+    return req->state == BL_SD_DONE;
+}
+
+bool BL_Sd_Transfer(BL_SdOp_t op, uint8_t *data, uint32_t sector, uint32_t count, uint32_t timeout) {
+    BL_SdRequest_t req = {
+        .op = op,
+        .data = data,
+        .sector = sector,
+        .count = count,
+        .timeout = timeout,
+    };
+
+    return BL_Sd_Submit(&req) && BL_Sd_Wait(&req);
+}
+
+bool BL_Sd_Sync(uint32_t timeout) {
+    uint32_t start = HAL_GetTick();
+
+    // BL_Sd_Tick wakes this up every millisecond
+    while (active != NULL || queue_tail != queue_head || card_busy) {
+        BL_Sd_Service();
+        if (active == NULL && queue_tail == queue_head && !card_busy) {
+            break;
+        }
+        if (HAL_GetTick() - start >= timeout) {
+            return false;
+        }
+        __WFE();
+    }
+    return true;
+}
+
+/* ********************** Interrupts ****************************** */
+
+// HAL_SD_RxCpltCallback/TxCpltCallback, through the BSP callbacks
+void BL_Sd_TransferDone(void) {
+    BL_SdRequest_t *req = active;
+    if (req == NULL || timed_out) {
+        return; // BL_Sd_Service aborts and finishes it
+    }
+
+    if (req->op == BL_SD_WRITE) {
+        card_busy = true;
+    }
+    BL_Sd_Finish(req, hsd1.ErrorCode == HAL_SD_ERROR_NONE);
+    BL_Sd_StartNext();
+}
+
+// HAL_SD_ErrorCallback. A failed CMD12 is followed by the completion
+// callback (the HAL is still busy then), data errors are not.
+void BL_Sd_TransferError(void) {
+    if (hsd1.State == HAL_SD_STATE_READY && active != NULL && !timed_out) {
+        card_busy = true; // whatever state the card is in, ask before the next one
+        BL_Sd_Finish(active, false);
+        BL_Sd_StartNext();
+    }
+}
+
+// Only flags a timeout, the abort is left to BL_Sd_Service: HAL_SD_Abort
+// waits on HAL_GetTick, which stands still in here, and SDMMC1 has the
+// same priority, so a stuck card would hang the core
+void BL_Sd_Tick(void) {
+    if (active != NULL) {
+        if (!timed_out && (int32_t)(HAL_GetTick() - active->deadline) >= 0) {
+            timed_out = true;
+            __SEV();
+        }
+        return;
+    }
+    // Fails queued requests that ran out of time behind a busy card
+    BL_Sd_StartNext();
+}
+
+/* ********************** Statistics ****************************** */
+
+void BL_Sd_ResetStats(void) {
+    memset(stats, 0, sizeof(stats));
+}
+
+const BL_SdStats_t *BL_Sd_Stats(BL_SdOp_t op) {
+    return &stats[op];
+}
+
+void BL_Sd_Report(void) {
+    static const char *const names[] = {"read", "write"};
+
+    for (uint8_t op = BL_SD_READ; op <= BL_SD_WRITE; op++) {
+        const BL_SdStats_t *s = &stats[op];
+        if (s->requests == 0) {
+            continue;
+        }
+        printf("SD %s: %lu requests (%lu failed), %lu sectors, avg %lu us (%lu queued), max %lu us\n",
+               names[op], (unsigned long)s->requests, (unsigned long)s->errors, (unsigned long)s->sectors,
+               (unsigned long)(s->total_us / s->requests), (unsigned long)(s->queued_us / s->requests),
+               (unsigned long)s->max_us);
+        printf("SD %s latency:", names[op]);
+        for (uint8_t i = 0; i < BL_SD_HIST_BUCKETS; i++) {
+            if (s->hist[i] == 0) {
+                continue;
+            }
+            if (i == BL_SD_HIST_BUCKETS - 1) {
+                printf(" >=%lu:%lu", (unsigned long)(1UL << (i - 1 + BL_SD_HIST_SHIFT)), (unsigned long)s->hist[i]);
+            } else {
+                printf(" <%lu:%lu", (unsigned long)(1UL << (i + BL_SD_HIST_SHIFT)), (unsigned long)s->hist[i]);
+            }
+        }
+        printf(" us\n");
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ * bl_sd_diskio.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_sd_diskio.h"
+#include "bl_sd.h"
+#include "bl_sdcache.h"
+#include "bsp_driver_sd.h"
+
+#define BL_SD_DISKIO_SECTOR  512
+#define BL_SD_DISKIO_TIMEOUT (30 * 1000)
+
+extern SD_HandleTypeDef hsd1;
+
+static volatile DSTATUS status = STA_NOINIT;
+
+/* ********************** Callbacks ****************************** */
+
+static void BL_SdDiskio_TransferDone(SD_HandleTypeDef *hsd) {
+    BL_Sd_TransferDone();
+}
+
+static void BL_SdDiskio_TransferError(SD_HandleTypeDef *hsd) {
+    BL_Sd_TransferError();
+}
+
+// After HAL_SD_Init, which only resets the callbacks of a handle in RESET
+static bool BL_SdDiskio_RegisterCallbacks(void) {
+    return HAL_SD_RegisterCallback(&hsd1, HAL_SD_TX_CPLT_CB_ID, BL_SdDiskio_TransferDone) == HAL_OK &&
+           HAL_SD_RegisterCallback(&hsd1, HAL_SD_RX_CPLT_CB_ID, BL_SdDiskio_TransferDone) == HAL_OK &&
+           HAL_SD_RegisterCallback(&hsd1, HAL_SD_ERROR_CB_ID, BL_SdDiskio_TransferError) == HAL_OK;
+}
+
+/* ********************** Disk driver ****************************** */
+
+static DSTATUS BL_SdDiskio_Initialize(BYTE lun) {
+    status = STA_NOINIT;
+    if (BSP_SD_Init() == MSD_OK && BL_SdDiskio_RegisterCallbacks() && BSP_SD_GetCardState() == MSD_OK) {
+        status &= ~STA_NOINIT;
+        BL_SdCache_Attach();
+    }
+    return status;
+}
+
+static DSTATUS BL_SdDiskio_Status(BYTE lun) {
+    return status;
+}
+
+static DRESULT BL_SdDiskio_Read(BYTE lun, BYTE *buff, DWORD sector, UINT count) {
+    // Misses are queued behind the transfers already submitted (read-ahead)
+    return BL_SdCache_Read(buff, sector, count) ? RES_OK : RES_ERROR;
+}
+
+#if _USE_WRITE == 1
+static DRESULT BL_SdDiskio_Write(BYTE lun, const BYTE *buff, DWORD sector, UINT count) {
+    // Small writes stay in the cache until CTRL_SYNC
+    return BL_SdCache_Write(buff, sector, count) ? RES_OK : RES_ERROR;
+}
+#endif
+
+#if _USE_IOCTL == 1
+static DRESULT BL_SdDiskio_Ioctl(BYTE lun, BYTE cmd, void *buff) {
+    BSP_SD_CardInfo info;
+
+    if (status & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+
+    switch (cmd) {
+    case CTRL_SYNC:
+        // Dirty sectors to the card, then until it has programmed them
+        return (BL_SdCache_Flush() && BL_Sd_Sync(BL_SD_DISKIO_TIMEOUT)) ? RES_OK : RES_ERROR;
+    case GET_SECTOR_COUNT:
+        BSP_SD_GetCardInfo(&info);
+        *(DWORD *)buff = info.LogBlockNbr;
+        return RES_OK;
+    case GET_SECTOR_SIZE:
+        BSP_SD_GetCardInfo(&info);
+        *(WORD *)buff = info.LogBlockSize;
+        return RES_OK;
+    case GET_BLOCK_SIZE:
+        BSP_SD_GetCardInfo(&info);
+        *(DWORD *)buff = info.LogBlockSize / BL_SD_DISKIO_SECTOR;
+        return RES_OK;
+    default:
+        return RES_PARERR;
+    }
+}
+#endif
+
+const Diskio_drvTypeDef BL_SdDiskio_Driver = {
+    BL_SdDiskio_Initialize,
+    BL_SdDiskio_Status,
+    BL_SdDiskio_Read,
+#if _USE_WRITE == 1
+    BL_SdDiskio_Write,
+#endif
+#if _USE_IOCTL == 1
+    BL_SdDiskio_Ioctl,
+#endif
+};
+
+bool BL_SdDiskio_Link(char *path) {
+    FATFS_UnLinkDriver(path);
+    return FATFS_LinkDriver(&BL_SdDiskio_Driver, path) == 0;
+}
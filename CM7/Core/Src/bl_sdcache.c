@@ -0,0 +1,400 @@
+/*
+ * bl_sdcache.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_sdcache.h"
+#include "bl_sd.h"
+#include "stm32h7xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BL_SDCACHE_SECTOR 512
+#define BL_SDCACHE_NONE   0xFFFF
+#define BL_SDCACHE_HASH(sector) ((sector) & (BL_SDCACHE_BUCKETS - 1))
+
+typedef struct {
+    uint32_t sector;
+    uint16_t next;     // next line in the hash bucket
+    uint16_t newer;    // LRU list, towards the most recently used line
+    uint16_t older;
+    bool valid;
+    bool dirty;
+    bool pinned;       // FAT sector
+    bool ahead;        // read ahead and not read since
+} BL_SdCacheLine_t;
+
+extern SD_HandleTypeDef hsd1;
+
+static BL_SdCacheLine_t lines[BL_SDCACHE_LINES];
+static uint16_t buckets[BL_SDCACHE_BUCKETS];
+static uint16_t mru;
+static uint16_t lru;
+static uint16_t pinned_lines;
+static uint32_t pin_first;
+static uint32_t pin_count;
+static uint32_t next_sector;    // sector after the last read, to spot sequential reads
+static uint32_t card_sectors;
+static uint32_t card_id[4];     // CID of the card the lines belong to
+static bool attached;
+static BL_SdCacheStats_t stats;
+
+// In AXI SRAM (.bss), which the SDMMC1 IDMA can reach. Cache line aligned
+// so the maintenance of bl_sd touches nothing else.
+static uint8_t data[BL_SDCACHE_LINES][BL_SDCACHE_SECTOR] __attribute__((aligned(32)));
+// Runs of sectors read or written with one command
+static uint8_t staging[BL_SDCACHE_RUN][BL_SDCACHE_SECTOR] __attribute__((aligned(32)));
+
+/* ********************** Lines ****************************** */
+
+static void BL_SdCache_Unlink(uint16_t i) {
+    BL_SdCacheLine_t *l = &lines[i];
+    if (l->newer != BL_SDCACHE_NONE) {
+        lines[l->newer].older = l->older;
+    } else {
+        mru = l->older;
+    }
+    if (l->older != BL_SDCACHE_NONE) {
+        lines[l->older].newer = l->newer;
+    } else {
+        lru = l->newer;
+    }
+}
+
+// Make line i the most recently used one
+static void BL_SdCache_Touch(uint16_t i) {
+    if (i == mru) {
+        return;
+    }
+    BL_SdCache_Unlink(i);
+    lines[i].newer = BL_SDCACHE_NONE;
+    lines[i].older = mru;
+    lines[mru].newer = i;
+    mru = i;
+}
+
+// Make line i the next one to reuse
+static void BL_SdCache_Demote(uint16_t i) {
+    if (i == lru) {
+        return;
+    }
+    BL_SdCache_Unlink(i);
+    lines[i].older = BL_SDCACHE_NONE;
+    lines[i].newer = lru;
+    lines[lru].older = i;
+    lru = i;
+}
+
+static uint16_t BL_SdCache_Find(uint32_t sector) {
+    for (uint16_t i = buckets[BL_SDCACHE_HASH(sector)]; i != BL_SDCACHE_NONE; i = lines[i].next) {
+        if (lines[i].sector == sector) {
+            return i;
+        }
+    }
+    return BL_SDCACHE_NONE;
+}
+
+// Take line i out of the hash table and give its slot up
+static void BL_SdCache_Drop(uint16_t i) {
+    BL_SdCacheLine_t *l = &lines[i];
+    uint16_t *link = &buckets[BL_SDCACHE_HASH(l->sector)];
+
+    if (!l->valid) {
+        return;
+    }
+    while (*link != i) {
+        link = &lines[*link].next;
+    }
+    *link = l->next;
+    if (l->pinned) {
+        pinned_lines--;
+    }
+    l->valid = false;
+    l->dirty = false;
+    l->pinned = false;
+    l->ahead = false;
+    BL_SdCache_Demote(i);
+}
+
+static void BL_SdCache_Init(void) {
+    for (uint16_t i = 0; i < BL_SDCACHE_BUCKETS; i++) {
+        buckets[i] = BL_SDCACHE_NONE;
+    }
+    for (uint16_t i = 0; i < BL_SDCACHE_LINES; i++) {
+        memset(&lines[i], 0, sizeof(lines[i]));
+        lines[i].next = BL_SDCACHE_NONE;
+        lines[i].newer = (i == 0) ? BL_SDCACHE_NONE : i - 1;
+        lines[i].older = (i == BL_SDCACHE_LINES - 1) ? BL_SDCACHE_NONE : i + 1;
+    }
+    mru = 0;
+    lru = BL_SDCACHE_LINES - 1;
+    pinned_lines = 0;
+    pin_first = 0;
+    pin_count = 0;
+    next_sector = 0;
+}
+
+/* ********************** Card ****************************** */
+
+// One command for count sectors, going through the staging buffer when buff
+// is not word aligned for the IDMA
+static bool BL_SdCache_Transfer(BL_SdOp_t op, uint8_t *buff, uint32_t sector, uint32_t count) {
+    if (((uintptr_t)buff & 3) == 0) {
+        stats.commands++;
+        return BL_Sd_Transfer(op, buff, sector, count, BL_SDCACHE_TIMEOUT);
+    }
+
+    while (count > 0) {
+        uint32_t n = (count < BL_SDCACHE_RUN) ? count : BL_SDCACHE_RUN;
+        if (op == BL_SD_WRITE) {
+            memcpy(staging, buff, n * BL_SDCACHE_SECTOR);
+        }
+        stats.commands++;
+        if (!BL_Sd_Transfer(op, staging[0], sector, n, BL_SDCACHE_TIMEOUT)) {
+            return false;
+        }
+        if (op == BL_SD_READ) {
+            memcpy(buff, staging, n * BL_SDCACHE_SECTOR);
+        }
+        buff += n * BL_SDCACHE_SECTOR;
+        sector += n;
+        count -= n;
+    }
+    return true;
+}
+
+bool BL_SdCache_Flush(void) {
+    uint16_t order[BL_SDCACHE_LINES];
+    uint16_t n = 0;
+
+    // Dirty lines by sector
+    for (uint16_t i = 0; i < BL_SDCACHE_LINES; i++) {
+        if (!lines[i].dirty) {
+            continue;
+        }
+        uint16_t j = n++;
+        while (j > 0 && lines[order[j - 1]].sector > lines[i].sector) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    for (uint16_t k = 0; k < n;) {
+        uint32_t sector = lines[order[k]].sector;
+        uint16_t run = 1;
+        while (k + run < n && run < BL_SDCACHE_RUN && lines[order[k + run]].sector == sector + run) {
+            run++;
+        }
+
+        bool ok;
+        if (run == 1) {
+            ok = BL_SdCache_Transfer(BL_SD_WRITE, data[order[k]], sector, 1);
+        } else {
+            for (uint16_t j = 0; j < run; j++) {
+                memcpy(staging[j], data[order[k + j]], BL_SDCACHE_SECTOR);
+            }
+            ok = BL_SdCache_Transfer(BL_SD_WRITE, staging[0], sector, run);
+        }
+        if (!ok) {
+            return false;
+        }
+
+        for (uint16_t j = 0; j < run; j++) {
+            lines[order[k + j]].dirty = false;
+        }
+        stats.writebacks += run;
+        k += run;
+    }
+    return true;
+}
+
+// A line for sector, the least recently used one that may go. FAT lines are
+// skipped while there are no more than BL_SDCACHE_PIN_MAX of them.
+static uint16_t BL_SdCache_Alloc(uint32_t sector) {
+    uint16_t i = lru;
+    while (lines[i].valid && lines[i].pinned && pinned_lines <= BL_SDCACHE_PIN_MAX) {
+        i = lines[i].newer;
+    }
+
+    // Write back everything at once, the dirty neighbours of this line
+    // share its commands
+    if (lines[i].dirty && !BL_SdCache_Flush()) {
+        return BL_SDCACHE_NONE;
+    }
+    if (lines[i].valid) {
+        stats.evictions++;
+        BL_SdCache_Drop(i);
+    }
+
+    BL_SdCacheLine_t *l = &lines[i];
+    uint16_t *bucket = &buckets[BL_SDCACHE_HASH(sector)];
+    l->sector = sector;
+    l->valid = true;
+    l->pinned = sector - pin_first < pin_count;
+    if (l->pinned) {
+        pinned_lines++;
+    }
+    l->next = *bucket;
+    *bucket = i;
+    BL_SdCache_Touch(i);
+    return i;
+}
+
+/* ********************** Disk driver ****************************** */
+
+bool BL_SdCache_Read(uint8_t *buff, uint32_t sector, uint32_t count) {
+    bool sequential = sector == next_sector;
+    next_sector = sector + count;
+
+    if (count >= BL_SDCACHE_BYPASS) {
+        if (!BL_SdCache_Transfer(BL_SD_READ, buff, sector, count)) {
+            return false;
+        }
+        // Sectors written into the cache and not yet to the card
+        for (uint32_t k = 0; k < count; k++) {
+            uint16_t i = BL_SdCache_Find(sector + k);
+            if (i != BL_SDCACHE_NONE && lines[i].dirty) {
+                memcpy(buff + k * BL_SDCACHE_SECTOR, data[i], BL_SDCACHE_SECTOR);
+            }
+        }
+        stats.bypass += count;
+        return true;
+    }
+
+    for (uint32_t k = 0; k < count;) {
+        uint32_t s = sector + k;
+        uint16_t i = BL_SdCache_Find(s);
+        if (i != BL_SDCACHE_NONE) {
+            memcpy(buff + k * BL_SDCACHE_SECTOR, data[i], BL_SDCACHE_SECTOR);
+            if (lines[i].ahead) {
+                lines[i].ahead = false;
+                stats.ahead_hits++;
+            }
+            BL_SdCache_Touch(i);
+            stats.hits++;
+            k++;
+            continue;
+        }
+
+        // The missing sectors from here on, past the end of the request too
+        // when it continues the previous one
+        uint32_t wanted = 1;
+        while (k + wanted < count && wanted < BL_SDCACHE_RUN && BL_SdCache_Find(s + wanted) == BL_SDCACHE_NONE) {
+            wanted++;
+        }
+        uint32_t n = wanted;
+        if (sequential && k + n == count) {
+            while (n < BL_SDCACHE_RUN && s + n < card_sectors && BL_SdCache_Find(s + n) == BL_SDCACHE_NONE) {
+                n++;
+            }
+        }
+
+        uint16_t slots[BL_SDCACHE_RUN];
+        for (uint32_t j = 0; j < n; j++) {
+            slots[j] = BL_SdCache_Alloc(s + j);
+            if (slots[j] == BL_SDCACHE_NONE) {
+                while (j > 0) {
+                    BL_SdCache_Drop(slots[--j]);
+                }
+                return false;
+            }
+        }
+        if (!BL_SdCache_Transfer(BL_SD_READ, staging[0], s, n)) {
+            for (uint32_t j = 0; j < n; j++) {
+                BL_SdCache_Drop(slots[j]);
+            }
+            return false;
+        }
+
+        for (uint32_t j = 0; j < n; j++) {
+            memcpy(data[slots[j]], staging[j], BL_SDCACHE_SECTOR);
+            if (j < wanted) {
+                memcpy(buff + (k + j) * BL_SDCACHE_SECTOR, staging[j], BL_SDCACHE_SECTOR);
+            } else {
+                lines[slots[j]].ahead = true;
+            }
+        }
+        stats.misses += wanted;
+        stats.ahead += n - wanted;
+        k += wanted;
+    }
+    return true;
+}
+
+bool BL_SdCache_Write(const uint8_t *buff, uint32_t sector, uint32_t count) {
+    if (count >= BL_SDCACHE_BYPASS) {
+        if (!BL_SdCache_Transfer(BL_SD_WRITE, (uint8_t *)buff, sector, count)) {
+            return false;
+        }
+        // Cached copies take the new contents, which are on the card now
+        for (uint32_t k = 0; k < count; k++) {
+            uint16_t i = BL_SdCache_Find(sector + k);
+            if (i != BL_SDCACHE_NONE) {
+                memcpy(data[i], buff + k * BL_SDCACHE_SECTOR, BL_SDCACHE_SECTOR);
+                lines[i].dirty = false;
+            }
+        }
+        stats.bypass += count;
+        return true;
+    }
+
+    for (uint32_t k = 0; k < count; k++) {
+        uint16_t i = BL_SdCache_Find(sector + k);
+        if (i == BL_SDCACHE_NONE) {
+            i = BL_SdCache_Alloc(sector + k);
+            if (i == BL_SDCACHE_NONE) {
+                return false;
+            }
+        } else {
+            BL_SdCache_Touch(i);
+        }
+        memcpy(data[i], buff + k * BL_SDCACHE_SECTOR, BL_SDCACHE_SECTOR);
+        lines[i].dirty = true;
+        lines[i].ahead = false;
+        stats.writes++;
+    }
+    return true;
+}
+
+void BL_SdCache_Attach(void) {
+    if (!attached || memcmp(card_id, hsd1.CID, sizeof(card_id)) != 0) {
+        BL_SdCache_Init();
+        memcpy(card_id, hsd1.CID, sizeof(card_id));
+        attached = true;
+    }
+    card_sectors = hsd1.SdCard.LogBlockNbr;
+}
+
+void BL_SdCache_Pin(uint32_t sector, uint32_t count) {
+    pin_first = sector;
+    pin_count = count;
+    pinned_lines = 0;
+    for (uint16_t i = 0; i < BL_SDCACHE_LINES; i++) {
+        lines[i].pinned = lines[i].valid && lines[i].sector - pin_first < pin_count;
+        if (lines[i].pinned) {
+            pinned_lines++;
+        }
+    }
+}
+
+/* ********************** Statistics ****************************** */
+
+const BL_SdCacheStats_t *BL_SdCache_Stats(void) {
+    return &stats;
+}
+
+void BL_SdCache_Report(void) {
+    uint32_t reads = stats.hits + stats.misses;
+    if (reads == 0 && stats.writes == 0) {
+        return;
+    }
+    printf("SD cache: %lu hits, %lu misses (%lu%% hits), %lu read ahead (%lu used), %lu bypassed\n",
+           (unsigned long)stats.hits, (unsigned long)stats.misses,
+           (unsigned long)(reads ? (uint64_t)stats.hits * 100 / reads : 0), (unsigned long)stats.ahead,
+           (unsigned long)stats.ahead_hits, (unsigned long)stats.bypass);
+    printf("SD cache: %lu writes, %lu written back, %lu evictions, %lu card commands\n",
+           (unsigned long)stats.writes, (unsigned long)stats.writebacks, (unsigned long)stats.evictions,
+           (unsigned long)stats.commands);
+}
@@ -0,0 +1,44 @@
+/*
+ * bl_stack.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_stack.h"
+#include "stm32h7xx.h"
+#include <stdio.h>
+
+extern uint32_t _estack;
+extern uint32_t _Min_Stack_Size;
+
+static uint32_t *BL_Stack_Bottom(void) {
+    return (uint32_t *)((uint32_t)&_estack - (uint32_t)&_Min_Stack_Size);
+}
+
+uint32_t BL_Stack_Size(void) {
+    return (uint32_t)&_Min_Stack_Size;
+}
+
+// Paint up to a little below the current stack pointer, this function's own
+// frame lies above it
+void BL_Stack_Paint(void) {
+    uint32_t *end = (uint32_t *)(__get_MSP() & ~3u) - 16;
+    for (uint32_t *p = BL_Stack_Bottom(); p < end; p++) {
+        *p = BL_STACK_PATTERN;
+    }
+}
+
+uint32_t BL_Stack_Peak(void) {
+    uint32_t *p = BL_Stack_Bottom();
+    uint32_t *top = &_estack;
+    while (p < top && *p == BL_STACK_PATTERN) {
+        p++;
+    }
+    return (uint32_t)top - (uint32_t)p;
+}
+
+void BL_Stack_Report(const char *what) {
+    uint32_t peak = BL_Stack_Peak();
+    printf("Stack: %s peaked at %lu of %lu bytes%s\n", what, (unsigned long)peak,
+           (unsigned long)BL_Stack_Size(), peak >= BL_Stack_Size() ? " (OVERFLOW)" : "");
+}
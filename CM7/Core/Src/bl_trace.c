@@ -0,0 +1,72 @@
+/*
+ * bl_trace.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_trace.h"
+#include "bl_log.h"
+#include <stdio.h>
+
+#define BL_TRACE_DWT_UNLOCK 0xC5ACCE55
+
+static BL_TraceEntry_t ring[BL_TRACE_DEPTH];
+static uint32_t head;    // entries recorded since the last clear
+static uint32_t last;    // cycle count of the previous mark
+static uint8_t command;  // command the marks belong to
+
+static const char *const phase_names[BL_TRACE_PHASES] = {
+    "cmd_ack", "addr_ack", "payload", "final_ack", "deferred"
+};
+
+// Enable the DWT cycle counter, the CM7 needs the lock opened first
+void BL_Trace_Init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = BL_TRACE_DWT_UNLOCK;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    BL_Trace_Clear();
+}
+
+void BL_Trace_Clear(void) {
+    head = 0;
+    last = DWT->CYCCNT;
+}
+
+void BL_Trace_Begin(uint8_t cmd) {
+    command = cmd;
+    last = DWT->CYCCNT;
+}
+
+void BL_Trace_Mark(BL_TracePhase_t phase, bool ok) {
+    uint32_t now = DWT->CYCCNT;
+    BL_TraceEntry_t *e = &ring[head & (BL_TRACE_DEPTH - 1)];
+    e->cycles = now - last;
+    e->command = command;
+    e->phase = phase;
+    e->ok = ok;
+    head++;
+    last = now;
+}
+
+void BL_Trace_Dump(UART_HandleTypeDef *huart) {
+    char line[64];
+    uint32_t first = (head > BL_TRACE_DEPTH) ? head - BL_TRACE_DEPTH : 0;
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
+    int n;
+
+    // Don't interleave with console output still queued, the log shares USART1
+    fflush(stdout);
+    BL_Log_Flush(1000);
+    n = snprintf(line, sizeof(line), "# trace %lu lost, %lu MHz\nseq,cmd,phase,cycles,us,ok\n",
+                 (unsigned long)first, (unsigned long)cycles_per_us);
+    HAL_UART_Transmit(huart, (uint8_t *)line, (uint16_t)n, 100);
+
+    for (uint32_t i = first; i < head; i++) {
+        const BL_TraceEntry_t *e = &ring[i & (BL_TRACE_DEPTH - 1)];
+        n = snprintf(line, sizeof(line), "%lu,0x%02x,%s,%lu,%lu,%u\n", (unsigned long)i, e->command,
+                     phase_names[e->phase], (unsigned long)e->cycles,
+                     (unsigned long)(cycles_per_us ? e->cycles / cycles_per_us : 0), e->ok);
+        HAL_UART_Transmit(huart, (uint8_t *)line, (uint16_t)n, 100);
+    }
+}
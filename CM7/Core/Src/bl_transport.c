@@ -0,0 +1,200 @@
+/*
+ * bl_transport.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_transport.h"
+#include "bl_tcm.h"
+#include <string.h>
+
+#if defined(USE_HAL_DRIVER)
+#include "stm32h7xx.h"
+#define BL_CRITICAL_ENTER() uint32_t primask = __get_PRIMASK(); __disable_irq()
+#define BL_CRITICAL_EXIT()  __set_PRIMASK(primask)
+#else
+#define BL_CRITICAL_ENTER()
+#define BL_CRITICAL_EXIT()
+#endif
+
+#define BL_RX_MASK (BL_TRANSPORT_RX_SIZE - 1)
+
+void BL_Transport_Init(BL_Transport_t *t, const BL_TransportOps_t *ops, void *ctx) {
+    t->ops = ops;
+    t->ctx = ctx;
+    t->rx_head = 0;
+    t->rx_tail = 0;
+    t->tx_queued = 0;
+    t->tx_fill = 0;
+    t->tx_active = 0;
+    t->baudrate = 0;
+    t->rx_overruns = 0;
+}
+
+bool BL_Transport_SetBaudrate(BL_Transport_t *t, uint32_t baudrate) {
+    if (t->ops->set_baudrate == NULL) {
+        return t->baudrate == baudrate;
+    }
+
+    t->tx_queued = 0;
+    t->tx_fill = 0;
+    if (!t->ops->set_baudrate(t, baudrate)) {
+        return false;
+    }
+    t->baudrate = baudrate;
+    return true;
+}
+
+uint32_t BL_Transport_Now(BL_Transport_t *t) {
+    return t->ops->get_tick();
+}
+
+uint32_t BL_Transport_Deadline(BL_Transport_t *t, uint32_t timeout_ms) {
+    return t->ops->get_tick() + timeout_ms;
+}
+
+static bool BL_Transport_Expired(BL_Transport_t *t, uint32_t deadline) {
+    return (int32_t)(t->ops->get_tick() - deadline) >= 0;
+}
+
+static void BL_Transport_Idle(BL_Transport_t *t) {
+    if (t->ops->idle != NULL) {
+        t->ops->idle(t);
+    }
+}
+
+/* ********************** Transmit ****************************** */
+
+bool BL_Transport_Send(BL_Transport_t *t, const uint8_t *data, uint16_t length, uint32_t deadline) {
+    BL_TransportSpan_t span = {data, length};
+    return BL_Transport_SendV(t, &span, 1, deadline);
+}
+
+// The slot is the only copy of the frame. The callers reuse their buffers as
+// soon as this returns (the ACK is collected later), and the slot sits in
+// memory the TX DMA can read.
+BL_ITCM_CODE bool BL_Transport_SendV(BL_Transport_t *t, const BL_TransportSpan_t *spans, uint8_t count, uint32_t deadline) {
+    uint16_t length = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        length += spans[i].length;
+    }
+    if (length > BL_TRANSPORT_TX_SIZE) {
+        return false;
+    }
+
+    // Wait for a free slot
+    while (t->tx_queued == BL_TRANSPORT_TX_SLOTS) {
+        if (BL_Transport_Expired(t, deadline)) {
+            return false;
+        }
+        BL_Transport_Idle(t);
+    }
+
+    uint8_t slot = t->tx_fill;
+    uint8_t *out = t->tx_buf[slot];
+    for (uint8_t i = 0; i < count; i++) {
+        memcpy(out, spans[i].data, spans[i].length);
+        out += spans[i].length;
+    }
+    t->tx_len[slot] = length;
+    t->tx_fill = (slot + 1) % BL_TRANSPORT_TX_SLOTS;
+
+    bool ok = true;
+    BL_CRITICAL_ENTER();
+    if (t->tx_queued++ == 0) {
+        // Line is idle, start right away. Otherwise TxDone picks it up.
+        t->tx_active = slot;
+        ok = t->ops->start_tx(t, t->tx_buf[slot], length);
+        if (!ok) {
+            t->tx_queued = 0;
+            t->tx_fill = slot;
+        }
+    }
+    BL_CRITICAL_EXIT();
+
+    return ok;
+}
+
+bool BL_Transport_WaitTx(BL_Transport_t *t, uint32_t deadline) {
+    while (t->tx_queued != 0) {
+        if (BL_Transport_Expired(t, deadline)) {
+            return false;
+        }
+        BL_Transport_Idle(t);
+    }
+    return true;
+}
+
+// Called by the backend (usually from the TX complete interrupt)
+BL_ITCM_CODE void BL_Transport_TxDone(BL_Transport_t *t) {
+    if (t->tx_queued == 0) {
+        return;
+    }
+
+    if (--t->tx_queued > 0) {
+        uint8_t slot = (t->tx_active + 1) % BL_TRANSPORT_TX_SLOTS;
+        t->tx_active = slot;
+        if (!t->ops->start_tx(t, t->tx_buf[slot], t->tx_len[slot])) {
+            t->tx_queued = 0; // drop the frame, the missing ACK reports it
+        }
+    }
+}
+
+/* ********************** Receive ****************************** */
+
+uint16_t BL_Transport_Available(BL_Transport_t *t) {
+    t->ops->rx_poll(t);
+    return (t->rx_head - t->rx_tail) & BL_RX_MASK;
+}
+
+bool BL_Transport_Receive(BL_Transport_t *t, uint8_t *data, uint16_t length, uint32_t deadline) {
+    while (length > 0) {
+        uint16_t available = BL_Transport_Available(t);
+
+        if (available == 0) {
+            if (BL_Transport_Expired(t, deadline)) {
+                return false;
+            }
+            BL_Transport_Idle(t);
+            continue;
+        }
+
+        // Copy up to the end of the ring at most, the next pass takes the rest
+        uint16_t chunk = BL_TRANSPORT_RX_SIZE - t->rx_tail;
+        if (chunk > available) {
+            chunk = available;
+        }
+        if (chunk > length) {
+            chunk = length;
+        }
+
+        memcpy(data, &t->rx_buf[t->rx_tail], chunk);
+        t->rx_tail = (t->rx_tail + chunk) & BL_RX_MASK;
+        data += chunk;
+        length -= chunk;
+    }
+
+    return true;
+}
+
+void BL_Transport_Flush(BL_Transport_t *t) {
+    t->ops->rx_poll(t);
+    t->rx_tail = t->rx_head;
+}
+
+// Used by byte oriented backends (ISR or simulation) to feed the ring
+BL_ITCM_CODE void BL_Transport_RxPush(BL_Transport_t *t, const uint8_t *data, uint16_t length) {
+    uint16_t head = t->rx_head;
+
+    for (uint16_t i = 0; i < length; i++) {
+        uint16_t next = (head + 1) & BL_RX_MASK;
+        if (next == t->rx_tail) {
+            t->rx_overruns++;
+            break;
+        }
+        t->rx_buf[head] = data[i];
+        head = next;
+    }
+
+    t->rx_head = head;
+}
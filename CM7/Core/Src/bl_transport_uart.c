@@ -0,0 +1,127 @@
+/*
+ * bl_transport_uart.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_transport_uart.h"
+#include "bl_tcm.h"
+
+// Maps HAL callbacks (which only know the UART handle) back to the transport
+static struct {
+    UART_HandleTypeDef *huart;
+    BL_Transport_t *transport;
+} uart_ports[BL_TRANSPORT_UART_MAX];
+
+BL_ITCM_CODE static BL_Transport_t *BL_TransportUart_Find(UART_HandleTypeDef *huart) {
+    for (uint8_t i = 0; i < BL_TRANSPORT_UART_MAX; i++) {
+        if (uart_ports[i].huart == huart) {
+            return uart_ports[i].transport;
+        }
+    }
+    return NULL;
+}
+
+/* ********************** Backend operations ****************************** */
+
+BL_ITCM_CODE static bool BL_TransportUart_StartTx(BL_Transport_t *t, const uint8_t *data, uint16_t length) {
+    UART_HandleTypeDef *huart = t->ctx;
+    return HAL_UART_Transmit_DMA(huart, data, length) == HAL_OK;
+}
+
+// The RX DMA runs in circular mode over rx_buf, so the write position is
+// simply what the DMA has not transferred yet
+static void BL_TransportUart_RxPoll(BL_Transport_t *t) {
+    UART_HandleTypeDef *huart = t->ctx;
+    uint16_t remaining = __HAL_DMA_GET_COUNTER(huart->hdmarx);
+    t->rx_head = (BL_TRANSPORT_RX_SIZE - remaining) & (BL_TRANSPORT_RX_SIZE - 1);
+}
+
+static void BL_TransportUart_RxReset(BL_Transport_t *t) {
+    UART_HandleTypeDef *huart = t->ctx;
+    HAL_UART_AbortReceive(huart);
+    t->rx_head = 0;
+    t->rx_tail = 0;
+    HAL_UART_Receive_DMA(huart, t->rx_buf, BL_TRANSPORT_RX_SIZE);
+}
+
+// Re-run the HAL init with the new rate so BRR is computed from the right
+// kernel clock, the FIFO setting is not part of Init and is restored by hand
+static bool BL_TransportUart_SetBaudrate(BL_Transport_t *t, uint32_t baudrate) {
+    UART_HandleTypeDef *huart = t->ctx;
+    bool fifo = (huart->FifoMode == UART_FIFOMODE_ENABLE);
+
+    HAL_UART_Abort(huart);
+    huart->Init.BaudRate = baudrate;
+    if (HAL_UART_Init(huart) != HAL_OK) {
+        return false;
+    }
+    if (fifo && HAL_UARTEx_EnableFifoMode(huart) != HAL_OK) {
+        return false;
+    }
+
+    BL_TransportUart_RxReset(t);
+    return true;
+}
+
+static const BL_TransportOps_t uart_ops = {
+    .start_tx = BL_TransportUart_StartTx,
+    .rx_poll = BL_TransportUart_RxPoll,
+    .rx_reset = BL_TransportUart_RxReset,
+    .get_tick = HAL_GetTick,
+    .idle = NULL,
+    .set_baudrate = BL_TransportUart_SetBaudrate,
+};
+
+/* ********************** HAL callbacks ****************************** */
+
+BL_ITCM_CODE static void BL_TransportUart_TxCplt(UART_HandleTypeDef *huart) {
+    BL_Transport_t *t = BL_TransportUart_Find(huart);
+    if (t != NULL) {
+        BL_Transport_TxDone(t);
+    }
+}
+
+// Blocking errors (overrun, DMA error) stop the affected direction, restart it
+static void BL_TransportUart_Error(UART_HandleTypeDef *huart) {
+    BL_Transport_t *t = BL_TransportUart_Find(huart);
+    if (t == NULL) {
+        return;
+    }
+
+    if (huart->RxState == HAL_UART_STATE_READY) {
+        t->rx_head = 0;
+        t->rx_tail = 0;
+        HAL_UART_Receive_DMA(huart, t->rx_buf, BL_TRANSPORT_RX_SIZE);
+    }
+    if (huart->gState == HAL_UART_STATE_READY && t->tx_queued != 0) {
+        BL_Transport_TxDone(t); // frame is lost, the missing ACK reports it
+    }
+}
+
+/* ********************** Init ****************************** */
+
+bool BL_TransportUart_Init(BL_Transport_t *t, UART_HandleTypeDef *huart) {
+    uint8_t slot = BL_TRANSPORT_UART_MAX;
+    for (uint8_t i = 0; i < BL_TRANSPORT_UART_MAX; i++) {
+        if (uart_ports[i].huart == huart || (uart_ports[i].huart == NULL && slot == BL_TRANSPORT_UART_MAX)) {
+            slot = i;
+        }
+    }
+    if (slot == BL_TRANSPORT_UART_MAX || huart->hdmarx == NULL || huart->hdmatx == NULL) {
+        return false;
+    }
+
+    BL_Transport_Init(t, &uart_ops, huart);
+    t->baudrate = huart->Init.BaudRate;
+    uart_ports[slot].huart = huart;
+    uart_ports[slot].transport = t;
+
+    if (HAL_UART_RegisterCallback(huart, HAL_UART_TX_COMPLETE_CB_ID, BL_TransportUart_TxCplt) != HAL_OK ||
+        HAL_UART_RegisterCallback(huart, HAL_UART_ERROR_CB_ID, BL_TransportUart_Error) != HAL_OK) {
+        return false;
+    }
+
+    BL_TransportUart_RxReset(t);
+    return true;
+}
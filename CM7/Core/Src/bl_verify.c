@@ -0,0 +1,204 @@
+/*
+ * bl_verify.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_verify.h"
+#include "bl_bench.h"
+#include "bl_crc.h"
+#include "bl_flash.h"
+#include "bootloader.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BL_VERIFY_CHUNK 256
+
+static uint32_t chunk[BL_VERIFY_CHUNK / 4]; // word aligned scratch for CRC input
+static uint32_t erased[BL_VERIFY_CHUNK / 4]; // blank flash, for gaps in a range
+
+void BL_Verify_Init(BL_Verify_t *v) {
+    BL_CRC_Init();
+    memset(erased, 0xFF, sizeof(erased));
+    v->count = 0;
+    v->open = false;
+    v->overflow = false;
+    v->coarse = false;
+    v->stage = 0xFFFFFFFF;
+}
+
+// Feed the partial word at the end of a range, padded with 0xFF
+static void BL_Verify_Unstage(BL_Verify_t *v, BL_VerifyRange_t *r) {
+    if (r->end & 3) {
+        r->crc = BL_CRC_Update(r->crc, &v->stage, 1);
+        r->end = (r->end + 3) & ~3UL;
+    }
+    v->stage = 0xFFFFFFFF;
+}
+
+static void BL_Verify_Close(BL_Verify_t *v) {
+    if (v->open) {
+        BL_Verify_Unstage(v, &v->ranges[v->count - 1]);
+        v->open = false;
+    }
+}
+
+// Feed blank flash to a range up to the word aligned end
+static void BL_Verify_Pad(BL_Verify_t *v, BL_VerifyRange_t *r, uint32_t end) {
+    BL_Verify_Unstage(v, r);
+    while (r->end < end) {
+        uint32_t n = end - r->end;
+        if (n > BL_VERIFY_CHUNK) {
+            n = BL_VERIFY_CHUNK;
+        }
+        r->crc = BL_CRC_Update(r->crc, erased, n / 4);
+        r->end += n;
+    }
+}
+
+// Let the open range take a block at address: right behind it, in the
+// word it ends in, or at the start of the next word
+static bool BL_Verify_Extend(BL_Verify_t *v, BL_VerifyRange_t *r, uint32_t address) {
+    if (address < r->end || address > ((r->end + 3) & ~3UL)) {
+        return false;
+    }
+    if ((address & 3) == 0) {
+        BL_Verify_Unstage(v, r);
+    }
+    return true;
+}
+
+// With the table full, grow the open range over the gap to address. That
+// only works forward and inside the erased flash: within the sector the
+// range ends in, or in the sector right after it.
+static bool BL_Verify_Grow(BL_Verify_t *v, BL_VerifyRange_t *r, uint32_t address) {
+    int32_t last = BL_Flash_SectorOf(r->end - 1);
+    int32_t next = BL_Flash_SectorOf(address);
+
+    if (address < r->end || last < 0 || next < 0 || next > last + 1) {
+        return false;
+    }
+    BL_Verify_Pad(v, r, address & ~3UL);
+    v->coarse = true;
+    return true;
+}
+
+void BL_Verify_Track(BL_Verify_t *v, uint32_t address, const uint8_t *data, uint16_t length) {
+    if (v->overflow || length == 0) {
+        return;
+    }
+
+    BL_VerifyRange_t *r = (v->count > 0) ? &v->ranges[v->count - 1] : NULL;
+    if (!v->open || !BL_Verify_Extend(v, r, address)) {
+        if (v->count == BL_VERIFY_MAX_RANGES) {
+            if (!BL_Verify_Grow(v, r, address)) {
+                v->overflow = true;
+                return;
+            }
+        } else {
+            BL_Verify_Close(v);
+            r = &v->ranges[v->count++];
+            r->address = address & ~3UL;
+            r->end = address;
+            r->crc = BL_CRC_INIT;
+            v->open = true;
+        }
+    }
+
+    uint8_t *stage = (uint8_t *)&v->stage;
+
+    while (length > 0) {
+        // Whole words go to the CRC unit in bulk, the rest through the stage
+        if ((address & 3) == 0 && length >= 4) {
+            uint16_t words = length / 4;
+            if (words > BL_VERIFY_CHUNK / 4) {
+                words = BL_VERIFY_CHUNK / 4;
+            }
+            memcpy(chunk, data, words * 4);
+            r->crc = BL_CRC_Update(r->crc, chunk, words);
+            address += words * 4;
+            data += words * 4;
+            length -= words * 4;
+            continue;
+        }
+
+        stage[address & 3] = *data++;
+        address++;
+        length--;
+        if ((address & 3) == 0) {
+            r->crc = BL_CRC_Update(r->crc, &v->stage, 1);
+            v->stage = 0xFFFFFFFF;
+        }
+    }
+
+    r->end = address;
+}
+
+// CRC of a range as it is on the target, read back in full Read Memory frames
+static bool BL_Verify_ReadBack(uint32_t address, uint32_t length, uint32_t *crc) {
+    *crc = BL_CRC_INIT;
+
+    while (length > 0) {
+        uint16_t n = (length > BL_VERIFY_CHUNK) ? BL_VERIFY_CHUNK : length;
+        if (!BL_ReadMemory(address, (uint8_t *)chunk, n)) {
+            return false;
+        }
+        *crc = BL_CRC_Update(*crc, chunk, n / 4);
+        address += n;
+        length -= n;
+    }
+
+    return true;
+}
+
+bool BL_Verify_TargetCrc(uint32_t address, uint32_t length, uint32_t *crc) {
+    BL_Target_t *t = BL_GetTarget();
+    BL_Phase_t phase = BL_Bench_Enter(BL_PHASE_VERIFY);
+    bool ok;
+
+    if (t->loader != NULL) {
+        ok = BL_Loader_Checksum(t->loader, address, length, crc);
+    } else if (BL_HasCommand(BL_CMD_GET_CHECKSUM)) {
+        ok = BL_GetChecksum(address, length, crc);
+    } else {
+        ok = BL_Verify_ReadBack(address, length, crc);
+    }
+    BL_Bench_Leave(phase);
+    return ok;
+}
+
+bool BL_Verify_Run(BL_Verify_t *v) {
+    BL_Verify_Close(v);
+
+    if (v->overflow) {
+        printf("Image has more than %d ranges, even sector by sector, can't verify\n",
+               BL_VERIFY_MAX_RANGES);
+        return false;
+    }
+
+    const char *method = (BL_GetTarget()->loader != NULL) ? "flash loader"
+                       : BL_HasCommand(BL_CMD_GET_CHECKSUM) ? "Get Checksum" : "read back";
+    uint32_t verified = 0;
+
+    for (uint16_t i = 0; i < v->count; i++) {
+        BL_VerifyRange_t *r = &v->ranges[i];
+        uint32_t length = ((r->end + 3) & ~3UL) - r->address;
+        uint32_t crc;
+
+        if (!BL_Verify_TargetCrc(r->address, length, &crc)) {
+            printf("Verify: reading %08lx failed\n", (unsigned long)r->address);
+            return false;
+        }
+        if (crc != r->crc) {
+            printf("Verify: mismatch in %08lx-%08lx (crc %08lx, expected %08lx)\n",
+                   (unsigned long)r->address, (unsigned long)(r->address + length),
+                   (unsigned long)crc, (unsigned long)r->crc);
+            return false;
+        }
+        verified += length;
+    }
+
+    printf("Verified %lu bytes in %u ranges%s (%s)\n", (unsigned long)verified, v->count,
+           v->coarse ? ", gaps taken as erased" : "", method);
+    return true;
+}
@@ -6,200 +6,614 @@
  */
 
 #include "bootloader.h"
+#include "bl_coalesce.h"
+#include "bl_hex.h"
+#include "bl_pipe.h"
+#include "bl_verify.h"
+#include "bl_diff.h"
+#include "bl_image.h"
+#include "bl_erase.h"
+#include "bl_flash.h"
+#include "bl_device.h"
+#include "bl_journal.h"
+#include "bl_stack.h"
+#include "bl_readahead.h"
+#include "bl_lines.h"
+#include "bl_sdcache.h"
+#include "bl_trace.h"
+#include "bl_crc.h"
+#include "bl_bench.h"
+#include "bl_log.h"
+#include "bl_tcm.h"
+#include "bl_transport_uart.h"
 #include "stm32h7xx_hal.h"
 #include <string.h>
 #include "fatfs.h"
 
-static uint32_t base_address = 0; // Extended linear address
+#define BL_HEX_READ_SIZE 4096 // f_read size when the CM4 parses without read-ahead
+
 static uint32_t start_address = 0xFFFFFFFF; // An invalid default address
-static uint8_t supported_cmd[15] = {0x00};
-static uint16_t supported_cmd_len = 1;
+static uint32_t records;         // data records of the last parse, 0 when streamed from the cache
+static BL_HexParser_t hex BL_DTCM_BSS; // HEX parser when this core parses itself
+static BL_Coalescer_t coalescer; // merges data records into full Write Memory frames
+static BL_Image_t image;         // binary cache of the HEX file being uploaded
+static BL_ReadAhead_t readahead; // DMA read-ahead of the HEX file being parsed
+static BL_LineReader_t lines;    // line splitter of the HEX file when this core parses
+static BL_Loader_t loader;       // RAM flash loader session of the default target
+static BL_ErasePlan_t erase;     // sectors of the upload and which are erased
+static BL_Journal_t journal;     // checkpoints of the upload, to resume it after a failure
 
 /* ****************************** Custom helper functions *********************** */
 
 extern UART_HandleTypeDef huart8;
 
-// Helper function to send data via UART
-static HAL_StatusTypeDef BL_UART_Transmit(uint8_t *data, uint16_t size, uint32_t timeout) {
-    return HAL_UART_Transmit(&huart8, data, size, timeout);
+static BL_Transport_t uart8_link BL_DMA_BUFFER;
+static BL_Target_t default_target;
+static BL_Target_t *target = &default_target;  // target the commands go to
+static uint8_t last_reply;  // ACK, NACK, anything else or 0 for nothing of the last wait
+
+// Long frame of the current try, the resync filler is none of its bytes
+static const uint8_t *frame_data;
+static uint16_t frame_length;
+static uint8_t frame_edges[2]; // length and checksum around a Write Memory payload
+
+// Time bytes take on the current link
+static uint32_t BL_WireUs(uint32_t bytes) {
+    return BL_Rto_WireUs(target->link->baudrate, bytes);
+}
+
+// Helper function to queue data for transmission, returns once it is copied.
+// It only has to wait for the frames queued before it to leave the UART.
+static uint32_t BL_TxTimeout(void) {
+    if (target->link->baudrate == 0) {
+        return 100;
+    }
+    return (BL_WireUs(BL_TRANSPORT_TX_SLOTS * BL_TRANSPORT_TX_SIZE) + 999) / 1000 + BL_RTO_MIN_MS;
+}
+
+static bool BL_UART_Transmit(const uint8_t *data, uint16_t size) {
+    return BL_Transport_Send(target->link, data, size, BL_Transport_Deadline(target->link, BL_TxTimeout()));
+}
+
+// Same for a frame made of several spans, without assembling it first
+static bool BL_UART_TransmitV(const BL_TransportSpan_t *spans, uint8_t count) {
+    return BL_Transport_SendV(target->link, spans, count, BL_Transport_Deadline(target->link, BL_TxTimeout()));
 }
 
-// Function to wait and receive data via UART
-static HAL_StatusTypeDef BL_UART_Receive(uint8_t *data, uint16_t size, uint32_t timeout) {
-    return HAL_UART_Receive(&huart8, data, size, timeout);
+// Function to wait and receive data that follows an ACK from the RX ring
+static bool BL_UART_Receive(uint8_t *data, uint16_t size) {
+    uint32_t timeout = BL_Rto_Timeout(&target->rto, BL_RTO_REPLY, 1, BL_WireUs(size), 1000);
+    return BL_Transport_Receive(target->link, data, size, BL_Transport_Deadline(target->link, timeout));
+}
+
+// Collect the ACK of a wait begun when its frame was queued. An ACK that
+// was in the RX ring already arrived at some unknown time, it is only a
+// sample when the wait just began.
+static bool BL_CollectAck(const BL_RtoWait_t *w) {
+    uint8_t ack;
+    bool exact = BL_Transport_Available(target->link) == 0 || BL_Transport_Now(target->link) == w->start;
+
+    if (!BL_Transport_Receive(target->link, &ack, 1, w->deadline)) {
+        last_reply = 0;
+        BL_Rto_Expired(&target->rto, w);
+        return false;
+    }
+    last_reply = ack;
+    if (ack == BL_ACK && exact) {
+        BL_Rto_Sample(&target->rto, w, BL_Transport_Now(target->link));
+    }
+    return ack == BL_ACK;
+}
+
+// Helper function to wait for the ACK of the frame just queued. bytes: the
+// frame and the ACK, units: pages or KiB for the classes that scale, the
+// timeout is initial until the class learned one.
+static bool BL_WaitAck(BL_RtoClass_t cls, uint32_t units, uint32_t bytes, uint32_t initial) {
+    BL_RtoWait_t w;
+    BL_Rto_Begin(&target->rto, &w, cls, units, BL_WireUs(bytes), initial, BL_Transport_Now(target->link));
+    return BL_CollectAck(&w);
+}
+
+// Check the GET command list without complaining
+bool BL_HasCommand(uint8_t cmd) {
+    for (uint8_t i = 0; i < target->supported_cmd_len; i++) {
+        if (target->supported_cmd[i] == cmd) {
+            return true;
+        }
+    }
+    return false;
 }
 
 // Helper function to check if a command is supported
 static bool BL_IsCommandSupported(uint8_t cmd) {
-    for (uint8_t i = 0; i < supported_cmd_len; i++) {
-        if (supported_cmd[i] == cmd) {
+    if (BL_HasCommand(cmd)) {
+        return true;
+    }
+    BL_LOG("Command %02x not supported\n", cmd);
+    return false;
+}
+
+// Before a command (and all its tries): the ROM bootloader is in charge, the
+// previous write went through and the command is on its list
+static bool BL_Ready(uint8_t command) {
+    if (target->loader != NULL) {
+        BL_LOG("Command %02x not available while the flash loader runs\n", command);
+        return false;
+    }
+    return BL_WaitPendingAck() && BL_IsCommandSupported(command);
+}
+
+// Send a command byte with its complement and wait for the ACK
+static bool BL_SendCommand(uint8_t command) {
+    if (!BL_Ready(command)) {
+        return false;
+    }
+
+    BL_Trace_Begin(command);
+    uint8_t cmd[] = {command, BL_COMPLEMENT(command)};
+    bool ok = BL_UART_Transmit(cmd, 2) && BL_WaitAck(BL_RTO_REPLY, 1, 3, 1000);
+    BL_Trace_Mark(BL_TRACE_CMD_ACK, ok);
+    return ok;
+}
+
+// Send an address (or any other 32-bit parameter) MSB first followed by
+// its XOR checksum and wait for the ACK
+static bool BL_SendWord(uint32_t word) {
+    uint8_t address_cmd[5] = {
+        (word >> 24) & 0xFF, (word >> 16) & 0xFF, (word >> 8) & 0xFF, word & 0xFF
+    };
+    address_cmd[4] = address_cmd[0] ^ address_cmd[1] ^ address_cmd[2] ^ address_cmd[3];
+    bool ok = BL_UART_Transmit(address_cmd, 5) && BL_WaitAck(BL_RTO_REPLY, 1, 6, 1000);
+    BL_Trace_Mark(BL_TRACE_ADDR_ACK, ok);
+    return ok;
+}
+
+/* ********************** Recovery ****************************** */
+
+static bool BL_GetOnce(uint8_t *buffer, uint16_t max_len, uint16_t *out_len);
+static bool BL_ReadMemoryOnce(uint32_t address, uint8_t *data, uint16_t length);
+static bool BL_WriteMemoryOnce(uint32_t address, const uint8_t *data, uint16_t length);
+
+// Drop whatever the target still sends, until the line is quiet for a
+// reply timeout
+static void BL_Drain(void) {
+    uint32_t quiet = BL_Rto_Timeout(&target->rto, BL_RTO_REPLY, 1, BL_WireUs(1), 10);
+    uint8_t byte;
+
+    for (uint16_t i = 0; i < BL_TRANSPORT_RX_SIZE; i++) {
+        if (!BL_Transport_Receive(target->link, &byte, 1, BL_Transport_Deadline(target->link, quiet))) {
+            break;
+        }
+    }
+    BL_Transport_Flush(target->link);
+}
+
+// Send one filler byte and wait a reply timeout for what comes back
+static uint8_t BL_ResyncStep(const uint8_t *filler) {
+    BL_RtoWait_t w;
+
+    if (!BL_UART_Transmit(filler, 1)) {
+        return 0;
+    }
+    BL_Rto_Begin(&target->rto, &w, BL_RTO_REPLY, 1, BL_WireUs(2), 10, BL_Transport_Now(target->link));
+    BL_CollectAck(&w);
+    return last_reply;
+}
+
+// Filler for a resync: even, not 0, and none of the bytes of the long
+// frame of the failed try. When the ROM lost one byte of that frame, the
+// filler completes it and passes the checksum only if it equals the lost
+// byte, so that frame can't pass.
+static uint8_t BL_ResyncFiller(void) {
+    uint32_t seen[8] = {0};
+
+    for (uint16_t i = 0; i < frame_length; i++) {
+        seen[frame_data[i] >> 5] |= 1UL << (frame_data[i] & 31);
+    }
+    for (uint8_t i = 0; i < sizeof(frame_edges); i++) {
+        seen[frame_edges[i] >> 5] |= 1UL << (frame_edges[i] & 31);
+    }
+    for (uint16_t v = 2; v < 256; v += 2) {
+        if (!(seen[v >> 5] & (1UL << (v & 31)))) {
+            return (uint8_t)v;
+        }
+    }
+    return BL_RESYNC_FILLER;
+}
+
+// Bring the ROM back to waiting for a command after an exchange broke off,
+// wherever it stands: in a command, a frame of it or done. Filler bytes
+// complete any frame it waits for with a bad checksum, so it NACKs and
+// drops the command. With v for the filler:
+//  - as command and complement v, v don't match,
+//  - a word XORs to 0 and its checksum is v,
+//  - a length frame (N, ~N) doesn't match either,
+//  - Write Memory and Erase take N = v, an odd number of data bytes v
+//    XOR to 0 with N, not v,
+//  - Extended Erase takes N = 257 * v, the longest frame.
+// A frame the ROM got part of already only passes when v is the byte it
+// lost, see BL_ResyncFiller. Short frames are caught one byte at a time,
+// long ones with a burst. Then one more filler byte or two: either the ROM
+// waits for a complement and NACKs the first, or it takes the first as a
+// command and NACKs the second. A GET checks that commands and replies
+// line up again.
+static bool BL_Resync(void) {
+    static uint8_t burst[BL_TRANSPORT_TX_SIZE];
+    uint8_t filler = BL_ResyncFiller();
+    uint32_t longest = 2 * (257UL * filler + 1) + 3;
+
+    target->rto.resyncs++;
+    for (uint8_t round = 0; round < 2; round++) {
+        BL_Drain();
+
+        bool nacked = false;
+        for (uint8_t i = 0; i < 8 && !nacked; i++) {
+            nacked = BL_ResyncStep(&filler) == BL_NACK;
+        }
+        if (!nacked) {
+            memset(burst, filler, sizeof(burst));
+            for (uint32_t sent = 0; sent < longest; sent += sizeof(burst)) {
+                if (!BL_UART_Transmit(burst, sizeof(burst))) {
+                    return false;
+                }
+            }
+        }
+        BL_Drain();
+
+        if (BL_ResyncStep(&filler) != BL_NACK && BL_ResyncStep(&filler) != BL_NACK) {
+            continue;
+        }
+        uint8_t list[sizeof(target->supported_cmd)];
+        uint16_t len;
+        if (BL_GetOnce(list, sizeof(list), &len)) {
             return true;
         }
     }
-    printf("Command %02x not supported\n", cmd);
+    BL_LOG("Target lost, no resync\n");
     return false;
 }
 
+// After a failed try of a command, false once the tries are used up. A
+// NACK leaves the ROM waiting for the next command, after anything else (a
+// timeout, a byte that is no reply) it has to be found first. So does a
+// second NACK in a row: a ROM that is one byte ahead NACKs every command.
+static bool BL_Retry(uint8_t *attempt) {
+    if (target->loader != NULL || *attempt >= BL_RTO_RETRIES) {
+        return false;
+    }
+    (*attempt)++;
+    target->rto.retries++;
+    target->rto.retrying = true;
+    return (last_reply == BL_NACK && *attempt == 1) || BL_Resync();
+}
+
+// Whether the write in flight is on the target, when its ACK got lost
+static bool BL_PendingOnTarget(void) {
+    static uint8_t data[256];
+    return BL_HasCommand(BL_CMD_READ_MEMORY) &&
+           BL_ReadMemoryOnce(target->pending_address, data, target->pending_length) &&
+           memcmp(data, target->pending_data, target->pending_length) == 0;
+}
+
+// Write the block in flight again and wait for it this time
+static bool BL_RewritePending(void) {
+    if (!BL_WriteMemoryOnce(target->pending_address, target->pending_data, target->pending_length)) {
+        return false;
+    }
+    target->ack_pending = false;
+    return BL_CollectAck(&target->pending_wait);
+}
+
+// Collect the ACK of a Write Memory frame that was sent without waiting for it
+bool BL_WaitPendingAck(void) {
+    if (target->loader != NULL) {
+        BL_Phase_t phase = BL_Bench_Enter(BL_PHASE_PROGRAM);
+        bool ok = BL_Loader_Sync(target->loader);
+        BL_Bench_Leave(phase);
+        return ok;
+    }
+    if (!target->ack_pending) {
+        return true;
+    }
+
+    target->ack_pending = false;
+    // Whatever ran since the frame was queued (parsing, reading the next
+    // block) is a phase of its own, the final ACK only gets the wait left
+    BL_Trace_Mark(BL_TRACE_DEFERRED, true);
+    BL_Phase_t phase = BL_Bench_Enter(BL_PHASE_PROGRAM);
+    bool ok = BL_CollectAck(&target->pending_wait);
+    BL_Trace_Mark(BL_TRACE_FINAL_ACK, ok);
+
+    // The write may have gone through with only its ACK lost, and written
+    // flash NACKs a second write, so the target is checked first
+    uint8_t attempt = 0;
+    while (!ok && BL_Retry(&attempt)) {
+        ok = BL_PendingOnTarget() || BL_RewritePending();
+    }
+    BL_Rto_Done(&target->rto, attempt, ok);
+    BL_Bench_Leave(phase);
+    if (!ok) {
+        BL_LOG("Write at %08lx not acknowledged\n", (unsigned long)target->pending_address);
+        return false;
+    }
+    return true;
+}
+
 /* ********************* Init functions ******************************** */
-bool BL_InitBootloader(void) {
-    uint8_t empty_buf[8];
-    HAL_UART_Receive(&huart8, empty_buf, 8, 10);
 
-    uint8_t init_cmd = BL_INIT_FRAME;
-    BL_UART_Transmit(&init_cmd, 1, 100);
+// Direct the following commands to another target, NULL selects the default
+// one. Every target keeps its own link, command list and write/verify state.
+void BL_SelectTarget(BL_Target_t *t) {
+    target = (t != NULL) ? t : &default_target;
+}
 
-    uint8_t ack;
-    HAL_StatusTypeDef status = BL_UART_Receive(&ack, 1, 1000);
+BL_Target_t *BL_GetTarget(void) {
+    return target;
+}
+
+// Use another transport than UART8 (e.g. a simulation)
+void BL_SetTransport(BL_Transport_t *transport) {
+    target->link = transport;
+    target->ack_pending = false;
+}
 
-    if (status != HAL_OK || ack != BL_ACK) {
+BL_Transport_t *BL_GetTransport(void) {
+    return target->link;
+}
+
+// Fall back to UART8 when no transport was set
+static bool BL_BindDefaultTransport(void) {
+    if (target->link != NULL) {
+        return true;
+    }
+    if (target != &default_target) {
+        printf("Target has no transport\n");
         return false;
     }
+    if (!BL_TransportUart_Init(&uart8_link, &huart8)) {
+        printf("UART8 transport init failed\n");
+        return false;
+    }
+    target->link = &uart8_link;
+    return true;
+}
+
+// Look the target up by its product ID and set up the flash layout, erase
+// costs and flash word of its profile. A target that doesn't answer GET ID
+// still works with the defaults.
+static void BL_SelectDevice(void) {
+    uint8_t id[4];
+    uint16_t len;
 
-    return BL_Get(supported_cmd, sizeof(supported_cmd), &supported_cmd_len);
+    target->pid = 0;
+    if (BL_HasCommand(BL_CMD_GET_ID) && BL_GetID(id, sizeof(id), &len) && len == 2) {
+        target->pid = ((uint16_t)id[0] << 8) | id[1];
+    }
+    target->device = BL_Device_Select(target->pid);
+    BL_Device_Apply(target->device);
+    BL_Device_Report(target->device, target->pid);
+
+    // The GET list is what counts, a gap only hints at a wrong profile
+    if ((target->device->commands & BL_DEVICE_EXTENDED_ERASE) && !BL_HasCommand(BL_CMD_EXTENDED_ERASE)) {
+        printf("Device: the bootloader has no Extended Erase, unlike the profile\n");
+    }
+    if ((target->device->commands & BL_DEVICE_GET_CHECKSUM) && !BL_HasCommand(BL_CMD_GET_CHECKSUM)) {
+        printf("Device: the bootloader has no Get Checksum, unlike the profile\n");
+    }
 }
 
-/* ********************** Basic Commands ****************************** */
+bool BL_InitBootloader(void) {
+    if (!BL_BindDefaultTransport()) {
+        return false;
+    }
+    target->ack_pending = false;
+    target->loader = NULL; // after a sync the ROM bootloader is in charge again
+
+    // Give pending garbage a reply timeout to arrive, then drop it
+    BL_Drain();
+
+    // The ROM may still be starting, so 0x7F goes out again every reply
+    // timeout. An ACK is the sync. A NACK comes from a ROM that was synced
+    // already and took two of them for a command, it waits for one now.
+    static const uint8_t init_cmd = BL_INIT_FRAME;
+    uint32_t end = BL_Transport_Deadline(target->link, BL_RTO_SYNC_MS);
+    bool synced = false;
+    for (uint8_t sent = 0; !synced && (int32_t)(BL_Transport_Now(target->link) - end) < 0; sent++) {
+        BL_RtoWait_t w;
+        if (!BL_UART_Transmit(&init_cmd, 1)) {
+            break;
+        }
+        target->rto.retrying = sent > 0; // the ACK may belong to an earlier one
+        BL_Rto_Begin(&target->rto, &w, BL_RTO_REPLY, 1, BL_WireUs(2), 100, BL_Transport_Now(target->link));
+        if ((int32_t)(w.deadline - end) > 0) {
+            w.deadline = end;
+        }
+        synced = BL_CollectAck(&w) || last_reply == BL_NACK;
+    }
+    target->rto.retrying = false;
+    if (!synced) {
+        return false;
+    }
 
-// Function to send the GET command and receive supported commands
-bool BL_Get(uint8_t *buffer, uint16_t max_len, uint16_t *out_len) {
-    if (!BL_IsCommandSupported(BL_CMD_GET)) {
+    target->supported_cmd[0] = BL_CMD_GET;
+    target->supported_cmd_len = 1;
+    if (!BL_Get(target->supported_cmd, sizeof(target->supported_cmd), &target->supported_cmd_len)) {
         return false;
     }
+    BL_SelectDevice();
+    return true;
+}
 
-    uint8_t cmd[] = {BL_CMD_GET, BL_COMPLEMENT(BL_CMD_GET)};
-    BL_UART_Transmit(cmd, 2, 100);
+// The ROM bootloader autobauds on the first 0x7F and keeps that rate until
+// reset, so every rate of the ladder gets a fresh reset, the sync and a GET
+// round trip. The first rate that passes wins.
+bool BL_InitBootloaderAutoBaud(const uint32_t *ladder, uint8_t count, BL_TargetReset_t reset) {
+    if (!BL_BindDefaultTransport()) {
+        return false;
+    }
 
-    uint8_t ack;
-    if (BL_UART_Receive(&ack, 1, 1000) != HAL_OK || ack != BL_ACK) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (!BL_Transport_SetBaudrate(target->link, ladder[i])) {
+            printf("Baud rate %lu not supported by the link\n", (unsigned long)ladder[i]);
+            continue;
+        }
+        if (reset != NULL) {
+            reset();
+        }
+
+        uint32_t start = BL_Transport_Now(target->link);
+        if (BL_InitBootloader()) {
+            printf("Bootloader synced at %lu baud in %lu ms\n",
+                   (unsigned long)ladder[i], (unsigned long)(BL_Transport_Now(target->link) - start));
+
+            // A rate the part syncs at can still be too fast for long
+            // frames, so above its limit the next rate gets a try
+            uint32_t max = target->device->max_baudrate;
+            if (max == 0 || ladder[i] <= max || reset == NULL || i + 1 == count) {
+                return true;
+            }
+            printf("%s is only good for %lu baud\n", target->device->name, (unsigned long)max);
+            continue;
+        }
+        printf("No sync at %lu baud\n", (unsigned long)ladder[i]);
+
+        if (reset == NULL) {
+            break; // target is locked to the rate it detected, can't try another one
+        }
+    }
+
+    return false;
+}
+
+/* ********************** Basic Commands ****************************** */
+
+// Function to send the GET command and receive supported commands
+static bool BL_GetOnce(uint8_t *buffer, uint16_t max_len, uint16_t *out_len) {
+    if (!BL_SendCommand(BL_CMD_GET)) {
         return false;
     }
 
-    // Receive data into the buffer (number of bytes as the first byte)
-    if (BL_UART_Receive(buffer, 1, 1000) != HAL_OK) {
+    // Number of bytes to follow minus one: version byte + command list
+    uint8_t num_bytes;
+    if (!BL_UART_Receive(&num_bytes, 1)) {
         return false;
     }
-    uint8_t num_bytes = buffer[0]; // Number of bytes to follow
 
     if (num_bytes > max_len) {
         return false; // Provided buffer isn't large enough
     }
 
-    if (BL_UART_Receive(&buffer[-1], num_bytes+1, 1000) != HAL_OK) { // -1 because we don't want overhead in the buffer
+    bool ok = BL_UART_Receive(&target->version, 1) &&
+              BL_UART_Receive(buffer, num_bytes);
+    BL_Trace_Mark(BL_TRACE_PAYLOAD, ok);
+    if (!ok) {
         return false;
     }
 
 //    BL_Hexdump(buffer, num_bytes);
 
     *out_len = num_bytes;
-    return true;
+    ok = BL_WaitAck(BL_RTO_REPLY, 1, 1, 1000);
+    BL_Trace_Mark(BL_TRACE_FINAL_ACK, ok);
+    return ok;
 }
 
-// Function to send the GET ID command and receive the unique device ID
-bool BL_GetID(uint8_t *buffer, uint16_t max_len, uint16_t *out_len) {
-	return false; // not working yet -> gives wrong count of bytes back
-    if (!BL_IsCommandSupported(BL_CMD_GET_ID)) {
+bool BL_Get(uint8_t *buffer, uint16_t max_len, uint16_t *out_len) {
+    if (!BL_Ready(BL_CMD_GET)) {
         return false;
     }
+    uint8_t attempt = 0;
+    bool ok;
+    while (!(ok = BL_GetOnce(buffer, max_len, out_len)) && BL_Retry(&attempt)) {
+    }
+    BL_Rto_Done(&target->rto, attempt, ok);
+    return ok;
+}
 
-    uint8_t cmd[] = {BL_CMD_GET_ID, BL_COMPLEMENT(BL_CMD_GET_ID)};
-    BL_UART_Transmit(cmd, 2, 100);
-
-    uint8_t ack;
-    if (BL_UART_Receive(&ack, 1, 1000) != HAL_OK || ack != BL_ACK) {
+// Function to send the GET ID command and receive the product ID: the
+// number of bytes minus one, the ID (two bytes on STM32), final ACK
+static bool BL_GetIDOnce(uint8_t *buffer, uint16_t max_len, uint16_t *out_len) {
+    if (!BL_SendCommand(BL_CMD_GET_ID)) {
         return false;
     }
 
-    // Receive data into the buffer (number of bytes as the first byte)
-    if (BL_UART_Receive(buffer, 1, 1000) != HAL_OK) {
+    uint8_t count;
+    if (!BL_UART_Receive(&count, 1)) {
         return false;
     }
-    uint8_t num_bytes = buffer[0] + 1; // Number of bytes to follow
+    uint16_t num_bytes = count + 1; // Number of bytes to follow
 
     if (num_bytes > max_len) {
         return false; // Provided buffer isn't large enough
     }
 
-    if (BL_UART_Receive(&buffer[0], num_bytes, 1000) != HAL_OK) {
+    if (!BL_UART_Receive(buffer, num_bytes)) {
         return false;
     }
 
     *out_len = num_bytes;
-    return true;
+    return BL_WaitAck(BL_RTO_REPLY, 1, 1, 1000);
 }
 
-// Function to send the GET VERSION command and receive the version and read protection status
-bool BL_GetVersion(uint8_t *version) {
-	return false; // not working yet -> gives wrong count of bytes back
-    if (!BL_IsCommandSupported(BL_CMD_GET_VERSION)) {
+bool BL_GetID(uint8_t *buffer, uint16_t max_len, uint16_t *out_len) {
+    if (!BL_Ready(BL_CMD_GET_ID)) {
         return false;
     }
+    uint8_t attempt = 0;
+    bool ok;
+    while (!(ok = BL_GetIDOnce(buffer, max_len, out_len)) && BL_Retry(&attempt)) {
+    }
+    BL_Rto_Done(&target->rto, attempt, ok);
+    return ok;
+}
 
-    uint8_t cmd[] = {BL_CMD_GET_VERSION, BL_COMPLEMENT(BL_CMD_GET_VERSION)};
-    BL_UART_Transmit(cmd, 2, 100);
-
-    uint8_t ack;
-    if (BL_UART_Receive(&ack, 1, 1000) != HAL_OK || ack != BL_ACK) {
+// Function to send the GET VERSION command and receive the version and the
+// two option bytes (always 0 on current parts), final ACK
+static bool BL_GetVersionOnce(uint8_t *version) {
+    if (!BL_SendCommand(BL_CMD_GET_VERSION)) {
         return false;
     }
 
     uint8_t data[3];
-    if (BL_UART_Receive(data, 3, 1000) != HAL_OK) {
+    if (!BL_UART_Receive(data, 3)) {
         return false;
     }
 
-    *version = data[0]; // Data[1] & Data[2] are usually reserved
-    return true;
+    *version = data[0];
+    return BL_WaitAck(BL_RTO_REPLY, 1, 1, 1000);
 }
 
-/* ********************** Jump to User Code ****************************** */
-
-// Function to send the `Go` command -> jumps to user code
-bool BL_Go(uint32_t address) {
-    if (!BL_IsCommandSupported(BL_CMD_GO)) {
-        return false;
-    }
-
-    // Command code for `Go` and its complement
-    uint8_t cmd[] = {BL_CMD_GO, BL_COMPLEMENT(BL_CMD_GO)};
-    HAL_StatusTypeDef status;
-
-    // Send the `Go` command and wait for acknowledgment
-    status = BL_UART_Transmit(cmd, 2, 100);
-    if (status != HAL_OK) {
+bool BL_GetVersion(uint8_t *version) {
+    if (!BL_Ready(BL_CMD_GET_VERSION)) {
         return false;
     }
-
-    uint8_t ack;
-    status = BL_UART_Receive(&ack, 1, 1000);
-    if (status != HAL_OK || ack != BL_ACK) {
-        return false;
+    uint8_t attempt = 0;
+    bool ok;
+    while (!(ok = BL_GetVersionOnce(version)) && BL_Retry(&attempt)) {
     }
+    BL_Rto_Done(&target->rto, attempt, ok);
+    return ok;
+}
 
-    // Prepare the address to be sent, MSB first
-    uint8_t address_bytes[] = {
-        (address >> 24) & 0xFF,
-        (address >> 16) & 0xFF,
-        (address >> 8) & 0xFF,
-        address & 0xFF
-    };
-
-    // Calculate the checksum (XOR of all address bytes)
-    uint8_t checksum = address_bytes[0] ^ address_bytes[1] ^ address_bytes[2] ^ address_bytes[3];
-    uint8_t address_packet[] = {address_bytes[0], address_bytes[1], address_bytes[2], address_bytes[3], checksum};
+/* ********************** Jump to User Code ****************************** */
 
-    // Send the address packet
-    status = BL_UART_Transmit(address_packet, 5, 100);
-    if (status != HAL_OK) {
-        return false;
+// Function to send the `Go` command -> jumps to user code
+bool BL_Go(uint32_t address) {
+    // The loader jumps on its own, the ROM bootloader is gone either way
+    if (target->loader != NULL) {
+        bool ok = BL_Loader_Go(target->loader, address);
+        target->loader = NULL;
+        return ok;
     }
 
-    // Receive the final acknowledgment
-    status = BL_UART_Receive(&ack, 1, 1000);
-    if (status != HAL_OK || ack != BL_ACK) {
+    // Send the `Go` command and wait for acknowledgment. Not retried: once
+    // the address went out the application may be running.
+    if (!BL_SendCommand(BL_CMD_GO)) {
         return false;
     }
 
-    return true;
+    // Send the address packet and receive the final acknowledgment
+    return BL_SendWord(address);
 }
 
 bool BL_GoToUserApp(void) {
@@ -209,274 +623,651 @@ bool BL_GoToUserApp(void) {
 /* ********************** Reading from Memory ****************************** */
 
 // Function to read memory from the target device
-bool BL_ReadMemory(uint32_t address, uint8_t *data, uint16_t length) {
-    if (!BL_IsCommandSupported(BL_CMD_READ_MEMORY)) {
+static bool BL_ReadMemoryOnce(uint32_t address, uint8_t *data, uint16_t length) {
+    if (!BL_SendCommand(BL_CMD_READ_MEMORY) || !BL_SendWord(address)) {
         return false;
     }
 
-    uint8_t cmd[] = {BL_CMD_READ_MEMORY, BL_COMPLEMENT(BL_CMD_READ_MEMORY)};
-    BL_UART_Transmit(cmd, 2, 100);
-
-    uint8_t ack;
-    if (BL_UART_Receive(&ack, 1, 1000) != HAL_OK || ack != BL_ACK) {
+    uint8_t length_cmd[2] = {length - 1, (uint8_t)(~(length - 1))};
+    bool ok = BL_UART_Transmit(length_cmd, 2) && BL_WaitAck(BL_RTO_REPLY, 1, 3, 1000);
+    BL_Trace_Mark(BL_TRACE_FINAL_ACK, ok); // the length ACK, the data follows it
+    if (!ok) {
         return false;
     }
 
-    uint8_t address_bytes[] = {
-        (address >> 24) & 0xFF, (address >> 16) & 0xFF, (address >> 8) & 0xFF, address & 0xFF
-    };
-    uint8_t checksum = address_bytes[0] ^ address_bytes[1] ^ address_bytes[2] ^ address_bytes[3];
-    uint8_t address_cmd[5] = {address_bytes[0], address_bytes[1], address_bytes[2], address_bytes[3], checksum};
-    BL_UART_Transmit(address_cmd, 5, 100);
+    ok = BL_UART_Receive(data, length);
+    BL_Trace_Mark(BL_TRACE_PAYLOAD, ok);
+    return ok;
+}
 
-    if (BL_UART_Receive(&ack, 1, 1000) != HAL_OK || ack != BL_ACK) {
+bool BL_ReadMemory(uint32_t address, uint8_t *data, uint16_t length) {
+    if (length == 0 || length > 256 || !BL_Ready(BL_CMD_READ_MEMORY)) {
         return false;
     }
-
-    uint8_t length_cmd[2] = {length - 1, (uint8_t)(~(length - 1))};
-    BL_UART_Transmit(length_cmd, 2, 100);
-
-    if (BL_UART_Receive(&ack, 1, 1000) != HAL_OK || ack != BL_ACK) {
-        return false;
+    uint8_t attempt = 0;
+    bool ok;
+    while (!(ok = BL_ReadMemoryOnce(address, data, length)) && BL_Retry(&attempt)) {
     }
-
-    return (BL_UART_Receive(data, length, 1000) == HAL_OK);
+    BL_Rto_Done(&target->rto, attempt, ok);
+    return ok;
 }
 
+// One line of 16 bytes per write, so each line is a single log record
 void BL_Hexdump(const void *buffer, size_t length) {
+    static const char digits[] = "0123456789abcdef";
     const unsigned char *buf = (const unsigned char *)buffer;
     const size_t bytes_per_line = 16; // Number of bytes per line
-
-    // Iterate over each byte in the buffer
-    for (size_t i = 0; i < length; i++) {
-        if (i % bytes_per_line == 0) {
-            // Print the offset/address at the beginning of each line
-            printf("%08zx: ", i);
+    char line[10 + 3 * 16 + 2];
+
+    for (size_t i = 0; i < length; i += bytes_per_line) {
+        // Offset at the beginning of each line, then the bytes in hex
+        int n = snprintf(line, sizeof(line), "%08lx: ", (unsigned long)i);
+        for (size_t j = i; j < length && j < i + bytes_per_line; j++) {
+            line[n++] = digits[buf[j] >> 4];
+            line[n++] = digits[buf[j] & 0x0F];
+            line[n++] = ' ';
         }
-
-        // Print the byte in hex format
-        printf("%02x ", buf[i]);
+        line[n++] = '\n';
+        fwrite(line, 1, n, stdout);
     }
-    printf("\n");
 }
 
 void BL_ReadMemoryHexdump(uint32_t address, uint16_t length) {
-    uint8_t data[length];
-    if (BL_ReadMemory(address, data, length)) {
+    static uint8_t data[256];
+    if (length <= sizeof(data) && BL_ReadMemory(address, data, length)) {
         BL_Hexdump(data, length);
     } else {
         printf("Failed to read memory\n");
     }
 }
 
-/* ********************** Writing to Memory ****************************** */
+// Let the target compute the CRC of a memory area (multiple of 4 bytes) with
+// the same parameters as bl_crc.c, so nothing has to be read back
+static bool BL_GetChecksumOnce(uint32_t address, uint32_t length, uint32_t *crc) {
+    if (!BL_SendCommand(BL_CMD_GET_CHECKSUM) || !BL_SendWord(address) || !BL_SendWord(length) ||
+        !BL_SendWord(BL_CRC_POLYNOMIAL) || !BL_SendWord(BL_CRC_INIT)) {
+        return false;
+    }
 
-// Function to write memory to the target device
-bool BL_WriteMemory(uint32_t address, const uint8_t *data, uint16_t length) {
-    if (!BL_IsCommandSupported(BL_CMD_WRITE_MEMORY)) {
+    // The target ACKs once it is done, then sends the CRC MSB first and its XOR
+    uint8_t result[5];
+    bool ok = BL_WaitAck(BL_RTO_CHECKSUM, (length + 1023) / 1024, 1, 5000);
+    BL_Trace_Mark(BL_TRACE_FINAL_ACK, ok);
+    if (!ok || !BL_UART_Receive(result, 5)) {
+        return false;
+    }
+    if ((result[0] ^ result[1] ^ result[2] ^ result[3]) != result[4]) {
         return false;
     }
 
-    uint8_t cmd[] = {BL_CMD_WRITE_MEMORY, BL_COMPLEMENT(BL_CMD_WRITE_MEMORY)};
-    BL_UART_Transmit(cmd, 2, 100);
+    *crc = ((uint32_t)result[0] << 24) | ((uint32_t)result[1] << 16) | ((uint32_t)result[2] << 8) | result[3];
+    return true;
+}
 
-    uint8_t ack;
-    if (BL_UART_Receive(&ack, 1, 1000) != HAL_OK || ack != BL_ACK) {
+bool BL_GetChecksum(uint32_t address, uint32_t length, uint32_t *crc) {
+    if (!BL_Ready(BL_CMD_GET_CHECKSUM)) {
         return false;
     }
+    uint8_t attempt = 0;
+    bool ok;
+    while (!(ok = BL_GetChecksumOnce(address, length, crc)) && BL_Retry(&attempt)) {
+    }
+    BL_Rto_Done(&target->rto, attempt, ok);
+    return ok;
+}
 
-    uint8_t address_bytes[] = {
-        (address >> 24) & 0xFF, (address >> 16) & 0xFF, (address >> 8) & 0xFF, address & 0xFF
-    };
-    uint8_t checksum = address_bytes[0] ^ address_bytes[1] ^ address_bytes[2] ^ address_bytes[3];
-    uint8_t address_cmd[5] = {address_bytes[0], address_bytes[1], address_bytes[2], address_bytes[3], checksum};
-    BL_UART_Transmit(address_cmd, 5, 100);
+/* ********************** Writing to Memory ****************************** */
 
-    if (BL_UART_Receive(&ack, 1, 1000) != HAL_OK || ack != BL_ACK) {
+// Function to write memory to the target device. The final ACK is collected
+// by the next command (or BL_WaitPendingAck), so the caller can prepare the
+// next block while this one is on the wire and being programmed.
+static bool BL_WriteMemoryOnce(uint32_t address, const uint8_t *data, uint16_t length) {
+    if (!BL_SendCommand(BL_CMD_WRITE_MEMORY) || !BL_SendWord(address)) {
         return false;
     }
 
-    uint8_t length_cmd[1] = {length - 1};
-    checksum = length_cmd[0];
-    for (uint16_t i = 0; i < length; i++) {
-        checksum ^= data[i];
+    // Length byte, the data straight from the caller's buffer, checksum
+    uint8_t count = length - 1;
+    uint8_t checksum = BL_XorChecksum(count, data, length);
+    frame_data = data;
+    frame_length = length;
+    frame_edges[0] = count;
+    frame_edges[1] = checksum;
+    BL_TransportSpan_t frame[] = {{&count, 1}, {data, length}, {&checksum, 1}};
+    bool ok = BL_UART_TransmitV(frame, 3);
+    BL_Trace_Mark(BL_TRACE_PAYLOAD, ok); // until queued, the final ACK is traced when collected
+    if (!ok) {
+        return false;
+    }
+
+    BL_Rto_Begin(&target->rto, &target->pending_wait, BL_RTO_PROGRAM, 1, BL_WireUs(length + 3),
+                 BL_Device_ProgramTimeout(BL_Device_Current()), BL_Transport_Now(target->link));
+    target->ack_pending = true;
+    return true;
+}
+
+// The block is kept until its ACK is in, the caller may reuse its buffer
+bool BL_WriteMemory(uint32_t address, const uint8_t *data, uint16_t length) {
+    if (length == 0 || length > 256 || !BL_Ready(BL_CMD_WRITE_MEMORY)) {
+        return false;
     }
-    uint8_t full_cmd[length + 2];
-    full_cmd[0] = length_cmd[0];
-    memcpy(&full_cmd[1], data, length);
-    full_cmd[length + 1] = checksum;
-    BL_UART_Transmit(full_cmd, length + 2, 100);
+    target->pending_address = address;
+    target->pending_length = length;
+    memcpy(target->pending_data, data, length);
 
-    return (BL_UART_Receive(&ack, 1, 1000) == HAL_OK && ack == BL_ACK);
+    uint8_t attempt = 0;
+    bool ok;
+    while (!(ok = BL_WriteMemoryOnce(address, target->pending_data, length)) && BL_Retry(&attempt)) {
+    }
+    BL_Rto_Done(&target->rto, attempt, ok);
+    return ok;
 }
 
 /* ********************** Erasing Memory ****************************** */
 
-// Function to erase specific pages using the `Erase` command (without extended erase)
-// or use num_pages 0xff and page_number 0x00 to perform a full erease
-bool BL_EraseMemory(uint16_t *page_numbers, uint16_t num_pages) {
-    if (!BL_IsCommandSupported(BL_CMD_ERASE)) {
+// Send an Erase command and its payload (checksum included) and wait until
+// the target ACKs, which it only does once the erase is done. count: pages,
+// 0 for a mass erase. Erasing again is harmless, so every try sends the
+// whole command.
+static bool BL_Erase(uint8_t command, const uint8_t *payload, uint16_t length, uint16_t count,
+                     uint32_t timeout) {
+    if (!BL_Ready(command)) {
         return false;
     }
 
-    uint8_t cmd[] = {BL_CMD_ERASE, (uint8_t)(~BL_CMD_ERASE)};
-    BL_UART_Transmit(cmd, 2, 100);
+    BL_RtoClass_t cls = count > 0 ? BL_RTO_ERASE : BL_RTO_MASS_ERASE;
+    frame_data = payload;
+    frame_length = length;
+    frame_edges[0] = frame_edges[1] = payload[0];
+    uint8_t attempt = 0;
+    bool ok;
+    do {
+        ok = BL_SendCommand(command);
+        if (ok) {
+            ok = BL_UART_Transmit(payload, length);
+            BL_Trace_Mark(BL_TRACE_PAYLOAD, ok);
+            ok = ok && BL_WaitAck(cls, count, length + 1, timeout);
+            BL_Trace_Mark(BL_TRACE_FINAL_ACK, ok);
+        }
+    } while (!ok && BL_Retry(&attempt));
+    BL_Rto_Done(&target->rto, attempt, ok);
+    return ok;
+}
 
-    uint8_t ack;
-    if (BL_UART_Receive(&ack, 1, 1000) != HAL_OK || ack != BL_ACK) {
+// Erase a list of pages (sectors), with Extended Erase when the bootloader
+// has it and the legacy Erase command otherwise. The legacy command only
+// takes 8-bit page numbers.
+bool BL_EraseMemory(const uint16_t *pages, uint16_t count, uint32_t timeout) {
+    static uint8_t payload[2 + 2 * BL_ERASE_PAGES_MAX + 1];
+    bool extended = BL_HasCommand(BL_CMD_EXTENDED_ERASE);
+    uint16_t length = 0;
+
+    if (count == 0 || count > BL_ERASE_PAGES_MAX) {
         return false;
     }
 
-    // Create the payload with the page count and page numbers
-    uint8_t payload[256]; // Adjust to the required buffer size
-    payload[0] = (uint8_t)(num_pages - 1); // Number of pages minus one
-    for (uint16_t i = 0; i < num_pages; i++) {
-        payload[1 + 2 * i] = (uint8_t)(page_numbers[i] >> 8);  // MSB of the page number
-        payload[2 + 2 * i] = (uint8_t)(page_numbers[i] & 0xFF);  // LSB of the page number
+    if (extended) {
+        // Number of pages minus one, then the page numbers, all MSB first
+        payload[length++] = (uint8_t)((count - 1) >> 8);
+        payload[length++] = (uint8_t)(count - 1);
+        for (uint16_t i = 0; i < count; i++) {
+            payload[length++] = (uint8_t)(pages[i] >> 8);
+            payload[length++] = (uint8_t)pages[i];
+        }
+    } else {
+        payload[length++] = (uint8_t)(count - 1);
+        for (uint16_t i = 0; i < count; i++) {
+            if (pages[i] > 0xFF) {
+                BL_LOG("Page %u needs Extended Erase\n", pages[i]);
+                return false;
+            }
+            payload[length++] = (uint8_t)pages[i];
+        }
     }
 
-    // Calculate the checksum by XOR-ing all bytes
-    uint8_t checksum = 0;
-    for (int i = 0; i < (1 + 2 * num_pages); i++) {
-        checksum ^= payload[i];
-    }
-    payload[1 + 2 * num_pages] = checksum;
+    payload[length] = BL_XorChecksum(0, payload, length);
+    return BL_Erase(extended ? BL_CMD_EXTENDED_ERASE : BL_CMD_ERASE, payload, length + 1, count, timeout);
+}
 
-    // Transmit the entire payload with the checksum
-    BL_UART_Transmit(payload, 2 + 2 * num_pages, 100);
+// Erase the whole user flash
+bool BL_MassErase(uint32_t timeout) {
+    if (BL_HasCommand(BL_CMD_EXTENDED_ERASE)) {
+        static const uint8_t payload[3] = {0xFF, 0xFF, 0x00}; // 0xFFFF: mass erase, checksum
+        return BL_Erase(BL_CMD_EXTENDED_ERASE, payload, sizeof(payload), 0, timeout);
+    }
 
-    // Receive the final acknowledgment
-    return (BL_UART_Receive(&ack, 1, 1000) == HAL_OK && ack == BL_ACK);
+    // Legacy global erase: 0xFF followed by 0x00 instead of an XOR checksum
+    static const uint8_t payload[2] = {0xFF, 0x00};
+    return BL_Erase(BL_CMD_ERASE, payload, sizeof(payload), 0, timeout);
 }
 
 /* **************** Upload Code ************************************** */
 
 // upload the user application to the target device
 
-// Helper function to convert a hex character ('0'-'9', 'a'-'f', 'A'-'F') to its numerical value
-uint8_t hex_char_to_nibble(char hex) {
-    if (hex >= '0' && hex <= '9') {
-        return hex - '0';
-    } else if (hex >= 'a' && hex <= 'f') {
-        return hex - 'a' + 10;
-    } else if (hex >= 'A' && hex <= 'F') {
-        return hex - 'A' + 10;
-    } else {
-        return 0xFF; // Invalid character
+bool BL_Mount_FS(void) {
+    // Initialize SD card (could be SDIO or SPI interface depending on your hardware setup)
+    // This may involve initializing HAL libraries for SPI/SDIO and setting up GPIOs
+    // e.g., HAL_SD_Init(&hsd), HAL_SPI_Init(&hspi)
+
+    // Try to mount the filesystem (assuming "0:" as the logical drive number)
+    FRESULT result = f_mount(&SDFatFS, "", 1); // "" means "default drive"
+    if (result != FR_OK) {
+        // Error mounting the filesystem
+        printf("Error mounting filesystem: %d\n", result);
+        return false;
     }
+#if defined(USE_HAL_DRIVER)
+    // Keep the FAT in the sector cache, every cluster chain walk goes through it
+    BL_SdCache_Pin(SDFatFS.fatbase, SDFatFS.fsize * SDFatFS.n_fats);
+#endif
+
+    // Successfully mounted
+    printf("Filesystem mounted successfully.\n");
+    return true;
 }
 
-// Function to convert a pair of hex characters to a byte
-uint8_t BL_HexPairToByte(const char *hex) {
-    uint8_t high_nibble = hex_char_to_nibble(hex[0]);
-    uint8_t low_nibble = hex_char_to_nibble(hex[1]);
+// Hand the target over to the RAM flash loader when its stub is on the card,
+// the commands that follow go through the loader's streaming protocol.
+// Returns false only when the target is left without a bootloader.
+bool BL_StartFlashLoader(const char *filename, uint32_t ram_address) {
+    if (target->loader != NULL || !BL_Mount_FS()) {
+        return true;
+    }
 
-    if (high_nibble == 0xFF || low_nibble == 0xFF) {
-        return 0;
+    switch (BL_Loader_Start(&loader, filename, ram_address)) {
+    case BL_LOADER_STARTED:
+        target->loader = &loader;
+        return true;
+    case BL_LOADER_UNAVAILABLE:
+        printf("Using the ROM bootloader\n");
+        return true;
+    default:
+        printf("Flash loader did not start, the target needs a reset\n");
+        return false;
+    }
+}
+
+// Block writer used by the coalescer
+static bool BL_WriteBlock(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    BL_Phase_t phase = BL_Bench_Enter(BL_PHASE_PROGRAM);
+    bool ok = (target->loader != NULL) ? BL_Loader_Write(target->loader, address, data, length)
+                                       : BL_WriteMemory(address, data, length);
+    BL_Bench_Leave(phase);
+    if (!ok) {
+        return false;
     }
+    BL_Verify_Track(&target->verify, address, data, length);
+    return true;
+}
 
-    return (high_nibble << 4) | low_nibble;
+// Check everything written by the last upload against the target
+bool BL_VerifyUpload(void) {
+    return BL_Verify_Run(&target->verify);
 }
 
-// Function to parse and write a single Intel HEX line
-bool BL_ProcessHexLine(const char *line) {
-    if (line[0] != ':') {
-        return false; // Line must start with ':'
+// Parse the open file line by line on this core
+static bool BL_ParseHexLocal(void) {
+    BL_Line_t line;
+
+    BL_HexParser_Init(&hex, &coalescer);
+    BL_LineReader_Init(&lines, &SDFile);
+
+    // Read and process each line of the file, straight from the read buffer
+    while (true) {
+        BL_Phase_t phase = BL_Bench_Enter(BL_PHASE_SD_READ);
+        bool ok = BL_LineReader_Next(&lines, &line);
+        BL_Bench_Leave(phase);
+        if (!ok) {
+            BL_LOG("Failed to read line %lu\n", (unsigned long)lines.lines + 1);
+            return false;
+        }
+        if (line.text == NULL) {
+            break;
+        }
+
+        // Process the hex line and upload data. printf, the line is gone
+        // from the read buffer by the time a deferred record is rendered.
+        if (!BL_ProcessHexLine(&hex, line.text)) {
+            printf("Failed to process line: %s\n", line.text);
+            return false;
+        }
     }
 
-    // Parse basic fields from the line
-    uint8_t byte_count = BL_HexPairToByte(&line[1]);
-    uint16_t address = (BL_HexPairToByte(&line[3]) << 8) | BL_HexPairToByte(&line[5]);
-    uint8_t record_type = BL_HexPairToByte(&line[7]);
+    start_address = hex.start_address;
+    records = hex.records;
+    return true;
+}
+
+// Next chunk of the open file, straight from the read-ahead buffers when it
+// runs and through a plain f_read otherwise
+static bool BL_ReadText(bool direct, BL_Span_t *span) {
+    static uint8_t text[BL_HEX_READ_SIZE] __attribute__((aligned(32)));
+    BL_Phase_t phase = BL_Bench_Enter(BL_PHASE_SD_READ);
+    UINT n;
+    bool ok;
 
-    // Process the data bytes
-    uint8_t data[256];
-    for (uint8_t i = 0; i < byte_count; i++) {
-        data[i] = BL_HexPairToByte(&line[9 + i * 2]);
+    if (direct) {
+        ok = BL_ReadAhead_Next(&readahead, span);
+    } else {
+        ok = f_read(&SDFile, text, sizeof(text), &n) == FR_OK;
+        span->data = text;
+        span->length = ok ? n : 0;
     }
+    BL_Bench_Leave(phase);
+    return ok;
+}
+
+// Let the CM4 parse the open file. This core only moves text into the pipe
+// with large reads and sends the blocks that come back, so reading and
+// parsing overlap with the transfers to the target.
+static bool BL_ParseHexPiped(bool direct) {
+    BL_Span_t text = { NULL, 0 };
+    uint32_t offset = 0;
+    uint32_t pending = 0;
+    bool eof = false;
+
+    while (true) {
+        // Keep the text ring topped up
+        if (!eof && pending == 0) {
+            if (!BL_ReadText(direct, &text)) {
+                BL_LOG("Failed to read file\n");
+                BL_Pipe_Abort();
+                return false;
+            }
+            offset = 0;
+            pending = text.length;
+            if (text.length == 0) {
+                eof = true;
+                BL_Pipe_EndText();
+            }
+        }
+        if (pending > 0) {
+            uint32_t taken = BL_Pipe_WriteText(&text.data[offset], pending);
+            offset += taken;
+            pending -= taken;
+        }
+
+        // State before the blocks, everything published before DONE is drained below
+        BL_PipeState_t state = BL_Pipe_State();
+        const BL_PipeBlock_t *b;
+        while ((b = BL_Pipe_PeekBlock()) != NULL) {
+            bool ok = BL_Coalescer_Push(&coalescer, b->address, b->data, b->length);
+            BL_Pipe_ReleaseBlock();
+            if (!ok) {
+                BL_Pipe_Abort();
+                return false;
+            }
+        }
 
-    // Calculate and verify the checksum
-    uint8_t checksum = 0;
-    for (int i = 1; i < 9 + byte_count * 2; i += 2) {
-        checksum += BL_HexPairToByte(&line[i]);
+        if (state == BL_PIPE_DONE) {
+            break;
+        }
+        if (state != BL_PIPE_BUSY) {
+            BL_LOG("Failed to process line %lu\n", (unsigned long)BL_Pipe_ErrorLine());
+            return false;
+        }
     }
-    checksum = ~checksum + 1;
-    uint8_t provided_checksum = BL_HexPairToByte(&line[9 + byte_count * 2]);
-    if (checksum != provided_checksum) {
-        printf("Checksum error\n");
+
+    start_address = BL_Pipe_StartAddress();
+    records = BL_Pipe_Records();
+    return true;
+}
+
+// Blocks of the flash line up with the flash words of the target, so no
+// word is programmed by two Write Memory commands
+static void BL_AlignToDevice(void) {
+    BL_Coalescer_SetFlashWord(&coalescer, BL_Device_Current()->flash_word, BL_Flash_SectorStart(0),
+                              BL_Flash_SectorStart(BL_Flash_SectorCount()));
+}
+
+// Run every record of an Intel HEX file through the coalescer into writer,
+// parsed by the CM4 when it is up and by this core otherwise.
+// The CM4 path reads the file with the DMA read-ahead unless the writer
+// itself goes to the SD card (readahead_ok false). Blocks for the target
+// (aligned) are padded to its flash words, the image cache takes them as
+// they are.
+static bool BL_ParseHexFile(const char *filename, BL_BlockWriter_t writer, void *ctx, bool readahead_ok,
+                            bool aligned) {
+    FRESULT result;
+
+    // Open the Intel HEX file
+    result = f_open(&SDFile, filename, FA_READ);
+    if (result != FR_OK) {
+        printf("Failed to open file: %d\n", result);
         return false;
     }
 
-    // Process based on record type
-    switch (record_type) {
-        case 0x00: // Data record
-            return BL_WriteMemory(base_address + address, data, byte_count);
+    start_address = 0xFFFFFFFF;
+    records = 0;
+    BL_Coalescer_Init(&coalescer, writer, ctx);
+    if (aligned) {
+        BL_AlignToDevice();
+    }
+    BL_Phase_t phase = BL_Bench_Enter(BL_PHASE_PARSE);
+
+    bool ok;
+    if (BL_Pipe_Start()) {
+        bool direct = readahead_ok && BL_ReadAhead_Open(&readahead, &SDFile);
+        ok = BL_ParseHexPiped(direct);
+        if (direct) {
+            BL_ReadAhead_Close(&readahead);
+            BL_ReadAhead_Report(&readahead);
+        }
+    } else {
+        ok = BL_ParseHexLocal();
+    }
 
-        case 0x01: // End-of-file record
-            return true;
+    // Close the file
+    f_close(&SDFile);
+    if (!ok) {
+        BL_Bench_Leave(phase);
+        return false;
+    }
 
-        case 0x04: // Extended linear address record
-            base_address = (data[0] << 8 | data[1]) << 16;
-            return true;
+    // Files without an EOF record still leave a partial block behind
+    ok = BL_Coalescer_Flush(&coalescer);
+    BL_Bench_Leave(phase);
+    if (!ok || !BL_WaitPendingAck()) {
+        BL_LOG("Failed to write last block\n");
+        return false;
+    }
+    return true;
+}
 
-        case 0x05: // Start linear address record
-            start_address = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
-            return true;
+// Convert a HEX file into its binary cache, two passes over the text
+static bool BL_BuildImage(const char *filename) {
+    printf("Building image cache for %s\n", filename);
 
-        default:
-            // Unsupported record types
-            return false;
+    if (!BL_Image_BuildBegin(&image, filename) ||
+        !BL_ParseHexFile(filename, BL_Image_Collect, &image, true, false) ||
+        !BL_Image_BuildLayout(&image)) {
+        BL_Image_BuildAbort(&image);
+        return false;
     }
+    // Placing writes the cache file between reads, so no read-ahead here
+    if (!BL_ParseHexFile(filename, BL_Image_Place, &image, false, false)) {
+        BL_Image_BuildAbort(&image);
+        return false;
+    }
+    return BL_Image_BuildEnd(&image, start_address);
 }
 
-bool BL_Mount_FS(void) {
-    // Initialize SD card (could be SDIO or SPI interface depending on your hardware setup)
-    // This may involve initializing HAL libraries for SPI/SDIO and setting up GPIOs
-    // e.g., HAL_SD_Init(&hsd), HAL_SPI_Init(&hspi)
+// Load or build the binary cache of a HEX file, false if there is none
+static bool BL_PrepareImage(const char *filename) {
+    return BL_Image_Load(&image, filename) || BL_BuildImage(filename);
+}
 
-    // Try to mount the filesystem (assuming "0:" as the logical drive number)
-    FRESULT result = f_mount(&SDFatFS, "", 1); // "" means "default drive"
-    if (result != FR_OK) {
-        // Error mounting the filesystem
-        printf("Error mounting filesystem: %d\n", result);
+// Feed the image of a HEX file into writer, from the binary cache when
+// BL_PrepareImage got one and straight from the text otherwise
+static bool BL_StreamImage(const char *filename, bool cached, BL_BlockWriter_t writer, void *ctx) {
+    if (!cached) {
+        printf("No image cache, parsing %s\n", filename);
+        return BL_ParseHexFile(filename, writer, ctx, true, true);
+    }
+
+    start_address = image.header.start_address;
+    records = 0;
+    BL_Coalescer_Init(&coalescer, writer, ctx);
+    BL_AlignToDevice();
+    BL_Phase_t phase = BL_Bench_Enter(BL_PHASE_PARSE);
+    if (!BL_Image_Stream(&image, &coalescer)) {
+        BL_Bench_Leave(phase);
+        BL_LOG("Failed to read image cache\n");
         return false;
     }
 
-    // Successfully mounted
-    printf("Filesystem mounted successfully.\n");
+    bool ok = BL_Coalescer_Flush(&coalescer);
+    BL_Bench_Leave(phase);
+    if (!ok || !BL_WaitPendingAck()) {
+        BL_LOG("Failed to write last block\n");
+        return false;
+    }
     return true;
 }
 
+bool BL_LoadHexImage(const char *filename, BL_BlockWriter_t writer, void *ctx) {
+    return BL_StreamImage(filename, BL_PrepareImage(filename), writer, ctx);
+}
+
+// Coalescer sink that erases the sectors under a block before writing it
+static bool BL_EraseAndWriteBlock(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    return BL_Erase_Before(ctx, address, length) && BL_WriteBlock(NULL, address, data, length);
+}
+
+// Coalescer sink of BL_UploadHexFile: blocks a resumed upload finds on the
+// target are only tracked for the verify pass, the others are erased and
+// written, and the journal takes its checkpoints along the way
+static bool BL_JournalWriteBlock(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    switch (BL_Journal_Check(&journal, ctx, address, data, length)) {
+    case BL_JOURNAL_SKIP:
+        BL_Verify_Track(&target->verify, address, data, length);
+        return true;
+    case BL_JOURNAL_WRITE:
+        return BL_EraseAndWriteBlock(ctx, address, data, length) &&
+               BL_Journal_Written(&journal, ctx, address, data, length);
+    default:
+        return false;
+    }
+}
+
+static void BL_ReportUpload(uint32_t start, uint32_t written) {
+    uint32_t elapsed = BL_Transport_Now(target->link) - start;
+    // Streamed from the image cache there are no records to count
+    if (records > 0) {
+        BL_LOG("%lu data records written in %lu frames\n", (unsigned long)records, (unsigned long)coalescer.frames);
+    } else {
+        BL_LOG("%lu frames written\n", (unsigned long)coalescer.frames);
+    }
+    BL_LOG("%lu bytes in %lu ms at %lu baud (%lu B/s)\n", (unsigned long)written,
+           (unsigned long)elapsed, (unsigned long)target->link->baudrate,
+           (unsigned long)(elapsed ? (uint64_t)written * 1000 / elapsed : 0));
+    BL_Stack_Report("upload");
+}
+
 // Function to read and upload an Intel HEX file from an SD card
 bool BL_UploadHexFile(const char *filename) {
-    FRESULT result;
-    char line[512];
+    BL_Stack_Paint();
 
     if(!BL_Mount_FS()){
         return false;
     }
 
-    // Open the Intel HEX file
-    result = f_open(&SDFile, filename, FA_READ);
-    if (result != FR_OK) {
-        printf("Failed to open file: %d\n", result);
+    BL_Verify_Init(&target->verify);
+    uint32_t start = BL_Transport_Now(target->link);
+    bool cached = BL_PrepareImage(filename);
+
+    // The flash loader erases every sector right before its first write
+    if (target->loader != NULL) {
+        if (!BL_StreamImage(filename, cached, BL_WriteBlock, NULL)) {
+            return false;
+        }
+        BL_ReportUpload(start, coalescer.bytes);
+        BL_Loader_Report(target->loader);
+        return true;
+    }
+
+    // Pick up after the last checkpoint of an earlier attempt
+    if (!BL_Journal_Begin(&journal, filename, cached)) {
+        return false;
+    }
+
+    // The segment table of the cache tells up front which sectors the image
+    // covers. Without it the sectors are found while writing. A resumed
+    // upload never mass erases, that would take the blocks it skips along.
+    BL_Erase_Init(&erase);
+    if (cached) {
+        for (uint16_t i = 0; i < image.header.segment_count; i++) {
+            BL_Erase_Touch(&erase, image.segments[i].address, image.segments[i].length);
+        }
+    }
+    bool allow_mass = BL_ERASE_ALLOW_MASS && !BL_Journal_Resuming(&journal);
+    if (!BL_Erase_Plan(&erase, allow_mass) ||
+        !BL_StreamImage(filename, cached, BL_JournalWriteBlock, &erase)) {
+        BL_Journal_End(&journal, false);
+        return false;
+    }
+    BL_Journal_End(&journal, true);
+
+    BL_ReportUpload(start, coalescer.bytes - journal.skipped_bytes);
+    BL_Erase_Report(&erase);
+    BL_Journal_Report(&journal);
+    return true;
+}
+
+// Coalescer sink for the programming pass of a differential upload
+static bool BL_WriteChangedBlock(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    BL_Diff_t *d = ctx;
+    if (!BL_Diff_IsChanged(d, address)) {
+        d->bytes_skipped += length;
+        return true;
+    }
+    if (target->loader == NULL && !BL_Erase_Before(&erase, address, length)) {
+        return false;
+    }
+    return BL_WriteBlock(NULL, address, data, length);
+}
+
+// Like BL_UploadHexFile, but only erases and programs the flash sectors that
+// differ from what is on the target. Reads the file twice, once to hash the
+// image against the target and once to program the changed sectors.
+// With the image cache in place both passes are binary reads.
+bool BL_UploadHexFileDiff(const char *filename) {
+    static BL_Diff_t diff;
+
+    BL_Stack_Paint();
+
+    if(!BL_Mount_FS()){
         return false;
     }
 
-    // Read and process each line of the file
-    while (f_gets(line, sizeof(line), &SDFile)) {
-        // Strip any trailing newline characters
-        line[strcspn(line, "\n")] = 0;
+    BL_Diff_Init(&diff);
+    BL_Verify_Init(&target->verify);
+    uint32_t start = BL_Transport_Now(target->link);
+    bool cached = BL_PrepareImage(filename);
 
-        // Process the hex line and upload data
-        if (!BL_ProcessHexLine(line)) {
-            printf("Failed to process line: %s\n", line);
-            f_close(&SDFile);
+    if (!BL_StreamImage(filename, cached, BL_Diff_Hash, &diff) || !BL_Diff_Finish(&diff)) {
+        return false;
+    }
+    BL_LOG("Diff: %u of %u sectors unchanged\n", diff.skipped, diff.sectors);
+
+    // Only the changed sectors are erased, never the whole flash. The flash
+    // loader erases every sector right before its first write.
+    BL_Erase_Init(&erase);
+    if (target->loader == NULL) {
+        BL_Diff_PlanErase(&diff, &erase);
+        if (!BL_Erase_Plan(&erase, false)) {
             return false;
         }
     }
+    if (!BL_StreamImage(filename, cached, BL_WriteChangedBlock, &diff)) {
+        return false;
+    }
 
-    // Close the file
-    f_close(&SDFile);
+    BL_LOG("Diff: skipped %u sectors, %lu bytes\n", diff.skipped, (unsigned long)diff.bytes_skipped);
+    BL_ReportUpload(start, coalescer.bytes - diff.bytes_skipped);
+    if (target->loader == NULL) {
+        BL_Erase_Report(&erase);
+    }
     return true;
 }
@@ -25,6 +25,16 @@
 #include <stdio.h>
 #include <string.h>
 #include "bootloader.h"
+#include "bl_gang.h"
+#include "bl_transport_uart.h"
+#include "bl_pipe.h"
+#include "bl_trace.h"
+#include "bl_perf.h"
+#include "bl_bench.h"
+#include "bl_log.h"
+#include "bl_sd.h"
+#include "bl_sdcache.h"
+#include "bl_sd_diskio.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -39,6 +49,21 @@
 #define HSEM_ID_0 (0U) /* HW semaphore 0*/
 #endif
 #define PUTCHAR_PROTOTYPE int __io_putchar(int ch)
+// 1: only erase and program the sectors that changed, needs the right sector map (bl_flash.h)
+#define UPLOAD_DIFFERENTIAL 0
+// 1: program every target of the gang table in main() at once
+#define GANG_PROGRAMMING 0
+// 1: dump the command phase timings as CSV on USART1 at the end (tools/bl_trace_hist.py)
+#define TRACE_DUMP 0
+// 1: run the CM7 from PLL1 at 400 MHz with both L1 caches on, 0: the CubeMX clock tree (64 MHz HSI)
+#define PERFORMANCE_PROFILE 1
+// 1: stream the image through the RAM flash loader (BL_LOADER_FILE on the card), ROM bootloader if it's missing
+// Off until a stub for the target family is in the tree, only the host model (tools/host/bl_sim_rom.c) speaks it
+#define FLASH_LOADER 0
+// 1: run the flashing benchmark instead of the upload, JSON lines on USART1 (tools/bl_bench_compare.py)
+#define BENCHMARK 0
+// Uploads before giving up, every retry resyncs and resumes from the journal on the card (bl_journal.h)
+#define UPLOAD_ATTEMPTS 3
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -64,13 +89,45 @@ static void MX_USART1_UART_Init(void);
 static void MX_UART8_Init(void);
 static void MX_SDMMC1_SD_Init(void);
 /* USER CODE BEGIN PFP */
+static void Target1_EnterBootloader(void) __attribute__((unused)); /* no UART routed to target 1 yet */
+static void Target2_EnterBootloader(void);
+static void MPU_Config(void);
+static void SystemClock_Config_Performance(void);
 
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
 
+/**
+  * @brief  Resets a target with BOOT0 high so it starts its ROM bootloader
+  * @param  port: GPIO port of the target's reset line
+  * @param  pin: GPIO pin of the target's reset line
+  * @retval None
+  */
+static void Target_EnterBootloader(GPIO_TypeDef *port, uint16_t pin)
+{
+  HAL_GPIO_WritePin(port, pin, 0);
+
+  HAL_Delay(10);
+  HAL_GPIO_WritePin(BOOT_GPIO_Port, BOOT_Pin, 1);
+
+  HAL_Delay(10);
+  HAL_GPIO_WritePin(port, pin, 1);
+
+  HAL_Delay(100);
+  HAL_GPIO_WritePin(BOOT_GPIO_Port, BOOT_Pin, 0);
+}
+
+static void Target1_EnterBootloader(void)
+{
+  Target_EnterBootloader(RST1_GPIO_Port, RST1_Pin);
+}
 
+static void Target2_EnterBootloader(void)
+{
+  Target_EnterBootloader(RST2_GPIO_Port, RST2_Pin);
+}
 
 /* USER CODE END 0 */
 
@@ -82,7 +139,12 @@ int main(void)
 {
 
   /* USER CODE BEGIN 1 */
-
+#if PERFORMANCE_PROFILE
+  /* MPU first, the D-cache must never see the DMA buffers as cacheable */
+  MPU_Config();
+  SCB_EnableICache();
+  SCB_EnableDCache();
+#endif
   /* USER CODE END 1 */
 /* USER CODE BEGIN Boot_Mode_Sequence_0 */
   int32_t timeout;
@@ -109,10 +171,16 @@ int main(void)
   /* Configure the system clock */
   SystemClock_Config();
 /* USER CODE BEGIN Boot_Mode_Sequence_2 */
+#if PERFORMANCE_PROFILE
+/* Before the CM4 starts, so it comes up with its final clock */
+SystemClock_Config_Performance();
+#endif
 /* When system initialization is finished, Cortex-M7 will release Cortex-M4 by means of
 HSEM notification */
 /*HW semaphore Clock enable*/
 __HAL_RCC_HSEM_CLK_ENABLE();
+/* Shared pipeline state has to be clean before the CM4 runs */
+BL_Pipe_Init();
 /*Take HSEM */
 HAL_HSEM_FastTake(HSEM_ID_0);
 /*Release HSEM in order to notify the CPU2(CM4)*/
@@ -138,10 +206,24 @@ Error_Handler();
   MX_FATFS_Init();
   /* USER CODE BEGIN 2 */
 
+  /* Console output goes out by DMA from here on, printf no longer waits for USART1 */
+  BL_Log_Init(&huart1, USART1_IRQn);
   setvbuf(stdout, NULL, _IOLBF, 0);
 
   printf("Hello World!\n");
 
+  BL_Trace_Init();
+
+  /* FatFs on the bl_sd request queue instead of the generated polling driver */
+  if (!BL_SdDiskio_Link(SDPath)) {
+	  printf("SD driver not linked!\n");
+  }
+
+  BL_PerfResult_t perf;
+  if (!BL_Perf_SelfCheck(&perf)) {
+	  printf("Self-check failed!\n");
+  }
+
   /*if(BL_Mount_FS() == false){
 	  printf("failed mounting!\n");
   }*/
@@ -155,26 +237,44 @@ Error_Handler();
 
   HAL_Delay(100);
   HAL_GPIO_WritePin(RST1_GPIO_Port, RST1_Pin, 0);
-  HAL_GPIO_WritePin(RST2_GPIO_Port, RST2_Pin, 0);
-
-  HAL_Delay(10);
-  HAL_GPIO_WritePin(BOOT_GPIO_Port, BOOT_Pin, 1);
-
-  HAL_Delay(10);
-  HAL_GPIO_WritePin(RST2_GPIO_Port, RST2_Pin, 1);
-
-  HAL_Delay(100);
   //HAL_GPIO_WritePin(RST1_GPIO_Port, RST1_Pin, 1);
-  HAL_GPIO_WritePin(BOOT_GPIO_Port, BOOT_Pin, 0);
 
+  const uint32_t baud_ladder[] = BL_BAUD_LADDER;
+  const uint8_t baud_count = sizeof(baud_ladder) / sizeof(baud_ladder[0]);
 
+#if GANG_PROGRAMMING
+  /* One entry per target, each one on its own UART. Only target 2 (UART8)
+     is routed so far, target 1 needs a UART before it can join:
+     BL_Gang_InitTarget(&gang[1], "T1", &target1_link, Target1_EnterBootloader); */
+  static BL_Transport_t target2_link BL_DMA_BUFFER;
+  static BL_GangTarget_t gang[BL_GANG_MAX_TARGETS];
+  uint8_t gang_count = 0;
 
+  if (BL_TransportUart_Init(&target2_link, &huart8)) {
+	  BL_Gang_InitTarget(&gang[gang_count++], "T2", &target2_link, Target2_EnterBootloader);
+  }
 
-  if(BL_InitBootloader() != true){
+  if (BL_Mount_FS() && BL_Gang_LoadImage("blinky.hex")) {
+	  uint8_t passed = BL_Gang_Run(gang, gang_count, baud_ladder, baud_count);
+	  BL_Gang_Report(gang, gang_count);
+	  printf("%u of %u targets programmed.\n", passed, gang_count);
+	  BL_Gang_StartApps(gang, gang_count);
+  } else {
+	  printf("Loading the image failed.\n");
+  }
+#else
+  /* Sync as fast as the link allows, every rate gets a fresh target reset */
+  if(BL_InitBootloaderAutoBaud(baud_ladder, baud_count, Target2_EnterBootloader) != true){
 	  printf("bootloader starting failed!\n");
 	  while(1);
   }
 
+#if FLASH_LOADER
+  if (!BL_StartFlashLoader(BL_LOADER_FILE, BL_LOADER_RAM_ADDRESS)) {
+	  while(1);
+  }
+#endif
+
 //  uint8_t buffer[15];
 //  uint16_t out_len;
 //  BL_GetVersion(buffer);
@@ -183,15 +283,52 @@ Error_Handler();
 
  // BL_ReadMemoryHexdump(0x08000000, 8);
 
-  if (BL_UploadHexFile("blinky.hex")) {
+#if BENCHMARK
+  /* Leaves the target in its bootloader, the flash holds the last scenario */
+  printf("Benchmark %s\n", BL_Bench_RunSuite("board", 0) ? "passed" : "failed");
+#else
+  bool uploaded = false;
+  for (uint8_t attempt = 1; !uploaded && attempt <= UPLOAD_ATTEMPTS; attempt++) {
+	  if (attempt > 1) {
+		  printf("Upload failed, resyncing for attempt %u\n", attempt);
+		  if (!BL_InitBootloaderAutoBaud(baud_ladder, baud_count, Target2_EnterBootloader)) {
+			  continue;
+		  }
+#if FLASH_LOADER
+		  if (!BL_StartFlashLoader(BL_LOADER_FILE, BL_LOADER_RAM_ADDRESS)) {
+			  continue;
+		  }
+#endif
+	  }
+#if UPLOAD_DIFFERENTIAL
+	  uploaded = BL_UploadHexFileDiff("blinky.hex");
+#else
+	  uploaded = BL_UploadHexFile("blinky.hex");
+#endif
+  }
+  if (uploaded && BL_VerifyUpload()) {
 	  printf("File upload successful.\n");
+
+	  if(BL_GoToUserApp() == true){
+		  printf("code started!\n");
+	  }
   } else {
 	  printf("File upload failed.\n");
   }
+#endif
 
-  if(BL_GoToUserApp() == true){
-	  printf("code started!\n");
-  }
+  /* Retries on the link and the timeouts the commands ran with */
+  BL_Rto_Report(&BL_GetTarget()->rto);
+#endif
+
+  /* Latency of the SD requests behind the upload, and how many the sector
+     cache saved */
+  BL_Sd_Report();
+  BL_SdCache_Report();
+
+#if TRACE_DUMP
+  BL_Trace_Dump(&huart1);
+#endif
 
 
 
@@ -348,7 +485,11 @@ static void MX_UART8_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN UART8_Init 2 */
-
+  /* The bootloader transport runs UART8 with DMA, let the FIFO absorb bursts */
+  if (HAL_UARTEx_EnableFifoMode(&huart8) != HAL_OK)
+  {
+    Error_Handler();
+  }
   /* USER CODE END UART8_Init 2 */
 
 }
@@ -471,6 +612,110 @@ static void MX_GPIO_Init(void)
 
 /* USER CODE BEGIN 4 */
 
+/**
+  * @brief  MPU map for the performance profile
+  *         - everything outside code, RAM and peripherals: no access, so
+  *           speculative reads never reach FMC/QSPI
+  *         - AXI SRAM: write-through, the SDMMC1 IDMA (which only reaches
+  *           this RAM) never finds dirty lines, an invalidate after each
+  *           read is all it takes
+  *         - SRAM4 (D3): non-cacheable, CM4 pipe and DMA1/DMA2 buffers
+  * @param  None
+  * @retval None
+  */
+static void MPU_Config(void)
+{
+  MPU_Region_InitTypeDef MPU_InitStruct = {0};
+
+  HAL_MPU_Disable();
+
+  MPU_InitStruct.Enable = MPU_REGION_ENABLE;
+  MPU_InitStruct.Number = MPU_REGION_NUMBER0;
+  MPU_InitStruct.BaseAddress = 0x00000000;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_4GB;
+  MPU_InitStruct.SubRegionDisable = 0x87;
+  MPU_InitStruct.TypeExtField = MPU_TEX_LEVEL0;
+  MPU_InitStruct.AccessPermission = MPU_REGION_NO_ACCESS;
+  MPU_InitStruct.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+  MPU_InitStruct.IsShareable = MPU_ACCESS_SHAREABLE;
+  MPU_InitStruct.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+  MPU_InitStruct.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+  HAL_MPU_ConfigRegion(&MPU_InitStruct);
+
+  MPU_InitStruct.Number = MPU_REGION_NUMBER1;
+  MPU_InitStruct.BaseAddress = D1_AXISRAM_BASE;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_512KB;
+  MPU_InitStruct.SubRegionDisable = 0x00;
+  MPU_InitStruct.TypeExtField = MPU_TEX_LEVEL0;
+  MPU_InitStruct.AccessPermission = MPU_REGION_FULL_ACCESS;
+  MPU_InitStruct.DisableExec = MPU_INSTRUCTION_ACCESS_ENABLE;
+  MPU_InitStruct.IsShareable = MPU_ACCESS_NOT_SHAREABLE;
+  MPU_InitStruct.IsCacheable = MPU_ACCESS_CACHEABLE;
+  MPU_InitStruct.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+  HAL_MPU_ConfigRegion(&MPU_InitStruct);
+
+  MPU_InitStruct.Number = MPU_REGION_NUMBER2;
+  MPU_InitStruct.BaseAddress = D3_SRAM_BASE;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_64KB;
+  MPU_InitStruct.TypeExtField = MPU_TEX_LEVEL1;
+  MPU_InitStruct.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+  MPU_InitStruct.IsShareable = MPU_ACCESS_SHAREABLE;
+  MPU_InitStruct.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+  MPU_InitStruct.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+  HAL_MPU_ConfigRegion(&MPU_InitStruct);
+
+  HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
+}
+
+/**
+  * @brief  Performance clock profile, applied on top of SystemClock_Config
+  *         The direct SMPS supply rules out VOS0, so the rated maximum is
+  *         400 MHz at VOS1: HSE 25 MHz / 5 * 160 = 800 MHz VCO, P /2 for
+  *         SYSCLK, Q /17 keeps the SDMMC kernel clock at 47 MHz. AXI/AHB run
+  *         at 200 MHz (2 flash wait states at VOS1), every APB at 100 MHz.
+  * @param  None
+  * @retval None
+  */
+static void SystemClock_Config_Performance(void)
+{
+  RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+  RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+
+  /* SYSCLK is still on HSI, so PLL1 can be reprogrammed */
+  RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_NONE;
+  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+  RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
+  RCC_OscInitStruct.PLL.PLLM = 5;
+  RCC_OscInitStruct.PLL.PLLN = 160;
+  RCC_OscInitStruct.PLL.PLLP = 2;
+  RCC_OscInitStruct.PLL.PLLQ = 17;
+  RCC_OscInitStruct.PLL.PLLR = 2;
+  RCC_OscInitStruct.PLL.PLLRGE = RCC_PLL1VCIRANGE_2;
+  RCC_OscInitStruct.PLL.PLLVCOSEL = RCC_PLL1VCOWIDE;
+  RCC_OscInitStruct.PLL.PLLFRACN = 0;
+  if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  /* Wait states are raised before the switch by HAL_RCC_ClockConfig */
+  RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
+                              |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2
+                              |RCC_CLOCKTYPE_D3PCLK1|RCC_CLOCKTYPE_D1PCLK1;
+  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+  RCC_ClkInitStruct.SYSCLKDivider = RCC_SYSCLK_DIV1;
+  RCC_ClkInitStruct.AHBCLKDivider = RCC_HCLK_DIV2;
+  RCC_ClkInitStruct.APB3CLKDivider = RCC_APB3_DIV2;
+  RCC_ClkInitStruct.APB1CLKDivider = RCC_APB1_DIV2;
+  RCC_ClkInitStruct.APB2CLKDivider = RCC_APB2_DIV2;
+  RCC_ClkInitStruct.APB4CLKDivider = RCC_APB4_DIV2;
+
+  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+}
+
 /**
   * @brief  Retargets the C library printf function to the USART.
   * @param  None
@@ -478,9 +723,9 @@ static void MX_GPIO_Init(void)
   */
 PUTCHAR_PROTOTYPE
 {
-  /* Place your implementation of fputc here */
-  /* e.g. write a character to the USART1 and Loop until the end of transmission */
-  HAL_UART_Transmit(&huart1, (uint8_t *)&ch, 1, 0xFFFF);
+  /* Into the console log like everything else on stdout (bl_log.c) */
+  char c = (char)ch;
+  BL_Log_Write(&c, 1);
 
   return ch;
 }
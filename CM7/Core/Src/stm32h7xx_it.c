@@ -22,6 +22,8 @@
 #include "stm32h7xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "bl_log.h"
+#include "bl_sd.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -57,6 +59,11 @@
 /* External variables --------------------------------------------------------*/
 extern SD_HandleTypeDef hsd1;
 /* USER CODE BEGIN EV */
+extern UART_HandleTypeDef huart8;
+extern DMA_HandleTypeDef hdma_uart8_rx;
+extern DMA_HandleTypeDef hdma_uart8_tx;
+extern UART_HandleTypeDef huart1;
+extern DMA_HandleTypeDef hdma_usart1_tx;
 
 /* USER CODE END EV */
 
@@ -187,6 +194,8 @@ void SysTick_Handler(void)
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
+  /* SD card programming after a write, and request timeouts */
+  BL_Sd_Tick();
 
   /* USER CODE END SysTick_IRQn 1 */
 }
@@ -214,4 +223,46 @@ void SDMMC1_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles DMA1 stream0 global interrupt (UART8_RX).
+  */
+void DMA1_Stream0_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_uart8_rx);
+}
+
+/**
+  * @brief This function handles DMA1 stream1 global interrupt (UART8_TX).
+  */
+void DMA1_Stream1_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_uart8_tx);
+}
+
+/**
+  * @brief This function handles UART8 global interrupt.
+  */
+void UART8_IRQHandler(void)
+{
+  HAL_UART_IRQHandler(&huart8);
+}
+
+/**
+  * @brief This function handles DMA1 stream2 global interrupt (USART1_TX).
+  */
+void DMA1_Stream2_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_usart1_tx);
+}
+
+/**
+  * @brief This function handles USART1 global interrupt, also pended by the
+  *        console log to start its next transfer.
+  */
+void USART1_IRQHandler(void)
+{
+  HAL_UART_IRQHandler(&huart1);
+  BL_Log_Drain();
+}
+
 /* USER CODE END 1 */
@@ -0,0 +1,47 @@
+/*
+ * bl_coalesce.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_COALESCE_H_
+#define INC_BL_COALESCE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Largest payload the ROM bootloader accepts in one Write Memory frame
+#define BL_COALESCE_BLOCK_SIZE 256
+
+// Sink for finished blocks, normally a wrapper around BL_WriteMemory
+typedef bool (*BL_BlockWriter_t)(void *ctx, uint32_t address, const uint8_t *data, uint16_t length);
+
+// Merges contiguous data records into blocks that never cross a
+// BL_COALESCE_BLOCK_SIZE aligned boundary. Works on absolute addresses, so
+// records on both sides of an extended address (0x04) record are merged too.
+//
+// With a flash word set, blocks inside [pad_start, pad_end) are widened to
+// whole flash words with 0xFF, and a gap that ends in the flash word the
+// block ends in is filled instead of starting a new block. Parts with ECC
+// program a flash word only once per erase, so no word may be split over
+// two blocks.
+typedef struct {
+    BL_BlockWriter_t write;
+    void *ctx;
+    uint16_t flash_word; // power of two up to the block size, 1: no padding
+    uint32_t pad_start;
+    uint32_t pad_end;
+    uint32_t address;   // target address of buf[0]
+    uint16_t length;    // number of bytes currently buffered
+    uint32_t frames;    // blocks handed to the writer since init
+    uint32_t bytes;     // payload bytes handed to the writer since init
+    uint8_t buf[BL_COALESCE_BLOCK_SIZE];
+} BL_Coalescer_t;
+
+void BL_Coalescer_Init(BL_Coalescer_t *c, BL_BlockWriter_t write, void *ctx);
+// Align the blocks in [start, end) to flash words, call after init
+void BL_Coalescer_SetFlashWord(BL_Coalescer_t *c, uint16_t flash_word, uint32_t start, uint32_t end);
+bool BL_Coalescer_Push(BL_Coalescer_t *c, uint32_t address, const uint8_t *data, uint16_t length);
+bool BL_Coalescer_Flush(BL_Coalescer_t *c);
+
+#endif /* INC_BL_COALESCE_H_ */
@@ -0,0 +1,53 @@
+/*
+ * bl_hex.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_HEX_H_
+#define INC_BL_HEX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bl_coalesce.h"
+
+// Longest line the readers of both cores accept: a record of 255 data bytes
+// (521 characters), a CR and the terminator
+#define BL_HEX_LINE_MAX (11 + 2 * 255 + 2)
+
+// Intel HEX record parser, shared by both cores. Data records are pushed to
+// the coalescer on their absolute address.
+typedef struct {
+    BL_Coalescer_t *coalescer;
+    uint32_t base_address;  // extended linear address
+    uint32_t start_address; // from the 0x05 record, 0xFFFFFFFF if none
+    bool eof;               // end-of-file record seen
+    uint32_t records;       // data records parsed
+} BL_HexParser_t;
+
+// Splits text that arrives in pieces into lines for the parser, the CM4
+// side of the pipe. A line ends at LF, a CR before it is dropped. Lines
+// are limited to BL_HEX_LINE_MAX like on the line reader of the CM7.
+typedef struct {
+    BL_HexParser_t *parser;
+    uint32_t lines;         // lines parsed, a failed line is lines + 1
+    uint16_t length;        // characters of the unfinished line
+    char line[BL_HEX_LINE_MAX];
+} BL_HexLines_t;
+
+void BL_HexParser_Init(BL_HexParser_t *p, BL_Coalescer_t *coalescer);
+// Parse one line without its line ending, an empty line is skipped
+bool BL_ProcessHexLine(BL_HexParser_t *p, const char *line);
+uint8_t BL_HexPairToByte(const char *hex);
+
+void BL_HexLines_Init(BL_HexLines_t *l, BL_HexParser_t *parser);
+// Parse every line text completes. False on a line that is too long or that
+// the parser rejects.
+bool BL_HexLines_Feed(BL_HexLines_t *l, const char *text, uint32_t length);
+// Parse the last line when the text doesn't end in a line ending
+bool BL_HexLines_End(BL_HexLines_t *l);
+// XOR of seed and every byte of data, the checksum of the bootloader frames.
+// Works a word at a time.
+uint8_t BL_XorChecksum(uint8_t seed, const uint8_t *data, uint32_t length);
+
+#endif /* INC_BL_HEX_H_ */
@@ -0,0 +1,91 @@
+/*
+ * bl_pipe.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_PIPE_H_
+#define INC_BL_PIPE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "bl_coalesce.h"
+
+// HEX parsing pipeline between the cores. The CM7 streams the file text into
+// the text ring, the CM4 parses it and hands back coalesced blocks through
+// the block ring, the CM7 sends them to the target. Both rings are single
+// producer/single consumer with free running indices, so no locks are
+// needed. The CM7 wakes the CM4 through an HSEM release notification.
+//
+// The shared state lives in the .bl_pipe section, which both linker scripts
+// place at the start of RAM_D3 without initialising it.
+
+#define BL_PIPE_TEXT_SIZE 8192  // power of two
+#define BL_PIPE_BLOCKS    16    // power of two
+#define BL_PIPE_HSEM_ID   1U    // released by the CM7 to wake the CM4
+
+typedef enum {
+    BL_PIPE_IDLE,
+    BL_PIPE_BUSY,
+    BL_PIPE_DONE,
+    BL_PIPE_ERROR,
+} BL_PipeState_t;
+
+typedef struct {
+    uint32_t address;
+    uint16_t length;
+    uint8_t data[BL_COALESCE_BLOCK_SIZE];
+} __attribute__((aligned(32))) BL_PipeBlock_t;
+
+// Fields written by the CM7, kept apart from the CM4 ones so that cache
+// maintenance on one side never touches data of the other
+typedef struct {
+    volatile uint32_t job;        // bumped to start parsing a new file
+    volatile uint32_t abort;      // job the CM4 should drop
+    volatile uint32_t text_head;
+    volatile uint32_t text_eof;   // all text of the job is in the ring
+    volatile uint32_t block_tail;
+} __attribute__((aligned(32))) BL_PipeCm7_t;
+
+typedef struct {
+    volatile uint32_t ready;      // CM4 worker is running
+    volatile uint32_t job;        // job the CM4 has accepted
+    volatile uint32_t state;      // BL_PipeState_t of that job
+    volatile uint32_t text_tail;
+    volatile uint32_t block_head;
+    volatile uint32_t start_address;
+    volatile uint32_t records;    // data records parsed
+    volatile uint32_t error_line; // line number of a parse error
+} __attribute__((aligned(32))) BL_PipeCm4_t;
+
+typedef struct {
+    BL_PipeCm7_t cm7;
+    BL_PipeCm4_t cm4;
+    uint8_t text[BL_PIPE_TEXT_SIZE] __attribute__((aligned(32)));
+    BL_PipeBlock_t blocks[BL_PIPE_BLOCKS];
+} BL_Pipe_t;
+
+#if defined(CORE_CM7)
+// Clear the shared state, before the CM4 is released
+void BL_Pipe_Init(void);
+// Start a new job, fails if the CM4 doesn't answer
+bool BL_Pipe_Start(void);
+void BL_Pipe_Abort(void);
+// Copy as much text as fits, returns the number of bytes taken
+uint32_t BL_Pipe_WriteText(const uint8_t *data, uint32_t length);
+void BL_Pipe_EndText(void);
+// Oldest parsed block or NULL, release it once it has been used
+const BL_PipeBlock_t *BL_Pipe_PeekBlock(void);
+void BL_Pipe_ReleaseBlock(void);
+BL_PipeState_t BL_Pipe_State(void);
+uint32_t BL_Pipe_StartAddress(void);
+uint32_t BL_Pipe_Records(void);
+uint32_t BL_Pipe_ErrorLine(void);
+#endif
+
+#if defined(CORE_CM4)
+// Parse every job the CM7 starts, never returns
+void BL_Pipe_Worker(void);
+#endif
+
+#endif /* INC_BL_PIPE_H_ */
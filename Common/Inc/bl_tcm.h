@@ -0,0 +1,34 @@
+/*
+ * bl_tcm.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INC_BL_TCM_H_
+#define INC_BL_TCM_H_
+
+// Placement in the tightly coupled memories of the CM7. ITCM code runs
+// without flash wait states or I-cache misses, DTCM data is single cycle
+// and never evicted. The CM7 linker scripts collect the sections, the
+// startup code copies .itcm_text and .dtcm_data from flash and clears
+// .dtcm_bss before main.
+//
+// DMA1/DMA2 and the SDMMC IDMA can't reach either memory, so anything a DMA
+// stream or FatFS touches stays out (BL_DMA_BUFFER, FIL, sector buffers).
+// The CM4 has no TCM and the host build no such sections, the macros are
+// empty there.
+//
+// What the placement gains on the board has not been measured yet, see
+// tools/bl_tcm_report.py for how to compare two console captures.
+
+#if defined(CORE_CM7) && defined(USE_HAL_DRIVER)
+#define BL_ITCM_CODE __attribute__((section(".itcm_text")))
+#define BL_DTCM_DATA __attribute__((section(".dtcm_data")))
+#define BL_DTCM_BSS  __attribute__((section(".dtcm_bss")))
+#else
+#define BL_ITCM_CODE
+#define BL_DTCM_DATA
+#define BL_DTCM_BSS
+#endif
+
+#endif /* INC_BL_TCM_H_ */
@@ -0,0 +1,96 @@
+/*
+ * bl_coalesce.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_coalesce.h"
+#include "bl_tcm.h"
+#include <string.h>
+
+void BL_Coalescer_Init(BL_Coalescer_t *c, BL_BlockWriter_t write, void *ctx) {
+    c->write = write;
+    c->ctx = ctx;
+    c->flash_word = 1;
+    c->pad_start = 0;
+    c->pad_end = 0;
+    c->address = 0;
+    c->length = 0;
+    c->frames = 0;
+    c->bytes = 0;
+}
+
+void BL_Coalescer_SetFlashWord(BL_Coalescer_t *c, uint16_t flash_word, uint32_t start, uint32_t end) {
+    c->flash_word = flash_word;
+    c->pad_start = start;
+    c->pad_end = end;
+}
+
+static inline bool BL_Coalescer_Padded(const BL_Coalescer_t *c, uint32_t address) {
+    return c->flash_word > 1 && address >= c->pad_start && address < c->pad_end;
+}
+
+// Hand the buffered block to the writer, no-op when the buffer is empty
+BL_ITCM_CODE bool BL_Coalescer_Flush(BL_Coalescer_t *c) {
+    if (c->length == 0) {
+        return true;
+    }
+
+    // Pad up to the end of the last flash word
+    if (BL_Coalescer_Padded(c, c->address)) {
+        uint16_t pad = (uint16_t)(-(c->address + c->length) & (c->flash_word - 1));
+        memset(&c->buf[c->length], 0xFF, pad);
+        c->length += pad;
+    }
+
+    uint16_t length = c->length;
+    c->length = 0;
+    c->frames++;
+    c->bytes += length;
+    return c->write(c->ctx, c->address, c->buf, length);
+}
+
+BL_ITCM_CODE bool BL_Coalescer_Push(BL_Coalescer_t *c, uint32_t address, const uint8_t *data, uint16_t length) {
+
+    while (length > 0) {
+        // A gap (or a jump backwards) ends the current block, one that ends
+        // in the last flash word of the block is filled instead
+        uint32_t end = c->address + c->length;
+        if (c->length > 0 && address != end) {
+            if (address > end && BL_Coalescer_Padded(c, c->address) &&
+                ((address ^ (end - 1)) & ~(uint32_t)(c->flash_word - 1)) == 0) {
+                memset(&c->buf[c->length], 0xFF, address - end);
+                c->length += address - end;
+            } else if (!BL_Coalescer_Flush(c)) {
+                return false;
+            }
+        }
+        if (c->length == 0) {
+            c->address = address;
+            if (BL_Coalescer_Padded(c, address)) {
+                // From the start of its flash word
+                c->address = address & ~(uint32_t)(c->flash_word - 1);
+                c->length = address - c->address;
+                memset(c->buf, 0xFF, c->length);
+            }
+        }
+
+        // Fill up to the next aligned boundary at most
+        uint16_t room = BL_COALESCE_BLOCK_SIZE - (address & (BL_COALESCE_BLOCK_SIZE - 1));
+        uint16_t chunk = (length < room) ? length : room;
+
+        memcpy(&c->buf[c->length], data, chunk);
+        c->length += chunk;
+        address += chunk;
+        data += chunk;
+        length -= chunk;
+
+        if ((address & (BL_COALESCE_BLOCK_SIZE - 1)) == 0) {
+            if (!BL_Coalescer_Flush(c)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,212 @@
+/*
+ * bl_hex.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_hex.h"
+#include "bl_tcm.h"
+#include <string.h>
+
+// Parse errors go to the deferred log of the CM7, the CM4 has no console
+// and reports the failing line through the pipe instead
+#if defined(CORE_CM7)
+#include "bl_log.h"
+#define BL_HEX_DIAG(...) BL_LOG(__VA_ARGS__)
+#else
+#define BL_HEX_DIAG(...) ((void)0)
+#endif
+
+// Hex digit lookup. Entries are stored XORed with 0xF0, so the entries left
+// out (0) read back as 0xF0: any invalid character sets the high nibble.
+// ORing every decoded nibble of a record and testing 0xF0 once validates
+// the whole record without a branch per digit.
+#define BL_HEX_DIGIT(value) ((value) ^ 0xF0)
+static const uint8_t hex_digits[256] BL_DTCM_DATA = {
+    ['0'] = BL_HEX_DIGIT(0x0), ['1'] = BL_HEX_DIGIT(0x1), ['2'] = BL_HEX_DIGIT(0x2), ['3'] = BL_HEX_DIGIT(0x3),
+    ['4'] = BL_HEX_DIGIT(0x4), ['5'] = BL_HEX_DIGIT(0x5), ['6'] = BL_HEX_DIGIT(0x6), ['7'] = BL_HEX_DIGIT(0x7),
+    ['8'] = BL_HEX_DIGIT(0x8), ['9'] = BL_HEX_DIGIT(0x9),
+    ['A'] = BL_HEX_DIGIT(0xA), ['B'] = BL_HEX_DIGIT(0xB), ['C'] = BL_HEX_DIGIT(0xC),
+    ['D'] = BL_HEX_DIGIT(0xD), ['E'] = BL_HEX_DIGIT(0xE), ['F'] = BL_HEX_DIGIT(0xF),
+    ['a'] = BL_HEX_DIGIT(0xA), ['b'] = BL_HEX_DIGIT(0xB), ['c'] = BL_HEX_DIGIT(0xC),
+    ['d'] = BL_HEX_DIGIT(0xD), ['e'] = BL_HEX_DIGIT(0xE), ['f'] = BL_HEX_DIGIT(0xF),
+};
+
+#define BL_HEX_NIBBLE(c) (hex_digits[(uint8_t)(c)] ^ 0xF0)
+
+void BL_HexParser_Init(BL_HexParser_t *p, BL_Coalescer_t *coalescer) {
+    p->coalescer = coalescer;
+    p->base_address = 0;
+    p->start_address = 0xFFFFFFFF;
+    p->eof = false;
+    p->records = 0;
+}
+
+// Function to convert a pair of hex characters to a byte, 0 if either isn't a hex digit
+uint8_t BL_HexPairToByte(const char *hex) {
+    uint8_t high_nibble = BL_HEX_NIBBLE(hex[0]);
+    uint8_t low_nibble = BL_HEX_NIBBLE(hex[1]);
+
+    if ((high_nibble | low_nibble) & 0xF0) {
+        return 0;
+    }
+
+    return (high_nibble << 4) | low_nibble;
+}
+
+// Decode count hex pairs into out and add them to *sum. Returns the OR of
+// every nibble, which has bits in 0xF0 set if a character wasn't a digit.
+BL_ITCM_CODE static uint8_t BL_HexDecode(const char *hex, uint8_t *out, uint16_t count, uint8_t *sum) {
+    uint8_t bad = 0;
+    uint8_t s = *sum;
+
+    for (uint16_t i = 0; i < count; i++) {
+        uint8_t high_nibble = BL_HEX_NIBBLE(hex[2 * i]);
+        uint8_t low_nibble = BL_HEX_NIBBLE(hex[2 * i + 1]);
+        uint8_t byte = (uint8_t)(high_nibble << 4) | low_nibble;
+        bad |= high_nibble | low_nibble;
+        out[i] = byte;
+        s += byte;
+    }
+
+    *sum = s;
+    return bad;
+}
+
+BL_ITCM_CODE uint8_t BL_XorChecksum(uint8_t seed, const uint8_t *data, uint32_t length) {
+    uint32_t x = 0;
+
+    // Bytes up to the first word boundary, then whole words, then the tail.
+    // XOR doesn't care which byte lane a byte ends up in, the lanes are
+    // folded together at the end.
+    while (length > 0 && ((uintptr_t)data & 3) != 0) {
+        seed ^= *data++;
+        length--;
+    }
+    const uint32_t *words = (const uint32_t *)data;
+    for (uint32_t i = 0; i < length / 4; i++) {
+        x ^= words[i];
+    }
+    data += length & ~3u;
+    for (uint32_t i = 0; i < (length & 3); i++) {
+        seed ^= data[i];
+    }
+
+    x ^= x >> 16;
+    x ^= x >> 8;
+    return seed ^ (uint8_t)x;
+}
+
+// Function to parse and write a single Intel HEX line. Every field is
+// decoded once, and the checksum is summed while decoding.
+BL_ITCM_CODE bool BL_ProcessHexLine(BL_HexParser_t *p, const char *line) {
+    if (line[0] == '\0') {
+        return true; // Blank line
+    }
+    if (line[0] != ':') {
+        return false; // Line must start with ':'
+    }
+
+    // The shortest record is the header and a checksum. Checked before the
+    // header is decoded, a line like ":10" ends right in it.
+    if (strnlen(line, 11) < 11) {
+        BL_HEX_DIAG("HEX record too short\n");
+        return false;
+    }
+
+    // Byte count, address and record type
+    uint8_t head[4];
+    uint8_t sum = 0;
+    if (BL_HexDecode(&line[1], head, 4, &sum) & 0xF0) {
+        BL_HEX_DIAG("Invalid HEX record\n");
+        return false;
+    }
+    uint8_t byte_count = head[0];
+    uint16_t address = (head[1] << 8) | head[2];
+    uint8_t record_type = head[3];
+
+    // Data and checksum, the line has to hold them all. Checked up front so
+    // the decode loop never reads past the terminator.
+    size_t needed = 9 + 2 * (size_t)byte_count + 2;
+    if (strnlen(line, needed) < needed) {
+        BL_HEX_DIAG("HEX record too short\n");
+        return false;
+    }
+
+    uint8_t data[256 + 1];
+    if (BL_HexDecode(&line[9], data, byte_count + 1, &sum) & 0xF0) {
+        BL_HEX_DIAG("Invalid HEX record\n");
+        return false;
+    }
+
+    // All bytes including the checksum add up to 0
+    if (sum != 0) {
+        BL_HEX_DIAG("Checksum error\n");
+        return false;
+    }
+
+    // Process based on record type
+    switch (record_type) {
+        case 0x00: // Data record
+            p->records++;
+            return BL_Coalescer_Push(p->coalescer, p->base_address + address, data, byte_count);
+
+        case 0x01: // End-of-file record
+            p->eof = true;
+            return BL_Coalescer_Flush(p->coalescer);
+
+        case 0x04: // Extended linear address record
+            p->base_address = (data[0] << 8 | data[1]) << 16;
+            return true;
+
+        case 0x05: // Start linear address record
+            p->start_address = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+            return true;
+
+        default:
+            // Unsupported record types
+            return false;
+    }
+}
+
+/* ********************** Line splitter ****************************** */
+
+void BL_HexLines_Init(BL_HexLines_t *l, BL_HexParser_t *parser) {
+    l->parser = parser;
+    l->lines = 0;
+    l->length = 0;
+}
+
+static bool BL_HexLines_Parse(BL_HexLines_t *l) {
+    uint16_t length = l->length;
+    if (length > 0 && l->line[length - 1] == '\r') {
+        length--;
+    }
+    l->line[length] = '\0';
+    l->length = 0;
+    if (!BL_ProcessHexLine(l->parser, l->line)) {
+        return false;
+    }
+    l->lines++;
+    return true;
+}
+
+bool BL_HexLines_Feed(BL_HexLines_t *l, const char *text, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        char c = text[i];
+        if (c == '\n') {
+            if (!BL_HexLines_Parse(l)) {
+                return false;
+            }
+        } else if (l->length == BL_HEX_LINE_MAX - 1) {
+            return false;
+        } else {
+            l->line[l->length++] = c;
+        }
+    }
+    return true;
+}
+
+bool BL_HexLines_End(BL_HexLines_t *l) {
+    return l->length == 0 || BL_HexLines_Parse(l);
+}
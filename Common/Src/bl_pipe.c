@@ -0,0 +1,281 @@
+/*
+ * bl_pipe.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_pipe.h"
+#include "bl_hex.h"
+#include "stm32h7xx_hal.h"
+#include <string.h>
+
+#define BL_TEXT_MASK  (BL_PIPE_TEXT_SIZE - 1)
+#define BL_BLOCK_MASK (BL_PIPE_BLOCKS - 1)
+
+static BL_Pipe_t pipe __attribute__((section(".bl_pipe")));
+
+/* ********************** CM7: file reader and block consumer ****************************** */
+
+#if defined(CORE_CM7)
+
+#define BL_PIPE_START_TIMEOUT 100 // ms for the CM4 to accept a job
+
+// The CM4 has no data cache, the CM7 one has to be cleaned after writing
+// and invalidated before reading shared data
+static void BL_Pipe_Clean(volatile void *addr, uint32_t size) {
+    if (SCB->CCR & SCB_CCR_DC_Msk) {
+        SCB_CleanDCache_by_Addr((uint32_t *)addr, (int32_t)size);
+    }
+}
+
+static void BL_Pipe_Invalidate(volatile void *addr, uint32_t size) {
+    if (SCB->CCR & SCB_CCR_DC_Msk) {
+        SCB_InvalidateDCache_by_Addr((uint32_t *)addr, (int32_t)size);
+    }
+}
+
+static volatile BL_PipeCm4_t *BL_Pipe_Cm4(void) {
+    BL_Pipe_Invalidate(&pipe.cm4, sizeof(pipe.cm4));
+    return &pipe.cm4;
+}
+
+// Make the CM7 fields visible and wake the CM4
+static void BL_Pipe_Publish(void) {
+    __DMB();
+    BL_Pipe_Clean(&pipe.cm7, sizeof(pipe.cm7));
+    HAL_HSEM_FastTake(BL_PIPE_HSEM_ID);
+    HAL_HSEM_Release(BL_PIPE_HSEM_ID, 0);
+}
+
+void BL_Pipe_Init(void) {
+    memset(&pipe, 0, sizeof(pipe));
+    BL_Pipe_Clean(&pipe, sizeof(pipe));
+}
+
+bool BL_Pipe_Start(void) {
+    if (!BL_Pipe_Cm4()->ready) {
+        return false;
+    }
+
+    pipe.cm7.text_head = 0;
+    pipe.cm7.text_eof = 0;
+    pipe.cm7.block_tail = 0;
+    pipe.cm7.job++;
+    BL_Pipe_Publish();
+
+    uint32_t start = HAL_GetTick();
+    while (BL_Pipe_Cm4()->job != pipe.cm7.job) {
+        if (HAL_GetTick() - start > BL_PIPE_START_TIMEOUT) {
+            BL_Pipe_Abort();
+            return false;
+        }
+    }
+    return true;
+}
+
+void BL_Pipe_Abort(void) {
+    pipe.cm7.abort = pipe.cm7.job;
+    BL_Pipe_Publish();
+}
+
+uint32_t BL_Pipe_WriteText(const uint8_t *data, uint32_t length) {
+    uint32_t head = pipe.cm7.text_head;
+    uint32_t space = BL_PIPE_TEXT_SIZE - (head - BL_Pipe_Cm4()->text_tail);
+    uint32_t n = (length < space) ? length : space;
+    if (n == 0) {
+        return 0;
+    }
+
+    // At most two pieces, up to the end of the ring and from its start
+    uint32_t offset = head & BL_TEXT_MASK;
+    uint32_t first = BL_PIPE_TEXT_SIZE - offset;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(&pipe.text[offset], data, first);
+    BL_Pipe_Clean(&pipe.text[offset], first);
+    if (n > first) {
+        memcpy(pipe.text, data + first, n - first);
+        BL_Pipe_Clean(pipe.text, n - first);
+    }
+
+    pipe.cm7.text_head = head + n;
+    BL_Pipe_Publish();
+    return n;
+}
+
+void BL_Pipe_EndText(void) {
+    pipe.cm7.text_eof = 1;
+    BL_Pipe_Publish();
+}
+
+const BL_PipeBlock_t *BL_Pipe_PeekBlock(void) {
+    uint32_t tail = pipe.cm7.block_tail;
+    if (BL_Pipe_Cm4()->block_head == tail) {
+        return NULL;
+    }
+
+    BL_PipeBlock_t *b = &pipe.blocks[tail & BL_BLOCK_MASK];
+    BL_Pipe_Invalidate(b, sizeof(*b));
+    return b;
+}
+
+void BL_Pipe_ReleaseBlock(void) {
+    pipe.cm7.block_tail++;
+    BL_Pipe_Publish();
+}
+
+BL_PipeState_t BL_Pipe_State(void) {
+    return (BL_PipeState_t)BL_Pipe_Cm4()->state;
+}
+
+uint32_t BL_Pipe_StartAddress(void) {
+    return BL_Pipe_Cm4()->start_address;
+}
+
+uint32_t BL_Pipe_Records(void) {
+    return BL_Pipe_Cm4()->records;
+}
+
+uint32_t BL_Pipe_ErrorLine(void) {
+    return BL_Pipe_Cm4()->error_line;
+}
+
+#endif /* CORE_CM7 */
+
+/* ********************** CM4: HEX parser ****************************** */
+
+#if defined(CORE_CM4)
+
+static volatile bool kicked;  // HSEM notification since the last sleep
+static uint32_t job;          // job being parsed
+
+// The HAL disarms the notification before calling back, arm it again
+void HAL_HSEM_FreeCallback(uint32_t SemMask) {
+    kicked = true;
+    HAL_HSEM_ActivateNotification(SemMask);
+}
+
+// Sleep until the CM7 touches the pipe. A pending interrupt still ends WFI
+// with PRIMASK set, so a kick between the caller's check and here isn't lost.
+static void BL_Pipe_Sleep(void) {
+    __disable_irq();
+    if (!kicked) {
+        __WFI();
+    }
+    kicked = false;
+    __enable_irq();
+}
+
+static bool BL_Pipe_Aborted(void) {
+    return pipe.cm7.job != job || pipe.cm7.abort == job;
+}
+
+// Coalescer sink, hands a finished block to the CM7
+static bool BL_Pipe_PushBlock(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    uint32_t head = pipe.cm4.block_head;
+
+    while (head - pipe.cm7.block_tail == BL_PIPE_BLOCKS) {
+        if (BL_Pipe_Aborted()) {
+            return false;
+        }
+        BL_Pipe_Sleep();
+    }
+
+    BL_PipeBlock_t *b = &pipe.blocks[head & BL_BLOCK_MASK];
+    b->address = address;
+    b->length = length;
+    memcpy(b->data, data, length);
+    __DMB();
+    pipe.cm4.block_head = head + 1;
+    return true;
+}
+
+static BL_PipeState_t BL_Pipe_Fail(uint32_t line) {
+    pipe.cm4.error_line = line;
+    return BL_Pipe_Aborted() ? BL_PIPE_IDLE : BL_PIPE_ERROR;
+}
+
+static BL_PipeState_t BL_Pipe_Parse(void) {
+    static BL_Coalescer_t coalescer;
+    static BL_HexParser_t parser;
+    static BL_HexLines_t lines;
+    uint32_t tail = 0;
+
+    BL_Coalescer_Init(&coalescer, BL_Pipe_PushBlock, NULL);
+    BL_HexParser_Init(&parser, &coalescer);
+    BL_HexLines_Init(&lines, &parser);
+
+    while (true) {
+        if (BL_Pipe_Aborted()) {
+            return BL_PIPE_IDLE;
+        }
+
+        // eof before head, the CM7 sets it after the last text
+        bool eof = pipe.cm7.text_eof;
+        __DMB();
+        uint32_t head = pipe.cm7.text_head;
+        if (head == tail) {
+            if (eof) {
+                break;
+            }
+            BL_Pipe_Sleep();
+            continue;
+        }
+
+        // Up to the end of the ring and from its start
+        while (tail != head) {
+            uint32_t offset = tail & BL_TEXT_MASK;
+            uint32_t n = BL_PIPE_TEXT_SIZE - offset;
+            if (n > head - tail) {
+                n = head - tail;
+            }
+            if (!BL_HexLines_Feed(&lines, (const char *)&pipe.text[offset], n)) {
+                return BL_Pipe_Fail(lines.lines + 1);
+            }
+            tail += n;
+        }
+        pipe.cm4.text_tail = tail;
+    }
+
+    if (!BL_HexLines_End(&lines)) {
+        return BL_Pipe_Fail(lines.lines + 1);
+    }
+    if (!BL_Coalescer_Flush(&coalescer)) {
+        return BL_Pipe_Fail(lines.lines);
+    }
+
+    pipe.cm4.start_address = parser.start_address;
+    pipe.cm4.records = parser.records;
+    __DMB();
+    return BL_PIPE_DONE;
+}
+
+void BL_Pipe_Worker(void) {
+    HAL_NVIC_SetPriority(HSEM2_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(HSEM2_IRQn);
+    HAL_HSEM_ActivateNotification(__HAL_HSEM_SEMID_TO_MASK(BL_PIPE_HSEM_ID));
+
+    job = pipe.cm7.job;
+    pipe.cm4.ready = 1;
+
+    while (true) {
+        while (pipe.cm7.job == job) {
+            BL_Pipe_Sleep();
+        }
+
+        job = pipe.cm7.job;
+        pipe.cm4.state = BL_PIPE_BUSY;
+        pipe.cm4.text_tail = 0;
+        pipe.cm4.block_head = 0;
+        pipe.cm4.start_address = 0xFFFFFFFF;
+        pipe.cm4.records = 0;
+        pipe.cm4.error_line = 0;
+        __DMB();
+        pipe.cm4.job = job;
+
+        pipe.cm4.state = BL_Pipe_Parse();
+    }
+}
+
+#endif /* CORE_CM4 */
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Summarise flashing benchmark runs and check them against a baseline.
+
+Reads the JSON lines printed by BL_Bench_Run (the output of _host/bl_bench or
+a capture of the USART1 console, other lines are skipped) and prints one
+row per run with the throughput and the phase breakdown.
+
+    python3 tools/bl_bench_compare.py bench.log
+    python3 tools/bl_bench_compare.py bench.log --baseline tools/bench/baseline_sim.json
+    python3 tools/bl_bench_compare.py bench.log --save tools/bench/baseline_sim.json
+
+With --baseline the exit status is 1 if a run failed or got slower than the
+baseline by more than the tolerance, in total or in one phase. Phases below
+--min-us in both runs are not compared, they are noise. Baseline runs that
+are not in the log (a run with --max-size or fewer rates) are only counted.
+"""
+
+import argparse
+import json
+import sys
+
+PHASES = ["sd_read", "parse", "erase", "program", "verify", "other"]
+
+
+def read_runs(lines):
+    """Yield the result objects found in lines."""
+    for line in lines:
+        start = line.find('{"bench"')
+        if start < 0:
+            continue
+        try:
+            run = json.loads(line[start:])
+        except ValueError:
+            continue
+        yield run
+
+
+def key(run):
+    return (run["target"], run["baud"], run["bench"], run["cache"])
+
+
+def key_name(k):
+    return "%s@%d %s/%s" % k
+
+
+def print_runs(runs):
+    print("%-36s %3s %9s %9s  %s" % ("run", "ok", "ms", "B/s", " ".join("%8s" % p for p in PHASES)))
+    for k in sorted(runs):
+        run = runs[k]
+        phases = run["phases_us"]
+        print("%-36s %3s %9.1f %9d  %s" % (
+            key_name(k), "yes" if run["ok"] else "NO", run["total_us"] / 1000.0,
+            run["bytes_per_s"], " ".join("%8.1f" % (phases.get(p, 0) / 1000.0) for p in PHASES)))
+
+
+def compare(runs, baseline, tolerance, min_us):
+    """Regressions of runs against baseline as lines of text, and the
+    number of runs compared."""
+    problems = []
+    compared = 0
+    for k in sorted(baseline):
+        base = baseline[k]
+        run = runs.get(k)
+        if run is None:
+            continue
+        compared += 1
+        if not run["ok"]:
+            problems.append("%s: failed" % key_name(k))
+            continue
+        limit = base["total_us"] * (1 + tolerance)
+        if run["total_us"] > limit:
+            problems.append("%s: total %.1f ms, baseline %.1f ms (+%.0f%%)" % (
+                key_name(k), run["total_us"] / 1000.0, base["total_us"] / 1000.0,
+                100.0 * (run["total_us"] - base["total_us"]) / base["total_us"]))
+        for phase in PHASES:
+            was = base["phases_us"].get(phase, 0)
+            now = run["phases_us"].get(phase, 0)
+            if max(was, now) < min_us:
+                continue
+            if now > was * (1 + tolerance) + min_us:
+                problems.append("%s: %s %.1f ms, baseline %.1f ms" % (
+                    key_name(k), phase, now / 1000.0, was / 1000.0))
+    return problems, compared
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", help="bench output, stdin if omitted")
+    parser.add_argument("--baseline", help="baseline file to compare against")
+    parser.add_argument("--save", help="write the runs as a new baseline file")
+    parser.add_argument("--tolerance", type=float, default=0.10, help="allowed slowdown (0.10)")
+    parser.add_argument("--min-us", type=int, default=5000, help="smallest phase time compared (5000)")
+    args = parser.parse_args()
+
+    source = open(args.log) if args.log else sys.stdin
+    with source:
+        runs = {key(run): run for run in read_runs(source)}
+
+    if not runs:
+        print("no benchmark results found", file=sys.stderr)
+        return 1
+    print_runs(runs)
+
+    if args.save:
+        with open(args.save, "w") as out:
+            out.write("[\n")
+            out.write(",\n".join(json.dumps(runs[k], sort_keys=True) for k in sorted(runs)))
+            out.write("\n]\n")
+        print("saved %d runs to %s" % (len(runs), args.save))
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = {key(run): run for run in json.load(f)}
+        problems, compared = compare(runs, baseline, args.tolerance, args.min_us)
+        for line in problems:
+            print("REGRESSION " + line)
+        print("%d of %d baseline runs compared against %s, %d regressions" % (
+            compared, len(baseline), args.baseline, len(problems)))
+        return 1 if problems else 0
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
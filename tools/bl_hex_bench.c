@@ -0,0 +1,290 @@
+/*
+ * bl_hex_bench.c
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Host micro-benchmark of the HEX decoder in Common/Src/bl_hex.c against the
+ * byte-at-a-time decoder it replaced, on real HEX files:
+ *
+ *     cc -O2 -ICommon/Inc -o bl_hex_bench tools/bl_hex_bench.c \
+ *         Common/Src/bl_hex.c Common/Src/bl_coalesce.c
+ *     ./bl_hex_bench firmware.hex [more.hex ...]
+ *
+ * Every file is read into memory first, split into lines and parsed a few
+ * times with each decoder, the best pass counts. Both decoders feed the
+ * same coalescer, so the figures include the block handling the firmware
+ * does too. The blocks of both are hashed and have to match. The XOR
+ * checksum of the Write Memory frames is timed the same way, byte loop
+ * against BL_XorChecksum.
+ *
+ * Cycles come from the TSC on x86 and are only comparable on the same host,
+ * they are not Cortex-M7 cycles.
+ */
+
+#include "bl_hex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_CYCLES() 0ULL
+#endif
+
+#define BENCH_PASSES 20
+
+/* ********************** Previous decoder ****************************** */
+
+static uint8_t legacy_nibble(char hex) {
+    if (hex >= '0' && hex <= '9') {
+        return hex - '0';
+    } else if (hex >= 'a' && hex <= 'f') {
+        return hex - 'a' + 10;
+    } else if (hex >= 'A' && hex <= 'F') {
+        return hex - 'A' + 10;
+    } else {
+        return 0xFF;
+    }
+}
+
+static uint8_t legacy_pair(const char *hex) {
+    uint8_t high_nibble = legacy_nibble(hex[0]);
+    uint8_t low_nibble = legacy_nibble(hex[1]);
+    if (high_nibble == 0xFF || low_nibble == 0xFF) {
+        return 0;
+    }
+    return (high_nibble << 4) | low_nibble;
+}
+
+static bool legacy_line(BL_HexParser_t *p, const char *line) {
+    if (line[0] != ':') {
+        return false;
+    }
+    uint8_t byte_count = legacy_pair(&line[1]);
+    uint16_t address = (legacy_pair(&line[3]) << 8) | legacy_pair(&line[5]);
+    uint8_t record_type = legacy_pair(&line[7]);
+
+    uint8_t data[256];
+    for (uint8_t i = 0; i < byte_count; i++) {
+        data[i] = legacy_pair(&line[9 + i * 2]);
+    }
+    uint8_t checksum = 0;
+    for (int i = 1; i < 9 + byte_count * 2; i += 2) {
+        checksum += legacy_pair(&line[i]);
+    }
+    checksum = ~checksum + 1;
+    if (checksum != legacy_pair(&line[9 + byte_count * 2])) {
+        return false;
+    }
+
+    switch (record_type) {
+        case 0x00:
+            return BL_Coalescer_Push(p->coalescer, p->base_address + address, data, byte_count);
+        case 0x01:
+            p->eof = true;
+            return BL_Coalescer_Flush(p->coalescer);
+        case 0x04:
+            p->base_address = (data[0] << 8 | data[1]) << 16;
+            return true;
+        case 0x05:
+            p->start_address = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint8_t legacy_xor(uint8_t seed, const uint8_t *data, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        seed ^= data[i];
+    }
+    return seed;
+}
+
+/* ********************** Harness ****************************** */
+
+typedef bool (*LineParser_t)(BL_HexParser_t *p, const char *line);
+
+typedef struct {
+    uint64_t hash;      // FNV-1a over address and data of every block
+    uint32_t blocks;
+} Sink_t;
+
+typedef struct {
+    double ns;
+    uint64_t cycles;
+} Timing_t;
+
+static bool sink_block(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    Sink_t *s = ctx;
+    uint64_t h = s->hash;
+    for (int i = 0; i < 4; i++) {
+        h = (h ^ ((address >> (8 * i)) & 0xFF)) * 0x100000001B3ULL;
+    }
+    for (uint16_t i = 0; i < length; i++) {
+        h = (h ^ data[i]) * 0x100000001B3ULL;
+    }
+    s->hash = h;
+    s->blocks++;
+    return true;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Best of BENCH_PASSES over every line, false if a line is rejected
+static bool run_parser(LineParser_t parse, char **lines, size_t count, Sink_t *sink, Timing_t *best) {
+    static BL_Coalescer_t coalescer;
+    BL_HexParser_t parser;
+
+    best->ns = 1e30;
+    best->cycles = ~0ULL;
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        memset(sink, 0, sizeof(*sink));
+        sink->hash = 0xCBF29CE484222325ULL;
+        BL_Coalescer_Init(&coalescer, sink_block, sink);
+        BL_HexParser_Init(&parser, &coalescer);
+
+        double t0 = now_ns();
+        uint64_t c0 = BENCH_CYCLES();
+        for (size_t i = 0; i < count; i++) {
+            if (!parse(&parser, lines[i])) {
+                fprintf(stderr, "line %zu rejected: %s\n", i + 1, lines[i]);
+                return false;
+            }
+        }
+        BL_Coalescer_Flush(&coalescer);
+        uint64_t cycles = BENCH_CYCLES() - c0;
+        double ns = now_ns() - t0;
+
+        if (ns < best->ns) {
+            best->ns = ns;
+        }
+        if (cycles < best->cycles) {
+            best->cycles = cycles;
+        }
+    }
+    return true;
+}
+
+static void run_xor(uint8_t (*xor)(uint8_t, const uint8_t *, uint32_t), const uint8_t *data, size_t size,
+                    uint8_t *result, Timing_t *best) {
+    best->ns = 1e30;
+    best->cycles = ~0ULL;
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        uint8_t x = 0;
+        double t0 = now_ns();
+        uint64_t c0 = BENCH_CYCLES();
+        // Write Memory sized frames, like BL_WriteMemory sees them
+        for (size_t offset = 0; offset < size; offset += BL_COALESCE_BLOCK_SIZE) {
+            size_t length = size - offset < BL_COALESCE_BLOCK_SIZE ? size - offset : BL_COALESCE_BLOCK_SIZE;
+            x ^= xor((uint8_t)(length - 1), data + offset, length);
+        }
+        uint64_t cycles = BENCH_CYCLES() - c0;
+        double ns = now_ns() - t0;
+        *result = x;
+        if (ns < best->ns) {
+            best->ns = ns;
+        }
+        if (cycles < best->cycles) {
+            best->cycles = cycles;
+        }
+    }
+}
+
+static void print_timing(const char *name, const Timing_t *t, size_t bytes) {
+    printf("  %-10s %9.3f ms  %6.2f ns/byte", name, t->ns / 1e6, t->ns / bytes);
+    if (t->cycles != 0) {
+        printf("  %6.2f cycles/byte", (double)t->cycles / bytes);
+    }
+    printf("\n");
+}
+
+// Read a whole file and cut it into NUL terminated lines without line endings
+static char *load_lines(const char *path, char ***lines, size_t *count, size_t *bytes) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *text = malloc(size + 1);
+    if (text == NULL || fread(text, 1, size, f) != (size_t)size) {
+        fclose(f);
+        free(text);
+        return NULL;
+    }
+    fclose(f);
+    text[size] = '\0';
+
+    size_t capacity = 1024;
+    *lines = malloc(capacity * sizeof(char *));
+    *count = 0;
+    *bytes = size;
+    for (char *line = strtok(text, "\r\n"); line != NULL; line = strtok(NULL, "\r\n")) {
+        if (*count == capacity) {
+            capacity *= 2;
+            *lines = realloc(*lines, capacity * sizeof(char *));
+        }
+        (*lines)[(*count)++] = line;
+    }
+    return text;
+}
+
+static bool bench_file(const char *path) {
+    char **lines;
+    size_t count, bytes;
+    char *text = load_lines(path, &lines, &count, &bytes);
+    if (text == NULL) {
+        return false;
+    }
+
+    Sink_t old_sink, new_sink;
+    Timing_t old_time, new_time;
+    bool ok = run_parser(legacy_line, lines, count, &old_sink, &old_time) &&
+              run_parser(BL_ProcessHexLine, lines, count, &new_sink, &new_time);
+
+    printf("%s: %zu lines, %zu bytes\n", path, count, bytes);
+    if (ok) {
+        print_timing("previous", &old_time, bytes);
+        print_timing("table", &new_time, bytes);
+        printf("  speedup    %.2fx, %u blocks, output %s\n", old_time.ns / new_time.ns, new_sink.blocks,
+               (old_sink.hash == new_sink.hash && old_sink.blocks == new_sink.blocks) ? "identical" : "DIFFERS");
+        ok = old_sink.hash == new_sink.hash && old_sink.blocks == new_sink.blocks;
+    }
+
+    // The XOR only needs bytes, the file contents do
+    uint8_t old_xor, new_xor;
+    run_xor(legacy_xor, (const uint8_t *)text, bytes, &old_xor, &old_time);
+    run_xor(BL_XorChecksum, (const uint8_t *)text, bytes, &new_xor, &new_time);
+    printf("  XOR checksum of %zu bytes in 256 byte frames\n", bytes);
+    print_timing("byte", &old_time, bytes);
+    print_timing("word", &new_time, bytes);
+    printf("  speedup    %.2fx, result %s\n", old_time.ns / new_time.ns, old_xor == new_xor ? "identical" : "DIFFERS");
+    ok = ok && old_xor == new_xor;
+
+    free(lines);
+    free(text);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s file.hex [file.hex ...]\n", argv[0]);
+        return 2;
+    }
+
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+        ok = bench_file(argv[i]) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""Report what the CM7 image places in ITCM and DTCM, and what it gained.
+
+Reads the linker map of the CM7 build (CubeIDE writes it next to the ELF)
+and lists the .itcm_text, .dtcm_data and .dtcm_bss input sections per
+object with their size, the global symbols in them and how full each
+memory is. With --elf the symbols come from nm instead, which also shows
+the static functions the map leaves out.
+
+    python3 tools/bl_tcm_report.py CM7/Debug/stm32-programmer_CM7.map
+    python3 tools/bl_tcm_report.py CM7/Debug/stm32-programmer_CM7.map --elf CM7/Debug/stm32-programmer_CM7.elf
+    python3 tools/bl_tcm_report.py CM7/Debug/stm32-programmer_CM7.map --before flash.log --after tcm.log
+
+--before and --after take console captures of two builds, with the parse
+self-check (PERFORMANCE_PROFILE) and/or benchmark runs (BENCHMARK) in them,
+and print how the cycle counts and phase times changed.
+
+Still open: no before/after capture from the board exists yet, so the gain
+of the placement is unmeasured. The parse self-check covers BL_ProcessHexLine
+(with the coalescer and CRC feed behind it); BL_XorChecksum and
+BL_Transport_SendV only show up inside the benchmark phases and need their
+own DWT brackets for per-function numbers.
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+from bl_bench_compare import key, key_name, read_runs
+
+SECTIONS = {".itcm_text": "ITCMRAM", ".dtcm_data": "DTCMRAM", ".dtcm_bss": "DTCMRAM"}
+MEMORIES = ["ITCMRAM", "DTCMRAM"]
+
+HEX = r"0x[0-9a-fA-F]+"
+MEMORY_LINE = re.compile(r"^(\w+)\s+(%s)\s+(%s)" % (HEX, HEX))
+OUTPUT_SECTION = re.compile(r"^(\.\S+)(?:\s+(%s)\s+(%s))?" % (HEX, HEX))
+INPUT_SECTION = re.compile(r"^ (\.\S+)(?:\s+(%s)\s+(%s)\s+(\S.*))?$" % (HEX, HEX))
+INPUT_CONTINUED = re.compile(r"^\s+(%s)\s+(%s)\s+(\S.*)$" % (HEX, HEX))
+SYMBOL = re.compile(r"^\s+(%s)\s+([A-Za-z_]\w*)$" % HEX)
+
+PERF_LINE = re.compile(r"Parse benchmark: (\d+) bytes of HEX in (\d+) cycles")
+
+
+def read_map(lines):
+    """Memory sizes and the TCM input sections of a GNU ld map file.
+
+    Returns ({memory: (origin, length)}, [{section, object, address, size,
+    symbols}]) for the output sections in SECTIONS."""
+    memories = {}
+    inputs = []
+    in_memory_table = False
+    output = None
+    pending = None  # input section whose address is on the next line
+
+    for line in lines:
+        line = line.rstrip("\n")
+        if line.startswith("Memory Configuration"):
+            in_memory_table = True
+            continue
+        if in_memory_table:
+            if line.startswith("Linker script and memory map"):
+                in_memory_table = False
+            m = MEMORY_LINE.match(line)
+            if m:
+                memories[m.group(1)] = (int(m.group(2), 16), int(m.group(3), 16))
+            continue
+
+        m = OUTPUT_SECTION.match(line)
+        if m:
+            output = m.group(1) if m.group(1) in SECTIONS else None
+            pending = None
+            continue
+        if output is None:
+            continue
+
+        m = INPUT_SECTION.match(line)
+        if m:
+            pending = None
+            if m.group(2) is None:
+                pending = m.group(1)
+            elif int(m.group(3), 16) > 0:
+                inputs.append({"section": output, "object": m.group(4), "address": int(m.group(2), 16),
+                               "size": int(m.group(3), 16), "symbols": []})
+            continue
+        if pending is not None:
+            m = INPUT_CONTINUED.match(line)
+            if m and int(m.group(2), 16) > 0:
+                inputs.append({"section": output, "object": m.group(3), "address": int(m.group(1), 16),
+                               "size": int(m.group(2), 16), "symbols": []})
+            pending = None
+            continue
+
+        m = SYMBOL.match(line)
+        if m and inputs and inputs[-1]["section"] == output:
+            # Linker script assignments (_sitcm = .) carry an '=' and never match
+            inputs[-1]["symbols"].append(m.group(2))
+
+    return memories, inputs
+
+
+def read_nm(elf, inputs):
+    """Replace the map symbols with every symbol nm finds in each input section."""
+    nm = os.environ.get("NM", "arm-none-eabi-nm")
+    try:
+        out = subprocess.run([nm, "-S", "-n", elf], check=True, capture_output=True, text=True).stdout
+    except (OSError, subprocess.CalledProcessError) as e:
+        print("nm failed (%s), keeping the map symbols" % e, file=sys.stderr)
+        return
+    for item in inputs:
+        item["symbols"] = []
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) != 4:
+            continue
+        address, size, name = int(fields[0], 16), int(fields[1], 16), fields[3]
+        for item in inputs:
+            if item["address"] <= address < item["address"] + item["size"]:
+                item["symbols"].append("%s(%d)" % (name, size))
+                break
+
+
+def print_placement(memories, inputs):
+    for memory in MEMORIES:
+        items = [i for i in inputs if SECTIONS[i["section"]] == memory]
+        used = sum(i["size"] for i in items)
+        origin, length = memories.get(memory, (0, 0))
+        share = " (%.1f%%)" % (100.0 * used / length) if length else ""
+        print("%-8s 0x%08x  %d of %d bytes%s" % (memory, origin, used, length, share))
+        for item in sorted(items, key=lambda i: i["address"]):
+            print("  %-11s 0x%08x %6d  %-28s %s" % (
+                item["section"], item["address"], item["size"], os.path.basename(item["object"]),
+                " ".join(item["symbols"])))
+    if not inputs:
+        print("nothing placed in ITCM or DTCM (no BL_ITCM_CODE/BL_DTCM_* in this build?)")
+
+
+def read_log(path):
+    """Parse self-check cycles (the last one) and benchmark runs of a console capture."""
+    cycles = None
+    with open(path, errors="replace") as f:
+        lines = f.readlines()
+    for line in lines:
+        m = PERF_LINE.search(line)
+        if m:
+            cycles = (int(m.group(1)), int(m.group(2)))
+    return cycles, {key(run): run for run in read_runs(lines)}
+
+
+def change(was, now):
+    return "%+.1f%%" % (100.0 * (now - was) / was) if was else "n/a"
+
+
+def print_gains(before, after):
+    cycles_before, runs_before = read_log(before)
+    cycles_after, runs_after = read_log(after)
+
+    if cycles_before and cycles_after:
+        print("parse self-check: %d -> %d cycles for %d bytes (%s), %.2f -> %.2f cycles/byte" % (
+            cycles_before[1], cycles_after[1], cycles_after[0], change(cycles_before[1], cycles_after[1]),
+            cycles_before[1] / cycles_before[0], cycles_after[1] / cycles_after[0]))
+    else:
+        print("parse self-check: not in both logs")
+
+    common = sorted(set(runs_before) & set(runs_after))
+    for k in common:
+        was, now = runs_before[k], runs_after[k]
+        parts = ["total %.1f -> %.1f ms (%s)" % (was["total_us"] / 1000.0, now["total_us"] / 1000.0,
+                                                 change(was["total_us"], now["total_us"]))]
+        for phase in ("parse", "program", "verify"):
+            a = was["phases_us"].get(phase, 0)
+            b = now["phases_us"].get(phase, 0)
+            parts.append("%s %.1f -> %.1f ms (%s)" % (phase, a / 1000.0, b / 1000.0, change(a, b)))
+        print("%-36s %s" % (key_name(k), ", ".join(parts)))
+    if not common:
+        print("benchmark runs: none in both logs")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map", help="linker map of the CM7 image")
+    parser.add_argument("--elf", help="ELF of the same build, symbols through nm ($NM)")
+    parser.add_argument("--before", help="console capture of the build without TCM placement")
+    parser.add_argument("--after", help="console capture of the build with TCM placement")
+    args = parser.parse_args()
+
+    with open(args.map, errors="replace") as f:
+        memories, inputs = read_map(f)
+    if args.elf:
+        read_nm(args.elf, inputs)
+    print_placement(memories, inputs)
+
+    if args.before or args.after:
+        if not (args.before and args.after):
+            parser.error("--before and --after go together")
+        print()
+        print_gains(args.before, args.after)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
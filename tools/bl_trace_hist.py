@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Latency histograms from a bootloader trace dump.
+
+Reads the CSV written by BL_Trace_Dump (a capture of the USART1 console is
+fine, lines that are not part of the dump are skipped) and prints per
+command and phase the count, percentiles and a log2 histogram in us.
+
+    python3 tools/bl_trace_hist.py console.log
+    python3 tools/bl_trace_hist.py < console.log
+"""
+
+import argparse
+import csv
+import sys
+from collections import defaultdict
+
+COMMANDS = {
+    0x00: "GET",
+    0x01: "GET_VERSION",
+    0x02: "GET_ID",
+    0x11: "READ",
+    0x21: "GO",
+    0x31: "WRITE",
+    0x43: "ERASE",
+    0x44: "EXT_ERASE",
+    0xA1: "CHECKSUM",
+}
+PHASES = ["cmd_ack", "addr_ack", "payload", "deferred", "final_ack"]
+FIELDS = ["seq", "cmd", "phase", "cycles", "us", "ok"]
+
+
+def read_dump(lines):
+    """Yield (cmd, phase, cycles, us, ok) for every row of the dump."""
+    mhz = 0
+    for row in csv.reader(lines):
+        if not row:
+            continue
+        if row[0].startswith("# trace"):
+            # "# trace <lost> lost, <mhz> MHz"
+            try:
+                mhz = int(row[1].split()[0])
+            except (IndexError, ValueError):
+                mhz = 0
+            continue
+        if len(row) != len(FIELDS) or row[0] == "seq":
+            continue
+        try:
+            cmd = int(row[1], 16)
+            cycles = int(row[3])
+            ok = row[5].strip() == "1"
+        except ValueError:
+            continue
+        us = cycles / mhz if mhz else float(row[4])
+        yield cmd, row[2], cycles, us, ok
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    k = min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))
+    return values[k]
+
+
+def histogram(values, width):
+    """Buckets of powers of two in us, bar length relative to the largest."""
+    buckets = defaultdict(int)
+    for v in values:
+        b = 0
+        while (1 << b) < v:
+            b += 1
+        buckets[b] += 1
+    peak = max(buckets.values())
+    lines = []
+    for b in range(min(buckets), max(buckets) + 1):
+        n = buckets.get(b, 0)
+        lo = 0 if b == 0 else (1 << (b - 1))
+        bar = "#" * (n * width // peak if n else 0)
+        lines.append("    %8d..%-8d us %7d %s" % (lo, 1 << b, n, bar))
+    return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dump", nargs="?", help="capture file, stdin if omitted")
+    parser.add_argument("--width", type=int, default=50, help="longest bar in characters")
+    args = parser.parse_args()
+
+    source = open(args.dump, newline="") if args.dump else sys.stdin
+    with source:
+        samples = defaultdict(list)
+        failed = defaultdict(int)
+        for cmd, phase, _cycles, us, ok in read_dump(source):
+            samples[(cmd, phase)].append(us)
+            if not ok:
+                failed[(cmd, phase)] += 1
+
+    if not samples:
+        print("no trace rows found", file=sys.stderr)
+        return 1
+
+    order = {p: i for i, p in enumerate(PHASES)}
+    for key in sorted(samples, key=lambda k: (k[0], order.get(k[1], len(PHASES)))):
+        cmd, phase = key
+        values = sorted(samples[key])
+        total = sum(values)
+        print("%s %s: n=%d failed=%d total=%.0f us" % (
+            COMMANDS.get(cmd, "0x%02x" % cmd), phase, len(values), failed[key], total))
+        print("    min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f us" % (
+            values[0], percentile(values, 50), percentile(values, 90),
+            percentile(values, 99), values[-1]))
+        for line in histogram(values, args.width):
+            print(line)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,186 @@
+/*
+ * bl_bench_host.c
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Runs the flashing benchmark of bl_bench.c against the ROM bootloader
+ * model, once per line rate. The generated HEX files go to --root, which
+ * plays the SD card. Every run prints one JSON line between the usual
+ * upload output, tools/bl_bench_compare.py picks them out:
+ *
+ *     tools/host/build.sh
+ *     _host/bl_bench > bench.log
+ *     _host/bl_bench --baud 115200,460800 --max-size 65536 --latency-us 200
+ *     python3 tools/bl_bench_compare.py bench.log --baseline tools/bench/baseline_sim.json
+ *
+ * The model flash is 2 MiB of 2 KiB sectors so the largest scenarios fit,
+ * and a fresh model is started for every rate.
+ */
+
+#include "bootloader.h"
+#include "bl_bench.h"
+#include "bl_device.h"
+#include "bl_sim_rom.h"
+#include "bl_transport_fd.h"
+#include "ff.h"
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define BENCH_DEFAULT_BAUDS "115200,460800,2000000"
+#define BENCH_DEFAULT_ROOT  "_host/bench"
+#define BENCH_SECTORS       1024
+
+static BL_Transport_t host_link;
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --root DIR        directory for the generated HEX files (" BENCH_DEFAULT_ROOT ")\n"
+            "  --baud LIST       comma separated line rates (" BENCH_DEFAULT_BAUDS ")\n"
+            "  --max-size N      only scenarios up to N data bytes\n"
+            "  --only NAME       only this scenario\n"
+            "  --target LABEL    name of the target in the JSON (sim)\n"
+            "  --list            print the scenarios and exit\n"
+            "model options:\n"
+            "  --latency-us N    delay before every ACK/NACK\n"
+            "  --erase-ms N      per sector erase time\n"
+            "  --program-us N    per Write Memory program time\n"
+            "  --legacy-erase    offer Erase (0x43) instead of Extended Erase\n"
+            "  --no-checksum     don't offer Get Checksum, verify reads back\n",
+            name);
+}
+
+// Child side of the socketpair, serves until the bench closes its end
+static int run_model(int fd, const BL_SimConfig_t *cfg) {
+    BL_Sim_t sim;
+    if (!BL_Sim_Init(&sim, cfg)) {
+        return 1;
+    }
+    while (BL_Sim_Run(&sim, fd)) {
+        BL_Sim_Reset(&sim);
+    }
+    BL_Sim_Report(&sim, stderr);
+    BL_Sim_Free(&sim);
+    return 0;
+}
+
+// Every scenario (or only the named one) against a fresh model at one rate
+static bool run_rate(const BL_SimConfig_t *cfg, const char *target, const char *only, uint32_t max_size) {
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+        perror("socketpair");
+        return false;
+    }
+    fflush(stdout);
+    pid_t model = fork();
+    if (model == 0) {
+        close(pair[0]);
+        exit(run_model(pair[1], cfg));
+    }
+    close(pair[1]);
+
+    bool ok = BL_TransportFd_Init(&host_link, pair[0], cfg->baudrate);
+    if (ok) {
+        BL_SetTransport(&host_link);
+        ok = BL_InitBootloader();
+        if (!ok) {
+            printf("No answer from the bootloader at %lu baud\n", (unsigned long)cfg->baudrate);
+        }
+    }
+    if (ok && only != NULL) {
+        const BL_BenchScenario_t *s;
+        for (uint8_t i = 0; (s = BL_Bench_Scenario(i)) != NULL; i++) {
+            if (strcmp(s->name, only) == 0) {
+                ok = BL_Bench_Run(s, target);
+                break;
+            }
+        }
+        if (s == NULL) {
+            printf("No scenario %s\n", only);
+            ok = false;
+        }
+    } else if (ok) {
+        ok = BL_Bench_RunSuite(target, max_size);
+    }
+
+    close(pair[0]);
+    waitpid(model, NULL, 0);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    static const struct option options[] = {
+        {"root", required_argument, NULL, 'r'},
+        {"baud", required_argument, NULL, 'b'},
+        {"max-size", required_argument, NULL, 'm'},
+        {"only", required_argument, NULL, 'o'},
+        {"target", required_argument, NULL, 't'},
+        {"list", no_argument, NULL, 'i'},
+        {"latency-us", required_argument, NULL, 'L'},
+        {"erase-ms", required_argument, NULL, 'e'},
+        {"program-us", required_argument, NULL, 'P'},
+        {"legacy-erase", no_argument, NULL, 'E'},
+        {"no-checksum", no_argument, NULL, 'C'},
+        {NULL, 0, NULL, 0},
+    };
+    BL_SimConfig_t cfg = BL_SIM_DEFAULT_CONFIG;
+    const char *root = BENCH_DEFAULT_ROOT;
+    char bauds[128] = BENCH_DEFAULT_BAUDS;
+    const char *only = NULL;
+    const char *target = "sim";
+    uint32_t max_size = 0;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+        case 'r': root = optarg; break;
+        case 'b': snprintf(bauds, sizeof(bauds), "%s", optarg); break;
+        case 'm': max_size = strtoul(optarg, NULL, 0); break;
+        case 'o': only = optarg; break;
+        case 't': target = optarg; break;
+        case 'i':
+            for (uint8_t i = 0; BL_Bench_Scenario(i) != NULL; i++) {
+                const BL_BenchScenario_t *s = BL_Bench_Scenario(i);
+                printf("%-16s %8u bytes, %u byte records%s\n", s->name, s->size, s->record_len,
+                       s->warm ? ", cold + warm" : "");
+            }
+            return 0;
+        case 'L': cfg.latency_us = strtoul(optarg, NULL, 0); break;
+        case 'e': cfg.erase_ms = strtoul(optarg, NULL, 0); break;
+        case 'P': cfg.program_us = strtoul(optarg, NULL, 0); break;
+        case 'E': cfg.extended_erase = false; break;
+        case 'C': cfg.get_checksum = false; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    setvbuf(stdout, NULL, _IOLBF, 0); // results show up while the suite runs
+    mkdir(root, 0777);
+    FF_Posix_SetRoot(root);
+
+    // The engine takes the geometry of the model, not that of the part its
+    // product ID names
+    cfg.sector_count = BENCH_SECTORS;
+    BL_Device_t model_device = {
+        .pid = cfg.pid, .name = "ROM model", .layout = {cfg.flash_base, 1, {{cfg.sector_size, cfg.sector_count}}},
+        .flash_word = 8, .erase = {cfg.erase_ms, cfg.mass_erase_ms, 2}, .program_ms = 450,
+    };
+    BL_Device_Pin(&model_device);
+
+    bool ok = true;
+    for (char *rate = strtok(bauds, ","); rate != NULL; rate = strtok(NULL, ",")) {
+        cfg.baudrate = strtoul(rate, NULL, 0);
+        ok = run_rate(&cfg, target, only, max_size) && ok;
+    }
+    printf("Bench %s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
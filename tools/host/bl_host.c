@@ -0,0 +1,199 @@
+/*
+ * bl_host.c
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Runs the bootloader protocol engine of the CM7 on Linux. The HEX parser,
+ * coalescer, image cache, erase planner, diff and verify code are the
+ * firmware sources, compiled against the host shims in this directory (see
+ * build.sh). The files come from a directory instead of the SD card.
+ *
+ * Without --port the other end is the ROM bootloader model of bl_sim_rom.c,
+ * running in a child process on a socketpair:
+ *
+ *     tools/host/build.sh
+ *     _host/bl_host --root cards/demo firmware.hex
+ *     _host/bl_host --loss 0.0001 --nack 0.01 --latency-us 500 firmware.hex
+ *     _host/bl_host --flash flash.bin --diff firmware.hex   # keeps the flash between runs
+ *     _host/bl_host --loader loader.bin firmware.hex         # through the flash loader model
+ *
+ * With --port the engine talks to a tty instead: a real board, or the
+ * standalone model of bl_sim.c on its pty.
+ */
+
+#include "bootloader.h"
+#include "bl_device.h"
+#include "bl_sim_rom.h"
+#include "bl_transport_fd.h"
+#include "ff.h"
+#include <getopt.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static BL_Transport_t host_link;
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "usage: %s [options] file.hex\n"
+            "  --root DIR        directory that stands in for the SD card (.)\n"
+            "  --port PATH       talk to a tty instead of the built-in model\n"
+            "  --baud N          line rate (115200)\n"
+            "  --diff            differential upload\n"
+            "  --no-verify       skip the verify pass\n"
+            "  --go ADDR         start the application when done\n"
+            "  --loader FILE     load the flash loader stub FILE from the root and upload through it,\n"
+            "                    the model runs its own loader in place of the stub\n"
+            "model options, without --port:\n"
+            "  --loss P          probability a byte is lost, per direction\n"
+            "  --nack P          probability a Write/Erase is NACKed\n"
+            "  --latency-us N    delay before every ACK/NACK\n"
+            "  --erase-ms N      per sector erase time\n"
+            "  --program-us N    per Write Memory program time\n"
+            "  --sectors N       flash sectors\n"
+            "  --sector-size N   bytes per sector\n"
+            "  --legacy-erase    offer Erase (0x43) instead of Extended Erase\n"
+            "  --no-checksum     don't offer Get Checksum\n"
+            "  --flash FILE      flash contents, loaded before and saved after the run\n"
+            "  --seed N          fault injection seed\n",
+            name);
+}
+
+// Child side of the socketpair: serve until the engine closes its end
+static int run_model(int fd, const BL_SimConfig_t *cfg, const char *flash_file) {
+    BL_Sim_t sim;
+    if (!BL_Sim_Init(&sim, cfg)) {
+        return 1;
+    }
+    if (flash_file != NULL) {
+        BL_Sim_LoadFlash(&sim, flash_file);
+    }
+    while (BL_Sim_Run(&sim, fd)) {
+        BL_Sim_Reset(&sim); // Go: the application runs until the next reset
+    }
+    BL_Sim_Report(&sim, stderr);
+    if (flash_file != NULL && !BL_Sim_SaveFlash(&sim, flash_file)) {
+        fprintf(stderr, "Sim: saving %s failed\n", flash_file);
+    }
+    BL_Sim_Free(&sim);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static const struct option options[] = {
+        {"root", required_argument, NULL, 'r'},
+        {"port", required_argument, NULL, 'p'},
+        {"baud", required_argument, NULL, 'b'},
+        {"diff", no_argument, NULL, 'd'},
+        {"no-verify", no_argument, NULL, 'V'},
+        {"go", required_argument, NULL, 'g'},
+        {"loader", required_argument, NULL, 'a'},
+        {"loss", required_argument, NULL, 'l'},
+        {"nack", required_argument, NULL, 'n'},
+        {"latency-us", required_argument, NULL, 'L'},
+        {"erase-ms", required_argument, NULL, 'e'},
+        {"program-us", required_argument, NULL, 'P'},
+        {"sectors", required_argument, NULL, 's'},
+        {"sector-size", required_argument, NULL, 'S'},
+        {"legacy-erase", no_argument, NULL, 'E'},
+        {"no-checksum", no_argument, NULL, 'C'},
+        {"flash", required_argument, NULL, 'f'},
+        {"seed", required_argument, NULL, 'x'},
+        {NULL, 0, NULL, 0},
+    };
+    BL_SimConfig_t cfg = BL_SIM_DEFAULT_CONFIG;
+    const char *port = NULL;
+    const char *flash_file = NULL;
+    const char *loader_file = NULL;
+    bool diff = false, verify = true, go = false;
+    uint32_t go_address = 0;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+        case 'r': FF_Posix_SetRoot(optarg); break;
+        case 'p': port = optarg; break;
+        case 'b': cfg.baudrate = strtoul(optarg, NULL, 0); break;
+        case 'd': diff = true; break;
+        case 'V': verify = false; break;
+        case 'g': go = true; go_address = strtoul(optarg, NULL, 0); break;
+        case 'a': loader_file = optarg; cfg.loader = true; break;
+        case 'l': cfg.loss = atof(optarg); break;
+        case 'n': cfg.nack = atof(optarg); break;
+        case 'L': cfg.latency_us = strtoul(optarg, NULL, 0); break;
+        case 'e': cfg.erase_ms = strtoul(optarg, NULL, 0); break;
+        case 'P': cfg.program_us = strtoul(optarg, NULL, 0); break;
+        case 's': cfg.sector_count = strtoul(optarg, NULL, 0); break;
+        case 'S': cfg.sector_size = strtoul(optarg, NULL, 0); break;
+        case 'E': cfg.extended_erase = false; break;
+        case 'C': cfg.get_checksum = false; break;
+        case 'f': flash_file = optarg; break;
+        case 'x': cfg.seed = strtoul(optarg, NULL, 0); break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int fd;
+    pid_t model = -1;
+    if (port != NULL) {
+        fd = BL_TransportFd_OpenTty(port, cfg.baudrate);
+        if (fd < 0) {
+            perror(port);
+            return 1;
+        }
+    } else {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            perror("socketpair");
+            return 1;
+        }
+        fflush(stdout);
+        model = fork();
+        if (model == 0) {
+            close(pair[0]);
+            return run_model(pair[1], &cfg, flash_file);
+        }
+        close(pair[1]);
+        fd = pair[0];
+    }
+
+    // The model answers GET ID with the product ID of a real part but has
+    // the geometry it was configured with, so its own profile is pinned. A
+    // real target gets the profile of its ID.
+    BL_Device_t model_device = {
+        .pid = cfg.pid, .name = "ROM model", .layout = {cfg.flash_base, 1, {{cfg.sector_size, cfg.sector_count}}},
+        .flash_word = 8, .erase = {cfg.erase_ms, cfg.mass_erase_ms, 2}, .program_ms = 450,
+    };
+    if (port == NULL) {
+        BL_Device_Pin(&model_device);
+    }
+
+    if (!BL_TransportFd_Init(&host_link, fd, cfg.baudrate)) {
+        return 1;
+    }
+    BL_SetTransport(&host_link);
+
+    bool ok = BL_InitBootloader();
+    if (!ok) {
+        printf("No answer from the bootloader\n");
+    }
+    ok = ok && (loader_file == NULL || BL_StartFlashLoader(loader_file, BL_LOADER_RAM_ADDRESS));
+    ok = ok && (diff ? BL_UploadHexFileDiff(argv[optind]) : BL_UploadHexFile(argv[optind]));
+    ok = ok && (!verify || BL_VerifyUpload());
+    ok = ok && (!go || BL_Go(go_address));
+    printf("%s\n", ok ? "Upload OK" : "Upload FAILED");
+    BL_Rto_Report(&BL_GetTarget()->rto);
+
+    close(fd);
+    if (model > 0) {
+        waitpid(model, NULL, 0);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+/*
+ * bl_host_port.c
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Host replacements for the modules that only make sense on the board.
+ * With BL_Pipe_Start failing the bootloader parses on its own, which also
+ * keeps the read-ahead (SDMMC DMA) out of the picture. The UART transport
+ * is never bound, the host sets its own with BL_SetTransport. The console
+ * log formats right away onto stdout.
+ */
+
+#include "stm32h7xx_hal.h"
+#include "bl_log.h"
+#include "bl_pipe.h"
+#include "bl_readahead.h"
+#include "bl_stack.h"
+#include "bl_trace.h"
+#include "bl_transport_uart.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+
+UART_HandleTypeDef huart8 = {"UART8"};
+
+/* ********************** HAL ****************************** */
+
+uint32_t HAL_GetTick(void) {
+    static struct timespec start;
+    struct timespec now;
+
+    if (start.tv_sec == 0 && start.tv_nsec == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000);
+}
+
+void HAL_Delay(uint32_t ms) {
+    struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000};
+    nanosleep(&ts, NULL);
+}
+
+/* ********************** Board modules ****************************** */
+
+bool BL_TransportUart_Init(BL_Transport_t *t, UART_HandleTypeDef *huart) {
+    return false;
+}
+
+void BL_Log_Deferred(const char *fmt, uint8_t nargs, ...) {
+    va_list ap;
+    va_start(ap, nargs);
+    vprintf(fmt, ap);
+    va_end(ap);
+}
+
+// No CM4
+void BL_Pipe_Init(void) {
+}
+
+bool BL_Pipe_Start(void) {
+    return false;
+}
+
+void BL_Pipe_Abort(void) {
+}
+
+uint32_t BL_Pipe_WriteText(const uint8_t *data, uint32_t length) {
+    return 0;
+}
+
+void BL_Pipe_EndText(void) {
+}
+
+const BL_PipeBlock_t *BL_Pipe_PeekBlock(void) {
+    return NULL;
+}
+
+void BL_Pipe_ReleaseBlock(void) {
+}
+
+BL_PipeState_t BL_Pipe_State(void) {
+    return BL_PIPE_ERROR;
+}
+
+uint32_t BL_Pipe_StartAddress(void) {
+    return 0xFFFFFFFF;
+}
+
+uint32_t BL_Pipe_Records(void) {
+    return 0;
+}
+
+uint32_t BL_Pipe_ErrorLine(void) {
+    return 0;
+}
+
+// No SDMMC
+bool BL_ReadAhead_Open(BL_ReadAhead_t *r, FIL *file) {
+    return false;
+}
+
+bool BL_ReadAhead_Next(BL_ReadAhead_t *r, BL_Span_t *span) {
+    return false;
+}
+
+void BL_ReadAhead_Close(BL_ReadAhead_t *r) {
+}
+
+void BL_ReadAhead_Report(const BL_ReadAhead_t *r) {
+}
+
+// No DWT, the simulator knows the timing anyway
+void BL_Trace_Init(void) {
+}
+
+void BL_Trace_Begin(uint8_t command) {
+}
+
+void BL_Trace_Mark(BL_TracePhase_t phase, bool ok) {
+}
+
+void BL_Trace_Clear(void) {
+}
+
+void BL_Trace_Dump(UART_HandleTypeDef *huart) {
+}
+
+// The host stack isn't the one that matters
+void BL_Stack_Paint(void) {
+}
+
+uint32_t BL_Stack_Peak(void) {
+    return 0;
+}
+
+uint32_t BL_Stack_Size(void) {
+    return 0;
+}
+
+void BL_Stack_Report(const char *what) {
+}
@@ -0,0 +1,314 @@
+/*
+ * bl_lines_bench.c
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Host benchmark of the line reader in CM7/Core/Src/bl_lines.c against the
+ * f_gets loop it replaced. Both run on the real FatFs of Middlewares/ with
+ * the firmware's ffconf.h, over a RAM disk, so the f_read and disk_read
+ * calls are the ones the firmware makes:
+ *
+ *     _host/bl_lines_bench                  # generated 4 MiB image, 32 byte records
+ *     _host/bl_lines_bench firmware.hex [more.hex ...]
+ *
+ * Every file is put on a freshly formatted RAM disk and split into lines a
+ * few times with each reader, the best pass counts. The lines of both are
+ * hashed and have to match, the exit code fails when they don't. build.sh
+ * builds it and runs it over the fixtures and the generated image. Besides the time, the f_read calls and the
+ * disk_read calls and sectors per pass are printed: on the board every
+ * disk_read is one SDMMC command, so those are what the card sees.
+ *
+ * Times are host times and only comparable on the same host, the per call
+ * overhead they show is what matters on the Cortex-M7.
+ */
+
+#include "ff.h"
+#include "diskio.h"
+#include "bl_lines.h"
+#include "bl_hex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_PASSES     10
+#define BENCH_DISK_SIZE  (64u * 1024 * 1024)
+#define BENCH_SECTOR     512
+#define BENCH_CLUSTER    (16u * 1024) // multi-sector reads stop at cluster ends
+#define BENCH_GEN_SIZE   (4u * 1024 * 1024) // data bytes of the generated image
+#define BENCH_GEN_RECORD 32
+
+/* ********************** RAM disk ****************************** */
+
+static uint8_t *disk;
+
+// Calls into the disk driver during the current pass
+static struct {
+    uint32_t reads;
+    uint32_t sectors;
+} disk_stats;
+
+DSTATUS disk_initialize(BYTE pdrv) {
+    return disk ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_status(BYTE pdrv) {
+    return disk ? 0 : STA_NOINIT;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count) {
+    memcpy(buff, &disk[(size_t)sector * BENCH_SECTOR], (size_t)count * BENCH_SECTOR);
+    disk_stats.reads++;
+    disk_stats.sectors += count;
+    return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count) {
+    memcpy(&disk[(size_t)sector * BENCH_SECTOR], buff, (size_t)count * BENCH_SECTOR);
+    return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff) {
+    switch (cmd) {
+    case CTRL_SYNC:
+        return RES_OK;
+    case GET_SECTOR_COUNT:
+        *(DWORD *)buff = BENCH_DISK_SIZE / BENCH_SECTOR;
+        return RES_OK;
+    case GET_SECTOR_SIZE:
+        *(WORD *)buff = BENCH_SECTOR;
+        return RES_OK;
+    case GET_BLOCK_SIZE:
+        *(DWORD *)buff = 1;
+        return RES_OK;
+    default:
+        return RES_PARERR;
+    }
+}
+
+DWORD get_fattime(void) {
+    return ((DWORD)(2026 - 1980) << 25) | (10u << 21) | (16u << 16);
+}
+
+/* ********************** Input ****************************** */
+
+static FATFS fs;
+
+// Format the RAM disk and store data as BENCH.HEX
+static bool Bench_Store(const char *data, size_t size) {
+    static uint8_t work[BENCH_SECTOR * 8];
+    FIL file;
+    UINT n;
+
+    memset(disk, 0, BENCH_DISK_SIZE);
+    if (f_mkfs("", FM_ANY, BENCH_CLUSTER, work, sizeof(work)) != FR_OK || f_mount(&fs, "", 1) != FR_OK) {
+        printf("Failed to format the RAM disk\n");
+        return false;
+    }
+    if (f_open(&file, "BENCH.HEX", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+        printf("Failed to create BENCH.HEX\n");
+        return false;
+    }
+    bool ok = f_write(&file, data, size, &n) == FR_OK && n == size;
+    f_close(&file);
+    return ok;
+}
+
+static char *Bench_Load(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(*size + 1);
+    if (data != NULL && fread(data, 1, *size, f) != *size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+static int Bench_Record(char *out, uint8_t type, uint16_t address, const uint8_t *data, uint8_t length) {
+    uint8_t sum = length + (address >> 8) + address + type;
+    int n = sprintf(out, ":%02X%04X%02X", length, address, type);
+    for (uint8_t i = 0; i < length; i++) {
+        n += sprintf(out + n, "%02X", data[i]);
+        sum += data[i];
+    }
+    return n + sprintf(out + n, "%02X\r\n", (uint8_t)-sum);
+}
+
+// A HEX image of size data bytes at 0x08000000, CRLF line endings
+static char *Bench_Generate(uint32_t size, size_t *length) {
+    char *out = malloc((size_t)size / BENCH_GEN_RECORD * 80 + 4096);
+    uint8_t data[BENCH_GEN_RECORD];
+    size_t n = 0;
+    uint32_t seed = 1;
+
+    if (out == NULL) {
+        return NULL;
+    }
+    for (uint32_t address = 0; address < size; address += BENCH_GEN_RECORD) {
+        if ((address & 0xFFFF) == 0) {
+            uint8_t upper[2] = {0x08, (uint8_t)(address >> 16)};
+            n += Bench_Record(out + n, 0x04, 0, upper, 2);
+        }
+        for (int i = 0; i < BENCH_GEN_RECORD; i++) {
+            seed = seed * 1103515245 + 12345;
+            data[i] = seed >> 16;
+        }
+        n += Bench_Record(out + n, 0x00, (uint16_t)address, data, BENCH_GEN_RECORD);
+    }
+    n += Bench_Record(out + n, 0x01, 0, NULL, 0);
+    *length = n;
+    return out;
+}
+
+/* ********************** Readers ****************************** */
+
+typedef struct {
+    double ms;
+    uint32_t lines;
+    uint32_t hash;
+    uint32_t f_reads;
+    uint32_t disk_reads;
+    uint32_t sectors;
+} Bench_Result_t;
+
+static uint32_t Bench_Hash(uint32_t h, const char *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ (uint8_t)s[i]) * 16777619u;
+    }
+    return (h ^ '\n') * 16777619u;
+}
+
+static double Bench_Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// The previous loop of BL_ParseHexLocal. Its buffer was BL_HEX_LINE_MAX,
+// which split a line of 511 characters in two, sized like the reader here
+// so both hand out the same lines.
+static bool Bench_Gets(Bench_Result_t *res) {
+    char line[BL_LINES_MAX + 2];
+    FIL file;
+
+    if (f_open(&file, "BENCH.HEX", FA_READ) != FR_OK) {
+        return false;
+    }
+    double start = Bench_Now();
+    while (f_gets(line, sizeof(line), &file) != NULL) {
+        size_t n = strcspn(line, "\n");
+        line[n] = 0;
+        res->hash = Bench_Hash(res->hash, line, n);
+        res->lines++;
+    }
+    res->ms = Bench_Now() - start;
+    // f_gets reads one character per f_read (_LFN_UNICODE 0)
+    res->f_reads = (uint32_t)f_tell(&file) + 1;
+    f_close(&file);
+    return true;
+}
+
+static bool Bench_Lines(Bench_Result_t *res) {
+    static BL_LineReader_t reader;
+    BL_Line_t line;
+    FIL file;
+
+    if (f_open(&file, "BENCH.HEX", FA_READ) != FR_OK) {
+        return false;
+    }
+    double start = Bench_Now();
+    BL_LineReader_Init(&reader, &file);
+    bool ok;
+    while ((ok = BL_LineReader_Next(&reader, &line)) && line.text != NULL) {
+        res->hash = Bench_Hash(res->hash, line.text, line.length);
+        res->lines++;
+    }
+    res->ms = Bench_Now() - start;
+    res->f_reads = reader.reads;
+    f_close(&file);
+    return ok;
+}
+
+static bool Bench_Run(bool (*reader)(Bench_Result_t *), Bench_Result_t *best) {
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        Bench_Result_t res = {.hash = 2166136261u};
+        memset(&disk_stats, 0, sizeof(disk_stats));
+        if (!reader(&res)) {
+            return false;
+        }
+        res.disk_reads = disk_stats.reads;
+        res.sectors = disk_stats.sectors;
+        if (pass == 0 || res.ms < best->ms) {
+            *best = res;
+        }
+    }
+    return true;
+}
+
+static void Bench_Print(const char *name, const Bench_Result_t *r, size_t size) {
+    printf("  %-8s %9.2f ms %8.1f MB/s  %7lu lines  %8lu f_read  %6lu disk_read  %7lu sectors\n",
+           name, r->ms, size / r->ms / 1e3, (unsigned long)r->lines, (unsigned long)r->f_reads,
+           (unsigned long)r->disk_reads, (unsigned long)r->sectors);
+}
+
+static bool Bench_File(const char *name, const char *data, size_t size) {
+    Bench_Result_t gets, lines;
+
+    if (!Bench_Store(data, size)) {
+        return false;
+    }
+    if (!Bench_Run(Bench_Gets, &gets) || !Bench_Run(Bench_Lines, &lines)) {
+        printf("%s: read failed\n", name);
+        return false;
+    }
+
+    printf("%s: %zu bytes\n", name, size);
+    Bench_Print("f_gets", &gets, size);
+    Bench_Print("bl_lines", &lines, size);
+    printf("  speedup %.1fx\n", gets.ms / lines.ms);
+    if (gets.lines != lines.lines || gets.hash != lines.hash) {
+        printf("  MISMATCH: %lu lines %08lx against %lu lines %08lx\n",
+               (unsigned long)gets.lines, (unsigned long)gets.hash,
+               (unsigned long)lines.lines, (unsigned long)lines.hash);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+
+    disk = malloc(BENCH_DISK_SIZE);
+    if (disk == NULL) {
+        return 1;
+    }
+
+    if (argc < 2) {
+        size_t size;
+        char *data = Bench_Generate(BENCH_GEN_SIZE, &size);
+        ok = data != NULL && Bench_File("generated", data, size);
+        free(data);
+    }
+    for (int i = 1; i < argc; i++) {
+        size_t size;
+        char *data = Bench_Load(argv[i], &size);
+        if (data == NULL || size > BENCH_DISK_SIZE / 2) {
+            printf("%s: can't use this file\n", argv[i]);
+            ok = false;
+        } else {
+            ok = Bench_File(argv[i], data, size) && ok;
+        }
+        free(data);
+    }
+
+    free(disk);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+/*
+ * bl_sim.c
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * The ROM bootloader model of bl_sim_rom.c on a pty, for tools that want a
+ * serial port (bl_host --port, stm32flash, ...):
+ *
+ *     _host/bl_sim --erase-ms 5 &
+ *     Simulated bootloader on /dev/pts/7
+ *     _host/bl_host --port /dev/pts/7 firmware.hex
+ *
+ * Takes the model options of bl_host, and --loader to run the flash loader
+ * model after a Go into RAM. After any other Go the model counts as reset
+ * into the bootloader again, and it keeps serving until interrupted.
+ */
+
+#define _GNU_SOURCE
+#include "bl_sim_rom.h"
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig) {
+    stop = 1;
+}
+
+int main(int argc, char **argv) {
+    static const struct option options[] = {
+        {"baud", required_argument, NULL, 'b'},
+        {"loss", required_argument, NULL, 'l'},
+        {"nack", required_argument, NULL, 'n'},
+        {"latency-us", required_argument, NULL, 'L'},
+        {"erase-ms", required_argument, NULL, 'e'},
+        {"program-us", required_argument, NULL, 'P'},
+        {"sectors", required_argument, NULL, 's'},
+        {"sector-size", required_argument, NULL, 'S'},
+        {"legacy-erase", no_argument, NULL, 'E'},
+        {"no-checksum", no_argument, NULL, 'C'},
+        {"flash", required_argument, NULL, 'f'},
+        {"seed", required_argument, NULL, 'x'},
+        {"loader", no_argument, NULL, 'a'},
+        {NULL, 0, NULL, 0},
+    };
+    BL_SimConfig_t cfg = BL_SIM_DEFAULT_CONFIG;
+    const char *flash_file = NULL;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+        case 'b': cfg.baudrate = strtoul(optarg, NULL, 0); break;
+        case 'l': cfg.loss = atof(optarg); break;
+        case 'n': cfg.nack = atof(optarg); break;
+        case 'L': cfg.latency_us = strtoul(optarg, NULL, 0); break;
+        case 'e': cfg.erase_ms = strtoul(optarg, NULL, 0); break;
+        case 'P': cfg.program_us = strtoul(optarg, NULL, 0); break;
+        case 's': cfg.sector_count = strtoul(optarg, NULL, 0); break;
+        case 'S': cfg.sector_size = strtoul(optarg, NULL, 0); break;
+        case 'E': cfg.extended_erase = false; break;
+        case 'C': cfg.get_checksum = false; break;
+        case 'f': flash_file = optarg; break;
+        case 'x': cfg.seed = strtoul(optarg, NULL, 0); break;
+        case 'a': cfg.loader = true; break;
+        default:
+            fprintf(stderr, "usage: %s [model options of bl_host]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("pty");
+        return 1;
+    }
+
+    // Raw on both ends. Holding the slave open keeps the master readable
+    // while no client is connected.
+    struct termios tio;
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if (slave < 0 || tcgetattr(slave, &tio) != 0) {
+        perror(ptsname(master));
+        return 1;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    BL_Sim_t sim;
+    if (!BL_Sim_Init(&sim, &cfg)) {
+        return 1;
+    }
+    if (flash_file != NULL) {
+        BL_Sim_LoadFlash(&sim, flash_file);
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    printf("Simulated bootloader on %s\n", ptsname(master));
+    fflush(stdout);
+
+    while (!stop && BL_Sim_Run(&sim, master)) {
+        BL_Sim_Reset(&sim);
+    }
+
+    BL_Sim_Report(&sim, stderr);
+    if (flash_file != NULL) {
+        BL_Sim_SaveFlash(&sim, flash_file);
+    }
+    BL_Sim_Free(&sim);
+    close(slave);
+    return 0;
+}
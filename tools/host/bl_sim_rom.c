@@ -0,0 +1,846 @@
+/*
+ * bl_sim_rom.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_sim_rom.h"
+#include "bootloader.h"
+#include "bl_crc.h"
+#include "bl_loader.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum {
+    BL_SIM_OK,
+    BL_SIM_TIMEOUT,  // silence in the middle of a command
+    BL_SIM_CLOSED,   // host went away
+} BL_SimIo_t;
+
+// Read buffer, one model runs per process
+static uint8_t rx_buf[512];
+static uint16_t rx_len;
+static uint16_t rx_pos;
+
+/* ********************** Time and randomness ****************************** */
+
+static uint64_t BL_Sim_Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Sleeps shorter than the scheduler can do are carried over to the next one
+static void BL_Sim_SleepUntil(uint64_t t) {
+    uint64_t now = BL_Sim_Now();
+    if (t > now + 200) {
+        struct timespec ts = {(t - now) / 1000000, (long)((t - now) % 1000000) * 1000};
+        nanosleep(&ts, NULL);
+    }
+}
+
+static uint64_t BL_Sim_WireUs(const BL_Sim_t *s, uint32_t bytes) {
+    return s->cfg.baudrate ? (uint64_t)bytes * 11 * 1000000 / s->cfg.baudrate : 0;
+}
+
+static bool BL_Sim_Chance(BL_Sim_t *s, double p) {
+    if (p <= 0) {
+        return false;
+    }
+    uint32_t x = s->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    s->random = x;
+    return x < p * 4294967296.0;
+}
+
+/* ********************** Line ****************************** */
+
+static BL_SimIo_t BL_Sim_Get(BL_Sim_t *s, uint8_t *byte, int timeout_ms) {
+    while (true) {
+        if (rx_pos == rx_len) {
+            struct pollfd p = {s->fd, POLLIN, 0};
+            int r = poll(&p, 1, timeout_ms);
+            if (r == 0) {
+                return BL_SIM_TIMEOUT;
+            }
+            if (r < 0) {
+                return BL_SIM_CLOSED; // interrupted, bl_sim is being stopped
+            }
+            ssize_t n = read(s->fd, rx_buf, sizeof(rx_buf));
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            if (n <= 0) {
+                return BL_SIM_CLOSED;
+            }
+            rx_len = n;
+            rx_pos = 0;
+        }
+
+        // The host writes whole frames at once, on a UART they trickle in
+        uint64_t now = BL_Sim_Now();
+        s->rx_clock = (s->rx_clock > now ? s->rx_clock : now) + BL_Sim_WireUs(s, 1);
+        BL_Sim_SleepUntil(s->rx_clock);
+
+        uint8_t b = rx_buf[rx_pos++];
+        if (BL_Sim_Chance(s, s->cfg.loss)) {
+            s->stats.lost_rx++;
+            continue;
+        }
+        *byte = b;
+        return BL_SIM_OK;
+    }
+}
+
+static BL_SimIo_t BL_Sim_GetN(BL_Sim_t *s, uint8_t *data, uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+        BL_SimIo_t r = BL_Sim_Get(s, &data[i], BL_SIM_BYTE_TIMEOUT);
+        if (r != BL_SIM_OK) {
+            return r;
+        }
+    }
+    return BL_SIM_OK;
+}
+
+static void BL_Sim_Put(BL_Sim_t *s, const uint8_t *data, uint16_t length) {
+    uint8_t out[300];
+    uint16_t n = 0;
+
+    BL_Sim_SleepUntil(BL_Sim_Now() + BL_Sim_WireUs(s, length));
+    for (uint16_t i = 0; i < length; i++) {
+        if (BL_Sim_Chance(s, s->cfg.loss)) {
+            s->stats.lost_tx++;
+        } else {
+            out[n++] = data[i];
+        }
+    }
+    for (uint16_t done = 0; done < n;) {
+        ssize_t w = write(s->fd, out + done, n - done);
+        if (w <= 0) {
+            if (w < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            return;
+        }
+        done += w;
+    }
+}
+
+static void BL_Sim_Reply(BL_Sim_t *s, uint8_t reply) {
+    if (s->cfg.latency_us) {
+        BL_Sim_SleepUntil(BL_Sim_Now() + s->cfg.latency_us);
+    }
+    if (reply == BL_NACK) {
+        s->stats.nacks++;
+    }
+    BL_Sim_Put(s, &reply, 1);
+}
+
+static void BL_Sim_Ack(BL_Sim_t *s) {
+    BL_Sim_Reply(s, BL_ACK);
+}
+
+static void BL_Sim_Nack(BL_Sim_t *s) {
+    BL_Sim_Reply(s, BL_NACK);
+}
+
+// Busy target, the final ACK comes once the flash is done
+static void BL_Sim_Busy(BL_Sim_t *s, uint64_t us) {
+    BL_Sim_SleepUntil(BL_Sim_Now() + us);
+}
+
+/* ********************** Memory ****************************** */
+
+// Pointer to length bytes at address, NULL if they aren't all in one memory
+static uint8_t *BL_Sim_Memory(BL_Sim_t *s, uint32_t address, uint32_t length, bool *flash) {
+    uint32_t flash_size = s->cfg.sector_size * s->cfg.sector_count;
+    if (address >= s->cfg.flash_base && length <= flash_size && address - s->cfg.flash_base <= flash_size - length) {
+        *flash = true;
+        return &s->flash[address - s->cfg.flash_base];
+    }
+    if (address >= BL_SIM_RAM_BASE && length <= BL_SIM_RAM_SIZE && address - BL_SIM_RAM_BASE <= BL_SIM_RAM_SIZE - length) {
+        *flash = false;
+        return &s->ram[address - BL_SIM_RAM_BASE];
+    }
+    return NULL;
+}
+
+// CRC over whole words in memory order, no reflection, no final XOR (the
+// CRC unit's reset setup)
+static uint32_t BL_Sim_Crc(uint32_t crc, uint32_t polynomial, const uint8_t *data, uint32_t length) {
+    for (uint32_t i = 0; i + 4 <= length; i += 4) {
+        uint32_t word = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16) | ((uint32_t)data[i + 3] << 24);
+        crc ^= word;
+        for (uint8_t bit = 0; bit < 32; bit++) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ polynomial : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void BL_Sim_EraseSector(BL_Sim_t *s, uint16_t sector) {
+    memset(&s->flash[(uint32_t)sector * s->cfg.sector_size], 0xFF, s->cfg.sector_size);
+    s->stats.sectors_erased++;
+}
+
+static void BL_Sim_MassErase(BL_Sim_t *s) {
+    memset(s->flash, 0xFF, (size_t)s->cfg.sector_size * s->cfg.sector_count);
+    s->stats.mass_erases++;
+    BL_Sim_Busy(s, (uint64_t)s->cfg.mass_erase_ms * 1000);
+}
+
+/* ********************** Commands ****************************** */
+
+static const uint8_t *BL_Sim_Commands(const BL_Sim_t *s, uint8_t *count) {
+    static uint8_t list[16];
+    uint8_t n = 0;
+    list[n++] = BL_CMD_GET;
+    list[n++] = BL_CMD_GET_VERSION;
+    list[n++] = BL_CMD_GET_ID;
+    list[n++] = BL_CMD_READ_MEMORY;
+    list[n++] = BL_CMD_GO;
+    list[n++] = BL_CMD_WRITE_MEMORY;
+    list[n++] = s->cfg.extended_erase ? BL_CMD_EXTENDED_ERASE : BL_CMD_ERASE;
+    list[n++] = BL_CMD_WRITE_PROTECT;
+    list[n++] = BL_CMD_WRITE_UNPROTECT;
+    list[n++] = BL_CMD_READOUT_PROTECT;
+    list[n++] = BL_CMD_READOUT_UNPROTECT;
+    if (s->cfg.get_checksum) {
+        list[n++] = BL_CMD_GET_CHECKSUM;
+    }
+    *count = n;
+    return list;
+}
+
+static bool BL_Sim_Supported(const BL_Sim_t *s, uint8_t cmd) {
+    uint8_t count;
+    const uint8_t *list = BL_Sim_Commands(s, &count);
+    return memchr(list, cmd, count) != NULL;
+}
+
+// Four bytes MSB first and their XOR, ACKed or NACKed
+static BL_SimIo_t BL_Sim_GetWord(BL_Sim_t *s, uint32_t *word, bool *ok) {
+    uint8_t b[5];
+    BL_SimIo_t r = BL_Sim_GetN(s, b, 5);
+    if (r != BL_SIM_OK) {
+        return r;
+    }
+    *word = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+    *ok = (b[0] ^ b[1] ^ b[2] ^ b[3]) == b[4];
+    return BL_SIM_OK;
+}
+
+static BL_SimIo_t BL_Sim_CmdGet(BL_Sim_t *s) {
+    uint8_t count;
+    const uint8_t *list = BL_Sim_Commands(s, &count);
+    uint8_t out[20];
+
+    out[0] = count; // bytes to follow minus one: version + commands
+    out[1] = s->cfg.version;
+    memcpy(&out[2], list, count);
+    BL_Sim_Ack(s);
+    BL_Sim_Put(s, out, count + 2);
+    BL_Sim_Ack(s);
+    return BL_SIM_OK;
+}
+
+static BL_SimIo_t BL_Sim_CmdGetVersion(BL_Sim_t *s) {
+    uint8_t out[3] = {s->cfg.version, 0x00, 0x00}; // option bytes, always 0
+    BL_Sim_Ack(s);
+    BL_Sim_Put(s, out, 3);
+    BL_Sim_Ack(s);
+    return BL_SIM_OK;
+}
+
+static BL_SimIo_t BL_Sim_CmdGetId(BL_Sim_t *s) {
+    uint8_t out[3] = {1, s->cfg.pid >> 8, s->cfg.pid & 0xFF};
+    BL_Sim_Ack(s);
+    BL_Sim_Put(s, out, 3);
+    BL_Sim_Ack(s);
+    return BL_SIM_OK;
+}
+
+static BL_SimIo_t BL_Sim_CmdRead(BL_Sim_t *s) {
+    uint32_t address;
+    uint8_t count[2];
+    bool ok, flash;
+
+    BL_Sim_Ack(s);
+    BL_SimIo_t r = BL_Sim_GetWord(s, &address, &ok);
+    if (r != BL_SIM_OK) {
+        return r;
+    }
+    if (!ok || BL_Sim_Memory(s, address, 1, &flash) == NULL) {
+        BL_Sim_Nack(s);
+        return BL_SIM_OK;
+    }
+    BL_Sim_Ack(s);
+
+    if ((r = BL_Sim_GetN(s, count, 2)) != BL_SIM_OK) {
+        return r;
+    }
+    const uint8_t *data = BL_Sim_Memory(s, address, count[0] + 1, &flash);
+    if ((uint8_t)~count[0] != count[1] || data == NULL) {
+        BL_Sim_Nack(s);
+        return BL_SIM_OK;
+    }
+    BL_Sim_Ack(s);
+    BL_Sim_Put(s, data, count[0] + 1);
+    return BL_SIM_OK;
+}
+
+static BL_SimIo_t BL_Sim_CmdGo(BL_Sim_t *s, bool *jumped, uint32_t *entry) {
+    uint32_t address;
+    bool ok, flash;
+
+    BL_Sim_Ack(s);
+    BL_SimIo_t r = BL_Sim_GetWord(s, &address, &ok);
+    if (r != BL_SIM_OK) {
+        return r;
+    }
+    if (!ok || BL_Sim_Memory(s, address, 4, &flash) == NULL) {
+        BL_Sim_Nack(s);
+        return BL_SIM_OK;
+    }
+    BL_Sim_Ack(s);
+    *jumped = true;
+    *entry = address;
+    return BL_SIM_OK;
+}
+
+static BL_SimIo_t BL_Sim_CmdWrite(BL_Sim_t *s) {
+    uint32_t address;
+    uint8_t data[257];
+    uint8_t count, checksum;
+    bool ok, flash;
+
+    BL_Sim_Ack(s);
+    BL_SimIo_t r = BL_Sim_GetWord(s, &address, &ok);
+    if (r != BL_SIM_OK) {
+        return r;
+    }
+    if (!ok || BL_Sim_Memory(s, address, 1, &flash) == NULL) {
+        BL_Sim_Nack(s);
+        return BL_SIM_OK;
+    }
+    BL_Sim_Ack(s);
+
+    if ((r = BL_Sim_Get(s, &count, BL_SIM_BYTE_TIMEOUT)) != BL_SIM_OK ||
+        (r = BL_Sim_GetN(s, data, count + 1)) != BL_SIM_OK ||
+        (r = BL_Sim_Get(s, &checksum, BL_SIM_BYTE_TIMEOUT)) != BL_SIM_OK) {
+        return r;
+    }
+
+    uint8_t x = count;
+    for (uint16_t i = 0; i <= count; i++) {
+        x ^= data[i];
+    }
+    uint8_t *dest = BL_Sim_Memory(s, address, count + 1, &flash);
+    if (x != checksum || dest == NULL) {
+        BL_Sim_Nack(s);
+        return BL_SIM_OK;
+    }
+    if (BL_Sim_Chance(s, s->cfg.nack)) {
+        s->stats.injected_nacks++;
+        BL_Sim_Nack(s);
+        return BL_SIM_OK;
+    }
+
+    if (flash) {
+        for (uint16_t i = 0; i <= count; i++) {
+            if (dest[i] != 0xFF) {
+                BL_Sim_Busy(s, s->cfg.program_us);
+                BL_Sim_Nack(s); // programming error, not erased
+                return BL_SIM_OK;
+            }
+        }
+        BL_Sim_Busy(s, s->cfg.program_us);
+    }
+    memcpy(dest, data, count + 1);
+    s->stats.bytes_written += count + 1;
+    BL_Sim_Ack(s);
+    return BL_SIM_OK;
+}
+
+// Erase (0x43) with 8-bit page numbers, or Extended Erase (0x44) with
+// 16-bit ones and the special codes for mass and bank erase
+static BL_SimIo_t BL_Sim_CmdErase(BL_Sim_t *s, bool extended) {
+    static uint8_t pages[2 * 0x10000];
+    uint8_t head[2];
+    uint8_t checksum;
+    BL_SimIo_t r;
+
+    BL_Sim_Ack(s);
+    if ((r = BL_Sim_GetN(s, head, extended ? 2 : 1)) != BL_SIM_OK) {
+        return r;
+    }
+
+    uint16_t n = extended ? (uint16_t)((head[0] << 8) | head[1]) : head[0];
+    bool special = extended ? n >= 0xFFF0 : n == 0xFF;
+    uint32_t count = special ? 0 : n + 1u;
+    uint32_t width = extended ? 2 : 1;
+
+    if ((r = BL_Sim_GetN(s, pages, count * width)) != BL_SIM_OK ||
+        (r = BL_Sim_Get(s, &checksum, BL_SIM_BYTE_TIMEOUT)) != BL_SIM_OK) {
+        return r;
+    }
+
+    uint8_t x = extended ? head[0] ^ head[1] : head[0];
+    for (uint32_t i = 0; i < count * width; i++) {
+        x ^= pages[i];
+    }
+    // The legacy global erase is confirmed with 0x00 instead of a checksum
+    if (!extended && special) {
+        x = 0x00;
+    }
+    if (x != checksum || (extended && special && n != 0xFFFF && n != 0xFFFE && n != 0xFFFD)) {
+        BL_Sim_Nack(s);
+        return BL_SIM_OK;
+    }
+    if (BL_Sim_Chance(s, s->cfg.nack)) {
+        s->stats.injected_nacks++;
+        BL_Sim_Nack(s);
+        return BL_SIM_OK;
+    }
+
+    if (special) {
+        uint16_t half = s->cfg.sector_count / 2;
+        if (n == 0xFFFE || n == 0xFFFD) { // bank 1, bank 2
+            uint16_t first = (n == 0xFFFE) ? 0 : half;
+            for (uint16_t i = 0; i < half; i++) {
+                BL_Sim_EraseSector(s, first + i);
+            }
+            BL_Sim_Busy(s, (uint64_t)s->cfg.mass_erase_ms * 1000);
+        } else {
+            BL_Sim_MassErase(s);
+        }
+        BL_Sim_Ack(s);
+        return BL_SIM_OK;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t page = extended ? (uint16_t)((pages[2 * i] << 8) | pages[2 * i + 1]) : pages[i];
+        if (page >= s->cfg.sector_count) {
+            BL_Sim_Nack(s);
+            return BL_SIM_OK;
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t page = extended ? (uint16_t)((pages[2 * i] << 8) | pages[2 * i + 1]) : pages[i];
+        BL_Sim_EraseSector(s, page);
+    }
+    BL_Sim_Busy(s, (uint64_t)count * s->cfg.erase_ms * 1000);
+    BL_Sim_Ack(s);
+    return BL_SIM_OK;
+}
+
+// CRC with the polynomial and init the host sends
+static BL_SimIo_t BL_Sim_CmdGetChecksum(BL_Sim_t *s) {
+    uint32_t address, length, polynomial, crc;
+    bool ok, flash;
+    BL_SimIo_t r;
+
+    BL_Sim_Ack(s);
+    if ((r = BL_Sim_GetWord(s, &address, &ok)) != BL_SIM_OK) {
+        return r;
+    }
+    if (!ok || (address & 3) != 0) {
+        BL_Sim_Nack(s);
+        return BL_SIM_OK;
+    }
+    BL_Sim_Ack(s);
+    if ((r = BL_Sim_GetWord(s, &length, &ok)) != BL_SIM_OK) {
+        return r;
+    }
+    const uint8_t *data = BL_Sim_Memory(s, address, length, &flash);
+    if (!ok || (length & 3) != 0 || data == NULL) {
+        BL_Sim_Nack(s);
+        return BL_SIM_OK;
+    }
+    BL_Sim_Ack(s);
+    if ((r = BL_Sim_GetWord(s, &polynomial, &ok)) != BL_SIM_OK) {
+        return r;
+    }
+    ok ? BL_Sim_Ack(s) : BL_Sim_Nack(s);
+    if (!ok) {
+        return BL_SIM_OK;
+    }
+    if ((r = BL_Sim_GetWord(s, &crc, &ok)) != BL_SIM_OK) {
+        return r;
+    }
+    ok ? BL_Sim_Ack(s) : BL_Sim_Nack(s);
+    if (!ok) {
+        return BL_SIM_OK;
+    }
+
+    crc = BL_Sim_Crc(crc, polynomial, data, length);
+
+    uint8_t out[5] = {crc >> 24, crc >> 16, crc >> 8, crc};
+    out[4] = out[0] ^ out[1] ^ out[2] ^ out[3];
+    BL_Sim_Ack(s);
+    BL_Sim_Put(s, out, 5);
+    return BL_SIM_OK;
+}
+
+// Protection changes end with a system reset, the host has to sync again.
+// Readout unprotect mass erases the flash on the way.
+static BL_SimIo_t BL_Sim_CmdProtection(BL_Sim_t *s, uint8_t cmd) {
+    BL_Sim_Ack(s);
+    if (cmd == BL_CMD_WRITE_PROTECT) {
+        uint8_t count, sectors[256], checksum;
+        BL_SimIo_t r;
+        if ((r = BL_Sim_Get(s, &count, BL_SIM_BYTE_TIMEOUT)) != BL_SIM_OK ||
+            (r = BL_Sim_GetN(s, sectors, count + 1)) != BL_SIM_OK ||
+            (r = BL_Sim_Get(s, &checksum, BL_SIM_BYTE_TIMEOUT)) != BL_SIM_OK) {
+            return r;
+        }
+    }
+    if (cmd == BL_CMD_READOUT_UNPROTECT) {
+        BL_Sim_MassErase(s);
+    }
+    BL_Sim_Ack(s);
+    BL_Sim_Reset(s);
+    return BL_SIM_OK;
+}
+
+/* ********************** Flash loader ****************************** */
+
+static void BL_Sim_LoaderRespond(BL_Sim_t *s, uint8_t type, uint8_t seq, uint8_t status, uint32_t value) {
+    BL_LoaderResponse_t r = {BL_LDR_SYNC_STUB, type, seq, status, value, 0};
+
+    r.crc = BL_Sim_Crc(BL_CRC_INIT, BL_CRC_POLYNOMIAL, (const uint8_t *)&r, 8);
+    if (type == BL_LDR_NACK) {
+        s->stats.nacks++;
+    }
+    BL_Sim_Put(s, (const uint8_t *)&r, sizeof(r));
+}
+
+// Only the first frame dropped after the last good one is NACKed, with the
+// number of the frame the loader waits for. The host sends everything from
+// there again, NACKing what follows would make it start over every time.
+static void BL_Sim_LoaderDrop(BL_Sim_t *s, bool *dropped, uint8_t expected, uint8_t status) {
+    s->stats.loader_dropped++;
+    if (!*dropped) {
+        *dropped = true;
+        BL_Sim_LoaderRespond(s, BL_LDR_NACK, expected, status, 0);
+    }
+}
+
+// PackBits into exactly length bytes, the word padding after it is ignored
+static bool BL_Sim_Unpack(const uint8_t *in, uint16_t in_length, uint8_t *out, uint16_t length) {
+    uint16_t i = 0;
+    uint16_t o = 0;
+
+    while (o < length) {
+        if (i >= in_length) {
+            return false;
+        }
+        int8_t n = (int8_t)in[i++];
+        if (n >= 0) {
+            uint16_t count = n + 1;
+            if (i + count > in_length || o + count > length) {
+                return false;
+            }
+            memcpy(&out[o], &in[i], count);
+            i += count;
+            o += count;
+        } else if (n != -128) {
+            uint16_t count = 1 - n;
+            if (i >= in_length || o + count > length) {
+                return false;
+            }
+            memset(&out[o], in[i++], count);
+            o += count;
+        }
+    }
+    return true;
+}
+
+// Erase the sectors a write goes to that weren't erased since the loader
+// started, then program if the target bytes are blank
+static uint8_t BL_Sim_LoaderProgram(BL_Sim_t *s, uint8_t *erased, uint32_t address, const uint8_t *data,
+                                    uint16_t length) {
+    bool flash;
+    uint8_t *dest = BL_Sim_Memory(s, address, length, &flash);
+
+    if (dest == NULL || !flash || length == 0) {
+        return BL_LDR_ERR_RANGE;
+    }
+
+    uint32_t offset = address - s->cfg.flash_base;
+    for (uint32_t sector = offset / s->cfg.sector_size; sector <= (offset + length - 1) / s->cfg.sector_size;
+         sector++) {
+        if (!(erased[sector / 8] & (1 << (sector % 8)))) {
+            erased[sector / 8] |= 1 << (sector % 8);
+            BL_Sim_EraseSector(s, (uint16_t)sector);
+            BL_Sim_Busy(s, (uint64_t)s->cfg.erase_ms * 1000);
+        }
+    }
+
+    BL_Sim_Busy(s, (uint64_t)s->cfg.program_us * ((length + 255) / 256));
+    for (uint16_t i = 0; i < length; i++) {
+        if (dest[i] != 0xFF) {
+            return BL_LDR_ERR_FLASH;
+        }
+    }
+    memcpy(dest, data, length);
+    s->stats.bytes_written += length;
+    return BL_LDR_OK;
+}
+
+// The stub, from its HELLO until a GO frame (true) or the host closing the
+// line (false)
+static bool BL_Sim_Loader(BL_Sim_t *s) {
+    static uint8_t frame[BL_LOADER_FRAME_MAX] __attribute__((aligned(4)));
+    static uint8_t raw[BL_LOADER_PAYLOAD_MAX];
+    static uint8_t erased[0x10000 / 8];
+    BL_LoaderHeader_t *h = (BL_LoaderHeader_t *)frame;
+    uint8_t *payload = &frame[sizeof(*h)];
+    uint16_t payload_max = s->cfg.loader_payload > BL_LOADER_PAYLOAD_MAX ? BL_LOADER_PAYLOAD_MAX
+                                                                         : s->cfg.loader_payload;
+    uint8_t caps = s->cfg.loader_packbits ? BL_LDR_CAP_PACKBITS : 0;
+    uint8_t expected = 0;
+    bool dropped = false;
+    uint8_t last_type = BL_LDR_ACK; // response to the last accepted frame, for a copy of it
+    uint32_t last_value = 0;
+
+    memset(erased, 0, sizeof(erased));
+    s->stats.loader_starts++;
+    BL_Sim_LoaderRespond(s, BL_LDR_HELLO, 0, BL_LDR_VERSION,
+                         s->cfg.loader_window | (uint32_t)caps << 8 | (uint32_t)payload_max << 16);
+
+    while (true) {
+        BL_SimIo_t r = BL_Sim_Get(s, &frame[0], -1);
+        if (r == BL_SIM_CLOSED) {
+            return false;
+        }
+        if (frame[0] != BL_LDR_SYNC_HOST) {
+            continue;
+        }
+
+        // A length the loader can't take means a damaged header
+        r = BL_Sim_GetN(s, &frame[1], sizeof(*h) - 1);
+        bool sane = r == BL_SIM_OK && (h->length & 3) == 0 && h->length <= payload_max;
+        if (sane) {
+            r = BL_Sim_GetN(s, payload, h->length + 4);
+        }
+        if (r == BL_SIM_CLOSED) {
+            return false;
+        }
+        if (r == BL_SIM_TIMEOUT) {
+            s->stats.resyncs++;
+            continue;
+        }
+        uint32_t crc;
+        if (sane) {
+            memcpy(&crc, &payload[h->length], sizeof(crc));
+        }
+        if (!sane || BL_Sim_Crc(BL_CRC_INIT, BL_CRC_POLYNOMIAL, frame, sizeof(*h) + h->length) != crc) {
+            BL_Sim_LoaderDrop(s, &dropped, expected, BL_LDR_ERR_CRC);
+            continue;
+        }
+
+        // A frame sent again because its ACK was lost is acknowledged again,
+        // one from further ahead means the one in between was lost
+        if (h->seq != expected) {
+            uint8_t behind = expected - h->seq;
+            if (behind == 1) {
+                BL_Sim_LoaderRespond(s, last_type, h->seq, BL_LDR_OK, last_value);
+            } else if (behind <= s->cfg.loader_window) {
+                BL_Sim_LoaderRespond(s, BL_LDR_ACK, h->seq, BL_LDR_OK, 0);
+            } else {
+                BL_Sim_LoaderDrop(s, &dropped, expected, BL_LDR_ERR_SEQ);
+            }
+            continue;
+        }
+        if (BL_Sim_Chance(s, s->cfg.nack)) {
+            s->stats.injected_nacks++;
+            BL_Sim_LoaderDrop(s, &dropped, expected, BL_LDR_ERR_CRC);
+            continue;
+        }
+
+        uint8_t status = BL_LDR_OK;
+        uint32_t value = 0;
+        const uint8_t *data = payload;
+        bool go = false;
+        switch (h->type) {
+        case BL_LDR_PROGRAM:
+            if (h->flags & BL_LDR_FLAG_PACKBITS) {
+                if (!caps || h->raw_length > sizeof(raw) || !BL_Sim_Unpack(payload, h->length, raw, h->raw_length)) {
+                    status = BL_LDR_ERR_FRAME;
+                    break;
+                }
+                data = raw;
+            } else if (h->raw_length > h->length) {
+                status = BL_LDR_ERR_FRAME;
+                break;
+            }
+            status = BL_Sim_LoaderProgram(s, erased, h->address, data, h->raw_length);
+            value = h->address;
+            break;
+        case BL_LDR_CHECKSUM: {
+            bool flash;
+            uint32_t length;
+            memcpy(&length, payload, sizeof(length));
+            const uint8_t *memory = BL_Sim_Memory(s, h->address, length, &flash);
+            if (h->raw_length != sizeof(length) || (h->address & 3) != 0 || (length & 3) != 0 || memory == NULL) {
+                status = BL_LDR_ERR_RANGE;
+                value = h->address;
+                break;
+            }
+            value = BL_Sim_Crc(BL_CRC_INIT, BL_CRC_POLYNOMIAL, memory, length);
+            break;
+        }
+        case BL_LDR_GO:
+            go = true;
+            break;
+        default:
+            status = BL_LDR_ERR_FRAME;
+            break;
+        }
+
+        if (status != BL_LDR_OK) {
+            BL_Sim_LoaderRespond(s, BL_LDR_NACK, h->seq, status, value);
+            continue;
+        }
+        last_type = (h->type == BL_LDR_CHECKSUM) ? BL_LDR_RESULT : BL_LDR_ACK;
+        last_value = (h->type == BL_LDR_CHECKSUM) ? value : 0;
+        BL_Sim_LoaderRespond(s, last_type, h->seq, BL_LDR_OK, last_value);
+        s->stats.loader_frames++;
+        expected++;
+        dropped = false;
+        if (go) {
+            return true;
+        }
+    }
+}
+
+/* ********************** Model ****************************** */
+
+bool BL_Sim_Init(BL_Sim_t *s, const BL_SimConfig_t *cfg) {
+    memset(s, 0, sizeof(*s));
+    s->cfg = *cfg;
+    s->random = cfg->seed ? cfg->seed : 1;
+    s->flash = malloc((size_t)cfg->sector_size * cfg->sector_count);
+    s->ram = calloc(1, BL_SIM_RAM_SIZE);
+    if (s->flash == NULL || s->ram == NULL) {
+        BL_Sim_Free(s);
+        return false;
+    }
+    memset(s->flash, 0xFF, (size_t)cfg->sector_size * cfg->sector_count);
+    return true;
+}
+
+void BL_Sim_Free(BL_Sim_t *s) {
+    free(s->flash);
+    free(s->ram);
+    s->flash = NULL;
+    s->ram = NULL;
+}
+
+void BL_Sim_Reset(BL_Sim_t *s) {
+    s->synced = false;
+}
+
+bool BL_Sim_Run(BL_Sim_t *s, int fd) {
+    s->fd = fd;
+    rx_len = rx_pos = 0;
+
+    while (true) {
+        uint8_t cmd, complement;
+        BL_SimIo_t r = BL_Sim_Get(s, &cmd, -1);
+        if (r == BL_SIM_CLOSED) {
+            return false;
+        }
+
+        // Autobaud: everything before the first 0x7F is noise
+        if (!s->synced) {
+            if (cmd == BL_INIT_FRAME) {
+                s->synced = true;
+                BL_Sim_Ack(s);
+            }
+            continue;
+        }
+
+        r = BL_Sim_Get(s, &complement, BL_SIM_BYTE_TIMEOUT);
+        if (r == BL_SIM_CLOSED) {
+            return false;
+        }
+        if (r == BL_SIM_TIMEOUT) {
+            s->stats.resyncs++;
+            continue;
+        }
+        if ((uint8_t)(cmd ^ complement) != 0xFF || !BL_Sim_Supported(s, cmd)) {
+            BL_Sim_Nack(s);
+            continue;
+        }
+
+        s->stats.commands++;
+        bool jumped = false;
+        uint32_t entry = 0;
+        switch (cmd) {
+        case BL_CMD_GET:            r = BL_Sim_CmdGet(s); break;
+        case BL_CMD_GET_VERSION:    r = BL_Sim_CmdGetVersion(s); break;
+        case BL_CMD_GET_ID:         r = BL_Sim_CmdGetId(s); break;
+        case BL_CMD_READ_MEMORY:    r = BL_Sim_CmdRead(s); break;
+        case BL_CMD_GO:             r = BL_Sim_CmdGo(s, &jumped, &entry); break;
+        case BL_CMD_WRITE_MEMORY:   r = BL_Sim_CmdWrite(s); break;
+        case BL_CMD_ERASE:          r = BL_Sim_CmdErase(s, false); break;
+        case BL_CMD_EXTENDED_ERASE: r = BL_Sim_CmdErase(s, true); break;
+        case BL_CMD_GET_CHECKSUM:   r = BL_Sim_CmdGetChecksum(s); break;
+        default:                    r = BL_Sim_CmdProtection(s, cmd); break;
+        }
+
+        if (r == BL_SIM_CLOSED) {
+            return false;
+        }
+        if (r == BL_SIM_TIMEOUT) {
+            s->stats.resyncs++;
+        }
+        if (jumped) {
+            bool flash;
+            if (s->cfg.loader && BL_Sim_Memory(s, entry, 4, &flash) != NULL && !flash) {
+                return BL_Sim_Loader(s);
+            }
+            return true;
+        }
+    }
+}
+
+bool BL_Sim_LoadFlash(BL_Sim_t *s, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    size_t n = fread(s->flash, 1, (size_t)s->cfg.sector_size * s->cfg.sector_count, f);
+    fclose(f);
+    return n > 0;
+}
+
+bool BL_Sim_SaveFlash(const BL_Sim_t *s, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return false;
+    }
+    size_t size = (size_t)s->cfg.sector_size * s->cfg.sector_count;
+    bool ok = fwrite(s->flash, 1, size, f) == size;
+    return fclose(f) == 0 && ok;
+}
+
+void BL_Sim_Report(const BL_Sim_t *s, FILE *out) {
+    const BL_SimStats_t *st = &s->stats;
+    fprintf(out, "Sim: %u commands, %u bytes written, %u sectors erased, %u mass erases\n",
+            st->commands, st->bytes_written, st->sectors_erased, st->mass_erases);
+    fprintf(out, "Sim: %u NACKs (%u injected), %u/%u bytes lost rx/tx, %u abandoned commands\n",
+            st->nacks, st->injected_nacks, st->lost_rx, st->lost_tx, st->resyncs);
+    if (st->loader_starts > 0) {
+        fprintf(out, "Sim: flash loader started %u times, %u frames accepted, %u dropped\n", st->loader_starts,
+                st->loader_frames, st->loader_dropped);
+    }
+}
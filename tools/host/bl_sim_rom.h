@@ -0,0 +1,113 @@
+/*
+ * bl_sim_rom.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef HOST_BL_SIM_ROM_H_
+#define HOST_BL_SIM_ROM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Software model of the STM32 ROM bootloader on the USART (AN3155): 0x7F
+// sync, command + complement, ACK/NACK after every step, XOR checksums,
+// the GET/GET_VERSION/GET_ID, Read, Go, Write, Erase, Extended Erase and
+// Get Checksum commands, and the protection commands (which reset the
+// model like they reset the chip).
+//
+// Memory is a flash of equal sectors plus a RAM. Flash can only be written
+// where it is erased (0xFF), like on the parts with ECC, so a missing erase
+// shows up as a NACK.
+//
+// Timing: every byte costs 11 bit times (8E1) at the configured rate in
+// both directions, erases and writes hold back their final ACK for the
+// programmed time, and latency_us delays every ACK and NACK. Faults: each
+// byte on the line is lost with probability loss, each final ACK of Write
+// or Erase turns into a NACK with probability nack.
+//
+// With loader set, a Go into RAM starts a model of the RAM flash loader stub
+// (bl_loader.h) instead of the application: HELLO, windowed frames checked
+// with CRC-32, cumulative ACKs, a NACK for the first frame it drops, PackBits
+// payloads, and an erase before the first write into a sector. Loss and
+// NACK injection apply to its frames too. Unlike the stub, the model
+// doesn't receive while the flash is busy.
+//
+// The real bootloader waits forever in the middle of a command. The model
+// gives up after BL_SIM_BYTE_TIMEOUT of silence and waits for the next
+// command, so a lost byte doesn't wedge a run.
+
+#define BL_SIM_BYTE_TIMEOUT 1000 // ms
+#define BL_SIM_RAM_BASE     0x20000000
+#define BL_SIM_RAM_SIZE     (128 * 1024)
+
+typedef struct {
+    uint32_t baudrate;       // wire time model, 0: no wire time
+    uint32_t latency_us;     // added before every ACK/NACK
+    uint32_t erase_ms;       // per sector
+    uint32_t mass_erase_ms;
+    uint32_t program_us;     // per Write Memory
+    double loss;             // probability a byte is lost, per direction
+    double nack;             // probability a Write/Erase fails with NACK
+    uint32_t seed;
+    bool extended_erase;     // 0x44 instead of 0x43 in the command list
+    bool get_checksum;       // 0xA1 in the command list
+    uint8_t version;         // bootloader version
+    uint16_t pid;            // product ID for GET ID
+    uint32_t flash_base;
+    uint32_t sector_size;
+    uint16_t sector_count;
+    bool loader;             // Go into RAM runs the flash loader model
+    uint8_t loader_window;
+    uint16_t loader_payload; // largest frame payload the loader takes
+    bool loader_packbits;
+} BL_SimConfig_t;
+
+// 2 KiB pages from 0x08000000 like BL_FLASH_DEFAULT_LAYOUT, 115200 baud,
+// the typical erase and program times of those parts
+#define BL_SIM_DEFAULT_CONFIG { \
+    .baudrate = 115200, .latency_us = 0, .erase_ms = 22, .mass_erase_ms = 25, .program_us = 300, \
+    .loss = 0, .nack = 0, .seed = 1, .extended_erase = true, .get_checksum = true, \
+    .version = 0x31, .pid = 0x450, .flash_base = 0x08000000, .sector_size = 2048, .sector_count = 512, \
+    .loader = false, .loader_window = 4, .loader_payload = 4096, .loader_packbits = true }
+
+typedef struct {
+    uint32_t commands;
+    uint32_t nacks;          // all NACKs sent
+    uint32_t injected_nacks;
+    uint32_t lost_rx;        // bytes from the host dropped
+    uint32_t lost_tx;        // bytes to the host dropped
+    uint32_t bytes_written;
+    uint32_t sectors_erased;
+    uint32_t mass_erases;
+    uint32_t resyncs;        // commands abandoned after a timeout
+    uint32_t loader_starts;
+    uint32_t loader_frames;  // frames the loader accepted
+    uint32_t loader_dropped; // frames it dropped (CRC, order, injected)
+} BL_SimStats_t;
+
+typedef struct {
+    BL_SimConfig_t cfg;
+    BL_SimStats_t stats;
+    int fd;
+    uint8_t *flash;
+    uint8_t *ram;
+    bool synced;
+    uint64_t rx_clock;       // arrival time of the last byte read, us
+    uint32_t random;
+} BL_Sim_t;
+
+bool BL_Sim_Init(BL_Sim_t *s, const BL_SimConfig_t *cfg);
+void BL_Sim_Free(BL_Sim_t *s);
+// Back to the state after a reset with BOOT0 high, memory is kept
+void BL_Sim_Reset(BL_Sim_t *s);
+// Serve fd until it closes (returns false) or the host sends Go (returns
+// true, the model then counts as running the application)
+bool BL_Sim_Run(BL_Sim_t *s, int fd);
+// Flash contents from/to a file, so runs can build on each other
+bool BL_Sim_LoadFlash(BL_Sim_t *s, const char *path);
+bool BL_Sim_SaveFlash(const BL_Sim_t *s, const char *path);
+void BL_Sim_Report(const BL_Sim_t *s, FILE *out);
+
+#endif /* HOST_BL_SIM_ROM_H_ */
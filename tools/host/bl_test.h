@@ -0,0 +1,35 @@
+/*
+ * bl_test.h
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Minimal checks for the host tests in this directory (bl_test_*.c). A
+ * failed check prints where and why and the test goes on, BL_TEST_DONE
+ * makes the exit code. build.sh builds and runs every test.
+ */
+
+#ifndef HOST_BL_TEST_H_
+#define HOST_BL_TEST_H_
+
+#include <stdio.h>
+
+static unsigned bl_test_checks;
+static unsigned bl_test_failures;
+
+#define BL_TEST_CHECK(cond, ...)                                     \
+    do {                                                             \
+        bl_test_checks++;                                            \
+        if (!(cond)) {                                               \
+            bl_test_failures++;                                      \
+            printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+            printf(__VA_ARGS__);                                     \
+            printf("\n");                                            \
+        }                                                            \
+    } while (0)
+
+// Result line of the test, evaluates to its exit code
+#define BL_TEST_DONE(name)                                                                     \
+    (printf("%s: %u checks, %u failed\n", (name), bl_test_checks, bl_test_failures),          \
+     bl_test_failures != 0)
+
+#endif /* HOST_BL_TEST_H_ */
@@ -0,0 +1,328 @@
+/*
+ * bl_test_coalesce.c
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Host test of the HEX parser and the coalescer (Common/Src/bl_hex.c,
+ * bl_coalesce.c) against a naive writer that sends every data record as a
+ * frame of its own:
+ *
+ *     _host/bl_test_coalesce tools/host/fixtures/blinky.hex [more.hex ...]
+ *
+ * Both writers are expanded into the bytes they write, in order and with
+ * their addresses, and have to match byte for byte. Every coalesced frame
+ * has to stay inside one 256 byte aligned block. Randomly generated record
+ * streams run through the same comparison, and truncated lines have to be
+ * rejected. With a flash word set, frames in the padded range have to be
+ * whole flash words, each written once, with 0xFF only where no record
+ * put data.
+ */
+
+#include "bl_test.h"
+#include "bl_hex.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Bytes a writer wrote, in order
+typedef struct {
+    uint32_t *address;
+    uint8_t *data;
+    uint32_t count;
+    uint32_t size;
+    uint32_t frames;
+} Writes_t;
+
+static void Writes_Add(Writes_t *w, uint32_t address, const uint8_t *data, uint16_t length) {
+    if (w->count + length > w->size) {
+        w->size = (w->count + length) * 2;
+        w->address = realloc(w->address, w->size * sizeof(*w->address));
+        w->data = realloc(w->data, w->size);
+    }
+    for (uint16_t i = 0; i < length; i++) {
+        w->address[w->count] = address + i;
+        w->data[w->count++] = data[i];
+    }
+    w->frames++;
+}
+
+static void Writes_Free(Writes_t *w) {
+    free(w->address);
+    free(w->data);
+    memset(w, 0, sizeof(*w));
+}
+
+static bool Coalesced(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    BL_TEST_CHECK(length > 0 && length <= BL_COALESCE_BLOCK_SIZE, "frame of %u bytes", length);
+    BL_TEST_CHECK(address / BL_COALESCE_BLOCK_SIZE == (address + length - 1) / BL_COALESCE_BLOCK_SIZE,
+                  "frame %08x+%u crosses a block", address, length);
+    Writes_Add(ctx, address, data, length);
+    return true;
+}
+
+static void Compare(const char *name, const Writes_t *naive, const Writes_t *coalesced) {
+    BL_TEST_CHECK(naive->count == coalesced->count, "%s: %u bytes naive, %u coalesced", name, naive->count,
+                  coalesced->count);
+    for (uint32_t i = 0; i < naive->count && i < coalesced->count; i++) {
+        if (naive->address[i] != coalesced->address[i] || naive->data[i] != coalesced->data[i]) {
+            BL_TEST_CHECK(false, "%s: byte %u: %02x at %08x naive, %02x at %08x coalesced", name, i,
+                          naive->data[i], naive->address[i], coalesced->data[i], coalesced->address[i]);
+            break;
+        }
+    }
+}
+
+/* ********************** Naive writer ****************************** */
+
+static uint8_t Byte(const char *s) {
+    unsigned v;
+    sscanf(s, "%2x", &v);
+    return (uint8_t)v;
+}
+
+// One frame per data record, with a parser of its own
+static bool NaiveFile(const char *path, Writes_t *w, uint32_t *start) {
+    FILE *f = fopen(path, "r");
+    char line[BL_HEX_LINE_MAX + 2];
+    uint32_t base = 0;
+
+    if (f == NULL) {
+        return false;
+    }
+    *start = 0xFFFFFFFF;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (line[0] != ':') {
+            continue;
+        }
+        uint8_t count = Byte(&line[1]);
+        uint16_t address = (Byte(&line[3]) << 8) | Byte(&line[5]);
+        uint8_t type = Byte(&line[7]);
+        uint8_t data[256];
+        for (uint16_t i = 0; i < count; i++) {
+            data[i] = Byte(&line[9 + 2 * i]);
+        }
+        if (type == 0x00) {
+            Writes_Add(w, base + address, data, count);
+        } else if (type == 0x04) {
+            base = (uint32_t)(data[0] << 8 | data[1]) << 16;
+        } else if (type == 0x05) {
+            *start = (uint32_t)data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+        } else if (type == 0x01) {
+            break;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/* ********************** Tests ****************************** */
+
+static void TestFile(const char *path) {
+    static BL_Coalescer_t coalescer;
+    static BL_HexParser_t parser;
+    Writes_t naive = {0}, coalesced = {0};
+    uint32_t start;
+    char line[BL_HEX_LINE_MAX + 2];
+
+    if (!NaiveFile(path, &naive, &start)) {
+        BL_TEST_CHECK(false, "can't open %s", path);
+        return;
+    }
+
+    FILE *f = fopen(path, "r");
+    BL_Coalescer_Init(&coalescer, Coalesced, &coalesced);
+    BL_HexParser_Init(&parser, &coalescer);
+    uint32_t records = 0;
+    while (!parser.eof && fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\r\n")] = 0;
+        BL_TEST_CHECK(BL_ProcessHexLine(&parser, line), "%s: line %s rejected", path, line);
+        records++;
+    }
+    fclose(f);
+    BL_TEST_CHECK(BL_Coalescer_Flush(&coalescer), "%s: flush", path);
+
+    BL_TEST_CHECK(parser.eof, "%s: no EOF record", path);
+    BL_TEST_CHECK(parser.start_address == start, "%s: start %08x, expected %08x", path, parser.start_address,
+                  start);
+    BL_TEST_CHECK(coalesced.frames <= naive.frames, "%s: %u frames for %u records", path, coalesced.frames,
+                  naive.frames);
+    Compare(path, &naive, &coalesced);
+    printf("%s: %u lines, %u records in %u frames\n", path, records, naive.frames, coalesced.frames);
+
+    Writes_Free(&naive);
+    Writes_Free(&coalesced);
+}
+
+// Lines that end before their record does are rejected without reading
+// past the terminator, each is copied to a buffer of exactly its size
+static void TestShortLines(void) {
+    static const char *const lines[] = {
+        ":", ":1", ":10", ":100000", ":10000000", ":1000000000", ":0000000",
+        ":00000001", ":00000001F", ":020000040800", ":10000000000102030405060708090A0B0C0D0E0F",
+    };
+    static BL_Coalescer_t coalescer;
+    static BL_HexParser_t parser;
+    Writes_t w = {0};
+
+    BL_Coalescer_Init(&coalescer, Coalesced, &w);
+    for (uint16_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+        size_t size = strlen(lines[i]) + 1;
+        char *line = malloc(size);
+        memcpy(line, lines[i], size);
+        BL_HexParser_Init(&parser, &coalescer);
+        BL_TEST_CHECK(!BL_ProcessHexLine(&parser, line), "short line %s accepted", lines[i]);
+        free(line);
+    }
+    BL_TEST_CHECK(w.count == 0, "%u bytes written from short lines", w.count);
+    Writes_Free(&w);
+}
+
+// Random records pushed straight into the coalescer: runs, gaps, jumps
+// back, lengths up to the largest record
+static void TestRandom(uint32_t seed) {
+    static BL_Coalescer_t coalescer;
+    Writes_t naive = {0}, coalesced = {0};
+    uint8_t data[255];
+    uint32_t address = 0x08000000 + (seed % 256);
+    char name[32];
+
+    srand(seed);
+    snprintf(name, sizeof(name), "random seed %u", seed);
+    BL_Coalescer_Init(&coalescer, Coalesced, &coalesced);
+    for (uint16_t i = 0; i < 2000; i++) {
+        uint16_t length = 1 + rand() % (rand() % 4 ? 32 : 255);
+        for (uint16_t j = 0; j < length; j++) {
+            data[j] = rand();
+        }
+        Writes_Add(&naive, address, data, length);
+        BL_TEST_CHECK(BL_Coalescer_Push(&coalescer, address, data, length), "%s: push", name);
+
+        address += length;
+        switch (rand() % 8) {
+        case 0: address += 1 + rand() % 300; break;
+        case 1: address -= rand() % 2000; break;
+        default: break;
+        }
+    }
+    BL_TEST_CHECK(BL_Coalescer_Flush(&coalescer), "%s: flush", name);
+    BL_TEST_CHECK(coalescer.bytes == naive.count, "%s: %u bytes counted, %u written", name, coalescer.bytes,
+                  naive.count);
+    Compare(name, &naive, &coalesced);
+
+    Writes_Free(&naive);
+    Writes_Free(&coalesced);
+}
+
+// Every byte of the address space of TestFlashWord: what the records put
+// there (-1 for nothing) and how often a frame wrote it
+#define PAD_BASE  0x08000000
+#define PAD_SPAN  (64 * 1024)
+#define PAD_START (PAD_BASE + 4096)
+#define PAD_END   (PAD_BASE + PAD_SPAN - 4096)
+
+typedef struct {
+    uint16_t flash_word;
+    int16_t expected[PAD_SPAN];
+    uint8_t written[PAD_SPAN];
+    uint8_t value[PAD_SPAN];
+} Padded_t;
+
+static bool PaddedFrame(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    Padded_t *p = ctx;
+    uint16_t word = p->flash_word;
+
+    BL_TEST_CHECK(length > 0 && length <= BL_COALESCE_BLOCK_SIZE, "frame of %u bytes", length);
+    BL_TEST_CHECK(address / BL_COALESCE_BLOCK_SIZE == (address + length - 1) / BL_COALESCE_BLOCK_SIZE,
+                  "frame %08x+%u crosses a block", address, length);
+    BL_TEST_CHECK(address >= PAD_BASE && address + length <= PAD_BASE + PAD_SPAN, "frame %08x+%u out of range",
+                  address, length);
+    if (address >= PAD_START && address < PAD_END) {
+        BL_TEST_CHECK((address & (word - 1)) == 0 && (length & (word - 1)) == 0,
+                      "frame %08x+%u not in whole %u byte words", address, length, word);
+    }
+    for (uint16_t i = 0; i < length && address + i - PAD_BASE < PAD_SPAN; i++) {
+        p->written[address + i - PAD_BASE]++;
+        p->value[address + i - PAD_BASE] = data[i];
+    }
+    return true;
+}
+
+// Random records, forward only and never overlapping, so every byte is
+// written at most once. Gaps are short, many of them end in the flash word
+// they start in.
+static void TestFlashWord(uint32_t seed, uint16_t flash_word) {
+    static BL_Coalescer_t coalescer;
+    static Padded_t p;
+    uint8_t data[255];
+    uint32_t address = PAD_BASE + seed % 64;
+    char name[48];
+
+    srand(seed);
+    snprintf(name, sizeof(name), "flash word %u seed %u", flash_word, seed);
+    memset(&p, 0, sizeof(p));
+    memset(p.expected, 0xFF, sizeof(p.expected));
+    p.flash_word = flash_word;
+    BL_Coalescer_Init(&coalescer, PaddedFrame, &p);
+    BL_Coalescer_SetFlashWord(&coalescer, flash_word, PAD_START, PAD_END);
+
+    while (true) {
+        uint16_t length = 1 + rand() % (rand() % 4 ? 32 : 255);
+        if (address + length > PAD_BASE + PAD_SPAN - BL_COALESCE_BLOCK_SIZE) {
+            break;
+        }
+        for (uint16_t j = 0; j < length; j++) {
+            data[j] = rand();
+            p.expected[address + j - PAD_BASE] = data[j];
+        }
+        BL_TEST_CHECK(BL_Coalescer_Push(&coalescer, address, data, length), "%s: push", name);
+        address += length;
+        if (rand() % 4 == 0) {
+            address += 1 + rand() % (rand() % 4 ? flash_word : 300);
+        }
+    }
+    BL_TEST_CHECK(BL_Coalescer_Flush(&coalescer), "%s: flush", name);
+
+    for (uint32_t i = 0; i < PAD_SPAN; i++) {
+        uint32_t at = PAD_BASE + i;
+        bool padded = at >= PAD_START && at < PAD_END;
+        if (p.written[i] > 1) {
+            BL_TEST_CHECK(false, "%s: %08x written %u times", name, at, p.written[i]);
+            break;
+        }
+        if (p.expected[i] >= 0 && (!p.written[i] || p.value[i] != p.expected[i])) {
+            BL_TEST_CHECK(false, "%s: %08x should be %02x", name, at, p.expected[i]);
+            break;
+        }
+        if (p.expected[i] < 0 && p.written[i] && (!padded || p.value[i] != 0xFF)) {
+            BL_TEST_CHECK(false, "%s: %08x written with %02x where no record put data", name, at, p.value[i]);
+            break;
+        }
+        // Padding only completes words that have data
+        if (p.expected[i] < 0 && p.written[i]) {
+            uint32_t word = i & ~(uint32_t)(flash_word - 1);
+            bool data_in_word = false;
+            for (uint32_t j = word; j < word + flash_word; j++) {
+                data_in_word |= p.expected[j] >= 0;
+            }
+            if (!data_in_word) {
+                BL_TEST_CHECK(false, "%s: %08x padded in a word without data", name, at);
+                break;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        TestFile(argv[i]);
+    }
+    TestShortLines();
+    for (uint32_t seed = 1; seed <= 20; seed++) {
+        TestRandom(seed);
+    }
+    for (uint16_t flash_word = 2; flash_word <= BL_COALESCE_BLOCK_SIZE; flash_word *= 2) {
+        for (uint32_t seed = 1; seed <= 5; seed++) {
+            TestFlashWord(seed, flash_word);
+        }
+    }
+    return BL_TEST_DONE("bl_test_coalesce");
+}
@@ -0,0 +1,268 @@
+/*
+ * bl_test_pipe.c
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Host test of the two HEX parse paths of the CM7 against each other:
+ *
+ *     _host/bl_test_pipe tools/host/fixtures/blinky.hex [more.hex ...]
+ *
+ * The local path is the loop of BL_ParseHexLocal, the line reader
+ * (CM7/Core/Src/bl_lines.c) over the FatFs API of ff_posix.c. The pipe
+ * path is the line splitter the CM4 worker of bl_pipe.c runs on the text
+ * ring, fed in pieces of random size like the ring hands them out. Both
+ * have to accept or reject the same files and produce the same block
+ * stream, start address and record count. Besides the files given, both
+ * get generated files with records of 255 bytes, blank lines, CRLF and LF
+ * endings, a last line without a line ending and lines that are too long.
+ */
+
+#include "bl_test.h"
+#include "bl_hex.h"
+#include "bl_lines.h"
+#include "fatfs.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void FF_Posix_SetRoot(const char *dir);
+
+// Blocks a path produced, in order
+typedef struct {
+    uint32_t *address;
+    uint16_t *length;
+    uint8_t *data;       // BL_COALESCE_BLOCK_SIZE per block
+    uint32_t count;
+    uint32_t size;
+} Blocks_t;
+
+typedef struct {
+    bool ok;
+    uint32_t start_address;
+    uint32_t records;
+    Blocks_t blocks;
+} Result_t;
+
+static bool Blocks_Add(void *ctx, uint32_t address, const uint8_t *data, uint16_t length) {
+    Blocks_t *b = ctx;
+    if (b->count == b->size) {
+        b->size = b->size ? b->size * 2 : 64;
+        b->address = realloc(b->address, b->size * sizeof(*b->address));
+        b->length = realloc(b->length, b->size * sizeof(*b->length));
+        b->data = realloc(b->data, (size_t)b->size * BL_COALESCE_BLOCK_SIZE);
+    }
+    b->address[b->count] = address;
+    b->length[b->count] = length;
+    memcpy(&b->data[(size_t)b->count * BL_COALESCE_BLOCK_SIZE], data, length);
+    b->count++;
+    return true;
+}
+
+static void Result_Free(Result_t *r) {
+    free(r->blocks.address);
+    free(r->blocks.length);
+    free(r->blocks.data);
+    memset(r, 0, sizeof(*r));
+}
+
+/* ********************** Parse paths ****************************** */
+
+static const char *dir;
+
+// BL_ParseHexLocal: lines straight from the read buffer of the line reader
+static void ParseLocal(const char *text, size_t size, Result_t *r) {
+    static BL_Coalescer_t coalescer;
+    static BL_HexParser_t parser;
+    static BL_LineReader_t reader;
+    char path[256];
+    FIL file;
+    BL_Line_t line;
+
+    snprintf(path, sizeof(path), "%s/TEST.HEX", dir);
+    FILE *f = fopen(path, "wb");
+    fwrite(text, 1, size, f);
+    fclose(f);
+
+    BL_Coalescer_Init(&coalescer, Blocks_Add, &r->blocks);
+    BL_HexParser_Init(&parser, &coalescer);
+    r->ok = f_open(&file, "TEST.HEX", FA_READ) == FR_OK;
+    BL_LineReader_Init(&reader, &file);
+    while (r->ok) {
+        r->ok = BL_LineReader_Next(&reader, &line);
+        if (!r->ok || line.text == NULL) {
+            break;
+        }
+        r->ok = BL_ProcessHexLine(&parser, line.text);
+    }
+    f_close(&file);
+    r->ok = r->ok && BL_Coalescer_Flush(&coalescer);
+    r->start_address = parser.start_address;
+    r->records = parser.records;
+}
+
+// BL_Pipe_Parse: the text in pieces of random size
+static void ParsePipe(const char *text, size_t size, Result_t *r) {
+    static BL_Coalescer_t coalescer;
+    static BL_HexParser_t parser;
+    static BL_HexLines_t lines;
+    size_t done = 0;
+
+    BL_Coalescer_Init(&coalescer, Blocks_Add, &r->blocks);
+    BL_HexParser_Init(&parser, &coalescer);
+    BL_HexLines_Init(&lines, &parser);
+    r->ok = true;
+    while (r->ok && done < size) {
+        size_t n = 1 + rand() % (rand() % 4 ? 64 : 2048);
+        if (n > size - done) {
+            n = size - done;
+        }
+        r->ok = BL_HexLines_Feed(&lines, &text[done], n);
+        done += n;
+    }
+    r->ok = r->ok && BL_HexLines_End(&lines) && BL_Coalescer_Flush(&coalescer);
+    r->start_address = parser.start_address;
+    r->records = parser.records;
+}
+
+// Both paths on text, expect: whether they have to accept it
+static void Compare(const char *name, const char *text, size_t size, bool expect) {
+    Result_t local = {0}, pipe = {0};
+
+    ParseLocal(text, size, &local);
+    ParsePipe(text, size, &pipe);
+
+    BL_TEST_CHECK(local.ok == expect, "%s: %s locally", name, local.ok ? "accepted" : "rejected");
+    BL_TEST_CHECK(pipe.ok == expect, "%s: %s by the pipe", name, pipe.ok ? "accepted" : "rejected");
+    if (expect && local.ok && pipe.ok) {
+        BL_TEST_CHECK(local.start_address == pipe.start_address, "%s: start %08x locally, %08x by the pipe", name,
+                      local.start_address, pipe.start_address);
+        BL_TEST_CHECK(local.records == pipe.records, "%s: %u records locally, %u by the pipe", name,
+                      local.records, pipe.records);
+        BL_TEST_CHECK(local.blocks.count == pipe.blocks.count, "%s: %u blocks locally, %u by the pipe", name,
+                      local.blocks.count, pipe.blocks.count);
+        for (uint32_t i = 0; i < local.blocks.count && i < pipe.blocks.count; i++) {
+            const Blocks_t *a = &local.blocks, *b = &pipe.blocks;
+            if (a->address[i] != b->address[i] || a->length[i] != b->length[i] ||
+                memcmp(&a->data[(size_t)i * BL_COALESCE_BLOCK_SIZE], &b->data[(size_t)i * BL_COALESCE_BLOCK_SIZE],
+                       a->length[i]) != 0) {
+                BL_TEST_CHECK(false, "%s: block %u: %08x+%u locally, %08x+%u by the pipe", name, i, a->address[i],
+                              a->length[i], b->address[i], b->length[i]);
+                break;
+            }
+        }
+        printf("%s: %u records in %u blocks on both paths\n", name, local.records, local.blocks.count);
+    }
+    Result_Free(&local);
+    Result_Free(&pipe);
+}
+
+/* ********************** Inputs ****************************** */
+
+static void TestFile(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        BL_TEST_CHECK(false, "can't open %s", path);
+        return;
+    }
+    fseek(f, 0, SEEK_END);
+    size_t size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = malloc(size + 1);
+    size = fread(text, 1, size, f);
+    fclose(f);
+
+    Compare(path, text, size, true);
+    free(text);
+}
+
+static size_t Record(char *out, uint8_t type, uint16_t address, const uint8_t *data, uint8_t length,
+                     const char *ending) {
+    uint8_t sum = length + (address >> 8) + address + type;
+    size_t n = sprintf(out, ":%02X%04X%02X", length, address, type);
+    for (uint8_t i = 0; i < length; i++) {
+        n += sprintf(out + n, "%02X", data[i]);
+        sum += data[i];
+    }
+    return n + sprintf(out + n, "%02X%s", (uint8_t)-sum, ending);
+}
+
+// Records of every length up to 255 bytes with the given line ending,
+// blank lines in between, the end record without a line ending (and with
+// a lone CR when crlf)
+static void TestGenerated(const char *name, const char *ending, bool blank) {
+    char *text = malloc(1024 * 1024);
+    uint8_t data[255];
+    uint8_t upper[2] = {0x08, 0x00};
+    uint8_t start[4] = {0x08, 0x00, 0x01, 0x01};
+    uint32_t address = 0;
+    size_t n = 0;
+
+    n += Record(text + n, 0x04, 0, upper, 2, ending);
+    for (uint32_t length = 1; length <= 255; length += (length < 240) ? 7 : 1) {
+        for (uint32_t i = 0; i < length; i++) {
+            data[i] = rand();
+        }
+        if (address + length > 0x10000) {
+            upper[1]++;
+            address = 0;
+            n += Record(text + n, 0x04, 0, upper, 2, ending);
+        }
+        n += Record(text + n, 0x00, address, data, length, ending);
+        address += length + (rand() % 3 == 0 ? rand() % 64 : 0);
+        if (blank && rand() % 4 == 0) {
+            n += sprintf(text + n, "%s", ending);
+        }
+    }
+    n += Record(text + n, 0x05, 0, start, 4, ending);
+    n += Record(text + n, 0x01, 0, NULL, 0, strcmp(ending, "\r\n") == 0 ? "\r" : "");
+
+    Compare(name, text, n, true);
+    free(text);
+}
+
+// A record of 255 bytes with trailing characters: up to the limit with
+// the CR, and one past it
+static void TestLongLines(void) {
+    char text[2048];
+    uint8_t data[255] = {0};
+    size_t n;
+
+    n = Record(text, 0x00, 0, data, 255, "");
+    n += sprintf(text + n, "X\r\n");
+    Compare("522 characters and CR", text, n, false);
+
+    n = Record(text, 0x00, 0, data, 255, "");
+    n += sprintf(text + n, "\r\n");
+    Compare("521 characters and CR", text, n, true);
+
+    n = Record(text, 0x00, 0, data, 255, "");
+    n += sprintf(text + n, "X\n");
+    Compare("522 characters", text, n, true);
+}
+
+int main(int argc, char **argv) {
+    char tmp[] = "/tmp/bl_test_pipe.XXXXXX";
+
+    dir = mkdtemp(tmp);
+    if (dir == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    FF_Posix_SetRoot(dir);
+    srand(1);
+
+    for (int i = 1; i < argc; i++) {
+        TestFile(argv[i]);
+    }
+    TestGenerated("generated CRLF", "\r\n", false);
+    TestGenerated("generated LF", "\n", false);
+    TestGenerated("generated CRLF with blank lines", "\r\n", true);
+    TestGenerated("generated LF with blank lines", "\n", true);
+    TestLongLines();
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/TEST.HEX", dir);
+    unlink(path);
+    rmdir(dir);
+    return BL_TEST_DONE("bl_test_pipe");
+}
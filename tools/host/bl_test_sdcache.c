@@ -0,0 +1,190 @@
+/*
+ * bl_test_sdcache.c
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Host test of the SD sector cache (CM7/Core/Src/bl_sdcache.c) over a card
+ * in RAM. Random reads, writes and flushes go through the cache while a
+ * reference copy takes the writes directly:
+ *
+ *     _host/bl_test_sdcache
+ *
+ * Every read has to return the reference contents, and after every flush
+ * the card has to equal the reference. Requests mix a small hot area (hits
+ * and evictions), sequential runs (read-ahead), large requests (bypass),
+ * the FAT area (pinned lines), the end of the card and buffers that are not
+ * word aligned (staging). Some card reads fail on purpose, the cache has to
+ * stay coherent. Each run ends on a card swap, after which nothing of the
+ * old card may be read back.
+ */
+
+#include "bl_test.h"
+#include "bl_sdcache.h"
+#include "bl_sd.h"
+#include "stm32h7xx_hal.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SECTOR       512
+#define CARD_SECTORS 2048
+#define HOT_SECTORS  160  // more than the cache holds
+#define FAT_FIRST    32
+#define FAT_SECTORS  16
+#define OPERATIONS   20000
+
+SD_HandleTypeDef hsd1;
+
+static uint8_t card[CARD_SECTORS][SECTOR];
+static uint8_t model[CARD_SECTORS][SECTOR];
+
+// Card reads fail at this rate, in percent
+static int fail_rate;
+static uint32_t failed;
+
+/* ********************** Card ****************************** */
+
+bool BL_Sd_Transfer(BL_SdOp_t op, uint8_t *data, uint32_t sector, uint32_t count, uint32_t timeout) {
+    BL_TEST_CHECK(((uintptr_t)data & 3) == 0, "buffer %p not word aligned", (void *)data);
+    BL_TEST_CHECK(count > 0 && sector < CARD_SECTORS && count <= CARD_SECTORS - sector,
+                  "transfer of %u sectors at %u", count, sector);
+    if (count == 0 || sector >= CARD_SECTORS || count > CARD_SECTORS - sector) {
+        return false;
+    }
+    if (op == BL_SD_READ) {
+        if (rand() % 100 < fail_rate) {
+            failed++;
+            return false;
+        }
+        memcpy(data, card[sector], (size_t)count * SECTOR);
+    } else {
+        memcpy(card[sector], data, (size_t)count * SECTOR);
+    }
+    return true;
+}
+
+// A new card with random contents, the reference starts out the same
+static void Card_Insert(uint32_t id) {
+    for (uint32_t s = 0; s < CARD_SECTORS; s++) {
+        for (uint32_t i = 0; i < SECTOR; i++) {
+            card[s][i] = rand();
+        }
+    }
+    memcpy(model, card, sizeof(card));
+    memset(&hsd1, 0, sizeof(hsd1));
+    hsd1.CID[0] = id;
+    hsd1.SdCard.LogBlockNbr = CARD_SECTORS;
+    BL_SdCache_Attach();
+    BL_SdCache_Pin(FAT_FIRST, FAT_SECTORS);
+}
+
+static void Card_Compare(const char *name) {
+    for (uint32_t s = 0; s < CARD_SECTORS; s++) {
+        if (memcmp(card[s], model[s], SECTOR) != 0) {
+            BL_TEST_CHECK(false, "%s: sector %u on the card differs from the reference", name, s);
+            return;
+        }
+    }
+}
+
+/* ********************** Tests ****************************** */
+
+static uint32_t next_sector;
+
+// Where the next request goes and how long it is
+static void Pick(uint32_t *sector, uint32_t *count) {
+    int where = rand() % 100;
+    *count = (rand() % 5 == 0) ? BL_SDCACHE_BYPASS + rand() % 12 : 1 + rand() % 4;
+
+    if (where < 50) {
+        *sector = rand() % HOT_SECTORS;
+    } else if (where < 75) {
+        *sector = next_sector;
+    } else if (where < 85) {
+        *sector = FAT_FIRST + rand() % FAT_SECTORS;
+        *count = 1;
+    } else if (where < 90) {
+        *sector = CARD_SECTORS - 1 - rand() % 16;
+    } else {
+        *sector = rand() % CARD_SECTORS;
+    }
+    if (*sector >= CARD_SECTORS) {
+        *sector = 0;
+    }
+    if (*count > CARD_SECTORS - *sector) {
+        *count = CARD_SECTORS - *sector;
+    }
+    next_sector = *sector + *count;
+}
+
+static void TestRandom(uint32_t seed) {
+    static uint8_t buffer[32 * SECTOR + 4];
+    char name[32];
+    uint32_t flushes = 0;
+
+    srand(seed);
+    snprintf(name, sizeof(name), "seed %u", seed);
+    fail_rate = (seed % 2) ? 2 : 0;
+    failed = 0;
+    Card_Insert(seed);
+
+    for (uint32_t op = 0; op < OPERATIONS; op++) {
+        int what = rand() % 100;
+        uint32_t sector, count;
+        // Word aligned or not, the cache stages the latter
+        uint8_t *buff = buffer + ((rand() % 4 == 0) ? 1 : 0);
+
+        Pick(&sector, &count);
+        if (what < 50) {
+            uint32_t before = failed;
+            bool ok = BL_SdCache_Read(buff, sector, count);
+            BL_TEST_CHECK(ok || failed != before, "%s: read of %u sectors at %u failed", name, count, sector);
+            if (ok && memcmp(buff, model[sector], (size_t)count * SECTOR) != 0) {
+                BL_TEST_CHECK(false, "%s: read of %u sectors at %u returned stale data", name, count, sector);
+            }
+        } else if (what < 98) {
+            for (uint32_t i = 0; i < count * SECTOR; i++) {
+                buff[i] = rand();
+            }
+            BL_TEST_CHECK(BL_SdCache_Write(buff, sector, count), "%s: write of %u sectors at %u failed", name,
+                          count, sector);
+            memcpy(model[sector], buff, (size_t)count * SECTOR);
+        } else if (what < 99) {
+            BL_TEST_CHECK(BL_SdCache_Flush(), "%s: flush failed", name);
+            Card_Compare(name);
+            flushes++;
+        } else {
+            // Same card again, the cache is kept
+            BL_SdCache_Attach();
+        }
+    }
+    BL_TEST_CHECK(BL_SdCache_Flush(), "%s: final flush failed", name);
+    Card_Compare(name);
+
+    // Another card, everything cached of this one has to go
+    fail_rate = 0;
+    Card_Insert(seed + 1000);
+    for (uint32_t s = 0; s < CARD_SECTORS; s += 4) {
+        BL_TEST_CHECK(BL_SdCache_Read(buffer, s, 4), "%s: read after the swap failed", name);
+        if (memcmp(buffer, model[s], 4 * SECTOR) != 0) {
+            BL_TEST_CHECK(false, "%s: sectors %u-%u of the old card read after the swap", name, s, s + 3);
+            break;
+        }
+    }
+    printf("%s: %u operations, %u flushes, %u failed card reads\n", name, OPERATIONS, flushes, failed);
+}
+
+int main(void) {
+    for (uint32_t seed = 1; seed <= 8; seed++) {
+        TestRandom(seed);
+    }
+
+    const BL_SdCacheStats_t *stats = BL_SdCache_Stats();
+    BL_TEST_CHECK(stats->hits > 0 && stats->misses > 0, "no hits or no misses");
+    BL_TEST_CHECK(stats->ahead_hits > 0, "read-ahead never used");
+    BL_TEST_CHECK(stats->bypass > 0, "no request bypassed the cache");
+    BL_TEST_CHECK(stats->evictions > 0, "nothing evicted");
+    BL_TEST_CHECK(stats->writebacks > 0 && stats->writebacks <= stats->writes, "%u written back of %u writes",
+                  stats->writebacks, stats->writes);
+    BL_SdCache_Report();
+    return BL_TEST_DONE("bl_test_sdcache");
+}
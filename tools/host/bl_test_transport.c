@@ -0,0 +1,225 @@
+/*
+ * bl_test_transport.c
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Host test of the transport state machine (CM7/Core/Src/bl_transport.c)
+ * on the fake UART of bl_transport_fake.c: RX ring wrap and overrun, TX
+ * slot queueing with both slots busy, deadline expiry (also across the
+ * tick wrap) and baud rate changes.
+ */
+
+#include "bl_test.h"
+#include "bl_transport_fake.h"
+#include <string.h>
+
+static BL_Transport_t link;
+static BL_TransportFake_t fake;
+
+static void Fill(uint8_t *data, uint16_t length, uint8_t seed) {
+    for (uint16_t i = 0; i < length; i++) {
+        data[i] = (uint8_t)(seed + i * 7);
+    }
+}
+
+/* ********************** Receive ****************************** */
+
+static void TestRxWrap(void) {
+    uint8_t in[BL_TRANSPORT_RX_SIZE], out[BL_TRANSPORT_RX_SIZE];
+
+    BL_TransportFake_SetTick(0);
+    BL_TransportFake_Init(&link, &fake);
+
+    // Move the tail close to the end of the ring
+    Fill(in, BL_TRANSPORT_RX_SIZE - 10, 1);
+    BL_Transport_RxPush(&link, in, BL_TRANSPORT_RX_SIZE - 10);
+    BL_TEST_CHECK(BL_Transport_Receive(&link, out, BL_TRANSPORT_RX_SIZE - 10, 0), "first fill");
+    BL_TEST_CHECK(memcmp(in, out, BL_TRANSPORT_RX_SIZE - 10) == 0, "first fill data");
+
+    // A frame across the end of the ring comes out in one piece
+    Fill(in, 300, 2);
+    BL_Transport_RxPush(&link, in, 300);
+    BL_TEST_CHECK(link.rx_head < link.rx_tail, "head %u behind tail %u after the wrap", link.rx_head,
+                  link.rx_tail);
+    BL_TEST_CHECK(BL_Transport_Available(&link) == 300, "%u available", BL_Transport_Available(&link));
+    memset(out, 0, sizeof(out));
+    BL_TEST_CHECK(BL_Transport_Receive(&link, out, 300, 0), "receive across the wrap");
+    BL_TEST_CHECK(memcmp(in, out, 300) == 0, "data across the wrap");
+    BL_TEST_CHECK(BL_Transport_Available(&link) == 0, "ring empty");
+    BL_TEST_CHECK(link.rx_overruns == 0, "%u overruns", link.rx_overruns);
+}
+
+static void TestRxOverrun(void) {
+    uint8_t in[BL_TRANSPORT_RX_SIZE + 16], out[BL_TRANSPORT_RX_SIZE];
+
+    BL_TransportFake_SetTick(0);
+    BL_TransportFake_Init(&link, &fake);
+
+    // The ring holds one byte less than its size, the rest is dropped
+    Fill(in, sizeof(in), 3);
+    BL_Transport_RxPush(&link, in, sizeof(in));
+    BL_TEST_CHECK(link.rx_overruns == 1, "%u overruns", link.rx_overruns);
+    BL_TEST_CHECK(BL_Transport_Available(&link) == BL_TRANSPORT_RX_SIZE - 1, "%u available",
+                  BL_Transport_Available(&link));
+    BL_TEST_CHECK(BL_Transport_Receive(&link, out, BL_TRANSPORT_RX_SIZE - 1, 0), "receive the full ring");
+    BL_TEST_CHECK(memcmp(in, out, BL_TRANSPORT_RX_SIZE - 1) == 0, "kept the oldest bytes");
+
+    // Room again after reading
+    BL_Transport_RxPush(&link, in, 5);
+    BL_TEST_CHECK(link.rx_overruns == 1 && BL_Transport_Available(&link) == 5, "push after the overrun");
+
+    // Overrun on a ring that wrapped
+    BL_Transport_Flush(&link);
+    BL_Transport_RxPush(&link, in, BL_TRANSPORT_RX_SIZE);
+    BL_TEST_CHECK(link.rx_overruns == 2, "%u overruns after the wrap", link.rx_overruns);
+    BL_TEST_CHECK(BL_Transport_Receive(&link, out, BL_TRANSPORT_RX_SIZE - 1, 0), "receive the wrapped ring");
+    BL_TEST_CHECK(memcmp(in, out, BL_TRANSPORT_RX_SIZE - 1) == 0, "wrapped ring data");
+}
+
+static void TestRxDeadline(void) {
+    uint8_t reply[4] = {0x79, 1, 2, 3}, out[4];
+
+    BL_TransportFake_SetTick(1000);
+    BL_TransportFake_Init(&link, &fake);
+
+    // Nothing comes: fails exactly at the deadline
+    uint32_t deadline = BL_Transport_Deadline(&link, 10);
+    BL_TEST_CHECK(!BL_Transport_Receive(&link, out, 1, deadline), "receive without data");
+    BL_TEST_CHECK(BL_TransportFake_Tick() == deadline, "gave up at %u, deadline %u", BL_TransportFake_Tick(),
+                  deadline);
+
+    // Bytes that arrive before the deadline, spread over the wait
+    BL_TransportFake_Receive(&fake, reply, 2, BL_TransportFake_Tick() + 3);
+    BL_TransportFake_Receive(&fake, &reply[2], 2, BL_TransportFake_Tick() + 9);
+    deadline = BL_Transport_Deadline(&link, 10);
+    BL_TEST_CHECK(BL_Transport_Receive(&link, out, 4, deadline), "receive in time");
+    BL_TEST_CHECK(memcmp(reply, out, 4) == 0, "data in time");
+
+    // A byte one tick late is missed, and there for the next call
+    BL_TransportFake_Receive(&fake, reply, 1, BL_TransportFake_Tick() + 11);
+    deadline = BL_Transport_Deadline(&link, 10);
+    BL_TEST_CHECK(!BL_Transport_Receive(&link, out, 1, deadline), "late byte");
+    BL_TEST_CHECK(BL_Transport_Receive(&link, out, 1, BL_Transport_Deadline(&link, 10)) && out[0] == 0x79,
+                  "late byte on the next call");
+
+    // Deadlines across the tick wrap
+    BL_TransportFake_SetTick(0xFFFFFFF0);
+    deadline = BL_Transport_Deadline(&link, 32);
+    BL_TEST_CHECK(!BL_Transport_Receive(&link, out, 1, deadline), "receive across the tick wrap");
+    BL_TEST_CHECK(BL_TransportFake_Tick() == 16, "gave up at %u after the tick wrap", BL_TransportFake_Tick());
+    BL_TransportFake_SetTick(0xFFFFFFF0);
+    BL_TransportFake_Receive(&fake, reply, 1, 5);
+    BL_TEST_CHECK(BL_Transport_Receive(&link, out, 1, BL_Transport_Deadline(&link, 32)),
+                  "byte after the tick wrap");
+}
+
+/* ********************** Transmit ****************************** */
+
+static void TestTxSlots(void) {
+    uint8_t a[BL_TRANSPORT_TX_SIZE], b[100], c[3] = {0x31, 0xCE, 0};
+    BL_TransportSpan_t spans[] = {{c, 1}, {b, 100}, {c, 2}};
+
+    BL_TransportFake_SetTick(0);
+    BL_TransportFake_Init(&link, &fake);
+    Fill(a, sizeof(a), 4);
+    Fill(b, sizeof(b), 5);
+
+    // The first frame goes out at once, the second waits in the other slot
+    BL_TEST_CHECK(BL_Transport_Send(&link, a, sizeof(a), 5), "first frame");
+    BL_TEST_CHECK(fake.tx_starts == 1 && fake.tx_last_length == sizeof(a), "first frame started");
+    BL_TEST_CHECK(BL_Transport_SendV(&link, spans, 3, 5), "second frame");
+    BL_TEST_CHECK(fake.tx_starts == 1 && link.tx_queued == 2, "second frame queued, %u started",
+                  fake.tx_starts);
+    BL_TEST_CHECK(BL_TransportFake_Tick() == 0, "queued without waiting");
+
+    // Both slots busy: the third frame waits and gives up at its deadline
+    BL_TEST_CHECK(!BL_Transport_Send(&link, c, 2, 7), "third frame with both slots busy");
+    BL_TEST_CHECK(BL_TransportFake_Tick() == 7, "gave up at %u", BL_TransportFake_Tick());
+    BL_TEST_CHECK(!BL_Transport_WaitTx(&link, 9), "wait with both slots busy");
+
+    // Completing the first starts the second, gathered into one transfer
+    BL_TransportFake_CompleteTx(&link);
+    BL_TEST_CHECK(fake.tx_starts == 2 && fake.tx_last_length == 103, "second frame started");
+    BL_TEST_CHECK(BL_Transport_Send(&link, c, 2, 20), "third frame once a slot is free");
+    BL_TransportFake_CompleteTx(&link);
+    BL_TEST_CHECK(fake.tx_starts == 3 && fake.tx_last_length == 2, "third frame started");
+    BL_TransportFake_CompleteTx(&link);
+    BL_TEST_CHECK(link.tx_queued == 0 && !fake.tx_busy, "line idle");
+    BL_TEST_CHECK(BL_Transport_WaitTx(&link, 20), "wait on an idle line");
+
+    // The wire holds the frames in order
+    uint8_t expected[BL_TRANSPORT_TX_SIZE + 105];
+    memcpy(expected, a, sizeof(a));
+    expected[sizeof(a)] = c[0];
+    memcpy(&expected[sizeof(a) + 1], b, 100);
+    memcpy(&expected[sizeof(a) + 101], c, 2);
+    memcpy(&expected[sizeof(a) + 103], c, 2);
+    BL_TEST_CHECK(fake.wire_length == sizeof(expected), "%u bytes on the wire", fake.wire_length);
+    BL_TEST_CHECK(memcmp(fake.wire, expected, sizeof(expected)) == 0, "wire data");
+
+    // Too large for a slot
+    uint8_t big[BL_TRANSPORT_TX_SIZE + 1] = {0};
+    BL_TEST_CHECK(!BL_Transport_Send(&link, big, sizeof(big), 100), "frame larger than a slot");
+
+    // Completion while waiting frees the slot before the deadline
+    fake.complete_on_idle = true;
+    for (uint8_t i = 0; i < 5; i++) {
+        BL_TEST_CHECK(BL_Transport_Send(&link, b, 50, BL_Transport_Deadline(&link, 10)), "frame %u", i);
+    }
+    BL_TEST_CHECK(BL_Transport_WaitTx(&link, BL_Transport_Deadline(&link, 10)), "drained");
+
+    // A transfer that can't start frees its slot again
+    fake.complete_on_idle = false;
+    fake.fail_start = true;
+    BL_TEST_CHECK(!BL_Transport_Send(&link, b, 10, 100), "start fails");
+    BL_TEST_CHECK(link.tx_queued == 0, "%u queued after the failed start", link.tx_queued);
+    fake.fail_start = false;
+    BL_TEST_CHECK(BL_Transport_Send(&link, b, 10, 100), "send after the failed start");
+    BL_TransportFake_CompleteTx(&link);
+}
+
+/* ********************** Baud rate ****************************** */
+
+static void TestBaudrate(void) {
+    uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    BL_TransportFake_SetTick(0);
+    BL_TransportFake_Init(&link, &fake);
+
+    // A change drops what was queued and received
+    BL_TEST_CHECK(BL_Transport_Send(&link, data, 8, 10) && BL_Transport_Send(&link, data, 8, 10), "queue two");
+    BL_Transport_RxPush(&link, data, 8);
+    BL_TransportFake_Receive(&fake, data, 8, 5);
+    BL_TEST_CHECK(BL_Transport_SetBaudrate(&link, 921600), "set 921600");
+    BL_TEST_CHECK(link.baudrate == 921600 && fake.baudrate == 921600, "rate %u", link.baudrate);
+    BL_TEST_CHECK(link.tx_queued == 0, "%u frames queued after the change", link.tx_queued);
+    BL_TEST_CHECK(BL_Transport_Available(&link) == 0, "%u bytes received after the change",
+                  BL_Transport_Available(&link));
+    BL_TransportFake_SetTick(10);
+    BL_TEST_CHECK(BL_Transport_Available(&link) == 0, "bytes in flight dropped");
+
+    // Both slots are free again and the line starts at once
+    uint32_t starts = fake.tx_starts;
+    BL_TEST_CHECK(BL_Transport_Send(&link, data, 8, 10) && fake.tx_starts == starts + 1, "send after the change");
+    BL_TransportFake_CompleteTx(&link);
+
+    // A failed change keeps the old rate
+    fake.fail_baudrate = true;
+    BL_TEST_CHECK(!BL_Transport_SetBaudrate(&link, 115200), "failed change");
+    BL_TEST_CHECK(link.baudrate == 921600, "rate %u after the failed change", link.baudrate);
+
+    // Without set_baudrate only the current rate is accepted
+    BL_TransportFake_InitFixedRate(&link, &fake, 115200);
+    BL_TEST_CHECK(BL_Transport_SetBaudrate(&link, 115200), "fixed rate, same rate");
+    BL_TEST_CHECK(!BL_Transport_SetBaudrate(&link, 921600), "fixed rate, other rate");
+    BL_TEST_CHECK(link.baudrate == 115200, "fixed rate %u", link.baudrate);
+}
+
+int main(void) {
+    TestRxWrap();
+    TestRxOverrun();
+    TestRxDeadline();
+    TestTxSlots();
+    TestBaudrate();
+    return BL_TEST_DONE("bl_test_transport");
+}
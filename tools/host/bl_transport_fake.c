@@ -0,0 +1,119 @@
+/*
+ * bl_transport_fake.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_transport_fake.h"
+#include <string.h>
+
+static uint32_t fake_tick;
+
+static BL_TransportFake_t *BL_TransportFake_Get(BL_Transport_t *t) {
+    return t->ctx;
+}
+
+static uint32_t BL_TransportFake_GetTick(void) {
+    return fake_tick;
+}
+
+static bool BL_TransportFake_StartTx(BL_Transport_t *t, const uint8_t *data, uint16_t length) {
+    BL_TransportFake_t *f = BL_TransportFake_Get(t);
+    if (f->fail_start) {
+        return false;
+    }
+
+    f->tx_busy = true;
+    f->tx_starts++;
+    f->tx_last_length = length;
+    if (f->wire_length + length <= BL_FAKE_WIRE_SIZE) {
+        memcpy(&f->wire[f->wire_length], data, length);
+        f->wire_length += length;
+    }
+    return true;
+}
+
+static void BL_TransportFake_RxPoll(BL_Transport_t *t) {
+    BL_TransportFake_t *f = BL_TransportFake_Get(t);
+    while (f->rx_next < f->rx_count && (int32_t)(fake_tick - f->rx_at[f->rx_next]) >= 0) {
+        BL_Transport_RxPush(t, &f->rx_data[f->rx_next++], 1);
+    }
+}
+
+static void BL_TransportFake_RxReset(BL_Transport_t *t) {
+    BL_TransportFake_t *f = BL_TransportFake_Get(t);
+    f->rx_resets++;
+    f->rx_next = f->rx_count; // what was on its way is lost with the old rate
+    t->rx_tail = t->rx_head;
+}
+
+static void BL_TransportFake_Idle(BL_Transport_t *t) {
+    BL_TransportFake_t *f = BL_TransportFake_Get(t);
+    f->idles++;
+    fake_tick += f->idle_ms;
+    if (f->complete_on_idle && f->tx_busy) {
+        BL_TransportFake_CompleteTx(t);
+    }
+}
+
+static bool BL_TransportFake_SetBaudrate(BL_Transport_t *t, uint32_t baudrate) {
+    BL_TransportFake_t *f = BL_TransportFake_Get(t);
+    if (f->fail_baudrate) {
+        return false;
+    }
+    f->baudrate = baudrate;
+    f->tx_busy = false; // the UART is stopped to change the rate
+    BL_TransportFake_RxReset(t);
+    return true;
+}
+
+static const BL_TransportOps_t fake_ops = {
+    .start_tx = BL_TransportFake_StartTx,
+    .rx_poll = BL_TransportFake_RxPoll,
+    .rx_reset = BL_TransportFake_RxReset,
+    .get_tick = BL_TransportFake_GetTick,
+    .idle = BL_TransportFake_Idle,
+    .set_baudrate = BL_TransportFake_SetBaudrate,
+};
+
+static const BL_TransportOps_t fake_fixed_ops = {
+    .start_tx = BL_TransportFake_StartTx,
+    .rx_poll = BL_TransportFake_RxPoll,
+    .rx_reset = BL_TransportFake_RxReset,
+    .get_tick = BL_TransportFake_GetTick,
+    .idle = BL_TransportFake_Idle,
+};
+
+void BL_TransportFake_Init(BL_Transport_t *t, BL_TransportFake_t *f) {
+    memset(f, 0, sizeof(*f));
+    f->idle_ms = 1;
+    BL_Transport_Init(t, &fake_ops, f);
+}
+
+void BL_TransportFake_InitFixedRate(BL_Transport_t *t, BL_TransportFake_t *f, uint32_t baudrate) {
+    memset(f, 0, sizeof(*f));
+    f->idle_ms = 1;
+    BL_Transport_Init(t, &fake_fixed_ops, f);
+    t->baudrate = baudrate;
+}
+
+void BL_TransportFake_SetTick(uint32_t tick) {
+    fake_tick = tick;
+}
+
+uint32_t BL_TransportFake_Tick(void) {
+    return fake_tick;
+}
+
+void BL_TransportFake_CompleteTx(BL_Transport_t *t) {
+    BL_TransportFake_t *f = BL_TransportFake_Get(t);
+    f->tx_busy = false;
+    BL_Transport_TxDone(t); // may start the next slot, which sets tx_busy again
+}
+
+void BL_TransportFake_Receive(BL_TransportFake_t *f, const uint8_t *data, uint16_t length, uint32_t tick) {
+    for (uint16_t i = 0; i < length && f->rx_count < BL_FAKE_RX_SIZE; i++) {
+        f->rx_data[f->rx_count] = data[i];
+        f->rx_at[f->rx_count++] = tick;
+    }
+}
@@ -0,0 +1,59 @@
+/*
+ * bl_transport_fake.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef HOST_BL_TRANSPORT_FAKE_H_
+#define HOST_BL_TRANSPORT_FAKE_H_
+
+#include "bl_transport.h"
+
+// Fake UART backend for the host tests of the transport. Time is virtual:
+// the clock only moves when the test sets it or while the transport waits
+// (every idle call advances it by idle_ms), so deadlines expire at exact
+// ticks. A transfer started by the transport stays on the wire until the
+// test completes it, like the TX complete interrupt would, or until the
+// next idle call with complete_on_idle. Received bytes are scheduled with
+// a tick and pushed into the ring by rx_poll once the clock reaches it.
+
+#define BL_FAKE_WIRE_SIZE 4096
+#define BL_FAKE_RX_SIZE   4096
+
+typedef struct {
+    uint32_t idle_ms;           // clock advance per idle call
+    bool complete_on_idle;      // an idle call completes the transfer on the wire
+    bool fail_start;            // start_tx fails
+    bool fail_baudrate;         // set_baudrate fails
+
+    // TX
+    bool tx_busy;               // a transfer is on the wire
+    uint32_t tx_starts;
+    uint16_t tx_last_length;
+    uint8_t wire[BL_FAKE_WIRE_SIZE]; // every byte started, in order
+    uint32_t wire_length;
+
+    // RX, bytes and the tick they arrive at
+    uint8_t rx_data[BL_FAKE_RX_SIZE];
+    uint32_t rx_at[BL_FAKE_RX_SIZE];
+    uint32_t rx_count;
+    uint32_t rx_next;
+
+    uint32_t baudrate;          // last rate set_baudrate took
+    uint32_t rx_resets;
+    uint32_t idles;
+} BL_TransportFake_t;
+
+void BL_TransportFake_Init(BL_Transport_t *t, BL_TransportFake_t *f);
+// With set_baudrate left out of the ops
+void BL_TransportFake_InitFixedRate(BL_Transport_t *t, BL_TransportFake_t *f, uint32_t baudrate);
+
+void BL_TransportFake_SetTick(uint32_t tick);
+uint32_t BL_TransportFake_Tick(void);
+
+// The transfer on the wire is done, the transport starts the queued one
+void BL_TransportFake_CompleteTx(BL_Transport_t *t);
+// Bytes from the target, arriving at tick
+void BL_TransportFake_Receive(BL_TransportFake_t *f, const uint8_t *data, uint16_t length, uint32_t tick);
+
+#endif /* HOST_BL_TRANSPORT_FAKE_H_ */
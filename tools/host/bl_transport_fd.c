@@ -0,0 +1,132 @@
+/*
+ * bl_transport_fd.c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "bl_transport_fd.h"
+#include "stm32h7xx_hal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+static int BL_TransportFd_Get(BL_Transport_t *t) {
+    return (int)(intptr_t)t->ctx;
+}
+
+static bool BL_TransportFd_StartTx(BL_Transport_t *t, const uint8_t *data, uint16_t length) {
+    int fd = BL_TransportFd_Get(t);
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                struct pollfd p = {fd, POLLOUT, 0};
+                poll(&p, 1, 10);
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        length -= n;
+    }
+    // Written in full, which is what the TX complete interrupt says on the board
+    BL_Transport_TxDone(t);
+    return true;
+}
+
+static void BL_TransportFd_RxPoll(BL_Transport_t *t) {
+    uint8_t buf[256];
+    ssize_t n;
+    while ((n = read(BL_TransportFd_Get(t), buf, sizeof(buf))) > 0) {
+        BL_Transport_RxPush(t, buf, n);
+    }
+}
+
+static void BL_TransportFd_RxReset(BL_Transport_t *t) {
+    BL_TransportFd_RxPoll(t);
+    t->rx_tail = t->rx_head;
+}
+
+// Sleep until something arrives instead of spinning
+static void BL_TransportFd_Idle(BL_Transport_t *t) {
+    struct pollfd p = {BL_TransportFd_Get(t), POLLIN, 0};
+    poll(&p, 1, 1);
+}
+
+static speed_t BL_TransportFd_Speed(uint32_t baudrate) {
+    switch (baudrate) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    default: return 0;
+    }
+}
+
+// Socketpairs have no line rate, ttys get the new speed
+static bool BL_TransportFd_SetBaudrate(BL_Transport_t *t, uint32_t baudrate) {
+    int fd = BL_TransportFd_Get(t);
+    struct termios tio;
+    if (isatty(fd)) {
+        speed_t speed = BL_TransportFd_Speed(baudrate);
+        if (speed == 0 || tcgetattr(fd, &tio) != 0) {
+            return false;
+        }
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+            return false;
+        }
+    }
+    BL_TransportFd_RxReset(t);
+    return true;
+}
+
+static const BL_TransportOps_t fd_ops = {
+    .start_tx = BL_TransportFd_StartTx,
+    .rx_poll = BL_TransportFd_RxPoll,
+    .rx_reset = BL_TransportFd_RxReset,
+    .get_tick = HAL_GetTick,
+    .idle = BL_TransportFd_Idle,
+    .set_baudrate = BL_TransportFd_SetBaudrate,
+};
+
+bool BL_TransportFd_Init(BL_Transport_t *t, int fd, uint32_t baudrate) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        return false;
+    }
+    BL_Transport_Init(t, &fd_ops, (void *)(intptr_t)fd);
+    t->baudrate = baudrate;
+    return true;
+}
+
+int BL_TransportFd_OpenTty(const char *path, uint32_t baudrate) {
+    struct termios tio;
+    speed_t speed = BL_TransportFd_Speed(baudrate);
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0 || speed == 0 || tcgetattr(fd, &tio) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= PARENB | CLOCAL | CREAD; // 8 data bits, even parity, 1 stop bit
+    tio.c_cflag &= ~(PARODD | CSTOPB);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
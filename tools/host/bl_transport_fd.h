@@ -0,0 +1,19 @@
+/*
+ * bl_transport_fd.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef HOST_BL_TRANSPORT_FD_H_
+#define HOST_BL_TRANSPORT_FD_H_
+
+#include "bl_transport.h"
+
+// Transport backend on a file descriptor: one end of a socketpair to the
+// simulated ROM bootloader, a pty or a real serial port. Frames are written
+// out synchronously, RX is polled into the ring.
+bool BL_TransportFd_Init(BL_Transport_t *t, int fd, uint32_t baudrate);
+// Open a tty (or pty) in raw 8E1 mode, like the ROM bootloader expects
+int BL_TransportFd_OpenTty(const char *path, uint32_t baudrate);
+
+#endif /* HOST_BL_TRANSPORT_FD_H_ */
@@ -0,0 +1,63 @@
+#!/bin/sh
+# Build the host tools: bl_host (protocol engine + ROM bootloader model),
+# bl_bench (the flashing benchmark against the model) and bl_sim (the model
+# on a pty), then build and run the host tests (bl_test_*.c, bl_test_pipe
+# compares the CM4 pipe parse with the local one of the CM7), the line
+# reader comparison and an upload through the flash loader model. Output
+# goes to _host/ in the repository root, CC and CFLAGS are taken from the
+# environment. Fails when a test fails.
+set -e
+cd "$(dirname "$0")/../.."
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2 -g -Wall -Wno-unused-parameter}
+OUT=_host
+DEFS="-DCORE_CM7"
+INC="-Itools/host/include -Itools/host -ICM7/Core/Inc -ICommon/Inc"
+
+ENGINE="CM7/Core/Src/bootloader.c CM7/Core/Src/bl_transport.c CM7/Core/Src/bl_crc.c CM7/Core/Src/bl_rto.c
+        CM7/Core/Src/bl_flash.c CM7/Core/Src/bl_device.c CM7/Core/Src/bl_erase.c CM7/Core/Src/bl_journal.c CM7/Core/Src/bl_diff.c
+        CM7/Core/Src/bl_verify.c CM7/Core/Src/bl_image.c CM7/Core/Src/bl_loader.c
+        CM7/Core/Src/bl_bench.c CM7/Core/Src/bl_lines.c Common/Src/bl_hex.c Common/Src/bl_coalesce.c"
+HOST="tools/host/bl_host_port.c tools/host/ff_posix.c tools/host/bl_transport_fd.c
+      tools/host/bl_sim_rom.c"
+
+mkdir -p "$OUT"
+$CC $CFLAGS -std=gnu11 $DEFS $INC -o "$OUT/bl_host" tools/host/bl_host.c $HOST $ENGINE
+$CC $CFLAGS -std=gnu11 $DEFS $INC -o "$OUT/bl_bench" tools/host/bl_bench_host.c $HOST $ENGINE
+$CC $CFLAGS -std=gnu11 $DEFS $INC -o "$OUT/bl_sim" tools/host/bl_sim.c tools/host/bl_sim_rom.c
+echo "Built $OUT/bl_host $OUT/bl_bench $OUT/bl_sim"
+
+# Host tests, each exits non-zero when a check fails
+FIXTURES=tools/host/fixtures
+$CC $CFLAGS -std=gnu11 $DEFS $INC -o "$OUT/bl_test_coalesce" tools/host/bl_test_coalesce.c \
+    tools/host/bl_host_port.c Common/Src/bl_hex.c Common/Src/bl_coalesce.c
+"$OUT/bl_test_coalesce" $FIXTURES/*.hex
+$CC $CFLAGS -std=gnu11 $DEFS $INC -o "$OUT/bl_test_transport" tools/host/bl_test_transport.c \
+    tools/host/bl_transport_fake.c CM7/Core/Src/bl_transport.c
+"$OUT/bl_test_transport"
+$CC $CFLAGS -std=gnu11 $DEFS $INC -o "$OUT/bl_test_sdcache" tools/host/bl_test_sdcache.c CM7/Core/Src/bl_sdcache.c
+"$OUT/bl_test_sdcache"
+$CC $CFLAGS -std=gnu11 $DEFS $INC -o "$OUT/bl_test_pipe" tools/host/bl_test_pipe.c tools/host/ff_posix.c \
+    tools/host/bl_host_port.c CM7/Core/Src/bl_lines.c Common/Src/bl_hex.c Common/Src/bl_coalesce.c
+"$OUT/bl_test_pipe" $FIXTURES/*.hex
+
+# Line reader against f_gets, on the real FatFs over a RAM disk
+FATFS=Middlewares/Third_Party/FatFs/src
+$CC $CFLAGS -std=gnu11 -D__MAIN_H -D__STM32H7_SD_H -I$FATFS -ICM7/FATFS/Target $INC \
+    -o "$OUT/bl_lines_bench" tools/host/bl_lines_bench.c CM7/Core/Src/bl_lines.c $FATFS/ff.c $FATFS/option/ccsbcs.c
+"$OUT/bl_lines_bench" $FIXTURES/*.hex
+"$OUT/bl_lines_bench"
+
+# Upload through the flash loader model, any file stands in for the stub
+CARD=$(mktemp -d)
+trap 'rm -rf "$CARD"' EXIT
+cp $FIXTURES/blinky.hex "$CARD"
+head -c 1024 /dev/zero > "$CARD/loader.bin"
+if ! "$OUT/bl_host" --root "$CARD" --baud 921600 --loader loader.bin --nack 0.05 blinky.hex > "$CARD/log" 2>&1 ||
+   ! grep -q "stub running" "$CARD/log"; then
+    cat "$CARD/log"
+    exit 1
+fi
+echo "bl_host: upload through the flash loader model passed"
+echo "Host tests passed"
@@ -0,0 +1,186 @@
+/*
+ * ff_posix.c
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * FatFs API on top of stdio, see include/ff.h
+ */
+
+#include "fatfs.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+char SDPath[4] = "0:/";
+FATFS SDFatFS;
+FIL SDFile;
+
+static const char *root = ".";
+
+void FF_Posix_SetRoot(const char *dir) {
+    root = dir;
+}
+
+// "0:/dir/file", "/dir/file" and "dir/file" all name root/dir/file
+static const char *FF_Posix_Path(const TCHAR *path, char *out, size_t size) {
+    if (path[0] >= '0' && path[0] <= '9' && path[1] == ':') {
+        path += 2;
+    }
+    while (*path == '/') {
+        path++;
+    }
+    snprintf(out, size, "%s/%s", root, path);
+    return out;
+}
+
+static FRESULT FF_Posix_Error(void) {
+    switch (errno) {
+    case ENOENT:
+        return FR_NO_FILE;
+    case ENOTDIR:
+        return FR_NO_PATH;
+    case EEXIST:
+        return FR_EXIST;
+    case EACCES:
+    case EISDIR:
+        return FR_DENIED;
+    case EROFS:
+        return FR_WRITE_PROTECTED;
+    default:
+        return FR_DISK_ERR;
+    }
+}
+
+FRESULT f_mount(FATFS *fs, const TCHAR *path, BYTE opt) {
+    struct stat st;
+    if (stat(root, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return FR_NOT_READY;
+    }
+    fs->mounted = 1;
+    return FR_OK;
+}
+
+FRESULT f_open(FIL *fp, const TCHAR *path, BYTE mode) {
+    char name[512];
+    struct stat st;
+    const char *how;
+
+    FF_Posix_Path(path, name, sizeof(name));
+    bool exists = stat(name, &st) == 0;
+
+    if ((mode & FA_CREATE_NEW) && exists) {
+        return FR_EXIST;
+    }
+    if ((mode & (FA_CREATE_NEW | FA_CREATE_ALWAYS | FA_OPEN_ALWAYS)) == 0 && !exists) {
+        return FR_NO_FILE;
+    }
+
+    if (mode & FA_CREATE_ALWAYS) {
+        how = (mode & FA_READ) ? "w+b" : "wb";
+    } else if (!exists) {
+        how = (mode & FA_READ) ? "w+b" : "wb";
+    } else {
+        how = (mode & FA_WRITE) ? "r+b" : "rb";
+    }
+
+    fp->fp = fopen(name, how);
+    if (fp->fp == NULL) {
+        return FF_Posix_Error();
+    }
+    fseek(fp->fp, 0, SEEK_END);
+    fp->size = ftell(fp->fp);
+    fp->fptr = 0;
+    fseek(fp->fp, 0, SEEK_SET);
+
+    if ((mode & FA_OPEN_APPEND) == FA_OPEN_APPEND) {
+        return f_lseek(fp, fp->size);
+    }
+    return FR_OK;
+}
+
+FRESULT f_close(FIL *fp) {
+    if (fp->fp == NULL) {
+        return FR_INVALID_OBJECT;
+    }
+    int r = fclose(fp->fp);
+    fp->fp = NULL;
+    return r == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br) {
+    size_t n = fread(buff, 1, btr, fp->fp);
+    *br = n;
+    fp->fptr += n;
+    return ferror(fp->fp) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw) {
+    size_t n = fwrite(buff, 1, btw, fp->fp);
+    *bw = n;
+    fp->fptr += n;
+    if (fp->fptr > fp->size) {
+        fp->size = fp->fptr;
+    }
+    return n == btw ? FR_OK : FR_DISK_ERR;
+}
+
+// Like FatFs, seeking past the end of a file opened for writing extends it
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs) {
+    if (fseek(fp->fp, ofs, SEEK_SET) != 0) {
+        return FR_DISK_ERR;
+    }
+    fp->fptr = ofs;
+    return FR_OK;
+}
+
+FRESULT f_sync(FIL *fp) {
+    return fflush(fp->fp) == 0 ? FR_OK : FR_DISK_ERR;
+}
+
+// FAT timestamps of the modification time
+FRESULT f_stat(const TCHAR *path, FILINFO *fno) {
+    char name[512];
+    struct stat st;
+    struct tm tm;
+
+    if (stat(FF_Posix_Path(path, name, sizeof(name)), &st) != 0) {
+        return FF_Posix_Error();
+    }
+    localtime_r(&st.st_mtime, &tm);
+    fno->fsize = st.st_size;
+    fno->fdate = (WORD)(((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday);
+    fno->ftime = (WORD)((tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2));
+    fno->fattrib = S_ISDIR(st.st_mode) ? 0x10 : 0x20;
+    const char *base = strrchr(name, '/');
+    snprintf(fno->fname, sizeof(fno->fname), "%.255s", base ? base + 1 : name);
+    return FR_OK;
+}
+
+FRESULT f_unlink(const TCHAR *path) {
+    char name[512];
+    return unlink(FF_Posix_Path(path, name, sizeof(name))) == 0 ? FR_OK : FF_Posix_Error();
+}
+
+// _USE_STRFUNC 2: CR is dropped, the line keeps its LF
+TCHAR *f_gets(TCHAR *buff, int len, FIL *fp) {
+    int n = 0;
+    while (n < len - 1) {
+        int c = fgetc(fp->fp);
+        if (c == EOF) {
+            break;
+        }
+        fp->fptr++;
+        if (c == '\r') {
+            continue;
+        }
+        buff[n++] = (TCHAR)c;
+        if (c == '\n') {
+            break;
+        }
+    }
+    buff[n] = '\0';
+    return n ? buff : NULL;
+}
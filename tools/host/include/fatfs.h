@@ -0,0 +1,18 @@
+/*
+ * fatfs.h
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Host stand-in for the CubeMX FatFs glue, the objects live in ff_posix.c
+ */
+
+#ifndef HOST_FATFS_H_
+#define HOST_FATFS_H_
+
+#include "ff.h"
+
+extern char SDPath[4];
+extern FATFS SDFatFS;
+extern FIL SDFile;
+
+#endif /* HOST_FATFS_H_ */
@@ -0,0 +1,93 @@
+/*
+ * ff.h
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Host stand-in for FatFs. The subset of the API the bootloader uses, on
+ * top of the files in a directory (the SD card root, see FF_Posix_SetRoot).
+ * Result codes, open modes and FILINFO fields match FatFs R0.12 with
+ * _USE_STRFUNC 2, so f_gets drops the CR of CRLF line endings like on the
+ * board.
+ */
+
+#ifndef HOST_FF_H_
+#define HOST_FF_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef unsigned int UINT;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef char TCHAR;
+typedef DWORD FSIZE_t;
+
+typedef enum {
+    FR_OK = 0,
+    FR_DISK_ERR,
+    FR_INT_ERR,
+    FR_NOT_READY,
+    FR_NO_FILE,
+    FR_NO_PATH,
+    FR_INVALID_NAME,
+    FR_DENIED,
+    FR_EXIST,
+    FR_INVALID_OBJECT,
+    FR_WRITE_PROTECTED,
+    FR_INVALID_DRIVE,
+    FR_NOT_ENABLED,
+    FR_NO_FILESYSTEM,
+    FR_MKFS_ABORTED,
+    FR_TIMEOUT,
+    FR_LOCKED,
+    FR_NOT_ENOUGH_CORE,
+    FR_TOO_MANY_OPEN_FILES,
+    FR_INVALID_PARAMETER
+} FRESULT;
+
+#define FA_READ          0x01
+#define FA_WRITE         0x02
+#define FA_OPEN_EXISTING 0x00
+#define FA_CREATE_NEW    0x04
+#define FA_CREATE_ALWAYS 0x08
+#define FA_OPEN_ALWAYS   0x10
+#define FA_OPEN_APPEND   0x30
+
+typedef struct {
+    int mounted;
+} FATFS;
+
+typedef struct {
+    FILE *fp;
+    FSIZE_t fptr;
+    FSIZE_t size;
+} FIL;
+
+typedef struct {
+    FSIZE_t fsize;
+    WORD fdate;
+    WORD ftime;
+    BYTE fattrib;
+    TCHAR fname[256];
+} FILINFO;
+
+#define f_tell(fp) ((fp)->fptr)
+#define f_size(fp) ((fp)->size)
+#define f_eof(fp)  ((int)((fp)->fptr == (fp)->size))
+
+// Directory that stands in for the card, relative paths otherwise
+void FF_Posix_SetRoot(const char *root);
+
+FRESULT f_mount(FATFS *fs, const TCHAR *path, BYTE opt);
+FRESULT f_open(FIL *fp, const TCHAR *path, BYTE mode);
+FRESULT f_close(FIL *fp);
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br);
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw);
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs);
+FRESULT f_sync(FIL *fp);
+FRESULT f_stat(const TCHAR *path, FILINFO *fno);
+FRESULT f_unlink(const TCHAR *path);
+TCHAR *f_gets(TCHAR *buff, int len, FIL *fp);
+
+#endif /* HOST_FF_H_ */
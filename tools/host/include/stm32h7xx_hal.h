@@ -0,0 +1,36 @@
+/*
+ * stm32h7xx_hal.h
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Host stand-in for the HAL header. Only what the protocol engine and the
+ * host tests need to compile on Linux, the hardware modules are replaced by
+ * bl_host_port.c.
+ */
+
+#ifndef HOST_STM32H7XX_HAL_H_
+#define HOST_STM32H7XX_HAL_H_
+
+#include <stdint.h>
+
+typedef struct {
+    const char *name;
+} UART_HandleTypeDef;
+
+typedef int IRQn_Type;
+
+// The fields of the SD handle the sector cache reads
+typedef struct {
+    uint32_t LogBlockNbr;
+} HAL_SD_CardInfoTypeDef;
+
+typedef struct {
+    uint32_t CID[4];
+    HAL_SD_CardInfoTypeDef SdCard;
+} SD_HandleTypeDef;
+
+// Milliseconds since the start of the process
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t ms);
+
+#endif /* HOST_STM32H7XX_HAL_H_ */